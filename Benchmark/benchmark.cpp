@@ -0,0 +1,654 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <benchmark/benchmark.h>
+
+#include "../Calculator/parser.h"
+#include "../Calculator/iterative.h"
+#include "../Calculator/compiler.h"
+#include "../Calculator/ast.h"
+#include "../Calculator/optimizer.h"
+#include "../Calculator/jit.h"
+#include "../Calculator/incremental.h"
+#include "../Calculator/shared.h"
+#include "../Calculator/archive.h"
+#include "../Calculator/batch.h"
+#include "../Calculator/gradient.h"
+#include "../Calculator/interval.h"
+#include "../Calculator/kernels.h"
+#include "../Calculator/parallel.h"
+#include "../Calculator/cache.h"
+#include "../Calculator/decimal.h"
+
+//Every benchmark reports how many expressions (or rows) per second it got through, shown inverted as
+//time per expression, and the parsing ones how many bytes per second went through the tokenizer.
+//The expressions come in three shapes:
+//    Short   - The ten expressions main() prints.
+//    Long    - One flat chain of terms, either with long literals or with single digits and many operators.
+//    Nested  - Every term in its own pair of parentheses, as deep as the argument.
+
+//The expressions main() prints, to have something short.
+static const char* const kShortExpressions[] = {
+    "-((6+4))* -(2+2) - -1",
+    "6/5-4-45+3.08",
+    "0.34+ -34/45-2",
+    "(0.03)*73-2",
+    "(20-23 + -5 * (12 / (34 + 3) - 3))",
+    "-25 + 4 * -(32 - 45 / 5 - -6)",
+    "0.0003101 - 34 * (4 + 5) / 23",
+    "1 + ((1 + 1) + 3) + 4 * 5 / 6 - 7",
+    "9 / 8/7 /6/5/4  /  3 /  2/1",
+    "-( -(-( -(2+3*4)+2 )-1)+ 0)",
+};
+
+static const int kShortCount = sizeof(kShortExpressions) / sizeof(kShortExpressions[0]);
+
+//NAME: makeLiteralHeavy
+//DESCRIPTION:  A chain of terms with long literals, so most of the time goes into converting numbers.
+static std::string makeLiteralHeavy(int terms)
+{
+    std::string eq;
+    char literal[32];
+    for (int i = 0; i < terms; i++)
+    {
+        snprintf(literal, sizeof(literal), "%s%d.%06d", i == 0 ? "" : (i % 2 ? " + " : " - "), 100000 + i * 7919, (i * 104729) % 1000000);
+        eq += literal;
+    }
+
+    return eq;
+}
+
+//NAME: makeOperatorHeavy
+//DESCRIPTION:  A chain of single digit terms, so most of the time goes into the operators.
+static std::string makeOperatorHeavy(int terms)
+{
+    static const char kOperators[] = { '+', '*', '-', '/' };
+
+    std::string eq;
+    for (int i = 0; i < terms; i++)
+    {
+        if (i > 0)
+            eq += kOperators[i % 4];
+        eq += (char)('1' + i % 9);
+    }
+
+    return eq;
+}
+
+//NAME: makeNested
+//DESCRIPTION:  (1+(2*(3-(4+ ... )))) as deep as asked for.
+static std::string makeNested(int depth)
+{
+    static const char kOperators[] = { '+', '*', '-', '+' };
+
+    std::string eq;
+    for (int i = 0; i < depth; i++)
+    {
+        eq += '(';
+        eq += (char)('1' + i % 9);
+        eq += kOperators[i % 4];
+    }
+
+    eq += '1';
+    eq.append(depth, ')');
+    return eq;
+}
+
+//NAME: makeFormula
+//DESCRIPTION:  A chain of terms over the variables x, y and z, for the benchmarks that need variables.
+static std::string makeFormula(int terms)
+{
+    static const char* const kTerms[] = { "x * 1.5", "y / 4", "-(z)", "x * y", "(y - 0.25)", "z * z" };
+
+    std::string eq;
+    for (int i = 0; i < terms; i++)
+    {
+        if (i > 0)
+            eq += i % 3 ? " + " : " - ";
+        eq += kTerms[i % 6];
+    }
+
+    return eq;
+}
+
+//NAME: reportRates
+//DESCRIPTION:  Adds the expressions per second and bytes per second to a benchmark's results.
+static void reportRates(benchmark::State& state, int64_t expressions, int64_t bytes)
+{
+    state.SetItemsProcessed(state.iterations() * expressions);
+    if (bytes > 0)
+        state.SetBytesProcessed(state.iterations() * bytes);
+
+    //The inverted rate is seconds per expression, printed with an SI prefix such as 45.2n.
+    state.counters["time/expr"] = benchmark::Counter((double)(state.iterations() * expressions),
+                                                     benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+}
+
+//NAME: solveString
+//DESCRIPTION:  Parses and solves one generated expression over and over.
+static void solveString(benchmark::State& state, const std::string& eq)
+{
+    for (auto _ : state)
+        benchmark::DoNotOptimize(solve(eq.c_str()));
+
+    reportRates(state, 1, (int64_t)eq.size());
+}
+
+static void BM_SolveShort(benchmark::State& state)
+{
+    int64_t bytes = 0;
+    for (int i = 0; i < kShortCount; i++)
+        bytes += (int64_t)strlen(kShortExpressions[i]);
+
+    for (auto _ : state)
+        for (int i = 0; i < kShortCount; i++)
+            benchmark::DoNotOptimize(solve(kShortExpressions[i]));
+
+    reportRates(state, kShortCount, bytes);
+}
+BENCHMARK(BM_SolveShort);
+
+static void BM_SolveLiteralHeavy(benchmark::State& state)
+{
+    solveString(state, makeLiteralHeavy((int)state.range(0)));
+}
+BENCHMARK(BM_SolveLiteralHeavy)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_SolveOperatorHeavy(benchmark::State& state)
+{
+    solveString(state, makeOperatorHeavy((int)state.range(0)));
+}
+BENCHMARK(BM_SolveOperatorHeavy)->Arg(16)->Arg(256)->Arg(4096);
+
+static void BM_SolveNested(benchmark::State& state)
+{
+    solveString(state, makeNested((int)state.range(0)));
+}
+BENCHMARK(BM_SolveNested)->Arg(8)->Arg(64)->Arg(512);
+
+static void BM_SolveIterativeNested(benchmark::State& state)
+{
+    std::string eq = makeNested((int)state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(solveIterative(eq.c_str()));
+
+    reportRates(state, 1, (int64_t)eq.size());
+}
+BENCHMARK(BM_SolveIterativeNested)->Arg(8)->Arg(64)->Arg(200);
+
+static void BM_SolveFloat(benchmark::State& state)
+{
+    std::string eq = makeOperatorHeavy((int)state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(solve<float>(eq.c_str()));
+
+    reportRates(state, 1, (int64_t)eq.size());
+}
+BENCHMARK(BM_SolveFloat)->Arg(256);
+
+static void BM_SolveDecimal(benchmark::State& state)
+{
+    std::string eq = makeOperatorHeavy((int)state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(solve<Decimal128>(eq.c_str()));
+
+    reportRates(state, 1, (int64_t)eq.size());
+}
+BENCHMARK(BM_SolveDecimal)->Arg(256);
+
+static void BM_SolveCached(benchmark::State& state)
+{
+    SolveCache cache;
+    for (int i = 0; i < kShortCount; i++)
+        cache.solve(kShortExpressions[i]);
+
+    for (auto _ : state)
+        for (int i = 0; i < kShortCount; i++)
+            benchmark::DoNotOptimize(cache.solve(kShortExpressions[i]));
+
+    reportRates(state, kShortCount, 0);
+}
+BENCHMARK(BM_SolveCached);
+
+static void BM_Compile(benchmark::State& state)
+{
+    VariableTable variables;
+    std::string eq = makeFormula((int)state.range(0));
+    for (auto _ : state)
+        benchmark::DoNotOptimize(compile(eq.c_str(), variables));
+
+    reportRates(state, 1, (int64_t)eq.size());
+}
+BENCHMARK(BM_Compile)->Arg(16)->Arg(256);
+
+static void BM_ParseTree(benchmark::State& state)
+{
+    VariableTable variables;
+    std::string eq = makeFormula((int)state.range(0));
+    Arena& arena = threadArena();
+    for (auto _ : state)
+    {
+        arena.reset();
+        benchmark::DoNotOptimize(parseTree(eq.c_str(), arena, variables).size());
+    }
+
+    state.counters["arena"] = (double)arena.capacity();
+    reportRates(state, 1, (int64_t)eq.size());
+}
+BENCHMARK(BM_ParseTree)->Arg(16)->Arg(256);
+
+//NAME: evaluateProgram
+//DESCRIPTION:  Evaluates one compiled formula over and over, optimized or not.
+static void evaluateProgram(benchmark::State& state, bool optimized)
+{
+    VariableTable variables;
+    variables.define("x", 1.25);
+    variables.define("y", 2.5);
+    variables.define("z", -3);
+
+    Program program = compile(makeFormula((int)state.range(0)).c_str(), variables);
+    if (optimized)
+        optimize(program);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(evaluate(program, variables.values()));
+
+    state.counters["instructions"] = (double)program.code.size();
+    reportRates(state, 1, 0);
+}
+
+static void BM_Evaluate(benchmark::State& state)
+{
+    evaluateProgram(state, false);
+}
+BENCHMARK(BM_Evaluate)->Arg(16)->Arg(256);
+
+static void BM_EvaluateOptimized(benchmark::State& state)
+{
+    evaluateProgram(state, true);
+}
+BENCHMARK(BM_EvaluateOptimized)->Arg(16)->Arg(256);
+
+static void BM_EvaluateNative(benchmark::State& state)
+{
+    VariableTable variables;
+    variables.define("x", 1.25);
+    variables.define("y", 2.5);
+    variables.define("z", -3);
+
+    Program program = compile(makeFormula((int)state.range(0)).c_str(), variables);
+    optimize(program);
+
+    HotProgram hot(program, 0);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(hot.evaluate(variables.values()));
+
+    state.SetLabel(hot.isNative() ? "native" : "interpreted");
+    reportRates(state, 1, 0);
+}
+BENCHMARK(BM_EvaluateNative)->Arg(16)->Arg(256);
+
+static void BM_EvaluateIncremental(benchmark::State& state)
+{
+    VariableTable variables;
+    variables.define("x", 1.25);
+    variables.define("y", 2.5);
+    int z = variables.define("z", -3);
+
+    //Only z changes, which a third of the terms read.
+    IncrementalProgram program(compile(makeFormula((int)state.range(0)).c_str(), variables), variables.values());
+    int64_t recalculated = 0;
+    double value = 0;
+    for (auto _ : state)
+    {
+        program.set(z, value);
+        benchmark::DoNotOptimize(program.evaluate());
+        recalculated += program.lastRecalculated();
+        value += 1;
+    }
+
+    state.counters["instructions"] = (double)program.program().code.size();
+    state.counters["recalculated"] = state.iterations() > 0 ? (double)recalculated / state.iterations() : 0;
+    reportRates(state, 1, 0);
+}
+BENCHMARK(BM_EvaluateIncremental)->Arg(16)->Arg(256);
+
+//NAME: makeFamily
+//DESCRIPTION:  Formulas which all start with the same chain of terms and differ only in their last one.
+static std::vector<std::string> makeFamily(int formulas)
+{
+    std::vector<std::string> family;
+    for (int i = 0; i < formulas; i++)
+        family.push_back(makeFormula(16) + " * " + std::to_string(i + 2));
+
+    return family;
+}
+
+static void BM_EvaluateFamily(benchmark::State& state)
+{
+    VariableTable variables;
+    variables.define("x", 1.25);
+    variables.define("y", 2.5);
+    variables.define("z", -3);
+
+    std::vector<std::string> family = makeFamily((int)state.range(0));
+    std::vector<Program> programs;
+    for (size_t i = 0; i < family.size(); i++)
+        programs.push_back(compile(family[i].c_str(), variables));
+
+    for (auto _ : state)
+        for (size_t i = 0; i < programs.size(); i++)
+            benchmark::DoNotOptimize(evaluate(programs[i], variables.values()));
+
+    reportRates(state, (int64_t)family.size(), 0);
+}
+BENCHMARK(BM_EvaluateFamily)->Arg(8)->Arg(64);
+
+static void BM_EvaluateShared(benchmark::State& state)
+{
+    VariableTable variables;
+    variables.define("x", 1.25);
+    variables.define("y", 2.5);
+    variables.define("z", -3);
+
+    std::vector<std::string> family = makeFamily((int)state.range(0));
+    std::vector<const char*> formulas;
+    for (size_t i = 0; i < family.size(); i++)
+        formulas.push_back(family[i].c_str());
+
+    SharedProgram shared = compileShared(formulas, variables);
+    std::vector<double> answers(formulas.size());
+    for (auto _ : state)
+    {
+        evaluateShared(shared, variables.values(), answers.data());
+        benchmark::DoNotOptimize(answers.data());
+    }
+
+    state.counters["instructions"] = (double)shared.program.code.size();
+    reportRates(state, (int64_t)family.size(), 0);
+}
+BENCHMARK(BM_EvaluateShared)->Arg(8)->Arg(64);
+
+//NAME: makeArchive
+//DESCRIPTION:  Compiles formulas of different lengths over x, y and z into an archive file.
+static void makeArchive(const char* path, int formulas)
+{
+    VariableTable variables;
+    std::vector<Program> programs;
+    for (int i = 0; i < formulas; i++)
+        programs.push_back(compile(makeFormula(4 + i % 13).c_str(), variables));
+
+    writeArchive(path, programs, &variables);
+}
+
+static void BM_CompileFormulas(benchmark::State& state)
+{
+    std::vector<std::string> formulas;
+    for (int i = 0; i < (int)state.range(0); i++)
+        formulas.push_back(makeFormula(4 + i % 13));
+
+    for (auto _ : state)
+    {
+        VariableTable variables;
+        for (size_t i = 0; i < formulas.size(); i++)
+            benchmark::DoNotOptimize(compile(formulas[i].c_str(), variables));
+    }
+
+    reportRates(state, state.range(0), 0);
+}
+BENCHMARK(BM_CompileFormulas)->Arg(1000)->Arg(10000);
+
+static void BM_OpenArchive(benchmark::State& state)
+{
+    const char* path = "benchmark-archive.calc";
+    makeArchive(path, (int)state.range(0));
+
+    for (auto _ : state)
+    {
+        Archive archive;
+        if (!archive.open(path))
+        {
+            state.SkipWithError("can't open the archive");
+            break;
+        }
+
+        benchmark::DoNotOptimize(archive.program(archive.size() - 1));
+    }
+
+    remove(path);
+    reportRates(state, state.range(0), 0);
+}
+BENCHMARK(BM_OpenArchive)->Arg(1000)->Arg(10000);
+
+static void BM_EvaluateArchived(benchmark::State& state)
+{
+    const char* path = "benchmark-archive.calc";
+    makeArchive(path, 1);
+
+    Archive archive;
+    archive.open(path);
+    const double variables[3] = { 1.25, 2.5, -3 };
+    ArchiveProgram program = archive.program(0);
+    for (auto _ : state)
+        benchmark::DoNotOptimize(evaluate(program, variables));
+
+    archive.close();
+    remove(path);
+    reportRates(state, 1, 0);
+}
+BENCHMARK(BM_EvaluateArchived);
+
+//A formula calling every function, to measure the math kernels rather than the four operators.
+static const char* const kMathFormula = "sqrt(x * x + y * y) + exp(-x / 8) * log(1 + y) - max(x, y) ^ 0.5 + abs(x - y) * min(x, 2)";
+
+//NAME: evaluateColumns
+//DESCRIPTION:  Evaluates one compiled formula over columns of rows; every row counts as one expression.
+template <typename T>
+static void evaluateColumns(benchmark::State& state, const std::string& formula)
+{
+    const size_t rows = (size_t)state.range(0);
+
+    VariableTable variables;
+    Program program = compile(formula.c_str(), variables);
+
+    std::vector<std::vector<T> > values(variables.size(), std::vector<T>(rows));
+    std::vector<const T*> columns(variables.size());
+    for (int slot = 0; slot < variables.size(); slot++)
+    {
+        for (size_t row = 0; row < rows; row++)
+            values[slot][row] = (T)(1 + (row * 7 + slot) % 13);
+
+        columns[slot] = values[slot].data();
+    }
+
+    std::vector<T> out(rows);
+    for (auto _ : state)
+    {
+        evaluateBatch(program, columns.data(), out.data(), rows);
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    reportRates(state, (int64_t)rows, 0);
+    state.SetLabel(batchKernels<T>().name);
+}
+
+static void BM_EvaluateBatchFloat(benchmark::State& state)
+{
+    evaluateColumns<float>(state, makeFormula(16));
+}
+BENCHMARK(BM_EvaluateBatchFloat)->Arg(64)->Arg(4096)->Arg(1 << 16);
+
+static void BM_EvaluateBatchDouble(benchmark::State& state)
+{
+    evaluateColumns<double>(state, makeFormula(16));
+}
+BENCHMARK(BM_EvaluateBatchDouble)->Arg(64)->Arg(4096)->Arg(1 << 16);
+
+static void BM_EvaluateBatchMathFloat(benchmark::State& state)
+{
+    evaluateColumns<float>(state, kMathFormula);
+}
+BENCHMARK(BM_EvaluateBatchMathFloat)->Arg(64)->Arg(4096)->Arg(1 << 16);
+
+static void BM_EvaluateBatchMathDouble(benchmark::State& state)
+{
+    evaluateColumns<double>(state, kMathFormula);
+}
+BENCHMARK(BM_EvaluateBatchMathDouble)->Arg(64)->Arg(4096)->Arg(1 << 16);
+
+//The math formula as the answer of a conditional, which no row picks in the first and about half of the
+//rows in every block pick in the second.
+static const std::string kSkippedConditional = std::string("x < 0 ? ") + kMathFormula + " : x + y";
+static const std::string kMixedConditional = std::string("x < 7 ? ") + kMathFormula + " : x + y";
+
+static void BM_EvaluateBatchSkipped(benchmark::State& state)
+{
+    evaluateColumns<double>(state, kSkippedConditional);
+}
+BENCHMARK(BM_EvaluateBatchSkipped)->Arg(4096);
+
+static void BM_EvaluateBatchMixed(benchmark::State& state)
+{
+    evaluateColumns<double>(state, kMixedConditional);
+}
+BENCHMARK(BM_EvaluateBatchMixed)->Arg(4096);
+
+//NAME: BM_EvaluateGradient
+//DESCRIPTION:  The formula with its derivative by every variable, to compare with BM_Evaluate, which
+//              finite differences would need 2N + 1 of.
+static void BM_EvaluateGradient(benchmark::State& state)
+{
+    VariableTable variables;
+    variables.define("x", 1.25);
+    variables.define("y", 2.5);
+    variables.define("z", -3);
+
+    Program program = compile(makeFormula((int)state.range(0)).c_str(), variables);
+    std::vector<double> gradient(program.variableCount);
+    Arena arena;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(evaluateGradient(program, variables.values(), gradient.data(), arena));
+        arena.reset();
+    }
+
+    state.counters["instructions"] = (double)program.code.size();
+    reportRates(state, 1, 0);
+}
+BENCHMARK(BM_EvaluateGradient)->Arg(16)->Arg(256);
+
+//NAME: BM_EvaluateGradientBatch
+//DESCRIPTION:  The same over columns of rows, to compare with BM_EvaluateBatchDouble.
+static void BM_EvaluateGradientBatch(benchmark::State& state)
+{
+    const size_t rows = (size_t)state.range(0);
+
+    VariableTable variables;
+    Program program = compile(makeFormula(16).c_str(), variables);
+
+    std::vector<std::vector<double> > values(variables.size(), std::vector<double>(rows));
+    std::vector<std::vector<double> > slopes(variables.size(), std::vector<double>(rows));
+    std::vector<const double*> columns(variables.size());
+    std::vector<double*> gradients(variables.size());
+    for (int slot = 0; slot < variables.size(); slot++)
+    {
+        for (size_t row = 0; row < rows; row++)
+            values[slot][row] = 1 + (row * 7 + slot) % 13;
+
+        columns[slot] = values[slot].data();
+        gradients[slot] = slopes[slot].data();
+    }
+
+    std::vector<double> out(rows);
+    Arena arena;
+    for (auto _ : state)
+    {
+        evaluateGradientBatch(program, columns.data(), out.data(), gradients.data(), rows, arena);
+        arena.reset();
+        benchmark::DoNotOptimize(out.data());
+        benchmark::ClobberMemory();
+    }
+
+    reportRates(state, (int64_t)rows, 0);
+    state.SetLabel(batchKernels<double>().name);
+}
+BENCHMARK(BM_EvaluateGradientBatch)->Arg(4096);
+
+//NAME: BM_EvaluateInterval
+//DESCRIPTION:  The formula over a range of every variable, once for a whole block of rows, to compare with
+//              BM_Evaluate for one row and BM_EvaluateBatchDouble for the block.
+static void BM_EvaluateInterval(benchmark::State& state)
+{
+    VariableTable variables;
+    variables.define("x");
+    variables.define("y");
+    variables.define("z");
+
+    Program program = compile(makeFormula((int)state.range(0)).c_str(), variables);
+    Interval ranges[] = { Interval(1, 1.5), Interval(2, 3), Interval(-4, -2.5) };
+    for (auto _ : state)
+    {
+        Interval bounds = evaluate(program, ranges);
+        benchmark::DoNotOptimize(bounds.lo);
+        benchmark::DoNotOptimize(bounds.hi);
+    }
+
+    state.counters["instructions"] = (double)program.code.size();
+    reportRates(state, 1, 0);
+}
+BENCHMARK(BM_EvaluateInterval)->Arg(16)->Arg(256);
+
+//NAME: BM_EvaluateMath
+//DESCRIPTION:  The same formula one row at a time, for comparison with the batch kernels.
+static void BM_EvaluateMath(benchmark::State& state)
+{
+    VariableTable variables;
+    Program program = compile(kMathFormula, variables);
+    std::vector<double> values(variables.size(), 3.0);
+
+    for (auto _ : state)
+        benchmark::DoNotOptimize(evaluate(program, values.data()));
+
+    reportRates(state, 1, 0);
+}
+BENCHMARK(BM_EvaluateMath);
+
+//NAME: BM_SolveAll
+//DESCRIPTION:  A large list of mixed expressions solved on as many threads as the argument, to show how
+//              well solveAll() scales.
+static void BM_SolveAll(benchmark::State& state)
+{
+    const size_t kCount = 1 << 16;
+
+    std::vector<std::string> text(kCount);
+    int64_t bytes = 0;
+    for (size_t i = 0; i < kCount; i++)
+    {
+        switch (i % 4)
+        {
+        case 0:  text[i] = kShortExpressions[i % kShortCount];   break;
+        case 1:  text[i] = makeLiteralHeavy(1 + i % 32);          break;
+        case 2:  text[i] = makeOperatorHeavy(1 + i % 64);         break;
+        default: text[i] = makeNested(1 + i % 16);                break;
+        }
+
+        bytes += (int64_t)text[i].size();
+    }
+
+    std::vector<const char*> expressions(kCount);
+    for (size_t i = 0; i < kCount; i++)
+        expressions[i] = text[i].c_str();
+
+    std::vector<double> answers(kCount);
+    ThreadPool pool((unsigned)state.range(0));
+    for (auto _ : state)
+        solveAll(expressions, answers, pool);
+
+    reportRates(state, (int64_t)kCount, bytes);
+}
+BENCHMARK(BM_SolveAll)->RangeMultiplier(2)->Range(1, 32)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,383 @@
+#include <algorithm>
+#include <bit>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include "archive.h"
+
+//NAME: alignUp
+//DESCRIPTION:  Rounds an offset up to the next multiple of 8.
+static uint64_t alignUp(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+//NAME: fits
+//DESCRIPTION:  Checks to see if count items of a size, starting at offset, are inside a file of length bytes.
+static bool fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t length)
+{
+    return offset % 8 == 0 && offset <= length && count <= (length - offset) / size;
+}
+
+//NAME: packArchive
+//DESCRIPTION:  Puts compiled formulas into an archive, in memory.
+//INPUT:
+//    programs  - The formulas, all compiled with the same variables.
+//    variables - The table they were compiled with, so the archive knows the variables' names.  NULL
+//                if they don't read any.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The archive.  Empty if it would be too large, or numbers aren't little endian here.
+std::vector<char> packArchive(std::span<const Program> programs, const VariableTable* variables)
+{
+    std::vector<char> archive;
+    if constexpr (std::endian::native != std::endian::little)
+        return archive;
+
+    uint64_t instructionCount = 0;
+    uint64_t constantCount = 0;
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        instructionCount += programs[i].code.size();
+        constantCount += programs[i].constants.size();
+    }
+
+    const uint32_t variableCount = variables != NULL ? (uint32_t)variables->size() : 0;
+    uint64_t nameBytes = 0;
+    for (uint32_t slot = 0; slot < variableCount; slot++)
+        nameBytes += strlen(variables->name(slot)) + 1;
+
+    if (programs.size() > UINT32_MAX || instructionCount > UINT32_MAX || constantCount > UINT32_MAX || nameBytes > UINT32_MAX)
+        return archive;
+
+    ArchiveHeader header = {};
+    memcpy(header.magic, kArchiveMagic, sizeof(header.magic));
+    header.version = kArchiveVersion;
+    header.formulaCount = (uint32_t)programs.size();
+    header.variableCount = variableCount;
+    header.instructionCount = instructionCount;
+    header.constantCount = constantCount;
+    header.formulasOffset = alignUp(sizeof(ArchiveHeader));
+    header.codeOffset = alignUp(header.formulasOffset + programs.size() * sizeof(ArchiveFormula));
+    header.constantsOffset = alignUp(header.codeOffset + instructionCount * sizeof(ArchiveInstruction));
+    header.namesOffset = alignUp(header.constantsOffset + constantCount * sizeof(double));
+    header.size = header.namesOffset + (variableCount + 1) * sizeof(uint32_t) + nameBytes;
+
+    archive.resize((size_t)header.size);
+    char* base = archive.data();
+    memcpy(base, &header, sizeof(header));
+
+    ArchiveFormula* formulas = (ArchiveFormula*)(base + header.formulasOffset);
+    ArchiveInstruction* code = (ArchiveInstruction*)(base + header.codeOffset);
+    double* constants = (double*)(base + header.constantsOffset);
+    uint32_t firstInstruction = 0;
+    uint32_t firstConstant = 0;
+    for (size_t i = 0; i < programs.size(); i++)
+    {
+        const Program& program = programs[i];
+        ArchiveFormula& formula = formulas[i];
+        formula.firstInstruction = firstInstruction;
+        formula.instructionCount = (uint32_t)program.code.size();
+        formula.firstConstant = firstConstant;
+        formula.constantCount = (uint32_t)program.constants.size();
+        formula.variableCount = (uint32_t)program.variableCount;
+        formula.error = (uint8_t)program.error;
+        formula.errorOffset = program.errorOffset;
+
+        for (size_t j = 0; j < program.code.size(); j++)
+        {
+            ArchiveInstruction& in = code[firstInstruction + j];
+            in.op = (uint32_t)program.code[j].op;
+            in.lhs = program.code[j].lhs;
+            in.rhs = program.code[j].rhs;
+        }
+
+        if (!program.constants.empty())
+            memcpy(constants + firstConstant, program.constants.data(), program.constants.size() * sizeof(double));
+
+        firstInstruction += formula.instructionCount;
+        firstConstant += formula.constantCount;
+    }
+
+    uint32_t* nameStarts = (uint32_t*)(base + header.namesOffset);
+    char* names = (char*)(nameStarts + variableCount + 1);
+    uint32_t used = 0;
+    for (uint32_t slot = 0; slot < variableCount; slot++)
+    {
+        size_t bytes = strlen(variables->name(slot)) + 1;
+        nameStarts[slot] = used;
+        memcpy(names + used, variables->name(slot), bytes);
+        used += (uint32_t)bytes;
+    }
+
+    nameStarts[variableCount] = used;
+    return archive;
+}
+
+//NAME: writeArchive
+//DESCRIPTION:  Puts compiled formulas into an archive file, see packArchive().
+//INPUT:
+//    path      - The file to write, replaced if it is there already.
+//    programs  - The formulas, all compiled with the same variables.
+//    variables - The table they were compiled with, NULL if they don't read any.
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if the archive couldn't be made or written.
+bool writeArchive(const char* path, std::span<const Program> programs, const VariableTable* variables)
+{
+    std::vector<char> archive = packArchive(programs, variables);
+    if (archive.empty())
+        return false;
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL)
+        return false;
+
+    bool written = fwrite(archive.data(), 1, archive.size(), file) == archive.size();
+    return fclose(file) == 0 && written;
+}
+
+//NAME: Archive::open
+//DESCRIPTION:  Maps an archive file into memory.
+//INPUT:
+//    path - The file.
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if it can't be read, isn't an archive, or is of another version.
+bool Archive::open(const char* path)
+{
+    close();
+    if (!file.open(path))
+        return false;
+
+    if (!attach(file.data(), file.size()))
+    {
+        file.close();
+        return false;
+    }
+
+    return true;
+}
+
+//NAME: Archive::attach
+//DESCRIPTION:  Uses an archive which is already in memory, for instance one built into the program.
+//              The memory must stay where it is for as long as the archive is used.
+//INPUT:
+//    data - The archive, on a multiple of 8 bytes.
+//    size - How many bytes it has.
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if it isn't an archive, or is of another version.
+bool Archive::attach(const void* data, size_t size)
+{
+    base = NULL;
+    length = 0;
+    header = NULL;
+
+    if constexpr (std::endian::native != std::endian::little)
+        return false;
+
+    if (data == NULL || (uintptr_t)data % 8 != 0 || size < sizeof(ArchiveHeader))
+        return false;
+
+    const ArchiveHeader* found = (const ArchiveHeader*)data;
+    if (memcmp(found->magic, kArchiveMagic, sizeof(kArchiveMagic)) != 0 || found->version != kArchiveVersion || found->size != size)
+        return false;
+
+    //Only the layout is checked here, nothing that would mean reading more than the header.
+    if (!fits(found->formulasOffset, found->formulaCount, sizeof(ArchiveFormula), size) ||
+        !fits(found->codeOffset, found->instructionCount, sizeof(ArchiveInstruction), size) ||
+        !fits(found->constantsOffset, found->constantCount, sizeof(double), size) ||
+        !fits(found->namesOffset, (uint64_t)found->variableCount + 1, sizeof(uint32_t), size))
+        return false;
+
+    base = (const char*)data;
+    length = size;
+    header = found;
+    return true;
+}
+
+//NAME: Archive::close
+//DESCRIPTION:  Stops using the archive, unmapping the file if it was opened from one.
+void Archive::close()
+{
+    file.close();
+    base = NULL;
+    length = 0;
+    header = NULL;
+}
+
+//NAME: Archive::program
+//DESCRIPTION:  One of the formulas, ready to be evaluated right where it lies.
+//INPUT:
+//    index - Which formula, from 0 to size() - 1.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The formula.  A formula whose entry points outside the archive has ErrorCode::DamagedArchive.
+ArchiveProgram Archive::program(int index) const
+{
+    ArchiveProgram program = { NULL, NULL, 0, 0, ErrorCode::DamagedArchive, 0 };
+    if (header == NULL || index < 0 || (uint32_t)index >= header->formulaCount)
+        return program;
+
+    const ArchiveFormula& formula = ((const ArchiveFormula*)(base + header->formulasOffset))[index];
+    program.variableCount = (int)formula.variableCount;
+    program.errorOffset = formula.errorOffset;
+    if (formula.error != (uint8_t)ErrorCode::None)
+    {
+        program.error = formula.error <= (uint8_t)ErrorCode::UnmatchedConditional ? (ErrorCode)formula.error : ErrorCode::DamagedArchive;
+        return program;
+    }
+
+    if (formula.instructionCount == 0 || formula.instructionCount > INT_MAX || formula.variableCount > INT_MAX ||
+        (uint64_t)formula.firstInstruction + formula.instructionCount > header->instructionCount ||
+        (uint64_t)formula.firstConstant + formula.constantCount > header->constantCount)
+        return program;
+
+    program.code = (const ArchiveInstruction*)(base + header->codeOffset) + formula.firstInstruction;
+    program.constants = (const double*)(base + header->constantsOffset) + formula.firstConstant;
+    program.count = (int)formula.instructionCount;
+    program.error = ErrorCode::None;
+    return program;
+}
+
+//NAME: isReadable
+//DESCRIPTION:  Checks to see if an instruction may read a register: one written before it, and not inside
+//              an answer of a conditional which is already over, since that may never have been written,
+//              nor that of a Jump, which is never written at all.
+//INPUT:
+//    hidden      - Which registers are inside an answer which is over.
+//    value       - The register.
+//    instruction - The instruction reading it.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the register can be read.
+static bool isReadable(const std::vector<char>& hidden, int value, int instruction)
+{
+    return value >= 0 && value < instruction && !hidden[value];
+}
+
+//NAME: Archive::verify
+//DESCRIPTION:  Checks every formula of the archive, and every name.  Needed only for archives which
+//              may not have been written by packArchive(), since evaluate() trusts what it is given.
+//              Conditionals have to be nested properly, each Branch going to its own Jump and each
+//              Jump to its own Merge.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if every formula can be evaluated safely.
+bool Archive::verify() const
+{
+    if (header == NULL)
+        return false;
+
+    const ArchiveFormula* formulas = (const ArchiveFormula*)(base + header->formulasOffset);
+    for (uint32_t f = 0; f < header->formulaCount; f++)
+    {
+        ArchiveProgram program = this->program((int)f);
+        if (program.error == ErrorCode::DamagedArchive)
+            return false;
+        if (!program.ok())
+            continue;
+
+        //The conditionals open: the Branch of each while its first answer is checked, its Jump after that.
+        std::vector<int> open;
+        std::vector<char> hidden(program.count, 0);
+
+        const int constantCount = (int)formulas[f].constantCount;
+        for (int i = 0; i < program.count; i++)
+        {
+            const ArchiveInstruction& in = program.code[i];
+            switch ((OpCode)in.op)
+            {
+            case OpCode::Branch:
+                if (!isReadable(hidden, in.lhs, i) || in.rhs <= i || in.rhs >= program.count)
+                    return false;
+
+                open.push_back(i);
+                break;
+
+            case OpCode::Jump:
+                if (open.empty() || program.code[open.back()].op != (uint32_t)OpCode::Branch || program.code[open.back()].rhs != i ||
+                    !isReadable(hidden, in.lhs, i) || in.rhs <= i || in.rhs >= program.count)
+                    return false;
+
+                //A Jump writes the register of its Merge, never its own.
+                std::fill(hidden.begin() + open.back() + 1, hidden.begin() + i + 1, 1);
+                open.back() = i;
+                break;
+
+            case OpCode::Merge:
+                if (open.empty() || program.code[open.back()].op != (uint32_t)OpCode::Jump || program.code[open.back()].rhs != i ||
+                    in.lhs < 0 || in.lhs >= open.back() || program.code[in.lhs].op != (uint32_t)OpCode::Branch ||
+                    program.code[in.lhs].rhs != open.back() || !isReadable(hidden, in.rhs, i))
+                    return false;
+
+                std::fill(hidden.begin() + open.back() + 1, hidden.begin() + i, 1);
+                open.pop_back();
+                break;
+
+            case OpCode::Constant:
+                if (in.lhs < 0 || in.lhs >= constantCount)
+                    return false;
+                break;
+
+            case OpCode::Variable:
+                if (in.lhs < 0 || in.lhs >= program.variableCount)
+                    return false;
+                break;
+
+            default:
+                //Functions taking one argument read rhs as well, and ignore it.
+                if (in.op > (uint32_t)OpCode::NotEqual || !isReadable(hidden, in.lhs, i) || !isReadable(hidden, in.rhs, i))
+                    return false;
+                break;
+            }
+        }
+
+        if (!open.empty())
+            return false;
+    }
+
+    //Every name has to be inside the archive and end with a '\0'.
+    const uint32_t* nameStarts = (const uint32_t*)(base + header->namesOffset);
+    const char* names = (const char*)(nameStarts + header->variableCount + 1);
+    const uint64_t nameBytes = length - (uint64_t)(names - base);
+    for (uint32_t slot = 0; slot < header->variableCount; slot++)
+    {
+        if (nameStarts[slot] >= nameStarts[slot + 1] || nameStarts[slot + 1] > nameBytes || names[nameStarts[slot + 1] - 1] != '\0')
+            return false;
+    }
+
+    return true;
+}
+
+//NAME: Archive::variableName
+//DESCRIPTION:  The name of one of the variables the formulas were compiled with.
+//INPUT:
+//    slot - The slot of the variable.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Its name, or NULL if there is no such slot.
+const char* Archive::variableName(int slot) const
+{
+    if (header == NULL || slot < 0 || (uint32_t)slot >= header->variableCount)
+        return NULL;
+
+    const uint32_t* nameStarts = (const uint32_t*)(base + header->namesOffset);
+    const char* names = (const char*)(nameStarts + header->variableCount + 1);
+    if (nameStarts[slot] >= length - (uint64_t)(names - base))
+        return NULL;
+
+    return names + nameStarts[slot];
+}
@@ -0,0 +1,163 @@
+#ifndef CALCULATOR_ARCHIVE_H
+#define CALCULATOR_ARCHIVE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "compiler.h"
+#include "stream.h"
+
+//A service with tens of thousands of formulas compiles all of them again every time it starts, which
+//takes seconds.  An archive holds formulas already compiled, in a form that is used right where it lies:
+//Archive::open() maps the file into memory and checks its header, and that is all.  Nothing is copied,
+//converted or allocated, so opening an archive of ten thousand formulas takes microseconds, and the
+//operating system shares the pages between every process that opens the same file.
+//
+//Everything is in one file, at offsets from its start, so the archive works wherever it is mapped:
+//     ArchiveHeader                      what is where
+//     ArchiveFormula[formulaCount]       where each formula's code and constants are
+//     ArchiveInstruction[...]            the code of every formula, one after another
+//     double[...]                        the constants of every formula, one after another
+//     uint32_t[variableCount + 1]        where each variable's name starts, and where the last one ends
+//     char[...]                          the names, each followed by a '\0'
+//Every part starts on a multiple of 8 bytes.  Numbers are little endian and doubles IEEE 754, which is
+//what every platform the calculator runs on uses anyway; an archive is neither written nor opened
+//anywhere else.  Registers and constants are numbered from the start of their own formula, exactly as in
+//a Program, and the slots of the variables are those of the VariableTable the formulas were compiled with.
+//
+//A different kArchiveVersion can't be opened.  The formulas' entries are checked as they are used, but
+//their code isn't, since that would mean reading the whole file; verify() checks everything, for an
+//archive that may not have been written by packArchive().
+//Version 2 added the instructions of comparisons and conditionals, which older code can't evaluate.
+
+static const char kArchiveMagic[8] = { 'C', 'A', 'L', 'C', 'A', 'R', 'C', '\0' };
+
+static const uint32_t kArchiveVersion = 2;
+
+//NAME: ArchiveHeader
+//DESCRIPTION:  The start of an archive.  Offsets are from the start of the file, size is its length.
+struct ArchiveHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t formulaCount;
+    uint32_t variableCount;
+    uint32_t reserved;
+    uint64_t instructionCount;
+    uint64_t constantCount;
+    uint64_t formulasOffset;
+    uint64_t codeOffset;
+    uint64_t constantsOffset;
+    uint64_t namesOffset;
+    uint64_t size;
+};
+
+//NAME: ArchiveFormula
+//DESCRIPTION:  One formula: which of the archive's instructions and constants are its own.
+//              A formula which didn't compile has no code, just its error and where it was found.
+struct ArchiveFormula
+{
+    uint32_t firstInstruction;
+    uint32_t instructionCount;
+    uint32_t firstConstant;
+    uint32_t constantCount;
+    uint32_t variableCount;
+    uint8_t error;
+    uint8_t reserved[3];
+    int32_t errorOffset;
+    uint32_t unused;
+};
+
+//NAME: ArchiveInstruction
+//DESCRIPTION:  An Instruction as it is stored, with a size and layout that are the same everywhere.
+struct ArchiveInstruction
+{
+    uint32_t op;
+    int32_t lhs;
+    int32_t rhs;
+};
+
+static_assert(sizeof(ArchiveHeader) == 80, "the header has to be the same everywhere");
+static_assert(sizeof(ArchiveFormula) == 32, "formulas have to be the same everywhere");
+static_assert(sizeof(ArchiveInstruction) == 12, "instructions have to be the same everywhere");
+
+//NAME: ArchiveProgram
+//DESCRIPTION:  A formula of an archive, pointing right into it.  Valid for as long as the archive is open.
+struct ArchiveProgram
+{
+    bool ok() const { return error == ErrorCode::None; }
+
+    const ArchiveInstruction* code;
+    const double* constants;
+    int count;
+    int variableCount;
+    ErrorCode error;
+    int errorOffset;
+};
+
+//NAME: Archive
+//DESCRIPTION:  Compiled formulas read straight from a file, or from memory holding one.
+class Archive
+{
+public:
+    Archive() : base(NULL), length(0), header(NULL) {}
+
+    Archive(const Archive&) = delete;
+
+    Archive& operator=(const Archive&) = delete;
+
+    bool open(const char* path);
+
+    bool attach(const void* data, size_t size);
+
+    void close();
+
+    bool verify() const;
+
+    int size() const { return header != NULL ? (int)header->formulaCount : 0; }
+
+    ArchiveProgram program(int index) const;
+
+    int variableCount() const { return header != NULL ? (int)header->variableCount : 0; }
+
+    const char* variableName(int slot) const;
+
+private:
+    MappedFile file;
+    const char* base;
+    size_t length;
+    const ArchiveHeader* header;
+};
+
+//Function declarations
+std::vector<char> packArchive(std::span<const Program> programs, const VariableTable* variables = NULL);
+
+bool writeArchive(const char* path, std::span<const Program> programs, const VariableTable* variables = NULL);
+
+
+//NAME: evaluate
+//DESCRIPTION:  Runs a formula of an archive using arithmetic of type T, right where it lies.
+//              Gives exactly what evaluate() gives for the Program it was packed from.
+//INPUT:
+//    program   - The formula, from Archive::program().
+//    variables - The value of every slot the formula reads.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The value calculated from the formula, NaN if it failed to compile and T has one.
+template <typename T = double>
+T evaluate(const ArchiveProgram& program, const T* variables = NULL)
+{
+    if (!program.ok())
+        return std::numeric_limits<T>::quiet_NaN();
+
+    assert(variables != NULL || program.variableCount == 0);
+
+    RegisterFile<T> registers(program.count);
+    runInstructions(program.code, program.count, program.constants, variables, registers.r);
+    return registers.r[program.count - 1];
+}
+
+#endif
@@ -0,0 +1,161 @@
+#include <cstdlib>
+
+#include "arena.h"
+
+//NAME: Arena::Arena
+//DESCRIPTION:  Creates an empty arena.  Nothing comes from the heap until the first allocation.
+//INPUT:
+//    blockSize - How big the first block is.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+Arena::Arena(size_t blockSize) : blocks(NULL), cursor(NULL), limit(NULL), blockSize(blockSize), reserved(0), allocations(0)
+{
+}
+
+//NAME: Arena::~Arena
+//DESCRIPTION:  Gives every block back to the heap.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+Arena::~Arena()
+{
+    releaseBlocks();
+}
+
+//NAME: Arena::allocate
+//DESCRIPTION:  Hands out memory which stays valid until the next reset().
+//INPUT:
+//    size      - How many bytes are needed.
+//    alignment - A power of two the address has to be a multiple of, at most alignof(std::max_align_t).
+//OUTPUT:
+//    none
+//RETURNS:
+//    The memory, or NULL if the heap has run out.
+void* Arena::allocate(size_t size, size_t alignment)
+{
+    char* aligned = (char*)(((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    if (cursor == NULL || size > (size_t)(limit - aligned))
+    {
+        if (!addBlock(size + alignment))
+            return NULL;
+
+        aligned = (char*)(((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    cursor = aligned + size;
+    return aligned;
+}
+
+//NAME: Arena::extend
+//DESCRIPTION:  Makes the last allocation bigger without moving it, which is possible as long as nothing
+//              has been allocated after it and the block has room.
+//INPUT:
+//    memory - The last allocation.
+//    size   - How big it is now.
+//    larger - How big it should be.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if it has grown; otherwise nothing changed and the caller has to allocate somewhere else.
+bool Arena::extend(void* memory, size_t size, size_t larger)
+{
+    char* start = (char*)memory;
+    if (start + size != cursor || larger - size > (size_t)(limit - cursor))
+        return false;
+
+    cursor = start + larger;
+    return true;
+}
+
+//NAME: Arena::reset
+//DESCRIPTION:  Takes back everything handed out.  If more than one block was needed, they are all
+//              swapped for a single block as big as all of them so next time one is enough.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void Arena::reset()
+{
+    if (blocks != NULL && blocks->next != NULL)
+    {
+        size_t total = reserved;
+        releaseBlocks();
+        addBlock(total);
+    }
+
+    cursor = blocks != NULL ? (char*)(blocks + 1) : NULL;
+}
+
+//NAME: Arena::addBlock
+//DESCRIPTION:  Gets another block from the heap and starts handing out memory from it.  Every block is
+//              at least as big as all of the ones before it together, so a growing arena needs few.
+//INPUT:
+//    minimum - The least the block has to hold.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the heap had the memory.
+bool Arena::addBlock(size_t minimum)
+{
+    size_t size = blockSize > reserved ? blockSize : reserved;
+    if (size < minimum)
+        size = minimum;
+
+    Block* block = (Block*)malloc(sizeof(Block) + size);
+    if (block == NULL)
+        return false;
+
+    block->next = blocks;
+    block->size = size;
+    blocks = block;
+    cursor = (char*)(block + 1);
+    limit = cursor + size;
+    reserved += size;
+    allocations++;
+    return true;
+}
+
+//NAME: Arena::releaseBlocks
+//DESCRIPTION:  Gives every block back to the heap.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void Arena::releaseBlocks()
+{
+    while (blocks != NULL)
+    {
+        Block* next = blocks->next;
+        free(blocks);
+        blocks = next;
+    }
+
+    cursor = NULL;
+    limit = NULL;
+    reserved = 0;
+}
+
+//NAME: threadArena
+//DESCRIPTION:  The arena of the calling thread.  It is created the first time the thread asks for it
+//              and reused for as long as the thread lives, so a worker which resets it between
+//              expressions never goes to the heap once it has warmed up.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The arena.
+Arena& threadArena()
+{
+    thread_local Arena arena;
+    return arena;
+}
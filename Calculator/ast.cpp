@@ -0,0 +1,278 @@
+#include <cstring>
+
+#include "ast.h"
+
+//NAME: Ast::add
+//DESCRIPTION:  Appends a node.  Its operands have to be in the tree already, the first one's sub-tree
+//              directly followed by the second one's, and this node directly after them, which is the
+//              order the parser finds them in.
+//INPUT:
+//    kind   - What the node stands for, anything but AstKind::Number.
+//    first  - The first operand, or the slot of an AstKind::Variable.
+//    second - The second operand of a binary operator.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The index of the node, or -1 if the arena has run out of memory.
+int Ast::add(AstKind kind, int first, int second)
+{
+    AstNode* node = append(kind);
+    if (node == NULL)
+        return -1;
+
+    node->child[0] = first;
+    node->child[1] = second;
+
+    //How many values evaluate() has on its stack after this node.  A Branch takes the condition off, and
+    //a Jump has the first answer on it, which isn't there when the other answer is calculated.
+    if (kind == AstKind::Variable)
+        depth++;
+    else if (kind != AstKind::Conditional && !isUnary(kind))
+        depth--;
+
+    if (depth > deepest)
+        deepest = depth;
+
+    return count - 1;
+}
+
+//NAME: Ast::addNumber
+//DESCRIPTION:  Appends a literal.
+//INPUT:
+//    value - The value of the literal.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The index of the node, or -1 if the arena has run out of memory.
+int Ast::addNumber(double value)
+{
+    AstNode* node = append(AstKind::Number);
+    if (node == NULL)
+        return -1;
+
+    node->value = value;
+    if (++depth > deepest)
+        deepest = depth;
+
+    return count - 1;
+}
+
+//NAME: Ast::clear
+//DESCRIPTION:  Removes every node.  Their memory stays with the tree for the next ones.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void Ast::clear()
+{
+    count = 0;
+    depth = 0;
+    deepest = 0;
+}
+
+//NAME: Ast::append
+//DESCRIPTION:  Makes room for one more node at the end of the array.
+//INPUT:
+//    kind - What the node stands for.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The new node, or NULL if the arena has run out of memory.
+AstNode* Ast::append(AstKind kind)
+{
+    if (count == room && !grow())
+        return NULL;
+
+    AstNode* node = &nodes[count++];
+    node->kind = kind;
+    return node;
+}
+
+//NAME: Ast::grow
+//DESCRIPTION:  Doubles the room in the array.  While the array is the last thing taken from the arena
+//              it simply gets longer where it is; otherwise it is copied somewhere new and the old copy
+//              waits for the arena to be reset like everything else.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if there is room for another node.
+bool Ast::grow()
+{
+    int larger = room == 0 ? kAstInitialNodes : room * 2;
+    if (nodes != NULL && arena->extend(nodes, room * sizeof(AstNode), larger * sizeof(AstNode)))
+    {
+        room = larger;
+        return true;
+    }
+
+    AstNode* moved = arena->allocate<AstNode>(larger);
+    if (moved == NULL)
+        return false;
+
+    if (count != 0)
+        memcpy(moved, nodes, count * sizeof(AstNode));
+
+    nodes = moved;
+    room = larger;
+    return true;
+}
+
+//NAME: TreeBuilder::number
+//DESCRIPTION:  Records a literal.  The text has already been converted, so the tree never
+//              has to look at it again.
+//INPUT:
+//    value - The value of the literal.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The node holding the literal.
+TreeBuilder::Value TreeBuilder::number(double value)
+{
+    int index = tree.addNumber(value);
+    if (index < 0)
+    {
+        fail(ErrorCode::OutOfMemory, NULL);
+        return 0;
+    }
+
+    return index;
+}
+
+//NAME: TreeBuilder::variable
+//DESCRIPTION:  Records a variable.  The name is resolved to its slot now, the same way compile()
+//              does: names the table doesn't know yet are defined in it.
+//INPUT:
+//    name   - The name of the variable, pointing into the expression.
+//    length - How many characters the name has.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The node holding the variable.
+TreeBuilder::Value TreeBuilder::variable(const char* name, size_t length)
+{
+    //Building a tree with variables needs a table to resolve them in.
+    if (variables == NULL)
+    {
+        fail(ErrorCode::UnknownVariable, name);
+        return 0;
+    }
+
+    int slot = variables->find(name, length);
+    if (slot < 0)
+        slot = variables->define(std::string(name, length).c_str());
+
+    if (slot >= tree.variableCount)
+        tree.variableCount = slot + 1;
+
+    return node(AstKind::Variable, slot);
+}
+
+//NAME: TreeBuilder::node
+//DESCRIPTION:  Records a node which isn't a literal.
+//INPUT:
+//    kind   - What the node stands for.
+//    first  - Its first operand, or the slot of a variable.
+//    second - Its second operand.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The node.
+TreeBuilder::Value TreeBuilder::node(AstKind kind, int first, int second)
+{
+    //Once something has failed the parser stops, but the operator it was working on still arrives.
+    if (failed())
+        return 0;
+
+    int index = tree.add(kind, first, second);
+    if (index < 0)
+    {
+        fail(ErrorCode::OutOfMemory, NULL);
+        return 0;
+    }
+
+    return index;
+}
+
+//NAME: TreeBuilder::endConditional
+//DESCRIPTION:  Records the end of a conditional, and points its Branch and Jump forward to where they go.
+//              Each of them was recorded right after the part it follows.
+//INPUT:
+//    condition - The node of its condition.
+//    then      - The node of its first answer.
+//    otherwise - The node of its other answer.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The node of the conditional.
+TreeBuilder::Value TreeBuilder::endConditional(Value condition, Value then, Value otherwise)
+{
+    Value conditional = node(AstKind::Conditional, condition + 1, otherwise);
+    if (failed())
+        return 0;
+
+    tree.link(condition + 1, then + 1);
+    tree.link(then + 1, conditional);
+    return conditional;
+}
+
+//NAME: parseTreeWith
+//DESCRIPTION:  Parses an expression into a tree.
+//INPUT:
+//    eq        - The expression.
+//    arena     - Where the nodes go.
+//    variables - The table to resolve names in, NULL if the expression has none.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The tree.
+static Ast parseTreeWith(const char* eq, Arena& arena, VariableTable* variables)
+{
+    assert(eq != NULL);
+
+    Ast tree(arena);
+    TreeBuilder builder(tree, variables);
+    parseExpression(eq, builder);
+
+    //Half a tree is no use to anybody.
+    if (builder.failed())
+    {
+        tree.clear();
+        tree.error = builder.error;
+        tree.errorOffset = builder.errorAt != NULL ? (int)(builder.errorAt - eq) : 0;
+    }
+
+    return tree;
+}
+
+//NAME: parseTree
+//DESCRIPTION:  Parses an expression into a tree whose nodes are stored in the arena.
+//INPUT:
+//    eq    - The expression.
+//    arena - Where the nodes go, for instance threadArena().  Reset it once the tree isn't needed.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The tree.  Check ok() first, a malformed expression has no nodes.
+Ast parseTree(const char* eq, Arena& arena)
+{
+    return parseTreeWith(eq, arena, NULL);
+}
+
+//NAME: parseTree
+//DESCRIPTION:  Parses an expression which may refer to variables into a tree whose nodes are stored in
+//              the arena.
+//INPUT:
+//    eq        - The expression.
+//    arena     - Where the nodes go, for instance threadArena().  Reset it once the tree isn't needed.
+//INPUT/OUTPUT:
+//    variables - The table to resolve names in.  Names it doesn't know yet are defined in it.
+//RETURNS:
+//    The tree.  Check ok() first, a malformed expression has no nodes.
+Ast parseTree(const char* eq, Arena& arena, VariableTable& variables)
+{
+    return parseTreeWith(eq, arena, &variables);
+}
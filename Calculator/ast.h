@@ -0,0 +1,278 @@
+#ifndef CALCULATOR_AST_H
+#define CALCULATOR_AST_H
+
+#include <cassert>
+#include <limits>
+#include <vector>
+
+#include "arena.h"
+#include "compiler.h"
+
+//compile() keeps nothing of the expression but the instructions it needs to calculate it, with constants
+//already folded.  Rewriting an expression needs all of it, as it was written: that is what an Ast is.
+//Its nodes live in one flat array inside an Arena, and a node refers to its operands by their index in
+//that array rather than by pointer, which keeps a node at 16 bytes, four to a cache line:
+//     2 * (x - 1)
+//
+//     [0] Number   2
+//     [1] Variable x
+//     [2] Number   1
+//     [3] Subtract [1] [2]
+//     [4] Multiply [0] [3]     The last node is the root.
+//The parser finishes an operand before it gets to the operator, so every node comes after its operands
+//and a pass from the first node to the last sees every operand before it is used.
+//
+//A conditional is three nodes, each right after one of its parts, which point forward to each other so
+//evaluate() can skip the answer it doesn't pick:
+//     x > 0 ? x : 1
+//
+//     [0] Variable x
+//     [1] Number   0
+//     [2] Greater     [0] [1]
+//     [3] Branch      [2] [5]     Goes on after [5] if [2] is 0.
+//     [4] Variable x
+//     [5] Jump        [4] [7]     Goes on after [7].
+//     [6] Number   1
+//     [7] Conditional [3] [6]
+//
+//The array grows in place while it is the last thing allocated from the arena, which while parsing it
+//is.  An arena reset between expressions, such as the one threadArena() gives every thread, therefore
+//needs no heap allocation at all once it is big enough for the largest expression.
+//A tree stays valid until its arena is reset.
+
+
+//NAME: AstKind
+//DESCRIPTION:  What a node of the tree stands for.
+enum class AstKind : unsigned char
+{
+    Number,         //A literal, value.
+    Variable,       //A variable, child[0] is its slot.
+    Negate,         //-child[0]
+    Add,            //child[0] + child[1]
+    Subtract,       //child[0] - child[1]
+    Multiply,       //child[0] * child[1]
+    Divide,         //child[0] / child[1]
+    Power,          //child[0] ^ child[1]     The functions, in the same order as Function.
+    Min,            //min(child[0], child[1])
+    Max,            //max(child[0], child[1])
+    Sqrt,           //sqrt(child[0])
+    Exp,            //exp(child[0])
+    Log,            //log(child[0])
+    Abs,            //abs(child[0])
+    Less,           //child[0] < child[1]     1 if it holds, 0 if it doesn't.
+    LessEqual,      //child[0] <= child[1]
+    Greater,        //child[0] > child[1]
+    GreaterEqual,   //child[0] >= child[1]
+    Equal,          //child[0] == child[1]
+    NotEqual,       //child[0] != child[1]
+    Branch,         //Follows the condition child[0], child[1] is the Jump.
+    Jump,           //Follows the first answer child[0], child[1] is the Conditional.
+    Conditional,    //child[0] is the Branch, child[1] the other answer.
+};
+
+//NAME: functionKind
+//DESCRIPTION:  The node which calls a function.
+constexpr AstKind functionKind(Function function)
+{
+    return (AstKind)((int)AstKind::Power + (int)function);
+}
+
+//NAME: kindFunction
+//DESCRIPTION:  The function a node calls, for nodes from AstKind::Power to AstKind::NotEqual.
+constexpr Function kindFunction(AstKind kind)
+{
+    return (Function)((int)kind - (int)AstKind::Power);
+}
+
+//NAME: isUnary
+//DESCRIPTION:  Checks to see if a node has just the one operand, child[0].
+constexpr bool isUnary(AstKind kind)
+{
+    return kind == AstKind::Negate || (kind >= AstKind::Sqrt && kind <= AstKind::Abs);
+}
+
+//NAME: AstNode
+//DESCRIPTION:  One node of the tree.
+struct AstNode
+{
+    AstKind kind;
+    union
+    {
+        int child[2];
+        double value;
+    };
+};
+
+//The first array of a tree has room for this many nodes.
+static const int kAstInitialNodes = 64;
+
+//NAME: Ast
+//DESCRIPTION:  An expression as a tree whose nodes are stored in an arena.
+//              A tree built from a malformed expression has no nodes, just the error and the byte in
+//              the expression where it was found.  variableCount is one more than the highest slot used.
+class Ast
+{
+public:
+    explicit Ast(Arena& arena) : variableCount(0), error(ErrorCode::None), errorOffset(0),
+                                 arena(&arena), nodes(NULL), count(0), room(0), depth(0), deepest(0) {}
+
+    bool ok() const { return error == ErrorCode::None; }
+
+    int size() const { return count; }
+
+    int root() const { return count - 1; }
+
+    const AstNode& operator[](int index) const { return nodes[index]; }
+
+    const AstNode* data() const { return nodes; }
+
+    int stackDepth() const { return deepest; }
+
+    int add(AstKind kind, int first = -1, int second = -1);
+
+    void link(int index, int target) { nodes[index].child[1] = target; }
+
+    int addNumber(double value);
+
+    void clear();
+
+    int variableCount;
+    ErrorCode error;
+    int errorOffset;
+
+private:
+    AstNode* append(AstKind kind);
+
+    bool grow();
+
+    Arena* arena;
+    AstNode* nodes;
+    int count;
+    int room;
+    int depth;
+    int deepest;
+};
+
+//NAME: TreeBuilder
+//DESCRIPTION:  The actions which record the expression into an Ast, exactly as it was written.
+//              A Value is the index of the node holding the sub-expression.
+class TreeBuilder : public ErrorState
+{
+public:
+    typedef int Value;
+    typedef double Number;
+
+    TreeBuilder(Ast& tree, VariableTable* variables) : tree(tree), variables(variables) {}
+
+    Value number(double value);
+
+    Value variable(const char* name, size_t length);
+
+    Value negate(Value value) { return node(AstKind::Negate, value); }
+
+    Value add(Value first, Value second) { return node(AstKind::Add, first, second); }
+
+    Value subtract(Value first, Value second) { return node(AstKind::Subtract, first, second); }
+
+    Value multiply(Value first, Value second) { return node(AstKind::Multiply, first, second); }
+
+    Value divide(Value first, Value second, const char*) { return node(AstKind::Divide, first, second); }
+
+    Value call(Function function, Value argument, const char*) { return node(functionKind(function), argument); }
+
+    Value call(Function function, Value first, Value second, const char*) { return node(functionKind(function), first, second); }
+
+    void beginThen(Value condition) { node(AstKind::Branch, condition); }
+
+    void beginElse(Value, Value then) { node(AstKind::Jump, then); }
+
+    Value endConditional(Value condition, Value then, Value otherwise);
+
+private:
+    Value node(AstKind kind, int first = -1, int second = -1);
+
+    Ast& tree;
+    VariableTable* variables;
+};
+
+//Function declarations
+Ast parseTree(const char* eq, Arena& arena);
+
+Ast parseTree(const char* eq, Arena& arena, VariableTable& variables);
+
+
+//NAME: evaluate
+//DESCRIPTION:  Calculates a tree using arithmetic of type T, every node in order from the first to the
+//              root.  An operator's operands are the two sub-trees right in front of it, so their values
+//              are always the last two calculated: a stack as deep as stackDepth() is all it takes, on
+//              the thread's stack for trees up to kInlineRegisters deep and on the heap for deeper ones, so
+//              the tree itself is only read and any number of threads can evaluate it at once.  A
+//              conditional skips the nodes of the answer it doesn't pick.
+//              Division by zero and the arguments of functions are not checked for, as with a compiled program.
+//INPUT:
+//    tree      - The tree from parseTree().
+//    variables - The value of every slot the tree reads, for instance VariableTable::values().
+//OUTPUT:
+//    none
+//RETURNS:
+//    The value calculated from the expression, NaN if the tree is of a malformed expression.
+template <typename T = double>
+T evaluate(const Ast& tree, const T* variables = NULL)
+{
+    if (!tree.ok() || tree.size() == 0)
+        return std::numeric_limits<T>::quiet_NaN();
+
+    assert(variables != NULL || tree.variableCount == 0);
+
+    //Every value is written before it is read, but the compiler can't follow the nodes far enough to
+    //see the answer is, and clearing the whole stack takes longer than evaluating most trees.
+    T inlineStack[kInlineRegisters];
+    std::vector<T> heapStack;
+
+    T* stack = inlineStack;
+    if (tree.stackDepth() > kInlineRegisters)
+    {
+        heapStack.resize(tree.stackDepth());
+        stack = heapStack.data();
+    }
+    stack[0] = T(0);
+
+    int top = 0;
+    const AstNode* nodes = tree.data();
+    const int count = tree.size();
+    for (int i = 0; i < count; i++)
+    {
+        const AstNode& node = nodes[i];
+        switch (node.kind)
+        {
+        case AstKind::Number:   stack[top++] = T(node.value);                                break;
+        case AstKind::Variable: stack[top++] = variables[node.child[0]];                     break;
+        case AstKind::Negate:   stack[top - 1] = stack[top - 1] * -1;                        break;
+        case AstKind::Add:      top--; stack[top - 1] = stack[top - 1] + stack[top];         break;
+        case AstKind::Subtract: top--; stack[top - 1] = stack[top - 1] - stack[top];         break;
+        case AstKind::Multiply: top--; stack[top - 1] = stack[top - 1] * stack[top];         break;
+        case AstKind::Divide:   top--; stack[top - 1] = stack[top - 1] / stack[top];         break;
+        case AstKind::Branch:
+            top--;
+            if (stack[top] == 0)
+                i = node.child[1];
+            break;
+        case AstKind::Jump:        i = node.child[1];                                        break;
+        case AstKind::Conditional:                                                           break;
+        default:
+            if (isUnary(node.kind))
+                stack[top - 1] = applyFunction(kindFunction(node.kind), stack[top - 1], stack[top - 1]);
+            else
+            {
+                top--;
+                stack[top - 1] = applyFunction(kindFunction(node.kind), stack[top - 1], stack[top]);
+            }
+            break;
+        }
+    }
+
+    assert(top == 1);
+    return stack[0];
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <limits>
+
+#include "batch.h"
+#include "kernels.h"
+
+//How many rows every instruction is run over at a time.  Small enough for the registers of a
+//typical program to stay in the L1 cache, large enough to make the call to each kernel worthwhile.
+static const size_t kBatchLanes = 64;
+
+//Which lanes of a block the condition of a conditional picks the first answer for.
+static const unsigned char kNoLanes = 0;
+static const unsigned char kAllLanes = 1;
+static const unsigned char kSomeLanes = 2;
+
+//NAME: evaluateBatch
+//DESCRIPTION:  Runs a compiled program for many rows of variables at once.
+//              Constants are spread across a block once up front and variables are read straight
+//              out of their columns, so only operators ever write to the registers.
+//              Division by zero is not checked for, it gives infinity or NaN just like the hardware does.
+//              A conditional whose condition goes the same way for every row of a block only runs the
+//              answer it picks; otherwise both answers are run and each row picks its own.
+//INPUT:
+//    program - The program from compile().
+//    columns - One array of count values for every variable slot the program reads.
+//    count   - How many rows there are.
+//OUTPUT:
+//    out     - The answer for every row.  All NaN if the program failed to compile.
+//RETURNS:
+//    none
+template <typename T>
+void evaluateBatch(const Program& program, const T* const* columns, T* out, size_t count)
+{
+    assert(columns != NULL || program.variableCount == 0);
+
+    if (count == 0)
+        return;
+
+    if (!program.ok())
+    {
+        std::fill(out, out + count, std::numeric_limits<T>::quiet_NaN());
+        return;
+    }
+
+    const BatchKernels<T>& kernels = batchKernels<T>();
+    const Instruction* code = program.code.data();
+    const size_t instructions = program.code.size();
+
+    //Every register gets a block of lanes, and a pointer to where its current values are.
+    std::vector<T> storage(instructions * kBatchLanes);
+    std::vector<const T*> r(instructions);
+
+    //The lanes of every conditional's Branch, and a block of zeros to compare its condition with.
+    std::vector<unsigned char> picked(instructions);
+    const std::vector<T> zeros(kBatchLanes, T(0));
+
+    for (size_t i = 0; i < instructions; i++)
+    {
+        if (code[i].op == OpCode::Constant)
+            std::fill(&storage[i * kBatchLanes], &storage[i * kBatchLanes] + kBatchLanes, T(program.constants[code[i].lhs]));
+
+        r[i] = &storage[i * kBatchLanes];
+    }
+
+    //A program which is just a constant has nothing to run.
+    if (code[instructions - 1].op == OpCode::Constant)
+    {
+        std::fill(out, out + count, T(program.constants[code[instructions - 1].lhs]));
+        return;
+    }
+
+    for (size_t row = 0; row < count; row += kBatchLanes)
+    {
+        size_t lanes = std::min(kBatchLanes, count - row);
+
+        for (size_t i = 0; i < instructions; i++)
+        {
+            const Instruction& in = code[i];
+
+            //The answer goes straight into the output instead of a register.
+            T* result = (i == instructions - 1) ? out + row : &storage[i * kBatchLanes];
+
+            switch (in.op)
+            {
+            case OpCode::Constant:                                                           break;
+            case OpCode::Variable: r[i] = columns[in.lhs] + row;                             break;
+            case OpCode::Negate:   kernels.negate(r[in.lhs], result, lanes);                 break;
+            case OpCode::Add:      kernels.add(r[in.lhs], r[in.rhs], result, lanes);         break;
+            case OpCode::Subtract: kernels.subtract(r[in.lhs], r[in.rhs], result, lanes);    break;
+            case OpCode::Multiply: kernels.multiply(r[in.lhs], r[in.rhs], result, lanes);    break;
+            case OpCode::Divide:   kernels.divide(r[in.lhs], r[in.rhs], result, lanes);      break;
+            case OpCode::Power:    kernels.power(r[in.lhs], r[in.rhs], result, lanes);       break;
+            case OpCode::Min:      kernels.minimum(r[in.lhs], r[in.rhs], result, lanes);     break;
+            case OpCode::Max:      kernels.maximum(r[in.lhs], r[in.rhs], result, lanes);     break;
+            case OpCode::Sqrt:     kernels.squareRoot(r[in.lhs], result, lanes);             break;
+            case OpCode::Exp:      kernels.exponential(r[in.lhs], result, lanes);            break;
+            case OpCode::Log:      kernels.logarithm(r[in.lhs], result, lanes);              break;
+            case OpCode::Abs:      kernels.absolute(r[in.lhs], result, lanes);               break;
+            case OpCode::Less:         kernels.less(r[in.lhs], r[in.rhs], result, lanes);            break;
+            case OpCode::LessEqual:    kernels.lessEqual(r[in.lhs], r[in.rhs], result, lanes);       break;
+            case OpCode::Greater:      kernels.greater(r[in.lhs], r[in.rhs], result, lanes);         break;
+            case OpCode::GreaterEqual: kernels.greaterEqual(r[in.lhs], r[in.rhs], result, lanes);    break;
+            case OpCode::Equal:        kernels.equal(r[in.lhs], r[in.rhs], result, lanes);           break;
+            case OpCode::NotEqual:     kernels.notEqual(r[in.lhs], r[in.rhs], result, lanes);        break;
+            case OpCode::Branch:
+                {
+                    //1 in the lanes which pick the first answer.  If none do it isn't run at all.
+                    kernels.notEqual(r[in.lhs], zeros.data(), result, lanes);
+                    size_t taken = (size_t)std::count(result, result + lanes, T(1));
+                    picked[i] = taken == 0 ? kNoLanes : taken == lanes ? kAllLanes : kSomeLanes;
+                    if (taken == 0)
+                        i = in.rhs;
+                }
+                break;
+            case OpCode::Jump:
+                {
+                    //The first answer is where the Merge keeps its values.  If every lane picks it the
+                    //other answer isn't run at all.
+                    T* answer = (in.rhs == (int)instructions - 1) ? out + row : &storage[in.rhs * kBatchLanes];
+                    if (picked[code[in.rhs].lhs] == kAllLanes && answer != out + row)
+                        r[in.rhs] = r[in.lhs];
+                    else
+                        std::copy(r[in.lhs], r[in.lhs] + lanes, answer);
+
+                    if (picked[code[in.rhs].lhs] == kAllLanes)
+                        i = in.rhs;
+                }
+                break;
+            case OpCode::Merge:
+                if (picked[in.lhs] == kNoLanes && result != out + row)
+                    r[i] = r[in.rhs];
+                else if (picked[in.lhs] == kNoLanes)
+                    std::copy(r[in.rhs], r[in.rhs] + lanes, result);
+                else
+                {
+                    kernels.select(r[in.lhs], result, r[in.rhs], result, lanes);
+                    r[i] = result;
+                }
+                break;
+            }
+        }
+
+        //A program which only reads a variable has to copy it out.
+        if (code[instructions - 1].op == OpCode::Variable)
+            std::copy(r[instructions - 1], r[instructions - 1] + lanes, out + row);
+    }
+}
+
+template void evaluateBatch<float>(const Program& program, const float* const* columns, float* out, size_t count);
+template void evaluateBatch<double>(const Program& program, const double* const* columns, double* out, size_t count);
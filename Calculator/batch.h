@@ -0,0 +1,21 @@
+#ifndef CALCULATOR_BATCH_H
+#define CALCULATOR_BATCH_H
+
+#include <cstddef>
+
+#include "compiler.h"
+
+//evaluate() runs a program for one set of variables.  When the same expression has to be calculated
+//for many rows of inputs it is much faster to run each instruction over many rows at once, since the
+//processor can then do four, eight or more of them with a single vector instruction.
+//evaluateBatch() takes the inputs as columns, one array per variable slot:
+//     columns[price] = { 9.5, 19.0, 28.5, ... }
+//     columns[qty]   = { 2.0,  4.0,  6.0, ... }
+//and works through them a block of rows at a time so the registers of the block stay in the cache.
+//T is float or double; float fits twice as many lanes in every vector.
+
+//Function declarations
+template <typename T>
+void evaluateBatch(const Program& program, const T* const* columns, T* out, size_t count);
+
+#endif
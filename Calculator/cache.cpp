@@ -0,0 +1,315 @@
+#include <cstring>
+
+#include "cache.h"
+#include "parser.h"
+
+//NAME: isTokenChar
+//DESCRIPTION:  Checks to see if a character can be part of a literal or a name, where a space in
+//              between splits it in two: "1 2" is not "12".
+//INPUT:
+//    c - The character to check.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if a space next to two of these has to be kept.
+static bool isTokenChar(char c)
+{
+    return isIdentifierChar(c) || c == '.';
+}
+
+//NAME: isSignificantSpace
+//DESCRIPTION:  Checks to see if the spaces between two characters change the meaning of the expression.
+//              Besides splitting literals and names, spaces also cut an exponent off its literal:
+//              "2e -5" and "2e- 5" are errors while "2e-5" is a number, a minus sign in front of an
+//              operand off what it negates: "2*- 3" is an error while "2*-3" is -6, and an operator of
+//              two characters in two: "1 < = 2" is an error while "1 <= 2" is 1.
+//INPUT:
+//    beforePrevious - The character before previous, or '\0'.
+//    previous       - The last character before the spaces.
+//    next           - The first character after them.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the spaces have to be kept.
+static bool isSignificantSpace(char beforePrevious, char previous, char next)
+{
+    if (isTokenChar(previous) && isTokenChar(next))
+        return true;
+    if ((previous == 'e' || previous == 'E') && (next == '+' || next == '-'))
+        return true;
+
+    if ((previous == '+' || previous == '-') && (beforePrevious == 'e' || beforePrevious == 'E'))
+        return true;
+    if (previous != '\0' && strchr("<>=!&|", previous) != NULL && (next == '=' || next == '&' || next == '|'))
+        return true;
+
+    //A minus sign is in front of an operand unless it follows one, which ends in a name, a literal or a ')'.
+    return previous == '-' && !isTokenChar(beforePrevious) && beforePrevious != ')';
+}
+
+//NAME: mix
+//DESCRIPTION:  Spreads every bit of a hash over all of the others (the splitmix64 finalizer).
+static uint64_t mix(uint64_t hash)
+{
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    return hash ^ (hash >> 31);
+}
+
+//NAME: hashExpression
+//DESCRIPTION:  Hashes the expression without the spaces that don't matter, so "1+2" and " 1 + 2 " hash
+//              the same.  The spaces that do matter are hashed as a single space, whatever they were.
+//INPUT:
+//    eq    - The expression to hash.
+//OUTPUT:
+//    where - Picks the bucket.
+//    key   - Identifies the expression within the bucket.  Never zero.
+//RETURNS:
+//    none
+static void hashExpression(const char* eq, uint64_t& where, uint64_t& key)
+{
+    uint64_t first = 0xCBF29CE484222325ull;
+    uint64_t second = 0x84222325CBF29CE4ull;
+    char beforePrevious = '\0';
+    char previous = '\0';
+
+    while (*eq != '\0')
+    {
+        char c = *eq;
+        if (isSpace(c))
+        {
+            eq = skipSpaces(eq);
+
+            if (previous == '\0' || *eq == '\0' || !isSignificantSpace(beforePrevious, previous, *eq))
+                continue;
+
+            c = ' ';
+        }
+        else
+            eq++;
+
+        //FNV-1a for the first hash and a rotate, xor and multiply for the second.
+        first = (first ^ (unsigned char)c) * 0x100000001B3ull;
+        second = (((second << 5) | (second >> 59)) ^ (unsigned char)c) * 0x9E3779B97F4A7C15ull;
+
+        beforePrevious = previous;
+        previous = c;
+    }
+
+    where = mix(first);
+    key = mix(second) | 1;
+}
+
+//NAME: counterStripe
+//DESCRIPTION:  Which of the hit and miss counters this thread updates, so that threads hitting the cache
+//              at the same time don't all write to the same cache line.
+static unsigned counterStripe()
+{
+    static std::atomic<unsigned> nextStripe(0);
+    thread_local unsigned stripe = nextStripe.fetch_add(1, std::memory_order_relaxed);
+    return stripe;
+}
+
+//NAME: SolveCache::SolveCache
+//DESCRIPTION:  Creates an empty cache.
+//INPUT:
+//    capacity - How many answers it should hold.  Rounded up to a power of two number of buckets.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+SolveCache::SolveCache(size_t capacity) : bucketCount(1)
+{
+    while (bucketCount * kWays < capacity)
+        bucketCount *= 2;
+
+    buckets.reset(new Bucket[bucketCount]);
+    clocks.reset(new Clock[bucketCount]);
+    for (int i = 0; i < kCounterStripes; i++)
+    {
+        counters[i].hits.store(0, std::memory_order_relaxed);
+        counters[i].misses.store(0, std::memory_order_relaxed);
+    }
+
+    clear();
+}
+
+//NAME: SolveCache::solve
+//DESCRIPTION:  solve() with the answer taken from the cache if the expression has been seen before.
+//INPUT:
+//    eq - The expression to solve.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The same as solve(eq).
+Result<double> SolveCache::solve(const char* eq)
+{
+    uint64_t where, key;
+    hashExpression(eq, where, key);
+
+    Result<double> result;
+    uint64_t bucket = where & (bucketCount - 1);
+    if (lookup(bucket, key, result.value))
+    {
+        result.error = ErrorCode::None;
+        result.offset = 0;
+        return result;
+    }
+
+    result = ::solve(eq);
+    if (result.ok())
+        insert(bucket, key, result.value);
+
+    return result;
+}
+
+//NAME: SolveCache::find
+//DESCRIPTION:  Looks an expression up without solving it if it isn't there.
+//INPUT:
+//    eq    - The expression to look for.
+//OUTPUT:
+//    value - Its answer, if it was found.
+//RETURNS:
+//    True if the expression was in the cache.
+bool SolveCache::find(const char* eq, double& value)
+{
+    uint64_t where, key;
+    hashExpression(eq, where, key);
+    return lookup(where & (bucketCount - 1), key, value);
+}
+
+//NAME: SolveCache::clear
+//DESCRIPTION:  Forgets every answer.  The counters are kept.  Not safe to call while other threads
+//              are using the cache.
+void SolveCache::clear()
+{
+    for (size_t i = 0; i < bucketCount; i++)
+    {
+        for (int way = 0; way < kWays; way++)
+        {
+            buckets[i].check[way].store(0, std::memory_order_relaxed);
+            buckets[i].value[way].store(0, std::memory_order_relaxed);
+        }
+
+        clocks[i].referenced.store(0, std::memory_order_relaxed);
+        clocks[i].hand = 0;
+    }
+}
+
+//NAME: SolveCache::hits
+//DESCRIPTION:  How many lookups found their expression.
+uint64_t SolveCache::hits() const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < kCounterStripes; i++)
+        total += counters[i].hits.load(std::memory_order_relaxed);
+
+    return total;
+}
+
+//NAME: SolveCache::misses
+//DESCRIPTION:  How many lookups didn't find their expression.
+uint64_t SolveCache::misses() const
+{
+    uint64_t total = 0;
+    for (int i = 0; i < kCounterStripes; i++)
+        total += counters[i].misses.load(std::memory_order_relaxed);
+
+    return total;
+}
+
+//NAME: SolveCache::lookup
+//DESCRIPTION:  Searches a bucket for an expression.
+//INPUT:
+//    bucket - The bucket the expression hashes to.
+//    key    - The expression's key.
+//OUTPUT:
+//    value  - Its answer, if it was found.
+//RETURNS:
+//    True if the expression was found.
+bool SolveCache::lookup(uint64_t bucket, uint64_t key, double& value)
+{
+    Counters& counter = counters[counterStripe() % kCounterStripes];
+    Bucket& entries = buckets[bucket];
+
+    for (int way = 0; way < kWays; way++)
+    {
+        uint64_t bits = entries.value[way].load(std::memory_order_relaxed);
+        if ((entries.check[way].load(std::memory_order_relaxed) ^ bits) != key)
+            continue;
+
+        //Only mark the entry if it isn't already, so hits on popular entries stay read only.
+        Clock& clock = clocks[bucket];
+        uint8_t mask = (uint8_t)(1 << way);
+        if ((clock.referenced.load(std::memory_order_relaxed) & mask) == 0)
+            clock.referenced.fetch_or(mask, std::memory_order_relaxed);
+
+        memcpy(&value, &bits, sizeof(value));
+        counter.hits.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    counter.misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+//NAME: SolveCache::insert
+//DESCRIPTION:  Adds an answer to a bucket, replacing an empty entry or else the first one the CLOCK hand
+//              finds that hasn't been hit since it last came by.
+//INPUT:
+//    bucket - The bucket the expression hashes to.
+//    key    - The expression's key.
+//    value  - Its answer.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void SolveCache::insert(uint64_t bucket, uint64_t key, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    std::lock_guard<std::mutex> lock(stripes[bucket % kStripes].mutex);
+    Bucket& entries = buckets[bucket];
+    Clock& clock = clocks[bucket];
+
+    int victim = -1;
+    for (int way = 0; way < kWays; way++)
+    {
+        uint64_t check = entries.check[way].load(std::memory_order_relaxed);
+        uint64_t old = entries.value[way].load(std::memory_order_relaxed);
+
+        //Another thread got here first.
+        if ((check ^ old) == key)
+            return;
+
+        if (victim < 0 && check == 0 && old == 0)
+            victim = way;
+    }
+
+    if (victim < 0)
+    {
+        //Every entry gets a second chance; after one turn of the hand at least one has lost it.
+        for (;;)
+        {
+            uint8_t mask = (uint8_t)(1 << clock.hand);
+            int way = clock.hand;
+            clock.hand = (uint8_t)((clock.hand + 1) % kWays);
+
+            if ((clock.referenced.load(std::memory_order_relaxed) & mask) == 0)
+            {
+                victim = way;
+                break;
+            }
+
+            clock.referenced.fetch_and((uint8_t)~mask, std::memory_order_relaxed);
+        }
+    }
+
+    //A reader seeing the old check with the new value (or the other way around) finds no match.
+    entries.value[victim].store(bits, std::memory_order_relaxed);
+    entries.check[victim].store(key ^ bits, std::memory_order_relaxed);
+    clock.referenced.fetch_and((uint8_t)~(1 << victim), std::memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#ifndef CALCULATOR_CACHE_H
+#define CALCULATOR_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "errors.h"
+
+//The same expressions tend to arrive over and over, often differing only in their spacing.
+//SolveCache remembers the answers to the ones it has seen so solve() doesn't have to parse them again.
+//
+//Nothing of the expression itself is stored.  It is hashed twice in a single pass, skipping the spaces
+//which don't change its meaning: the first hash picks a bucket and the second, 64 bit one identifies the
+//expression inside it.  Two different expressions would have to agree on both to be confused.
+//
+//A bucket is one cache line holding four entries, so a lookup is one hash and one memory probe.
+//Readers never take a lock: every entry stores key ^ value next to the value, so an entry that is being
+//overwritten at the same time simply doesn't match and counts as a miss.  All a reader writes is its
+//thread's stripe of the hit and miss counters, and the referenced bit of an entry it hits if that isn't
+//set already.
+//Writers are serialized by one of a set of striped locks and replace entries in CLOCK order, so entries
+//which are still being hit survive.  Only expressions without errors are cached.
+
+//How many answers a cache holds by default.
+static const size_t kDefaultCacheCapacity = 4096;
+
+class SolveCache
+{
+public:
+    explicit SolveCache(size_t capacity = kDefaultCacheCapacity);
+
+    SolveCache(const SolveCache&) = delete;
+
+    SolveCache& operator=(const SolveCache&) = delete;
+
+    Result<double> solve(const char* eq);
+
+    bool find(const char* eq, double& value);
+
+    void clear();
+
+    size_t capacity() const { return bucketCount * kWays; }
+
+    uint64_t hits() const;
+
+    uint64_t misses() const;
+
+private:
+    static const int kWays = 4;
+    static const int kStripes = 16;
+    static const int kCounterStripes = 16;
+
+    //NAME: Bucket
+    //DESCRIPTION:  Four entries sharing a cache line.  check[i] is key[i] ^ value[i]; both zero is empty.
+    struct alignas(64) Bucket
+    {
+        std::atomic<uint64_t> check[kWays];
+        std::atomic<uint64_t> value[kWays];
+    };
+
+    //NAME: Clock
+    //DESCRIPTION:  The CLOCK state of a bucket: which entries were hit since the hand last passed them,
+    //              and where the hand is.  Readers only write referenced when the bit isn't already set.
+    struct Clock
+    {
+        std::atomic<uint8_t> referenced;
+        uint8_t hand;
+    };
+
+    struct alignas(64) Stripe
+    {
+        std::mutex mutex;
+    };
+
+    struct alignas(64) Counters
+    {
+        std::atomic<uint64_t> hits;
+        std::atomic<uint64_t> misses;
+    };
+
+    bool lookup(uint64_t bucket, uint64_t key, double& value);
+
+    void insert(uint64_t bucket, uint64_t key, double value);
+
+    std::unique_ptr<Bucket[]> buckets;
+    std::unique_ptr<Clock[]> clocks;
+    size_t bucketCount;
+    Stripe stripes[kStripes];
+    Counters counters[kCounterStripes];
+};
+
+#endif
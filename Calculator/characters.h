@@ -0,0 +1,241 @@
+#ifndef CALCULATOR_CHARACTERS_H
+#define CALCULATOR_CHARACTERS_H
+
+#include <bit>
+#include <cstdint>
+#include <type_traits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CALC_SSE2 1
+#include <emmintrin.h>
+#endif
+
+//Every character the tokenizer looks at is classified with a single lookup in kCharacterTable instead
+//of a chain of comparisons, and one character can be in several classes at once: a letter is both
+//kIdentifierStartClass and kIdentifierClass.
+//
+//Spaces are ' ', '\t', '\v', '\f' and '\r'.  '\n' is not a space: it ends a line in the streaming mode,
+//while a '\r' in front of it just gets skipped like any other space.
+//Runs of spaces and digits longer than a character or two are skipped sixteen at a time with SSE2.
+//Like the literal scanner, that may read up to fifteen bytes past the end of the run, which is only
+//done when they are on the same memory page; CALC_NO_OVERREAD turns it off.
+
+#if defined(__SANITIZE_ADDRESS__)
+#define CALC_NO_OVERREAD 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define CALC_NO_OVERREAD 1
+#endif
+#endif
+
+//The loops going sixteen characters at a time are kept out of line, where they don't get in the way of
+//the tokenizer functions they are called from.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CALC_NOINLINE __declspec(noinline)
+#else
+#define CALC_NOINLINE __attribute__((noinline))
+#endif
+
+static const uint16_t kDigitClass = 0x001;
+static const uint16_t kSpaceClass = 0x002;
+static const uint16_t kSumClass = 0x004;                //+ and -
+static const uint16_t kProductClass = 0x008;            //* and /
+static const uint16_t kParenthesisClass = 0x010;
+static const uint16_t kIdentifierStartClass = 0x020;
+static const uint16_t kIdentifierClass = 0x040;
+static const uint16_t kPowerClass = 0x080;              //^
+static const uint16_t kComparisonClass = 0x100;         //< > = and !, which start every comparison
+static const uint16_t kConditionalClass = 0x200;        //? and : of a conditional, & and | of && and ||
+
+//NAME: CharacterTable
+//DESCRIPTION:  The classes of all 256 characters.
+struct CharacterTable
+{
+    uint16_t classes[256];
+};
+
+//NAME: makeCharacterTable
+//DESCRIPTION:  Fills in the table, while compiling.
+constexpr CharacterTable makeCharacterTable()
+{
+    CharacterTable table = {};
+    for (int c = '0'; c <= '9'; c++)
+        table.classes[c] = kDigitClass | kIdentifierClass;
+    for (int c = 'a'; c <= 'z'; c++)
+        table.classes[c] = kIdentifierStartClass | kIdentifierClass;
+    for (int c = 'A'; c <= 'Z'; c++)
+        table.classes[c] = kIdentifierStartClass | kIdentifierClass;
+
+    table.classes['_'] = kIdentifierStartClass | kIdentifierClass;
+    table.classes[' '] = kSpaceClass;
+    table.classes['\t'] = kSpaceClass;
+    table.classes['\v'] = kSpaceClass;
+    table.classes['\f'] = kSpaceClass;
+    table.classes['\r'] = kSpaceClass;
+    table.classes['+'] = kSumClass;
+    table.classes['-'] = kSumClass;
+    table.classes['*'] = kProductClass;
+    table.classes['/'] = kProductClass;
+    table.classes['^'] = kPowerClass;
+    table.classes['<'] = kComparisonClass;
+    table.classes['>'] = kComparisonClass;
+    table.classes['='] = kComparisonClass;
+    table.classes['!'] = kComparisonClass;
+    table.classes['?'] = kConditionalClass;
+    table.classes[':'] = kConditionalClass;
+    table.classes['&'] = kConditionalClass;
+    table.classes['|'] = kConditionalClass;
+    table.classes['('] = kParenthesisClass;
+    table.classes[')'] = kParenthesisClass;
+    return table;
+}
+
+inline constexpr CharacterTable kCharacterTable = makeCharacterTable();
+
+//NAME: characterClass
+//DESCRIPTION:  The classes a character belongs to.
+constexpr uint16_t characterClass(char c)
+{
+    return kCharacterTable.classes[(unsigned char)c];
+}
+
+//NAME: isSpace
+//DESCRIPTION:  Checks to see if a character is a space the tokenizer skips.
+constexpr bool isSpace(char c)
+{
+    //Almost every character the tokenizer sees is above ' ', which takes one comparison to rule out.
+    return (unsigned char)c <= ' ' && (characterClass(c) & kSpaceClass) != 0;
+}
+
+//NAME: canReadSixteen
+//DESCRIPTION:  Checks to see if sixteen bytes can be loaded starting at p without crossing into the next
+//              memory page, which might not exist.
+//INPUT:
+//    p - Where the load would start.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the load is safe.
+constexpr bool canReadSixteen(const char* p)
+{
+    if (std::is_constant_evaluated())
+        return false;
+
+#if defined(CALC_NO_OVERREAD) || !defined(CALC_SSE2)
+    (void)p;
+    return false;
+#else
+    return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - 16;
+#endif
+}
+
+#if defined(CALC_SSE2)
+//NAME: spaceMask
+//DESCRIPTION:  One bit for each of sixteen characters which is a space: ' ' or '\t' to '\r' except '\n'.
+inline unsigned spaceMask(const char* p)
+{
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i control = _mm_sub_epi8(chunk, _mm_set1_epi8('\t'));
+    __m128i inRange = _mm_cmpeq_epi8(_mm_min_epu8(control, _mm_set1_epi8('\r' - '\t')), control);
+    __m128i spaces = _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')),
+                                  _mm_andnot_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), inRange));
+    return (unsigned)_mm_movemask_epi8(spaces);
+}
+
+//NAME: digitMask
+//DESCRIPTION:  One bit for each of sixteen characters which is a digit, and in zeros one for each '0'.
+inline unsigned digitMask(const char* p, unsigned& zeros)
+{
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i value = _mm_sub_epi8(chunk, _mm_set1_epi8('0'));
+    __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(value, _mm_set1_epi8(9)), value);
+    zeros = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('0')));
+    return (unsigned)_mm_movemask_epi8(digits);
+}
+#endif
+
+//NAME: skipSpaceRun
+//DESCRIPTION:  Skips a run of spaces, sixteen at a time where possible.
+//INPUT:
+//    p - Where the spaces may start.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The first character which isn't a space.
+CALC_NOINLINE constexpr const char* skipSpaceRun(const char* p)
+{
+#if defined(CALC_SSE2)
+    while (isSpace(*p) && canReadSixteen(p))
+    {
+        unsigned others = ~spaceMask(p) & 0xFFFF;
+        if (others != 0)
+            return p + std::countr_zero(others);
+
+        p += 16;
+    }
+#endif
+
+    while (isSpace(*p))
+        p++;
+
+    return p;
+}
+
+//NAME: skipSpaces
+//DESCRIPTION:  Skips any spaces.  There is usually none or one, which costs a comparison or two; longer
+//              runs, such as indentation, are left to skipSpaceRun().
+//INPUT:
+//    p - Where the spaces may start.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The first character which isn't a space.
+constexpr const char* skipSpaces(const char* p)
+{
+    if (!isSpace(*p))
+        return p;
+    p++;
+
+    if (!isSpace(*p))
+        return p;
+
+    return skipSpaceRun(p);
+}
+
+//NAME: skipDigits
+//DESCRIPTION:  Skips a run of digits, sixteen at a time where possible.
+//INPUT:
+//    p        - Where the digits may start.
+//OUTPUT:
+//    nonZero  - Set if any of the digits skipped isn't '0'; left alone otherwise.
+//RETURNS:
+//    The first character which isn't a digit.
+CALC_NOINLINE constexpr const char* skipDigits(const char* p, bool& nonZero)
+{
+#if defined(CALC_SSE2)
+    while (canReadSixteen(p))
+    {
+        unsigned zeros = 0;
+        unsigned digits = digitMask(p, zeros);
+        unsigned others = ~digits & 0xFFFF;
+        unsigned run = others != 0 ? ((1u << std::countr_zero(others)) - 1) : 0xFFFF;
+        if ((digits & ~zeros & run) != 0)
+            nonZero = true;
+        if (others != 0)
+            return p + std::countr_zero(others);
+
+        p += 16;
+    }
+#endif
+
+    while (*p >= '0' && *p <= '9')
+    {
+        if (*p != '0')
+            nonZero = true;
+        p++;
+    }
+
+    return p;
+}
+
+#endif
@@ -0,0 +1,388 @@
+#include "compiler.h"
+
+//NAME: Compiler::number
+//DESCRIPTION:  Records a literal.  The text has already been converted, so the program never
+//              has to look at it again.
+//INPUT:
+//    value - The value of the literal.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the literal.
+Compiler::Value Compiler::number(double value)
+{
+    program.constants.push_back(value);
+    return emit(OpCode::Constant, (int)program.constants.size() - 1, 0);
+}
+
+//NAME: Compiler::variable
+//DESCRIPTION:  Records a variable.  The name is resolved to its slot now so the program never
+//              has to compare names.  Names the table doesn't know yet are defined in it.
+//INPUT:
+//    name   - The name of the variable, pointing into the expression.
+//    length - How many characters the name has.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the variable.
+Compiler::Value Compiler::variable(const char* name, size_t length)
+{
+    //An answer which is dropped doesn't need its variables.
+    if (dropping > 0)
+        return number(0);
+
+    //Compiling an expression with variables needs a table to resolve them in.
+    if (variables == NULL)
+    {
+        fail(ErrorCode::UnknownVariable, name);
+        return number(0);
+    }
+
+    int slot = variables->find(name, length);
+    if (slot < 0)
+        slot = variables->define(std::string(name, length).c_str());
+
+    if (slot >= program.variableCount)
+        program.variableCount = slot + 1;
+
+    return emit(OpCode::Variable, slot, 0);
+}
+
+//NAME: Compiler::negate
+//DESCRIPTION:  Records a negation.  Negating a constant is done right away.
+//INPUT:
+//    value - The register to negate.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the negated value.
+Compiler::Value Compiler::negate(Value value)
+{
+    if (isConstant(value))
+    {
+        double constant = program.constants[program.code[value].lhs];
+        discard(value);
+
+        Evaluator<double> evaluator;
+        return number(evaluator.negate(constant));
+    }
+
+    return emit(OpCode::Negate, value, 0);
+}
+
+//NAME: Compiler::call
+//DESCRIPTION:  Records a function taking one argument.  A function of a constant is calculated right away.
+//INPUT:
+//    function - The function.
+//    argument - The register of its argument.
+//    at       - Where the function's name starts, for reporting an argument it isn't defined for.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the result.
+Compiler::Value Compiler::call(Function function, Value argument, const char* at)
+{
+    if (isConstant(argument))
+    {
+        double constant = program.constants[program.code[argument].lhs];
+        discard(argument);
+
+        Evaluator<double> evaluator;
+        double result = evaluator.call(function, constant, at);
+        if (evaluator.failed() && foldFailed(evaluator))
+            return emit(functionCode(function), number(constant), 0);
+
+        return number(result);
+    }
+
+    return emit(functionCode(function), argument, 0);
+}
+
+//NAME: Compiler::binary
+//DESCRIPTION:  Records a binary operator, or a function taking two arguments.  When both operands are
+//              constants the operator is calculated right away and only the result is kept.
+//INPUT:
+//    op     - The operator.
+//    first  - The register of the left operand.
+//    second - The register of the right operand.
+//    at     - Where the right operand starts in the expression, for reporting division by zero.
+//             For a function, where it is reported when the arguments are out of its domain.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the result.
+Compiler::Value Compiler::binary(OpCode op, Value first, Value second, const char* at)
+{
+    if (isConstant(first) && isConstant(second))
+    {
+        double a = program.constants[program.code[first].lhs];
+        double b = program.constants[program.code[second].lhs];
+
+        //The second operand was parsed after the first, so it has to go first.
+        discard(second);
+        discard(first);
+
+        //Folding uses the very same arithmetic as solve() so both give the same answer.
+        Evaluator<double> evaluator;
+        switch (op)
+        {
+        case OpCode::Add:      return number(evaluator.add(a, b));
+        case OpCode::Subtract: return number(evaluator.subtract(a, b));
+        case OpCode::Multiply: return number(evaluator.multiply(a, b));
+        default:
+            {
+                double result = op == OpCode::Divide ? evaluator.divide(a, b, at) : evaluator.call(codeFunction(op), a, b, at);
+                if (evaluator.failed() && foldFailed(evaluator))
+                {
+                    Value lhs = number(a);
+                    Value rhs = number(b);
+                    return emit(op, lhs, rhs);
+                }
+
+                return number(result);
+            }
+        }
+    }
+
+    return emit(op, first, second);
+}
+
+//NAME: Compiler::beginThen
+//DESCRIPTION:  Records the Branch after the condition of a conditional.  A condition which is a constant
+//              picks its answer right away: the Branch isn't needed, and neither is the other answer.
+//              Inside an answer which is dropped everything is a constant, conditions included.
+//INPUT:
+//    condition - The register of the condition.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void Compiler::beginThen(Value condition)
+{
+    Conditional conditional = { -1, -1, true, 0, 0 };
+    if (isConstant(condition))
+    {
+        conditional.taken = program.constants[program.code[condition].lhs] != 0;
+        discard(condition);
+
+        if (!conditional.taken)
+        {
+            conditional.code = program.code.size();
+            conditional.constants = program.constants.size();
+            dropping++;
+        }
+    }
+    else
+    {
+        conditional.branch = emit(OpCode::Branch, condition, -1);
+        speculative++;
+    }
+
+    conditionals.push_back(conditional);
+}
+
+//NAME: Compiler::beginElse
+//DESCRIPTION:  Records the Jump after the first answer of a conditional, or drops that answer if its
+//              condition was a constant 0.
+//INPUT:
+//    condition - The register of the condition.
+//    then      - The register of the first answer.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void Compiler::beginElse(Value, Value then)
+{
+    Conditional& conditional = conditionals.back();
+    if (conditional.branch >= 0)
+    {
+        conditional.jump = emit(OpCode::Jump, then, -1);
+        program.code[conditional.branch].rhs = conditional.jump;
+    }
+    else if (conditional.taken)
+    {
+        conditional.code = program.code.size();
+        conditional.constants = program.constants.size();
+        dropping++;
+    }
+    else
+    {
+        drop(conditional);
+        dropping--;
+    }
+}
+
+//NAME: Compiler::endConditional
+//DESCRIPTION:  Records the Merge at the end of a conditional, or drops its other answer if the condition
+//              was a constant which isn't 0.
+//INPUT:
+//    condition - The register of the condition.
+//    then      - The register of the first answer.
+//    otherwise - The register of the other answer.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the answer which is picked.
+Compiler::Value Compiler::endConditional(Value, Value then, Value otherwise)
+{
+    Conditional conditional = conditionals.back();
+    conditionals.pop_back();
+    if (conditional.branch >= 0)
+    {
+        int merge = emit(OpCode::Merge, conditional.branch, otherwise);
+        program.code[conditional.jump].rhs = merge;
+        speculative--;
+        return merge;
+    }
+
+    if (!conditional.taken)
+        return otherwise;
+
+    //The first answer is the last thing recorded again.
+    drop(conditional);
+    dropping--;
+    return then;
+}
+
+//NAME: Compiler::drop
+//DESCRIPTION:  Removes the answer of a conditional which is never picked, everything recorded since it started.
+//INPUT:
+//    conditional - The conditional.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void Compiler::drop(const Conditional& conditional)
+{
+    program.code.resize(conditional.code);
+    program.constants.resize(conditional.constants);
+}
+
+//NAME: Compiler::foldFailed
+//DESCRIPTION:  Decides what happens when folding constants fails, as dividing by a constant 0 does.
+//              Normally that is an error in the expression.  In an answer which is dropped it is nothing,
+//              and in one which may not be picked the operation is recorded instead, to fail when it runs.
+//INPUT:
+//    folding - The evaluator which failed.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the operation has to be recorded.
+bool Compiler::foldFailed(const ErrorState& folding)
+{
+    if (dropping > 0)
+        return false;
+    if (speculative > 0)
+        return true;
+
+    fail(folding.error, folding.errorAt);
+    return false;
+}
+
+//NAME: Compiler::emit
+//DESCRIPTION:  Appends an instruction to the program.
+//INPUT:
+//    op  - The operation.
+//    lhs - The first operand (or constant index).
+//    rhs - The second operand.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register the instruction writes to.
+Compiler::Value Compiler::emit(OpCode op, int lhs, int rhs)
+{
+    Instruction instruction = { op, lhs, rhs };
+    program.code.push_back(instruction);
+    return (int)program.code.size() - 1;
+}
+
+//NAME: Compiler::isConstant
+//DESCRIPTION:  Checks to see if a register holds a value known at compile time.
+//INPUT:
+//    value - The register to check.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the register is loaded from the constant pool.
+bool Compiler::isConstant(Value value) const
+{
+    return program.code[value].op == OpCode::Constant;
+}
+
+//NAME: Compiler::discard
+//DESCRIPTION:  Removes a constant which has been folded into another one.
+//              Folded constants are always the last thing recorded, since a constant sub-expression
+//              folds all the way down to a single instruction before its parent sees it.
+//INPUT:
+//    value - The register to remove.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void Compiler::discard(Value value)
+{
+    assert(value == (int)program.code.size() - 1);
+    assert(program.code[value].lhs == (int)program.constants.size() - 1);
+    (void)value;
+
+    program.code.pop_back();
+    program.constants.pop_back();
+}
+
+//NAME: compileWith
+//DESCRIPTION:  Parses an expression once and records it as a Program.
+//INPUT:
+//    eq        - The expression to compile.
+//    variables - The table to resolve names in, NULL if the expression has none.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The compiled program.
+static Program compileWith(const char* eq, VariableTable* variables)
+{
+    assert(eq != NULL);
+
+    Program program;
+    Compiler compiler(program, variables);
+    parseExpression(eq, compiler);
+
+    //Half a program is no use to anybody.
+    if (compiler.failed())
+    {
+        program.code.clear();
+        program.constants.clear();
+        program.error = compiler.error;
+        program.errorOffset = (int)(compiler.errorAt - eq);
+    }
+
+    return program;
+}
+
+//NAME: compile
+//DESCRIPTION:  Parses an expression once and records it as a Program.
+//INPUT:
+//    eq  - The expression to compile.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The compiled program.  Pass it to evaluate() as many times as needed.
+//    Check ok() first, a malformed expression can't be evaluated.
+Program compile(const char* eq)
+{
+    return compileWith(eq, NULL);
+}
+
+//NAME: compile
+//DESCRIPTION:  Parses an expression which may refer to variables once and records it as a Program.
+//INPUT:
+//    eq        - The expression to compile.
+//INPUT/OUTPUT:
+//    variables - The table the names in the expression are resolved in.  Names it doesn't
+//                contain yet are added to it.
+//RETURNS:
+//    The compiled program.  Pass it to evaluate() along with variables.values().
+//    Check ok() first, a malformed expression can't be evaluated.
+Program compile(const char* eq, VariableTable& variables)
+{
+    return compileWith(eq, &variables);
+}
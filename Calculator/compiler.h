@@ -0,0 +1,315 @@
+#ifndef CALCULATOR_COMPILER_H
+#define CALCULATOR_COMPILER_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "parser.h"
+
+//Parsing an expression is by far the most expensive part of solving it: every character has to be
+//looked at and every literal converted from text.  When the same expression is solved over and over
+//that work is repeated every time for no reason.
+//compile() runs the parser once and records the operations it finds into a flat list of instructions.
+//Every instruction stores its result in its own register (the register number IS the instruction number),
+//and only ever reads registers written before it, so evaluating the program is a single pass from the
+//first instruction to the last with no character scanning and no recursion.
+//     1 + 2 * -(3 + x)
+//
+//     r0 = 1
+//     r1 = 2
+//     r2 = 3           Sub-expressions made of constants only are calculated while compiling,
+//     r3 = x           so only the parts that can change are left for evaluate().
+//     r4 = r2 + r3     Variables are read from the slot their name was resolved to while compiling.
+//     r5 = -r4
+//     r6 = r1 * r5
+//     r7 = r0 + r6     The last register holds the answer.
+//
+//A conditional only runs the instructions of the answer it picks.  Its condition is followed by a Branch,
+//the instructions of the first answer, a Jump, the instructions of the other answer and a Merge, whose
+//register ends up holding the answer which was picked:
+//     x > 0 ? sqrt(x) : 0
+//
+//     r0 = x
+//     r1 = 0
+//     r2 = r0 > r1
+//     r3 = branch r2 else r5       1 if r2 isn't 0; if it is, evaluate() goes on after r5.
+//     r4 = sqrt(r0)
+//     r5 = jump r4 to r7           Stores r4 in r7 and goes on after r7.
+//     r6 = 0
+//     r7 = merge r3, r6            Stores r6 in r7.
+//The registers of an answer are only written if it is picked, and nothing after the Merge reads them.
+//A condition which is a constant leaves nothing but the answer it picks, and the other one isn't even
+//checked for errors, exactly as solve() doesn't check it.  Neither is an answer which may not be picked
+//when it is folded: x > 0 ? 1 / 0 : 2 compiles, and gives infinity for positive x.
+//
+//Literals are converted and constants folded in double precision.  evaluate<T>() runs the same program
+//in whatever type is asked for, so one compiled expression serves float batch work as well as double
+//finance paths.
+
+
+//NAME: OpCode
+//DESCRIPTION:  The operations an instruction can perform.
+enum class OpCode : unsigned char
+{
+    Constant,      //Loads constants[lhs].
+    Variable,      //Loads variables[lhs].
+    Negate,        //-lhs
+    Add,           //lhs + rhs
+    Subtract,      //lhs - rhs
+    Multiply,      //lhs * rhs
+    Divide,        //lhs / rhs
+    Power,         //lhs ^ rhs         The functions, in the same order as Function.
+    Min,           //min(lhs, rhs)
+    Max,           //max(lhs, rhs)
+    Sqrt,          //sqrt(lhs)
+    Exp,           //exp(lhs)
+    Log,           //log(lhs)
+    Abs,           //abs(lhs)
+    Less,          //lhs < rhs         1 if it holds, 0 if it doesn't.
+    LessEqual,     //lhs <= rhs
+    Greater,       //lhs > rhs
+    GreaterEqual,  //lhs >= rhs
+    Equal,         //lhs == rhs
+    NotEqual,      //lhs != rhs
+    Branch,        //1 if lhs isn't 0, otherwise 0 and goes on after the Jump at rhs.
+    Jump,          //Stores lhs in the register of the Merge at rhs and goes on after it.
+    Merge,         //rhs, if the Branch at lhs went on after its Jump.
+};
+
+//NAME: functionCode
+//DESCRIPTION:  The instruction which calls a function.
+constexpr OpCode functionCode(Function function)
+{
+    return (OpCode)((int)OpCode::Power + (int)function);
+}
+
+//NAME: codeFunction
+//DESCRIPTION:  The function an instruction calls, for instructions from OpCode::Power to OpCode::NotEqual.
+constexpr Function codeFunction(OpCode op)
+{
+    return (Function)((int)op - (int)OpCode::Power);
+}
+
+//NAME: hasTarget
+//DESCRIPTION:  Checks to see if the rhs of an instruction is the instruction it goes to rather than a register.
+constexpr bool hasTarget(OpCode op)
+{
+    return op == OpCode::Branch || op == OpCode::Jump;
+}
+
+//NAME: isUnary
+//DESCRIPTION:  Checks to see if an instruction reads only lhs.  Not true of OpCode::Constant or
+//              OpCode::Variable, which don't read a register at all.  True of OpCode::Branch and
+//              OpCode::Jump, see hasTarget().
+constexpr bool isUnary(OpCode op)
+{
+    return op == OpCode::Negate || (op >= OpCode::Sqrt && op <= OpCode::Abs) || hasTarget(op);
+}
+
+static_assert(functionCode(Function::NotEqual) == OpCode::NotEqual && (int)Function::NotEqual == kFunctionCount - 1,
+              "the functions have to be in the same order as their instructions");
+
+//NAME: Instruction
+//DESCRIPTION:  One step of a compiled expression.  lhs and rhs are the registers holding the operands,
+//              except for OpCode::Constant where lhs indexes the constant pool and OpCode::Variable where
+//              lhs is the slot of the variable.
+struct Instruction
+{
+    OpCode op;
+    int lhs;
+    int rhs;
+};
+
+//NAME: Program
+//DESCRIPTION:  A compiled expression.  The answer is held in the register of the last instruction.
+//              variableCount is one more than the highest slot the program reads.
+//              A program compiled from a malformed expression has no code, just the error and the
+//              byte in the expression where it was found.
+struct Program
+{
+    Program() : variableCount(0), error(ErrorCode::None), errorOffset(0) {}
+
+    bool ok() const { return error == ErrorCode::None; }
+
+    std::vector<Instruction> code;
+    std::vector<double> constants;
+    int variableCount;
+    ErrorCode error;
+    int errorOffset;
+};
+
+//NAME: Compiler
+//DESCRIPTION:  The actions which record the expression into a Program instead of calculating it.
+//              A Value is the register which will hold the sub-expression when the program runs.
+class Compiler : public ErrorState
+{
+public:
+    typedef int Value;
+    typedef double Number;
+
+    explicit Compiler(Program& program, VariableTable* variables = NULL)
+        : program(program), variables(variables), dropping(0), speculative(0) {}
+
+    Value number(double value);
+
+    Value variable(const char* name, size_t length);
+
+    Value negate(Value value);
+
+    Value add(Value first, Value second) { return binary(OpCode::Add, first, second); }
+
+    Value subtract(Value first, Value second) { return binary(OpCode::Subtract, first, second); }
+
+    Value multiply(Value first, Value second) { return binary(OpCode::Multiply, first, second); }
+
+    Value divide(Value first, Value second, const char* at) { return binary(OpCode::Divide, first, second, at); }
+
+    Value call(Function function, Value argument, const char* at);
+
+    Value call(Function function, Value first, Value second, const char* at) { return binary(functionCode(function), first, second, at); }
+
+    void beginThen(Value condition);
+
+    void beginElse(Value condition, Value then);
+
+    Value endConditional(Value condition, Value then, Value otherwise);
+
+private:
+    //A conditional being compiled.  branch is its Branch, or -1 if the condition was a constant, in which
+    //case taken is what it came to and code and constants are where the answer which is dropped starts.
+    struct Conditional
+    {
+        int branch;
+        int jump;
+        bool taken;
+        size_t code;
+        size_t constants;
+    };
+
+    Value binary(OpCode op, Value first, Value second, const char* at = NULL);
+
+    Value emit(OpCode op, int lhs, int rhs);
+
+    bool isConstant(Value value) const;
+
+    void discard(Value value);
+
+    void drop(const Conditional& conditional);
+
+    bool foldFailed(const ErrorState& folding);
+
+    Program& program;
+    VariableTable* variables;
+
+    //The conditionals open, how many of them drop the code being recorded and how many Branch it is in.
+    std::vector<Conditional> conditionals;
+    int dropping;
+    int speculative;
+};
+
+//Function declarations
+Program compile(const char* eq);
+
+Program compile(const char* eq, VariableTable& variables);
+
+
+//Programs this small are evaluated with their registers on the stack.
+static const int kInlineRegisters = 64;
+
+//NAME: RegisterFile
+//DESCRIPTION:  The registers of a program being evaluated: on the stack for up to kInlineRegisters of them,
+//              on the heap for more.
+template <typename T>
+struct RegisterFile
+{
+    explicit RegisterFile(size_t count) : r(inlineRegisters)
+    {
+        if (count > kInlineRegisters)
+        {
+            heapRegisters.resize(count);
+            r = heapRegisters.data();
+        }
+    }
+
+    RegisterFile(const RegisterFile&) = delete;
+
+    RegisterFile& operator=(const RegisterFile&) = delete;
+
+    T inlineRegisters[kInlineRegisters];
+    std::vector<T> heapRegisters;
+    T* r;
+};
+
+//NAME: runInstructions
+//DESCRIPTION:  The interpreter of evaluate(), evaluateShared() and the evaluate() of archived formulas,
+//              which keep their instructions in different places: every instruction executed in order,
+//              the answer a conditional doesn't pick skipped.  Code is Instruction or anything else with
+//              an op, lhs and rhs.
+//INPUT:
+//    code      - The instructions.
+//    count     - How many.
+//    constants - What their Constant instructions load.
+//    variables - The value of every slot they read.
+//OUTPUT:
+//    r         - The registers, one for every instruction.  Those of the answers a conditional doesn't
+//                pick, and those of its Jump, aren't written.
+//RETURNS:
+//    none
+template <typename T, typename Code>
+void runInstructions(const Code* code, int count, const double* constants, const T* variables, T* r)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const Code& in = code[i];
+        switch ((OpCode)in.op)
+        {
+        case OpCode::Constant: r[i] = T(constants[in.lhs]);          break;
+        case OpCode::Variable: r[i] = variables[in.lhs];             break;
+        case OpCode::Negate:   r[i] = r[in.lhs] * -1;                break;
+        case OpCode::Add:      r[i] = r[in.lhs] + r[in.rhs];         break;
+        case OpCode::Subtract: r[i] = r[in.lhs] - r[in.rhs];         break;
+        case OpCode::Multiply: r[i] = r[in.lhs] * r[in.rhs];         break;
+        case OpCode::Divide:   r[i] = r[in.lhs] / r[in.rhs];         break;
+        case OpCode::Branch:
+            r[i] = r[in.lhs] != 0 ? T(1) : T(0);
+            if (r[i] == 0)
+                i = in.rhs;
+            break;
+        case OpCode::Jump:
+            r[in.rhs] = r[in.lhs];
+            i = in.rhs;
+            break;
+        case OpCode::Merge:    r[i] = r[in.rhs];                     break;
+        default:               r[i] = applyFunction(codeFunction((OpCode)in.op), r[in.lhs], r[in.rhs]);  break;
+        }
+    }
+}
+
+//NAME: evaluate
+//DESCRIPTION:  Runs a compiled program using arithmetic of type T.  No parsing happens here,
+//              every instruction is simply executed in order.
+//              Division by zero is not checked for, it gives whatever T gives (infinity or NaN for
+//              floating point types), and neither are the arguments of functions.
+//INPUT:
+//    program   - The program from compile().
+//    variables - The value of every slot the program reads, for instance VariableTable::values().
+//OUTPUT:
+//    none
+//RETURNS:
+//    The value calculated from the expression, NaN if the program failed to compile and T has one.
+template <typename T = double>
+T evaluate(const Program& program, const T* variables = NULL)
+{
+    if (!program.ok())
+        return std::numeric_limits<T>::quiet_NaN();
+
+    assert(variables != NULL || program.variableCount == 0);
+
+    const int count = (int)program.code.size();
+    RegisterFile<T> registers(program.code.size());
+    runInstructions(program.code.data(), count, program.constants.data(), variables, registers.r);
+    return registers.r[count - 1];
+}
+
+#endif
@@ -0,0 +1,969 @@
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "decimal.h"
+
+//The most digits a product, an aligned sum or a scaled dividend can have; 10^77 still fits in 256 bits.
+static const int kWideDigits = 77;
+
+//Sums are aligned to this many digits at most, so that even the sum of two of them still fits.
+static const int kAlignedDigits = 76;
+
+//The powers of ten up to 10^9, the largest divideSmall() and multiplyAdd() take.
+static const uint32_t kSmallPowersOfTen[] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+};
+
+//The powers of ten a uint64_t holds.
+static const uint64_t kWordPowersOfTen[] = {
+    1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull, 100000000ull, 1000000000ull,
+    10000000000ull, 100000000000ull, 1000000000000ull, 10000000000000ull, 100000000000000ull,
+    1000000000000000ull, 10000000000000000ull, 100000000000000000ull, 1000000000000000000ull,
+    10000000000000000000ull,
+};
+
+//Coefficients below this can be added in a uint64_t without it overflowing.
+static const uint64_t kHalfWord = (uint64_t)1 << 63;
+
+typedef WideInteger<8> Wide;
+
+//NAME: PowersOfTen
+//DESCRIPTION:  10^0 to 10^kWideDigits, for counting digits.
+struct PowersOfTen
+{
+    constexpr PowersOfTen() : value()
+    {
+        value[0].multiplyAdd(1, 1);
+        for (int i = 1; i <= kWideDigits; i++)
+        {
+            value[i] = value[i - 1];
+            value[i].multiplyAdd(10, 0);
+        }
+    }
+
+    Wide value[kWideDigits + 1];
+};
+
+static constexpr PowersOfTen kPowersOfTen;
+
+//NAME: digitCount
+//DESCRIPTION:  Counts the decimal digits of a number.  The number of bits gives it to within one.
+//INPUT:
+//    number - The number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    How many digits it has, 0 for zero.
+static int digitCount(const Wide& number)
+{
+    if (number.isZero())
+        return 0;
+
+    //bits * log10(2), which is never more than one too many.
+    int digits = (number.bitLength() * 1233) >> 12;
+    return number.isLess(kPowersOfTen.value[digits]) ? digits : digits + 1;
+}
+
+//NAME: dropDigits
+//DESCRIPTION:  Divides a number by 10^count, rounding toward zero.
+//INPUT:
+//    count  - How many digits to drop.
+//INPUT/OUTPUT:
+//    number - The number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if any of the digits dropped wasn't 0.
+static bool dropDigits(Wide& number, int count)
+{
+    bool dropped = false;
+    for (; count >= 9; count -= 9)
+        dropped = number.divideSmall(kSmallPowersOfTen[9]) != 0 || dropped;
+    if (count > 0)
+        dropped = number.divideSmall(kSmallPowersOfTen[count]) != 0 || dropped;
+
+    return dropped;
+}
+
+//NAME: multiplyWide
+//DESCRIPTION:  The full product of two numbers, schoolbook style.
+//INPUT:
+//    a - The first number.
+//    b - The second number; a.size + b.size must not be more than the room in a Wide.
+//OUTPUT:
+//    none
+//RETURNS:
+//    a * b.
+static Wide multiplyWide(const Wide& a, const Wide& b)
+{
+    Wide product;
+    if (a.isZero() || b.isZero())
+        return product;
+
+    for (int i = 0; i < a.size; i++)
+    {
+        uint64_t carry = 0;
+        for (int j = 0; j < b.size; j++)
+        {
+            uint64_t sum = (uint64_t)a.limbs[i] * b.limbs[j] + product.limbs[i + j] + carry;
+            product.limbs[i + j] = (uint32_t)sum;
+            carry = sum >> 32;
+        }
+
+        product.limbs[i + b.size] = (uint32_t)carry;
+    }
+
+    product.size = a.size + b.size;
+    while (product.size > 0 && product.limbs[product.size - 1] == 0)
+        product.size--;
+
+    return product;
+}
+
+//NAME: divideWide
+//DESCRIPTION:  Long division a limb at a time (Knuth's algorithm D).  Each limb of the quotient is guessed
+//              from the top two limbs of what is left over and the top limb of the divisor, which is
+//              shifted so its highest bit is set; the guess is then at most two too large.
+//INPUT:
+//    dividend - What is divided.
+//    divisor  - What it is divided by, not zero.
+//OUTPUT:
+//    quotient  - dividend / divisor, rounded toward zero.
+//    remainder - What is left over.
+//RETURNS:
+//    none
+static void divideWide(const Wide& dividend, const Wide& divisor, Wide& quotient, Wide& remainder)
+{
+    assert(!divisor.isZero());
+
+    quotient = Wide();
+    remainder = Wide();
+    if (dividend.isLess(divisor))
+    {
+        remainder = dividend;
+        return;
+    }
+
+    if (divisor.size == 1)
+    {
+        quotient = dividend;
+        remainder.multiplyAdd(1, quotient.divideSmall(divisor.limbs[0]));
+        return;
+    }
+
+    int n = divisor.size;
+    int m = dividend.size;
+    int shift = std::countl_zero(divisor.limbs[n - 1]);
+
+    uint32_t v[8];
+    uint32_t u[9];
+    for (int i = n - 1; i > 0; i--)
+        v[i] = (uint32_t)(((uint64_t)divisor.limbs[i] << shift) | ((uint64_t)divisor.limbs[i - 1] >> (32 - shift)));
+    v[0] = divisor.limbs[0] << shift;
+
+    u[m] = (uint32_t)((uint64_t)dividend.limbs[m - 1] >> (32 - shift));
+    for (int i = m - 1; i > 0; i--)
+        u[i] = (uint32_t)(((uint64_t)dividend.limbs[i] << shift) | ((uint64_t)dividend.limbs[i - 1] >> (32 - shift)));
+    u[0] = dividend.limbs[0] << shift;
+
+    const uint64_t kBase = (uint64_t)1 << 32;
+    for (int j = m - n; j >= 0; j--)
+    {
+        uint64_t top = ((uint64_t)u[j + n] << 32) | u[j + n - 1];
+        uint64_t guess = top / v[n - 1];
+        uint64_t rest = top % v[n - 1];
+        while (guess >= kBase || guess * v[n - 2] > ((rest << 32) | u[j + n - 2]))
+        {
+            guess--;
+            rest += v[n - 1];
+            if (rest >= kBase)
+                break;
+        }
+
+        //Take guess * divisor away, and add the divisor back once if the guess was still one too large.
+        int64_t borrow = 0;
+        int64_t difference;
+        for (int i = 0; i < n; i++)
+        {
+            uint64_t product = guess * v[i];
+            difference = (int64_t)u[i + j] - borrow - (int64_t)(product & 0xFFFFFFFFu);
+            u[i + j] = (uint32_t)difference;
+            borrow = (int64_t)(product >> 32) - (difference >> 32);
+        }
+
+        difference = (int64_t)u[j + n] - borrow;
+        u[j + n] = (uint32_t)difference;
+
+        quotient.limbs[j] = (uint32_t)guess;
+        if (difference < 0)
+        {
+            quotient.limbs[j]--;
+            uint64_t carry = 0;
+            for (int i = 0; i < n; i++)
+            {
+                uint64_t sum = (uint64_t)u[i + j] + v[i] + carry;
+                u[i + j] = (uint32_t)sum;
+                carry = sum >> 32;
+            }
+
+            u[j + n] += (uint32_t)carry;
+        }
+    }
+
+    quotient.size = m - n + 1;
+    while (quotient.size > 0 && quotient.limbs[quotient.size - 1] == 0)
+        quotient.size--;
+
+    for (int i = 0; i < n; i++)
+        remainder.limbs[i] = (uint32_t)(((uint64_t)u[i] >> shift) | ((uint64_t)u[i + 1] << (32 - shift)));
+
+    remainder.size = n;
+    while (remainder.size > 0 && remainder.limbs[remainder.size - 1] == 0)
+        remainder.size--;
+}
+
+//NAME: Decimal128::Decimal128
+//DESCRIPTION:  Converts a double through its shortest text, the fewest digits that read back as the same
+//              double.  NaN becomes 0 and the infinities the largest numbers there are.
+//INPUT:
+//    value - The double.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+Decimal128::Decimal128(double value) : high(0), low(0), exponent(0), negative(false)
+{
+    if (std::isnan(value))
+        return;
+
+    if (std::isinf(value))
+    {
+        Wide largest = kPowersOfTen.value[kDigits];
+        largest.subtract(kPowersOfTen.value[0]);
+        *this = round(largest, kMaxExponent, value < 0, false);
+        return;
+    }
+
+    char text[32];
+    std::to_chars_result result = std::to_chars(text, text + sizeof(text), value);
+    *this = fromText(text, result.ptr);
+}
+
+//NAME: Decimal128::fromDecimal
+//DESCRIPTION:  mantissa * 10^exponent, exactly.
+//INPUT:
+//    mantissa - The digits.
+//    exponent - The power of ten they are multiplied by.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The number.
+Decimal128 Decimal128::fromDecimal(uint64_t mantissa, int exponent)
+{
+    Wide digits;
+    digits.multiplyAdd(1, (uint32_t)(mantissa >> 32));
+    digits.multiplyAdd((uint32_t)1 << 16, 0);
+    digits.multiplyAdd((uint32_t)1 << 16, (uint32_t)mantissa);
+    return round(digits, exponent, false, false);
+}
+
+//NAME: Decimal128::fromText
+//DESCRIPTION:  Reads a number written like a literal, optionally with a sign: digits, a decimal point and
+//              more digits, and an exponent.  Digits beyond kAlignedDigits only count for being there.
+//INPUT:
+//    begin - The first character.
+//    end   - Just after the last one.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The number, rounded to kDigits significant digits.
+Decimal128 Decimal128::fromText(const char* begin, const char* end)
+{
+    const char* p = begin;
+    bool minus = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+        p++;
+
+    Wide digits;
+    int64_t exponent = 0;
+    int significant = 0;
+    bool dropped = false;
+    bool fraction = false;
+    for (; p < end && *p != 'e' && *p != 'E'; p++)
+    {
+        if (*p == '.')
+        {
+            fraction = true;
+            continue;
+        }
+
+        if (significant == 0 && *p == '0')
+        {
+            if (fraction)
+                exponent--;
+            continue;
+        }
+
+        if (significant < kAlignedDigits)
+        {
+            digits.multiplyAdd(10, (uint32_t)(*p - '0'));
+            significant++;
+            if (fraction)
+                exponent--;
+        }
+        else
+        {
+            dropped = dropped || *p != '0';
+            if (!fraction)
+                exponent++;
+        }
+    }
+
+    if (p < end)
+    {
+        p++;
+        bool negativeExponent = (p < end && *p == '-');
+        if (p < end && (*p == '+' || *p == '-'))
+            p++;
+
+        int64_t value = 0;
+        for (; p < end; p++)
+        {
+            //Anything this big is held at the largest number or zero anyway.
+            if (value < (int64_t)kMaxExponent * 4)
+                value = value * 10 + (*p - '0');
+        }
+
+        exponent += negativeExponent ? -value : value;
+    }
+
+    return round(digits, exponent, minus, dropped);
+}
+
+//NAME: Decimal128::toDouble
+//DESCRIPTION:  The nearest double, ties to even, by way of the exact digits.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The double.
+double Decimal128::toDouble() const
+{
+    //When the coefficient and the power of ten are both exact in double, one multiplication or division
+    //rounds correctly, which covers integers and amounts with a few decimals.
+    if (high == 0 && low <= ((uint64_t)1 << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double value = (double)low;
+        value = exponent >= 0 ? value * exactPowerOfTen<double>(exponent) : value / exactPowerOfTen<double>(-exponent);
+        return negative ? -value : value;
+    }
+
+    char text[kLongestDecimal];
+    size_t length = formatDecimal(*this, text, sizeof(text));
+
+    double value = 0;
+    std::from_chars_result result = std::from_chars(text, text + length, value);
+    if (result.ec == std::errc::result_out_of_range)
+    {
+        double magnitude = exponent > 0 ? std::numeric_limits<double>::infinity() : 0.0;
+        return negative ? -magnitude : magnitude;
+    }
+
+    return value;
+}
+
+//NAME: Decimal128::coefficient
+//DESCRIPTION:  The coefficient as a Wide.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The coefficient.
+Decimal128::Wide Decimal128::coefficient() const
+{
+    Wide digits;
+    digits.limbs[0] = (uint32_t)low;
+    digits.limbs[1] = (uint32_t)(low >> 32);
+    digits.limbs[2] = (uint32_t)high;
+    digits.limbs[3] = (uint32_t)(high >> 32);
+
+    digits.size = 4;
+    while (digits.size > 0 && digits.limbs[digits.size - 1] == 0)
+        digits.size--;
+
+    return digits;
+}
+
+//NAME: Decimal128::round
+//DESCRIPTION:  Makes a Decimal128 of coefficient * 10^exponent, rounded to kDigits significant digits,
+//              ties to even.  Exponents out of range are held at the largest number or at zero.
+//INPUT:
+//    exponent    - The power of ten the coefficient is multiplied by.
+//    negative    - True if the number is below zero.
+//    sticky      - True if something which wasn't zero was already dropped after the coefficient's last
+//                  digit, so that a 5 dropped now is more than a tie.
+//INPUT/OUTPUT:
+//    coefficient - The digits, any number of them.  They are rounded in place.
+//RETURNS:
+//    The number.
+Decimal128 Decimal128::round(Wide& coefficient, int64_t exponent, bool negative, bool sticky)
+{
+    int digits = digitCount(coefficient);
+    if (digits > kDigits)
+    {
+        int count = digits - kDigits;
+        sticky = dropDigits(coefficient, count - 1) || sticky;
+
+        uint32_t last = coefficient.divideSmall(10);
+        bool odd = coefficient.size > 0 && (coefficient.limbs[0] & 1) != 0;
+        if (last > 5 || (last == 5 && (sticky || odd)))
+        {
+            coefficient.multiplyAdd(1, 1);
+            if (!coefficient.isLess(kPowersOfTen.value[kDigits]))
+            {
+                coefficient.divideSmall(10);
+                count++;
+            }
+        }
+
+        exponent += count;
+    }
+
+    Decimal128 number;
+    if (coefficient.isZero() || exponent < -kMaxExponent)
+        return number;
+
+    if (exponent > kMaxExponent)
+    {
+        coefficient = kPowersOfTen.value[kDigits];
+        coefficient.subtract(kPowersOfTen.value[0]);
+        exponent = kMaxExponent;
+    }
+
+    uint32_t limbs[4] = {};
+    for (int i = 0; i < coefficient.size; i++)
+        limbs[i] = coefficient.limbs[i];
+
+    number.low = ((uint64_t)limbs[1] << 32) | limbs[0];
+    number.high = ((uint64_t)limbs[3] << 32) | limbs[2];
+    number.exponent = (int32_t)exponent;
+    number.negative = negative;
+    return number;
+}
+
+//NAME: Decimal128::fromWord
+//DESCRIPTION:  Makes a Decimal128 of a coefficient which fits in 64 bits, so it needs no rounding.
+//INPUT:
+//    coefficient - The digits.
+//    exponent    - The power of ten they are multiplied by, no further from 0 than kMaxExponent.
+//    negative    - True if the number is below zero.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The number.
+Decimal128 Decimal128::fromWord(uint64_t coefficient, int64_t exponent, bool negative)
+{
+    Decimal128 number;
+    if (coefficient == 0)
+        return number;
+
+    number.low = coefficient;
+    number.exponent = (int32_t)exponent;
+    number.negative = negative;
+    return number;
+}
+
+//NAME: Decimal128::trim
+//DESCRIPTION:  Drops the zeros at the end of the coefficient, but only until the exponent reaches ideal:
+//              6 / 5 is worked out to 34 digits, but 1.2 is all it needs.
+//INPUT:
+//    value - The number.
+//    ideal - The exponent it would have if it hadn't been worked out to more digits than it has.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The same number with fewer zeros.
+Decimal128 Decimal128::trim(Decimal128 value, int64_t ideal)
+{
+    if (value.isZero() || value.exponent >= ideal)
+        return value;
+
+    Wide digits = value.coefficient();
+    int64_t exponent = value.exponent;
+    while (ideal - exponent >= 9)
+    {
+        Wide shorter = digits;
+        if (shorter.divideSmall(kSmallPowersOfTen[9]) != 0)
+            break;
+
+        digits = shorter;
+        exponent += 9;
+    }
+
+    while (exponent < ideal)
+    {
+        Wide shorter = digits;
+        if (shorter.divideSmall(10) != 0)
+            break;
+
+        digits = shorter;
+        exponent++;
+    }
+
+    return round(digits, exponent, value.negative, false);
+}
+
+//NAME: Decimal128::add
+//DESCRIPTION:  Adds or subtracts two numbers.  The one which reaches higher is scaled up to the other's
+//              exponent; if that would take more than kAlignedDigits digits the other one is scaled down
+//              instead, and what is dropped from it is so far below the 34 digits which are kept that it
+//              only counts for being there.
+//INPUT:
+//    a        - The first number.
+//    b        - The second number.
+//    subtract - True to calculate a - b instead of a + b.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The sum or difference.
+Decimal128 Decimal128::add(const Decimal128& a, const Decimal128& b, bool subtract)
+{
+    if (b.isZero())
+        return a;
+    if (a.isZero())
+        return subtract ? -b : b;
+
+    //Amounts of money still fit in 64 bits once they are aligned, and then it all happens in a uint64_t.
+    bool yNegative = b.negative != subtract;
+    if (a.high == 0 && b.high == 0 && a.low < kHalfWord && b.low < kHalfWord)
+    {
+        uint64_t first = a.low;
+        uint64_t second = b.low;
+        int64_t shift = (int64_t)a.exponent - b.exponent;
+        bool aligned = true;
+        if (shift > 0)
+        {
+            aligned = shift < 19 && first < kHalfWord / kWordPowersOfTen[shift];
+            first *= aligned ? kWordPowersOfTen[shift] : 1;
+        }
+        else if (shift < 0)
+        {
+            aligned = shift > -19 && second < kHalfWord / kWordPowersOfTen[-shift];
+            second *= aligned ? kWordPowersOfTen[-shift] : 1;
+        }
+
+        int64_t exponent = shift > 0 ? b.exponent : a.exponent;
+        if (aligned && a.negative == yNegative)
+            return fromWord(first + second, exponent, a.negative);
+        if (aligned && first >= second)
+            return fromWord(first - second, exponent, a.negative);
+        if (aligned)
+            return fromWord(second - first, exponent, yNegative);
+    }
+
+    Wide x = a.coefficient();
+    Wide y = b.coefficient();
+    int xDigits = digitCount(x);
+    int yDigits = digitCount(y);
+    int64_t xExponent = a.exponent;
+    int64_t yExponent = b.exponent;
+    bool xNegative = a.negative;
+    if (yExponent + yDigits > xExponent + xDigits)
+    {
+        std::swap(x, y);
+        std::swap(xDigits, yDigits);
+        std::swap(xExponent, yExponent);
+        std::swap(xNegative, yNegative);
+    }
+
+    bool sticky = false;
+    if (xExponent > yExponent)
+    {
+        int64_t room = kAlignedDigits - xDigits;
+        int64_t scale = xExponent - yExponent < room ? xExponent - yExponent : room;
+        x.multiplyPowerOfTen((int)scale);
+        xExponent -= scale;
+
+        if (xExponent > yExponent)
+        {
+            int64_t count = xExponent - yExponent;
+            if (count >= yDigits)
+            {
+                y = Wide();
+                sticky = true;
+            }
+            else
+                sticky = dropDigits(y, (int)count);
+        }
+    }
+    else if (yExponent > xExponent)
+        y.multiplyPowerOfTen((int)(yExponent - xExponent));
+
+    if (xNegative == yNegative)
+    {
+        x.add(y);
+        return round(x, xExponent, xNegative, sticky);
+    }
+
+    //y reaches no higher than x, but the same height can still be the larger of the two.
+    if (x.isLess(y))
+    {
+        std::swap(x, y);
+        xNegative = yNegative;
+    }
+
+    x.subtract(y);
+    if (sticky)
+    {
+        //x - (y + something below 1) is x - y - 1 and something above 0.
+        Wide one;
+        one.multiplyAdd(1, 1);
+        x.subtract(one);
+    }
+
+    return round(x, xExponent, xNegative, sticky);
+}
+
+//NAME: Decimal128::multiply
+//DESCRIPTION:  Multiplies two numbers.  The product of the coefficients is exact and then rounded.
+//INPUT:
+//    a - The first number.
+//    b - The second number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The product.
+Decimal128 Decimal128::multiply(const Decimal128& a, const Decimal128& b)
+{
+    if (a.isZero() || b.isZero())
+        return Decimal128();
+
+    if (a.high == 0 && b.high == 0 && std::bit_width(a.low) + std::bit_width(b.low) <= 64)
+    {
+        int64_t exponent = (int64_t)a.exponent + b.exponent;
+        if (exponent >= -kMaxExponent && exponent <= kMaxExponent)
+            return fromWord(a.low * b.low, exponent, a.negative != b.negative);
+    }
+
+    Wide product = multiplyWide(a.coefficient(), b.coefficient());
+    return round(product, (int64_t)a.exponent + b.exponent, a.negative != b.negative, false);
+}
+
+//NAME: Decimal128::divide
+//DESCRIPTION:  Divides two numbers.  The dividend is scaled up so the quotient has at least one digit
+//              more than is kept, and what is left over decides the ties.  A quotient which comes out
+//              exactly is trimmed back to the digits it needs.
+//INPUT:
+//    a - The dividend.
+//    b - The divisor.  Dividing by zero gives zero.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The quotient.
+Decimal128 Decimal128::divide(const Decimal128& a, const Decimal128& b)
+{
+    if (a.isZero() || b.isZero())
+        return Decimal128();
+
+    //An amount divided by a whole number usually comes out exactly within a few more digits, and then
+    //there is no need for long division.  The first which does is the one trim() would have left.
+    int64_t ideal = (int64_t)a.exponent - b.exponent;
+    if (a.high == 0 && b.high == 0)
+    {
+        uint64_t dividend = a.low;
+        for (int extra = 0; extra <= 8; extra++)
+        {
+            if (dividend % b.low == 0)
+            {
+                if (ideal - extra >= -kMaxExponent && ideal - extra <= kMaxExponent)
+                    return fromWord(dividend / b.low, ideal - extra, a.negative != b.negative);
+                break;
+            }
+
+            if (dividend > UINT64_MAX / 10)
+                break;
+            dividend *= 10;
+        }
+    }
+
+    Wide dividend = a.coefficient();
+    Wide divisor = b.coefficient();
+    int scale = digitCount(divisor) + kDigits + 1 - digitCount(dividend);
+    if (scale < 0)
+        scale = 0;
+
+    dividend.multiplyPowerOfTen(scale);
+
+    Wide quotient;
+    Wide remainder;
+    divideWide(dividend, divisor, quotient, remainder);
+
+    Decimal128 result = round(quotient, ideal - scale, a.negative != b.negative, !remainder.isZero());
+    return remainder.isZero() ? trim(result, ideal) : result;
+}
+
+//NAME: Decimal128::compareMagnitude
+//DESCRIPTION:  Compares two numbers, ignoring their signs.
+//INPUT:
+//    a - The first number.
+//    b - The second number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Less than 0 if |a| < |b|, 0 if they are equal, more than 0 if |a| > |b|.
+int Decimal128::compareMagnitude(const Decimal128& a, const Decimal128& b)
+{
+    if (a.exponent == b.exponent)
+    {
+        if (a.high != b.high)
+            return a.high < b.high ? -1 : 1;
+        if (a.low != b.low)
+            return a.low < b.low ? -1 : 1;
+        return 0;
+    }
+
+    //Whichever reaches higher is larger; at the same height the one with the larger exponent is scaled
+    //down to the other's, which takes no more than kDigits digits.
+    Wide x = a.coefficient();
+    Wide y = b.coefficient();
+    int64_t xTop = a.exponent + digitCount(x);
+    int64_t yTop = b.exponent + digitCount(y);
+    if (xTop != yTop)
+        return xTop < yTop ? -1 : 1;
+
+    if (a.exponent > b.exponent)
+        x.multiplyPowerOfTen(a.exponent - b.exponent);
+    else
+        y.multiplyPowerOfTen(b.exponent - a.exponent);
+
+    if (x.isLess(y))
+        return -1;
+    return y.isLess(x) ? 1 : 0;
+}
+
+//NAME: Decimal128::compare
+//DESCRIPTION:  Compares two numbers by value, so 1.0 and 1 are equal.
+//INPUT:
+//    a - The first number.
+//    b - The second number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Less than 0 if a < b, 0 if they are equal, more than 0 if a > b.
+int Decimal128::compare(const Decimal128& a, const Decimal128& b)
+{
+    if (a.isZero() || b.isZero())
+    {
+        if (a.isZero() && b.isZero())
+            return 0;
+        if (a.isZero())
+            return b.negative ? 1 : -1;
+        return a.negative ? -1 : 1;
+    }
+
+    if (a.negative != b.negative)
+        return a.negative ? -1 : 1;
+
+    int magnitude = compareMagnitude(a, b);
+    return a.negative ? -magnitude : magnitude;
+}
+
+//NAME: floor
+//DESCRIPTION:  The largest whole number which isn't more than a number.
+//INPUT:
+//    a - The number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The whole number, with no digits after the decimal point.
+Decimal128 floor(const Decimal128& a)
+{
+    if (a.exponent >= 0)
+        return a;
+
+    Decimal128::Wide digits = a.coefficient();
+    bool fraction;
+    if (-(int64_t)a.exponent > digitCount(digits))
+    {
+        digits = Decimal128::Wide();
+        fraction = !a.isZero();
+    }
+    else
+        fraction = dropDigits(digits, -a.exponent);
+
+    if (fraction && a.negative)
+        digits.multiplyAdd(1, 1);
+
+    return Decimal128::round(digits, 0, a.negative, false);
+}
+
+//NAME: sqrt
+//DESCRIPTION:  The square root, to within a unit in the 34th digit.  std::sqrt() gives the first 16
+//              digits, and each step of Newton's method x = (x + a / x) / 2 doubles that.  A root which
+//              comes out exactly is trimmed to the digits it needs, as a quotient is.
+//INPUT:
+//    a - The number, not below zero.  Negative numbers give zero; solve() reports them before they get here.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The square root.
+Decimal128 sqrt(const Decimal128& a)
+{
+    if (a.isZero() || a.negative)
+        return Decimal128();
+
+    //The coefficient alone fits in a double; the exponent is halved separately so nothing overflows.
+    Decimal128 coefficient = a;
+    int64_t exponent = a.exponent;
+    coefficient.exponent = 0;
+    if (exponent % 2 != 0)
+    {
+        coefficient.exponent = 1;
+        exponent--;
+    }
+
+    Decimal128 root(std::sqrt(coefficient.toDouble()));
+    root.exponent += (int32_t)(exponent / 2);
+
+    const Decimal128 half = Decimal128::fromDecimal(5, -1);
+    for (int i = 0; i < 3; i++)
+        root = (root + a / root) * half;
+
+    //(x + a / x) / 2 lands on the exact root if there is one, but with more zeros than it needs.
+    Decimal128 ideal = Decimal128::trim(root, (a.exponent >= 0 ? a.exponent : a.exponent - 1) / 2);
+    return ideal * ideal == a ? ideal : root;
+}
+
+//NAME: pow
+//DESCRIPTION:  a^b.  A whole power of up to kMaxWholePower is calculated by squaring and multiplying in
+//              decimal, so 1.05^12 is exact; any other power goes through double.
+//INPUT:
+//    a - The base.
+//    b - The exponent.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The power.
+Decimal128 pow(const Decimal128& a, const Decimal128& b)
+{
+    static const int kMaxWholePower = 1 << 16;
+
+    if (floor(b) != b || fabs(b) > Decimal128(kMaxWholePower))
+        return Decimal128(std::pow(a.toDouble(), b.toDouble()));
+
+    int power = (int)fabs(b).toDouble();
+    Decimal128 result = 1;
+    Decimal128 base = a;
+    while (power != 0)
+    {
+        if ((power & 1) != 0)
+            result *= base;
+
+        power >>= 1;
+        if (power != 0)
+            base *= base;
+    }
+
+    return b.negative ? Decimal128(1) / result : result;
+}
+
+//NAME: formatDecimal
+//DESCRIPTION:  Writes a number as text with every digit of its coefficient, without a terminating '\0'.
+//              Numbers with a few digits after the decimal point, or whole numbers of no more than
+//              34 digits, are written out in full: 0.10, -44.72, 1000.  Others get an exponent: 1.5e+40.
+//INPUT:
+//    value  - The number.
+//    size   - How much room there is; kLongestDecimal is always enough.
+//OUTPUT:
+//    buffer - Where the text goes.
+//RETURNS:
+//    How many characters were written, or 0 if they didn't fit.
+size_t formatDecimal(const Decimal128& value, char* buffer, size_t size)
+{
+    //The digits of the coefficient, nine at a time from the lowest up.
+    char digits[Decimal128::kDigits + 9];
+    int count = 0;
+    Decimal128::Wide coefficient = value.coefficient();
+    if (coefficient.isZero())
+        digits[count++] = '0';
+
+    while (!coefficient.isZero())
+    {
+        uint32_t chunk = coefficient.divideSmall(kSmallPowersOfTen[9]);
+        for (int i = 0; i < 9 && (chunk != 0 || !coefficient.isZero()); i++)
+        {
+            digits[count++] = (char)('0' + chunk % 10);
+            chunk /= 10;
+        }
+    }
+
+    for (int i = 0; i < count / 2; i++)
+        std::swap(digits[i], digits[count - 1 - i]);
+
+    char text[kLongestDecimal];
+    size_t length = 0;
+    if (value.negative)
+        text[length++] = '-';
+
+    int64_t adjusted = (int64_t)value.exponent + count - 1;
+    if (value.exponent <= 0 && adjusted >= -6)
+    {
+        //Digits with a decimal point somewhere in them, or in front of them.
+        if (adjusted >= 0)
+        {
+            memcpy(text + length, digits, (size_t)(adjusted + 1));
+            length += (size_t)(adjusted + 1);
+        }
+        else
+        {
+            text[length++] = '0';
+        }
+
+        if (value.exponent < 0)
+        {
+            text[length++] = '.';
+            for (int64_t i = adjusted + 1; i < 0; i++)
+                text[length++] = '0';
+
+            int first = adjusted >= 0 ? (int)adjusted + 1 : 0;
+            memcpy(text + length, digits + first, (size_t)(count - first));
+            length += (size_t)(count - first);
+        }
+    }
+    else if (value.exponent > 0 && adjusted < Decimal128::kDigits)
+    {
+        //A whole number with zeros after its digits.
+        memcpy(text + length, digits, (size_t)count);
+        length += (size_t)count;
+        for (int i = 0; i < value.exponent; i++)
+            text[length++] = '0';
+    }
+    else
+    {
+        text[length++] = digits[0];
+        if (count > 1)
+        {
+            text[length++] = '.';
+            memcpy(text + length, digits + 1, (size_t)(count - 1));
+            length += (size_t)(count - 1);
+        }
+
+        text[length++] = 'e';
+        text[length++] = adjusted < 0 ? '-' : '+';
+        int64_t magnitude = adjusted < 0 ? -adjusted : adjusted;
+        std::to_chars_result result = std::to_chars(text + length, text + sizeof(text), magnitude);
+        length = (size_t)(result.ptr - text);
+    }
+
+    if (length > size)
+        return 0;
+
+    memcpy(buffer, text, length);
+    return length;
+}
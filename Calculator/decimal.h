@@ -0,0 +1,165 @@
+#ifndef CALCULATOR_DECIMAL_H
+#define CALCULATOR_DECIMAL_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+#include "literal.h"
+
+//double can't hold 0.1, so 0.1 + 0.2 isn't 0.3 and a column of prices doesn't quite add up to its total.
+//Decimal128 is a number of the form coefficient * 10^exponent, where the coefficient is an integer of up
+//to 34 digits kept in 128 bits inside the object itself.  Nothing is ever allocated, so it is as cheap to
+//copy around as a pair of doubles, and the same parser solves an expression in it:
+//     solve<double>("0.1 + 0.2")       0.30000000000000004
+//     solve<Decimal128>("0.1 + 0.2")   0.3
+//Which type an expression is solved in is chosen every time solve() is called, so a program can solve the
+//expressions that are about money exactly and the rest in double, without a second calculator for them.
+//
+//Literals of up to 34 significant digits are exact.  + - and * are exact whenever the answer has no more than
+//34 significant digits, which covers any sum or product of amounts of money; anything longer, and any
+//quotient that doesn't come out exactly, is rounded to 34 digits, ties to even.  The digits of a decimal
+//are kept as written, the way a decimal type keeps them: 2.50 * 4 is 10.00, and 6 / 5 is 1.2 because a
+//quotient which is exact keeps only the digits it needs.  Comparisons don't care, 10.00 == 10.
+//sqrt() and powers with a whole exponent are calculated in decimal too, to within a unit in the 34th
+//digit; exp(), log() and other powers go through double, as they do for Fixed64.
+//
+//There are no infinities or NaNs.  Dividing by zero gives zero; solve() reports it before it gets there.
+//Exponents beyond +-kMaxExponent are held at the largest number or at zero.
+//Compiled programs fold their constants in double, so evaluate<Decimal128>() is only as exact as the
+//constants the program was compiled to; solve<Decimal128>() is exact.
+
+//NAME: Decimal128
+//DESCRIPTION:  A signed decimal number with a 34 digit coefficient.  Zero is never negative.
+class Decimal128
+{
+public:
+    static const int kDigits = 34;
+
+    static const int kMaxExponent = 999999999;
+
+    Decimal128() : high(0), low(0), exponent(0), negative(false) {}
+
+    Decimal128(int value)
+        : high(0), low(value < 0 ? 0 - (uint64_t)(int64_t)value : (uint64_t)value), exponent(0), negative(value < 0) {}
+
+    //The shortest decimal that reads back as the same double, so Decimal128(0.1) is 0.1.
+    explicit Decimal128(double value);
+
+    static Decimal128 fromDecimal(uint64_t mantissa, int exponent);
+
+    static Decimal128 fromText(const char* begin, const char* end);
+
+    bool isZero() const { return high == 0 && low == 0; }
+
+    double toDouble() const;
+
+    explicit operator double() const { return toDouble(); }
+
+    explicit operator float() const { return (float)toDouble(); }
+
+    friend Decimal128 operator+(const Decimal128& a, const Decimal128& b) { return add(a, b, false); }
+
+    friend Decimal128 operator-(const Decimal128& a, const Decimal128& b) { return add(a, b, true); }
+
+    friend Decimal128 operator-(const Decimal128& a)
+    {
+        Decimal128 negated = a;
+        negated.negative = !a.negative && !a.isZero();
+        return negated;
+    }
+
+    friend Decimal128 operator*(const Decimal128& a, const Decimal128& b) { return multiply(a, b); }
+
+    friend Decimal128 operator/(const Decimal128& a, const Decimal128& b) { return divide(a, b); }
+
+    friend bool operator==(const Decimal128& a, const Decimal128& b) { return compare(a, b) == 0; }
+
+    friend bool operator!=(const Decimal128& a, const Decimal128& b) { return compare(a, b) != 0; }
+
+    friend bool operator<(const Decimal128& a, const Decimal128& b) { return compare(a, b) < 0; }
+
+    friend bool operator>(const Decimal128& a, const Decimal128& b) { return compare(a, b) > 0; }
+
+    friend bool operator<=(const Decimal128& a, const Decimal128& b) { return compare(a, b) <= 0; }
+
+    friend bool operator>=(const Decimal128& a, const Decimal128& b) { return compare(a, b) >= 0; }
+
+    //The functions an expression can call.  fabs() and floor() are exact, sqrt() and whole powers are good
+    //to a unit in the 34th digit, and the others go through double.
+    friend Decimal128 fabs(const Decimal128& a)
+    {
+        Decimal128 magnitude = a;
+        magnitude.negative = false;
+        return magnitude;
+    }
+
+    friend Decimal128 floor(const Decimal128& a);
+
+    friend Decimal128 sqrt(const Decimal128& a);
+
+    friend Decimal128 exp(const Decimal128& a) { return Decimal128(std::exp(a.toDouble())); }
+
+    friend Decimal128 log(const Decimal128& a) { return Decimal128(std::log(a.toDouble())); }
+
+    friend Decimal128 pow(const Decimal128& a, const Decimal128& b);
+
+    friend size_t formatDecimal(const Decimal128& value, char* buffer, size_t size);
+
+    Decimal128& operator+=(const Decimal128& b) { return *this = *this + b; }
+
+    Decimal128& operator-=(const Decimal128& b) { return *this = *this - b; }
+
+    Decimal128& operator*=(const Decimal128& b) { return *this = *this * b; }
+
+    Decimal128& operator/=(const Decimal128& b) { return *this = *this / b; }
+
+private:
+    //Room for the product of two coefficients, and for a dividend scaled up for a 35 digit quotient.
+    typedef WideInteger<8> Wide;
+
+    Wide coefficient() const;
+
+    static Decimal128 round(Wide& coefficient, int64_t exponent, bool negative, bool sticky);
+
+    static Decimal128 fromWord(uint64_t coefficient, int64_t exponent, bool negative);
+
+    static Decimal128 trim(Decimal128 value, int64_t ideal);
+
+    static Decimal128 add(const Decimal128& a, const Decimal128& b, bool subtract);
+
+    static Decimal128 multiply(const Decimal128& a, const Decimal128& b);
+
+    static Decimal128 divide(const Decimal128& a, const Decimal128& b);
+
+    static int compare(const Decimal128& a, const Decimal128& b);
+
+    static int compareMagnitude(const Decimal128& a, const Decimal128& b);
+
+    uint64_t high;
+    uint64_t low;
+    int32_t exponent;
+    bool negative;
+};
+
+//Enough room for formatDecimal() to write any Decimal128.
+static const size_t kLongestDecimal = 64;
+
+//Literals are converted straight from their digits, and read again from their text if there were more
+//than the mantissa holds.
+template <>
+struct DecimalConverter<Decimal128>
+{
+    static Decimal128 convert(const DecimalLiteral& literal)
+    {
+        if (literal.truncated)
+            return Decimal128::fromText(literal.begin, literal.end);
+
+        return Decimal128::fromDecimal(literal.mantissa, literal.exponent);
+    }
+};
+
+//Function declarations
+size_t formatDecimal(const Decimal128& value, char* buffer, size_t size);
+
+#endif
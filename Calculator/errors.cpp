@@ -0,0 +1,31 @@
+#include "errors.h"
+
+//NAME: errorMessage
+//DESCRIPTION:  Describes an error for people.
+//INPUT:
+//    code - The error.
+//OUTPUT:
+//    none
+//RETURNS:
+//    A short description of the error.
+const char* errorMessage(ErrorCode code)
+{
+    switch (code)
+    {
+    case ErrorCode::None:                 return "no error";
+    case ErrorCode::ExpectedNumber:       return "expected a number";
+    case ErrorCode::UnmatchedParenthesis: return "unmatched parenthesis";
+    case ErrorCode::UnexpectedCharacter:  return "unexpected character";
+    case ErrorCode::DivisionByZero:       return "division by zero";
+    case ErrorCode::UnknownVariable:      return "unknown variable";
+    case ErrorCode::TooDeep:              return "nested too deeply";
+    case ErrorCode::OutOfMemory:          return "out of memory";
+    case ErrorCode::DamagedArchive:       return "damaged archive";
+    case ErrorCode::UnknownFunction:      return "unknown function";
+    case ErrorCode::ArgumentCount:        return "wrong number of arguments";
+    case ErrorCode::OutOfDomain:          return "argument out of domain";
+    case ErrorCode::UnmatchedConditional: return "? without a :";
+    }
+
+    return "unknown error";
+}
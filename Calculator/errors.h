@@ -0,0 +1,68 @@
+#ifndef CALCULATOR_ERRORS_H
+#define CALCULATOR_ERRORS_H
+
+#include <cstddef>
+
+//A malformed expression must never take the whole program down with it.  Instead of asserting, the
+//parser records the first problem it finds together with where it found it, and every function on the
+//way back up simply checks failed() and returns.  That check is a single compare, so expressions which
+//are fine pay next to nothing for it.
+
+//NAME: ErrorCode
+//DESCRIPTION:  What went wrong with an expression.
+enum class ErrorCode : unsigned char
+{
+    None,
+    ExpectedNumber,         //A number, variable or parenthesis was expected here.
+    UnmatchedParenthesis,   //A parenthesis is never closed, or closed without being opened.
+    UnexpectedCharacter,    //Something follows the end of the expression.
+    DivisionByZero,         //The divisor is known to be zero.
+    UnknownVariable,        //The name hasn't been bound to a value.
+    TooDeep,                //Too many operators are waiting on parentheses inside them.
+    OutOfMemory,            //There was no memory left for the tree of the expression.
+    DamagedArchive,         //The compiled formula read from an archive doesn't make sense.
+    UnknownFunction,        //A name followed by a parenthesis isn't a function.
+    ArgumentCount,          //A function is called with too few or too many arguments.
+    OutOfDomain,            //A function isn't defined for its argument, such as sqrt(-1).
+    UnmatchedConditional,   //A ? isn't followed by the : of its other answer.
+};
+
+//NAME: ErrorState
+//DESCRIPTION:  Where the actions used by the parser keep the first error found in an expression.
+struct ErrorState
+{
+    constexpr ErrorState() : error(ErrorCode::None), errorAt(NULL) {}
+
+    constexpr bool failed() const { return error != ErrorCode::None; }
+
+    constexpr void fail(ErrorCode code, const char* at)
+    {
+        //Only the first error is interesting, everything after it is just a consequence.
+        if (!failed())
+        {
+            error = code;
+            errorAt = at;
+        }
+    }
+
+    ErrorCode error;
+    const char* errorAt;
+};
+
+//NAME: Result
+//DESCRIPTION:  The answer to an expression, or why there isn't one.
+//              offset is the byte in the expression where the error was found.
+template <typename T>
+struct Result
+{
+    constexpr bool ok() const { return error == ErrorCode::None; }
+
+    T value;
+    ErrorCode error;
+    int offset;
+};
+
+//Function declarations
+const char* errorMessage(ErrorCode code);
+
+#endif
@@ -0,0 +1,248 @@
+#ifndef CALCULATOR_FIXED_H
+#define CALCULATOR_FIXED_H
+
+#include <cmath>
+#include <cstdint>
+
+#include "literal.h"
+
+#if defined(_MSC_VER) && defined(_M_X64) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+//NAME: Fixed64
+//DESCRIPTION:  A signed 64 bit fixed point number with 32 integer bits and 32 fractional bits.
+//              Everything is done with integer instructions, so the same expression gives exactly the
+//              same answer on every processor and compiler.  The range is about +-2 billion and the
+//              resolution 2^-32 (about 2.3e-10).  Overflow wraps around like an integer would.
+//              Products round toward negative infinity, quotients toward zero.
+class Fixed64
+{
+public:
+    static const int kFractionBits = 32;
+
+    Fixed64() : raw(0) {}
+
+    Fixed64(int value) : raw((int64_t)((uint64_t)(int64_t)value << kFractionBits)) {}
+
+    explicit Fixed64(double value) : raw(fromDouble(value)) {}
+
+    static Fixed64 fromRaw(int64_t raw)
+    {
+        Fixed64 fixed;
+        fixed.raw = raw;
+        return fixed;
+    }
+
+    int64_t toRaw() const { return raw; }
+
+    //NAME: fromDecimal
+    //DESCRIPTION:  mantissa * 10^exponent rounded to the nearest fixed point value, without going through
+    //              double, so literals such as 0.1 are as close as Fixed64 can get.
+    //              Values too large to represent wrap around like any other overflow.
+    static Fixed64 fromDecimal(uint64_t mantissa, int exponent)
+    {
+        if (exponent >= 0)
+        {
+            //Only the low 32 bits of the integer survive the shift; every factor of ten adds a factor of
+            //two, so after 32 of them nothing is left.
+            if (exponent >= 32)
+                return Fixed64();
+
+            uint64_t value = mantissa;
+            for (int i = 0; i < exponent; i++)
+                value *= 10;
+
+            return fromRaw((int64_t)(value << kFractionBits));
+        }
+
+        //mantissa * 2^32 is below 2^96, so anything smaller than 10^-29 rounds to zero.
+        int digits = -exponent;
+        if (digits > 29)
+            return Fixed64();
+
+        //10^19 is the largest power of ten that fits the divisor.  The digits beyond it only move the
+        //answer by a fraction of a unit.
+        while (digits > 19)
+        {
+            mantissa = (mantissa + 5) / 10;
+            digits--;
+        }
+
+        uint64_t divisor = 1;
+        for (int i = 0; i < digits; i++)
+            divisor *= 10;
+
+        uint64_t remainder;
+        uint64_t quotient = divideWide(mantissa >> 32, mantissa << 32, divisor, remainder);
+        if (remainder >= divisor - remainder)
+            quotient++;
+
+        return fromRaw((int64_t)quotient);
+    }
+
+    double toDouble() const { return (double)raw / 4294967296.0; }
+
+    explicit operator double() const { return toDouble(); }
+
+    explicit operator float() const { return (float)toDouble(); }
+
+    friend Fixed64 operator+(Fixed64 a, Fixed64 b) { return fromRaw((int64_t)((uint64_t)a.raw + (uint64_t)b.raw)); }
+
+    friend Fixed64 operator-(Fixed64 a, Fixed64 b) { return fromRaw((int64_t)((uint64_t)a.raw - (uint64_t)b.raw)); }
+
+    friend Fixed64 operator-(Fixed64 a) { return fromRaw((int64_t)(0 - (uint64_t)a.raw)); }
+
+    friend Fixed64 operator*(Fixed64 a, Fixed64 b) { return fromRaw(multiply(a.raw, b.raw)); }
+
+    friend Fixed64 operator/(Fixed64 a, Fixed64 b) { return fromRaw(divide(a.raw, b.raw)); }
+
+    friend bool operator==(Fixed64 a, Fixed64 b) { return a.raw == b.raw; }
+
+    friend bool operator!=(Fixed64 a, Fixed64 b) { return a.raw != b.raw; }
+
+    friend bool operator<(Fixed64 a, Fixed64 b) { return a.raw < b.raw; }
+
+    friend bool operator>(Fixed64 a, Fixed64 b) { return a.raw > b.raw; }
+
+    friend bool operator<=(Fixed64 a, Fixed64 b) { return a.raw <= b.raw; }
+
+    friend bool operator>=(Fixed64 a, Fixed64 b) { return a.raw >= b.raw; }
+
+    //The functions an expression can call.  fabs() and floor() are exact, the others go through double
+    //and so are only as reproducible as the processor's std::sqrt(), std::exp(), std::log() and std::pow().
+    friend Fixed64 fabs(Fixed64 a) { return a.raw < 0 ? -a : a; }
+
+    friend Fixed64 floor(Fixed64 a) { return fromRaw(a.raw & ~(int64_t)0xffffffff); }
+
+    friend Fixed64 sqrt(Fixed64 a) { return Fixed64(std::sqrt(a.toDouble())); }
+
+    friend Fixed64 exp(Fixed64 a) { return Fixed64(std::exp(a.toDouble())); }
+
+    friend Fixed64 log(Fixed64 a) { return Fixed64(std::log(a.toDouble())); }
+
+    friend Fixed64 pow(Fixed64 a, Fixed64 b) { return Fixed64(std::pow(a.toDouble(), b.toDouble())); }
+
+    Fixed64& operator+=(Fixed64 b) { return *this = *this + b; }
+
+    Fixed64& operator-=(Fixed64 b) { return *this = *this - b; }
+
+    Fixed64& operator*=(Fixed64 b) { return *this = *this * b; }
+
+    Fixed64& operator/=(Fixed64 b) { return *this = *this / b; }
+
+private:
+    //NAME: fromDouble
+    //DESCRIPTION:  value * 2^32 rounded toward zero.  Casting a double outside the range of int64_t is
+    //              undefined, so NaN is 0 and anything out of range the nearest end of it.
+    static int64_t fromDouble(double value)
+    {
+        const double scaled = value * 4294967296.0;
+        if (std::isnan(scaled))
+            return 0;
+        if (scaled >= 9223372036854775808.0)
+            return INT64_MAX;
+        if (scaled <= -9223372036854775808.0)
+            return INT64_MIN;
+        return (int64_t)scaled;
+    }
+
+    //NAME: multiply
+    //DESCRIPTION:  (a * b) >> 32 with the full 128 bit product in between.
+    static int64_t multiply(int64_t a, int64_t b)
+    {
+#if defined(__SIZEOF_INT128__)
+        return (int64_t)(((__int128)a * b) >> kFractionBits);
+#elif defined(_MSC_VER) && defined(_M_X64) && !defined(__clang__)
+        int64_t high;
+        uint64_t low = (uint64_t)_mul128(a, b, &high);
+        return (int64_t)__shiftright128(low, (uint64_t)high, kFractionBits);
+#else
+        //Schoolbook multiplication of the magnitudes in 32 bit halves, then the sign is put back.
+        bool negative = (a < 0) != (b < 0);
+        uint64_t x = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+        uint64_t y = b < 0 ? 0 - (uint64_t)b : (uint64_t)b;
+
+        uint64_t xl = x & 0xFFFFFFFFu, xh = x >> 32;
+        uint64_t yl = y & 0xFFFFFFFFu, yh = y >> 32;
+
+        uint64_t ll = xl * yl;
+        uint64_t lh = xl * yh;
+        uint64_t hl = xh * yl;
+        uint64_t hh = xh * yh;
+
+        uint64_t middle = (ll >> 32) + (lh & 0xFFFFFFFFu) + (hl & 0xFFFFFFFFu);
+        uint64_t low = (middle << 32) | (ll & 0xFFFFFFFFu);
+        uint64_t high = hh + (lh >> 32) + (hl >> 32) + (middle >> 32);
+
+        if (negative)
+        {
+            low = 0 - low;
+            high = ~high + (low == 0 ? 1 : 0);
+        }
+
+        return (int64_t)((high << 32) | (low >> 32));
+#endif
+    }
+
+    //NAME: divide
+    //DESCRIPTION:  (a << 32) / b with the full 128 bit dividend.  Dividing by zero gives zero;
+    //              the parser reports it before it ever gets here.
+    static int64_t divide(int64_t a, int64_t b)
+    {
+        if (b == 0)
+            return 0;
+
+#if defined(__SIZEOF_INT128__)
+        return (int64_t)(((__int128)a * ((__int128)1 << kFractionBits)) / b);
+#else
+        //Long division of the magnitudes, then the sign is put back.
+        bool negative = (a < 0) != (b < 0);
+        uint64_t x = a < 0 ? 0 - (uint64_t)a : (uint64_t)a;
+        uint64_t y = b < 0 ? 0 - (uint64_t)b : (uint64_t)b;
+
+        uint64_t remainder;
+        uint64_t quotient = divideWide(x >> 32, x << 32, y, remainder);
+        return negative ? (int64_t)(0 - quotient) : (int64_t)quotient;
+#endif
+    }
+
+    //NAME: divideWide
+    //DESCRIPTION:  The low 64 bits of (high:low) / y, one bit at a time.
+    static uint64_t divideWide(uint64_t high, uint64_t low, uint64_t y, uint64_t& remainder)
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 x = ((unsigned __int128)high << 64) | low;
+        remainder = (uint64_t)(x % y);
+        return (uint64_t)(x / y);
+#else
+        uint64_t quotient = 0;
+        remainder = 0;
+        for (int bit = 127; bit >= 0; bit--)
+        {
+            uint64_t next = bit >= 64 ? (high >> (bit - 64)) & 1 : (low >> bit) & 1;
+            bool carry = (remainder >> 63) != 0;
+            remainder = (remainder << 1) | next;
+            if (carry || remainder >= y)
+            {
+                remainder -= y;
+                if (bit < 64)
+                    quotient |= (uint64_t)1 << bit;
+            }
+        }
+
+        return quotient;
+#endif
+    }
+
+    int64_t raw;
+};
+
+//Literals are converted straight from their digits.
+template <>
+struct DecimalConverter<Fixed64>
+{
+    static Fixed64 convert(const DecimalLiteral& literal) { return Fixed64::fromDecimal(literal.mantissa, literal.exponent); }
+};
+
+#endif
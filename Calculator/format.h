@@ -0,0 +1,89 @@
+#ifndef CALCULATOR_FORMAT_H
+#define CALCULATOR_FORMAT_H
+
+#include <charconv>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+//printf("%g") has to parse its format string, lock the stream and go through the locale for every
+//number, which for the streaming mode costs more than solving the expression did.  formatNumber()
+//writes straight into a buffer the caller supplies with std::to_chars, which doesn't do any of that.
+//
+//The shortest form is the fewest digits that read back as exactly the same number, so nothing is lost
+//and nothing is printed that doesn't matter: 0.1 comes out as 0.1, not 0.10000000000000001.
+//The other styles are %.<precision>g and %.<precision>f without the printf.
+//Infinities and NaNs come out as inf, -inf, nan and -nan on every platform.
+
+//NAME: NumberStyle
+//DESCRIPTION:  How formatNumber() writes a number.
+enum class NumberStyle : unsigned char
+{
+    Shortest,       //As few digits as read back as the same number.
+    Significant,    //precision significant digits, like %g.
+    Fixed,          //precision digits after the decimal point, like %f.
+};
+
+//The largest precision formatNumber() accepts; anything larger is treated as this.
+static const int kMaxPrecision = 64;
+
+//Enough room for any number in any style: a Fixed double can have 309 digits before the point.
+static const size_t kLongestNumber = 320 + kMaxPrecision;
+
+//NAME: NumberFormat
+//DESCRIPTION:  The style and precision for formatNumber().
+struct NumberFormat
+{
+    NumberFormat() : style(NumberStyle::Shortest), precision(0) {}
+
+    NumberFormat(NumberStyle style, int precision) : style(style), precision(precision) {}
+
+    NumberStyle style;
+    int precision;
+};
+
+//NAME: formatNumber
+//DESCRIPTION:  Writes a number as text, without a terminating '\0'.
+//INPUT:
+//    value  - The number.
+//    size   - How much room there is.
+//    format - How to write it.
+//OUTPUT:
+//    buffer - Where the text goes.
+//RETURNS:
+//    How many characters were written, or 0 if they didn't fit.
+template <typename T>
+size_t formatNumber(T value, char* buffer, size_t size, const NumberFormat& format = NumberFormat())
+{
+    //to_chars spells these differently on every standard library.
+    if (!std::isfinite(value))
+    {
+        const char* text = std::isinf(value) ? (value < 0 ? "-inf" : "inf") : (std::signbit(value) ? "-nan" : "nan");
+        size_t length = strlen(text);
+        if (length > size)
+            return 0;
+
+        memcpy(buffer, text, length);
+        return length;
+    }
+
+    int precision = format.precision < 0 ? 0 : (format.precision > kMaxPrecision ? kMaxPrecision : format.precision);
+
+    std::to_chars_result result;
+    switch (format.style)
+    {
+    case NumberStyle::Significant:
+        result = std::to_chars(buffer, buffer + size, value, std::chars_format::general, precision == 0 ? 1 : precision);
+        break;
+    case NumberStyle::Fixed:
+        result = std::to_chars(buffer, buffer + size, value, std::chars_format::fixed, precision);
+        break;
+    default:
+        result = std::to_chars(buffer, buffer + size, value);
+        break;
+    }
+
+    return result.ec == std::errc() ? (size_t)(result.ptr - buffer) : 0;
+}
+
+#endif
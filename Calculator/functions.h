@@ -0,0 +1,204 @@
+#ifndef CALCULATOR_FUNCTIONS_H
+#define CALCULATOR_FUNCTIONS_H
+
+#include <cmath>
+#include <cstddef>
+
+#include "errors.h"
+
+//Besides the four operators, an expression can raise to a power and call a handful of functions:
+//     x ^ y                    x to the power y.  Binds tighter than * and /, and from the right, so
+//                              2 ^ 3 ^ 2 is 2 ^ 9.  A minus sign in front of it negates the power: -2 ^ 2 is -4.
+//     sqrt(x)  exp(x)  log(x)  abs(x)      log is the natural logarithm.
+//     min(x, y)  max(x, y)
+//A name followed by an open parenthesis is always a call, so a variable can have the name of a function.
+//
+//The comparisons < <= > >= == and != are functions too, only written between their arguments; they give
+//1 if they hold and 0 if they don't, so x < NaN is 0 and NaN != NaN is 1 as in C++.  They can't be called
+//by name, and the parser turns && and || into conditionals, see parser.h, so they need nothing of their own.
+//
+//Everything which calculates an expression, whatever its type, goes through applyFunction() so they all
+//agree.  min(x, y) is x < y ? x : y and max(x, y) is x > y ? x : y, which is exactly what the minsd and
+//maxsd instructions do, NaNs included, so the JIT and the batch kernels give the same answers as well.
+//Only exp(), log() and ^ of the batch kernels are approximations, see kernels.h.
+//
+//solve() reports arguments a function isn't defined for, see checkDomain().  A compiled program doesn't
+//check them any more than it checks for division by zero: sqrt(-1) simply gives NaN.
+//std::sqrt() and the others aren't constexpr everywhere, so solveConstant() can only take the functions
+//on compilers which treat them as if they were, such as GCC.
+
+//NAME: Function
+//DESCRIPTION:  The functions an expression can call, ^ and the comparisons included.  Only those from
+//              Sqrt to Abs take a single argument.
+enum class Function : unsigned char
+{
+    Power,
+    Min,
+    Max,
+    Sqrt,
+    Exp,
+    Log,
+    Abs,
+    Less,
+    LessEqual,
+    Greater,
+    GreaterEqual,
+    Equal,
+    NotEqual,
+};
+
+static const int kFunctionCount = 13;
+
+//NAME: FunctionName
+//DESCRIPTION:  The name a function is called by in an expression.
+struct FunctionName
+{
+    const char* name;
+    Function function;
+};
+
+inline constexpr FunctionName kFunctionNames[] =
+{
+    { "sqrt", Function::Sqrt },
+    { "exp",  Function::Exp },
+    { "log",  Function::Log },
+    { "abs",  Function::Abs },
+    { "min",  Function::Min },
+    { "max",  Function::Max },
+};
+
+//NAME: functionArguments
+//DESCRIPTION:  How many arguments a function takes.
+constexpr int functionArguments(Function function)
+{
+    return function >= Function::Sqrt && function <= Function::Abs ? 1 : 2;
+}
+
+//NAME: findFunction
+//DESCRIPTION:  Looks up a function by its name.
+//INPUT:
+//    name   - The name, pointing into the expression.
+//    length - How many characters the name has.
+//OUTPUT:
+//    function - The function, if there is one by that name.
+//RETURNS:
+//    True if there is.
+constexpr bool findFunction(const char* name, size_t length, Function& function)
+{
+    for (const FunctionName& known : kFunctionNames)
+    {
+        size_t i = 0;
+        while (i < length && known.name[i] == name[i])
+            i++;
+
+        if (i == length && known.name[i] == '\0')
+        {
+            function = known.function;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//NAME: functionName
+//DESCRIPTION:  The name of a function, its operator for a power or a comparison.
+constexpr const char* functionName(Function function)
+{
+    for (const FunctionName& known : kFunctionNames)
+    {
+        if (known.function == function)
+            return known.name;
+    }
+
+    switch (function)
+    {
+    case Function::Less:         return "<";
+    case Function::LessEqual:    return "<=";
+    case Function::Greater:      return ">";
+    case Function::GreaterEqual: return ">=";
+    case Function::Equal:        return "==";
+    case Function::NotEqual:     return "!=";
+    default:                     return "^";
+    }
+}
+
+//NAME: applyFunction
+//DESCRIPTION:  Calculates a function using arithmetic of type T.  The math functions are found the way
+//              std::sqrt() and the others are for the built-in types, and next to the type for types
+//              such as Fixed64.
+//INPUT:
+//    function - The function.
+//    first    - Its first argument.
+//    second   - Its second argument, ignored by functions taking one.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The result.
+template <typename T>
+constexpr T applyFunction(Function function, T first, T second)
+{
+    using std::exp;
+    using std::fabs;
+    using std::log;
+    using std::pow;
+    using std::sqrt;
+
+    switch (function)
+    {
+    case Function::Power:        return pow(first, second);
+    case Function::Min:          return first < second ? first : second;
+    case Function::Max:          return first > second ? first : second;
+    case Function::Sqrt:         return sqrt(first);
+    case Function::Exp:          return exp(first);
+    case Function::Log:          return log(first);
+    case Function::Abs:          return fabs(first);
+    case Function::Less:         return first < second ? T(1) : T(0);
+    case Function::LessEqual:    return first <= second ? T(1) : T(0);
+    case Function::Greater:      return first > second ? T(1) : T(0);
+    case Function::GreaterEqual: return first >= second ? T(1) : T(0);
+    case Function::Equal:        return first == second ? T(1) : T(0);
+    case Function::NotEqual:     return first != second ? T(1) : T(0);
+    }
+
+    return first;
+}
+
+//NAME: checkDomain
+//DESCRIPTION:  Checks to see if a function is defined for its arguments: the square root and the power
+//              of a negative number only are for integer powers, the logarithm only of a positive number,
+//              and 0 can't be raised to a negative power.
+//INPUT:
+//    function - The function.
+//    first    - Its first argument.
+//    second   - Its second argument, ignored by functions taking one.
+//OUTPUT:
+//    none
+//RETURNS:
+//    ErrorCode::None if it is, otherwise why not.
+template <typename T>
+constexpr ErrorCode checkDomain(Function function, T first, T second)
+{
+    using std::floor;
+
+    switch (function)
+    {
+    case Function::Power:
+        if (first == 0 && second < 0)
+            return ErrorCode::DivisionByZero;
+        if (first < 0 && floor(second) != second)
+            return ErrorCode::OutOfDomain;
+        return ErrorCode::None;
+
+    case Function::Sqrt:
+        return first < 0 ? ErrorCode::OutOfDomain : ErrorCode::None;
+
+    case Function::Log:
+        return first <= 0 ? ErrorCode::OutOfDomain : ErrorCode::None;
+
+    default:
+        return ErrorCode::None;
+    }
+}
+
+#endif
@@ -0,0 +1,453 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "gradient.h"
+#include "kernels.h"
+
+//How many rows evaluateGradientBatch() runs forwards and sweeps backwards at a time.  Twice the registers
+//of evaluateBatch() have to stay in the cache, the values and the adjoints.
+static const size_t kGradientLanes = 64;
+
+//Which lanes of a block the condition of a conditional picks the first answer for.
+static const unsigned char kNoLanes = 0;
+static const unsigned char kAllLanes = 1;
+static const unsigned char kSomeLanes = 2;
+
+//NAME: GradientBlocks
+//DESCRIPTION:  What evaluateGradientBatch() keeps for the rows of one block: the values and adjoints of
+//              every register, kGradientLanes to each, and the blocks of constants and scratch space the
+//              sweep backwards works with.
+template <typename T>
+struct GradientBlocks
+{
+    T* storage;
+    T* adjoint;
+    const T** r;
+    unsigned char* picked;
+    unsigned char* ran;
+    T* zeros;
+    T* ones;
+    T* halves;
+    T* scratch;
+    T* other;
+};
+
+//NAME: findDependents
+//DESCRIPTION:  Marks the registers whose values depend on a variable, the only ones with an adjoint worth
+//              sweeping, or worth passing an adjoint on to.
+//INPUT:
+//    program - The program.
+//OUTPUT:
+//    depends - 1 for each register which depends on a variable, 0 for the others.
+//RETURNS:
+//    none
+static void findDependents(const Program& program, unsigned char* depends)
+{
+    const Instruction* code = program.code.data();
+    for (size_t i = 0; i < program.code.size(); i++)
+    {
+        const Instruction& in = code[i];
+        switch (in.op)
+        {
+        case OpCode::Constant:  depends[i] = 0;                                                         break;
+        case OpCode::Variable:  depends[i] = 1;                                                         break;
+        case OpCode::Branch:
+        case OpCode::Jump:      depends[i] = 0;                                                         break;
+        case OpCode::Merge:     depends[i] = depends[code[code[in.lhs].rhs].lhs] | depends[in.rhs];     break;
+        default:
+            if (in.op >= OpCode::Less)
+                depends[i] = 0;
+            else if (isUnary(in.op))
+                depends[i] = depends[in.lhs];
+            else
+                depends[i] = depends[in.lhs] | depends[in.rhs];
+            break;
+        }
+    }
+}
+
+//NAME: runForwards
+//DESCRIPTION:  Runs a block of rows through a program the way evaluateBatch() does, except that every
+//              register keeps its values for the sweep backwards.
+//INPUT:
+//    program - The program.
+//    kernels - The batch kernels.
+//    columns - The variables of the block, one array per slot.
+//    lanes   - How many rows the block has.
+//INPUT/OUTPUT:
+//    blocks  - The values of every register are calculated into storage, and r says where they are; a
+//              variable's are in its column.  picked says which lanes the Branch of every conditional
+//              picks the first answer for, and ran which registers hold values of this block.
+//RETURNS:
+//    none
+template <typename T>
+static void runForwards(const Program& program, const BatchKernels<T>& kernels, const T* const* columns, size_t lanes,
+                        GradientBlocks<T>& blocks)
+{
+    const Instruction* code = program.code.data();
+    const size_t instructions = program.code.size();
+    const T** r = blocks.r;
+    std::fill(blocks.ran, blocks.ran + instructions, 0);
+
+    for (size_t i = 0; i < instructions; i++)
+    {
+        const Instruction& in = code[i];
+        T* result = blocks.storage + i * kGradientLanes;
+        blocks.ran[i] = 1;
+
+        switch (in.op)
+        {
+        case OpCode::Constant:                                                           break;
+        case OpCode::Variable: r[i] = columns[in.lhs];                                   break;
+        case OpCode::Negate:   kernels.negate(r[in.lhs], result, lanes);                 break;
+        case OpCode::Add:      kernels.add(r[in.lhs], r[in.rhs], result, lanes);         break;
+        case OpCode::Subtract: kernels.subtract(r[in.lhs], r[in.rhs], result, lanes);    break;
+        case OpCode::Multiply: kernels.multiply(r[in.lhs], r[in.rhs], result, lanes);    break;
+        case OpCode::Divide:   kernels.divide(r[in.lhs], r[in.rhs], result, lanes);      break;
+        case OpCode::Power:    kernels.power(r[in.lhs], r[in.rhs], result, lanes);       break;
+        case OpCode::Min:      kernels.minimum(r[in.lhs], r[in.rhs], result, lanes);     break;
+        case OpCode::Max:      kernels.maximum(r[in.lhs], r[in.rhs], result, lanes);     break;
+        case OpCode::Sqrt:     kernels.squareRoot(r[in.lhs], result, lanes);             break;
+        case OpCode::Exp:      kernels.exponential(r[in.lhs], result, lanes);            break;
+        case OpCode::Log:      kernels.logarithm(r[in.lhs], result, lanes);              break;
+        case OpCode::Abs:      kernels.absolute(r[in.lhs], result, lanes);               break;
+        case OpCode::Less:         kernels.less(r[in.lhs], r[in.rhs], result, lanes);            break;
+        case OpCode::LessEqual:    kernels.lessEqual(r[in.lhs], r[in.rhs], result, lanes);       break;
+        case OpCode::Greater:      kernels.greater(r[in.lhs], r[in.rhs], result, lanes);         break;
+        case OpCode::GreaterEqual: kernels.greaterEqual(r[in.lhs], r[in.rhs], result, lanes);    break;
+        case OpCode::Equal:        kernels.equal(r[in.lhs], r[in.rhs], result, lanes);           break;
+        case OpCode::NotEqual:     kernels.notEqual(r[in.lhs], r[in.rhs], result, lanes);        break;
+        case OpCode::Branch:
+            {
+                kernels.notEqual(r[in.lhs], blocks.zeros, result, lanes);
+                size_t taken = (size_t)std::count(result, result + lanes, T(1));
+                blocks.picked[i] = taken == 0 ? kNoLanes : taken == lanes ? kAllLanes : kSomeLanes;
+                if (taken == 0)
+                    i = in.rhs;
+            }
+            break;
+        case OpCode::Jump:
+            //The Merge holds the first answer from here on, even if it is jumped over.
+            std::copy(r[in.lhs], r[in.lhs] + lanes, blocks.storage + in.rhs * kGradientLanes);
+            blocks.ran[in.rhs] = 1;
+            if (blocks.picked[code[in.rhs].lhs] == kAllLanes)
+                i = in.rhs;
+            break;
+        case OpCode::Merge:
+            if (blocks.picked[in.lhs] == kNoLanes)
+                std::copy(r[in.rhs], r[in.rhs] + lanes, result);
+            else
+                kernels.select(r[in.lhs], result, r[in.rhs], result, lanes);
+            break;
+        }
+    }
+}
+
+//NAME: passOn
+//DESCRIPTION:  Adds (or subtracts) what an adjoint passes through a partial derivative to the adjoint of
+//              an operand: the product, already in scratch, in every lane but those whose adjoint is 0.
+//              They pass nothing on, even when the partial is infinite or NaN, which also keeps the answer
+//              a row didn't pick, calculated anyway because other rows of the block picked it, out of
+//              that row's derivatives.
+//INPUT:
+//    combine - kernels.add or kernels.subtract.
+//    kernels - The batch kernels.
+//    passed  - The adjoint being passed on.
+//    lanes   - How many rows the block has.
+//INPUT/OUTPUT:
+//    blocks  - Its scratch holds the product.
+//    into    - The adjoint of the operand.
+//RETURNS:
+//    none
+template <typename T>
+static void passOn(void (*combine)(const T*, const T*, T*, size_t), const BatchKernels<T>& kernels, const T* passed,
+                   size_t lanes, GradientBlocks<T>& blocks, T* into)
+{
+    kernels.select(passed, blocks.scratch, blocks.zeros, blocks.scratch, lanes);
+    combine(into, blocks.scratch, into, lanes);
+}
+
+//NAME: sweepBackwards
+//DESCRIPTION:  Passes the adjoints of a block of rows from the answer back to the variables, a whole block
+//              of lanes at a time with the batch kernels.  Only registers which depend on a variable and
+//              were run for the block are swept.
+//INPUT:
+//    program   - The program.
+//    kernels   - The batch kernels.
+//    depends   - Which registers depend on a variable, from findDependents().
+//    lanes     - How many rows the block has.
+//INPUT/OUTPUT:
+//    blocks    - The values from runForwards(); the adjoint of the answer has to be 1 and all the others 0.
+//    gradients - The derivatives of the block, one array per slot, which have to be 0.
+//RETURNS:
+//    none
+template <typename T>
+static void sweepBackwards(const Program& program, const BatchKernels<T>& kernels, const unsigned char* depends, size_t lanes,
+                           GradientBlocks<T>& blocks, T* const* gradients)
+{
+    const Instruction* code = program.code.data();
+    const T* const* r = blocks.r;
+    T* scratch = blocks.scratch;
+    T* other = blocks.other;
+    const T* zeros = blocks.zeros;
+
+    for (size_t i = program.code.size(); i-- > 0;)
+    {
+        if (!depends[i] || !blocks.ran[i])
+            continue;
+
+        const Instruction& in = code[i];
+        const T* passed = blocks.adjoint + i * kGradientLanes;
+        if (in.op == OpCode::Variable)
+        {
+            kernels.add(gradients[in.lhs], passed, gradients[in.lhs], lanes);
+            continue;
+        }
+
+        if (in.op == OpCode::Merge)
+        {
+            //Each row passes its adjoint to the answer its Branch picked.
+            const T* condition = r[in.lhs];
+            int then = code[code[in.lhs].rhs].lhs;
+            if (depends[then])
+            {
+                kernels.select(condition, passed, zeros, scratch, lanes);
+                kernels.add(blocks.adjoint + then * kGradientLanes, scratch, blocks.adjoint + then * kGradientLanes, lanes);
+            }
+            if (depends[in.rhs])
+            {
+                kernels.select(condition, zeros, passed, scratch, lanes);
+                kernels.add(blocks.adjoint + in.rhs * kGradientLanes, scratch, blocks.adjoint + in.rhs * kGradientLanes, lanes);
+            }
+            continue;
+        }
+
+        const T* v = r[i];
+        const T* a = r[in.lhs];
+        const T* b = isUnary(in.op) ? NULL : r[in.rhs];
+        T* da = depends[in.lhs] ? blocks.adjoint + in.lhs * kGradientLanes : NULL;
+        T* db = !isUnary(in.op) && depends[in.rhs] ? blocks.adjoint + in.rhs * kGradientLanes : NULL;
+
+        switch (in.op)
+        {
+        case OpCode::Negate:
+            kernels.subtract(da, passed, da, lanes);
+            break;
+
+        case OpCode::Add:
+            if (da != NULL)
+                kernels.add(da, passed, da, lanes);
+            if (db != NULL)
+                kernels.add(db, passed, db, lanes);
+            break;
+
+        case OpCode::Subtract:
+            if (da != NULL)
+                kernels.add(da, passed, da, lanes);
+            if (db != NULL)
+                kernels.subtract(db, passed, db, lanes);
+            break;
+
+        case OpCode::Multiply:
+            if (da != NULL)
+            {
+                kernels.multiply(passed, b, scratch, lanes);
+                passOn(kernels.add, kernels, passed, lanes, blocks, da);
+            }
+            if (db != NULL)
+            {
+                kernels.multiply(passed, a, scratch, lanes);
+                passOn(kernels.add, kernels, passed, lanes, blocks, db);
+            }
+            break;
+
+        case OpCode::Divide:
+            //a / b passes passed * (1 / b) to a, and passed * (a / b / b) to b, rounded as the tape rounds them.
+            if (da != NULL)
+            {
+                kernels.divide(blocks.ones, b, scratch, lanes);
+                kernels.multiply(passed, scratch, scratch, lanes);
+                passOn(kernels.add, kernels, passed, lanes, blocks, da);
+            }
+            if (db != NULL)
+            {
+                kernels.divide(v, b, scratch, lanes);
+                kernels.multiply(passed, scratch, scratch, lanes);
+                passOn(kernels.subtract, kernels, passed, lanes, blocks, db);
+            }
+            break;
+
+        case OpCode::Power:
+            if (da != NULL)
+            {
+                kernels.subtract(b, blocks.ones, scratch, lanes);
+                kernels.power(a, scratch, scratch, lanes);
+                kernels.multiply(scratch, b, scratch, lanes);
+                kernels.multiply(passed, scratch, scratch, lanes);
+                passOn(kernels.add, kernels, passed, lanes, blocks, da);
+            }
+            if (db != NULL)
+            {
+                kernels.logarithm(a, scratch, lanes);
+                kernels.multiply(scratch, v, scratch, lanes);
+                kernels.multiply(passed, scratch, scratch, lanes);
+                passOn(kernels.add, kernels, passed, lanes, blocks, db);
+            }
+            break;
+
+        case OpCode::Min:
+        case OpCode::Max:
+            //The adjoint goes to the argument given.
+            (in.op == OpCode::Min ? kernels.less : kernels.greater)(a, b, other, lanes);
+            if (da != NULL)
+            {
+                kernels.select(other, passed, zeros, scratch, lanes);
+                kernels.add(da, scratch, da, lanes);
+            }
+            if (db != NULL)
+            {
+                kernels.select(other, zeros, passed, scratch, lanes);
+                kernels.add(db, scratch, db, lanes);
+            }
+            break;
+
+        case OpCode::Sqrt:
+            kernels.divide(blocks.halves, v, scratch, lanes);
+            kernels.multiply(passed, scratch, scratch, lanes);
+            passOn(kernels.add, kernels, passed, lanes, blocks, da);
+            break;
+
+        case OpCode::Exp:
+            kernels.multiply(passed, v, scratch, lanes);
+            passOn(kernels.add, kernels, passed, lanes, blocks, da);
+            break;
+
+        case OpCode::Log:
+            kernels.divide(blocks.ones, a, scratch, lanes);
+            kernels.multiply(passed, scratch, scratch, lanes);
+            passOn(kernels.add, kernels, passed, lanes, blocks, da);
+            break;
+
+        case OpCode::Abs:
+            //The adjoint is added where the argument is positive, subtracted where it is negative.
+            kernels.greater(a, zeros, other, lanes);
+            kernels.select(other, passed, zeros, scratch, lanes);
+            kernels.add(da, scratch, da, lanes);
+            kernels.less(a, zeros, other, lanes);
+            kernels.select(other, passed, zeros, scratch, lanes);
+            kernels.subtract(da, scratch, da, lanes);
+            break;
+
+        default:
+            //Nothing else depends on a variable.
+            break;
+        }
+    }
+}
+
+//NAME: failGradientBatch
+//DESCRIPTION:  Gives NaN for every answer and derivative of rows which can't be differentiated.
+template <typename T>
+static void failGradientBatch(int slots, T* out, T* const* gradients, size_t count)
+{
+    std::fill(out, out + count, std::numeric_limits<T>::quiet_NaN());
+    for (int slot = 0; slot < slots; slot++)
+        std::fill(gradients[slot], gradients[slot] + count, std::numeric_limits<T>::quiet_NaN());
+}
+
+//NAME: evaluateGradientBatch
+//DESCRIPTION:  Runs a compiled program for many rows of variables at once, and finds the derivative of
+//              every row's answer with respect to every variable.  The answers are exactly what
+//              evaluateBatch() gives.
+//INPUT:
+//    program   - The program from compile().
+//    columns   - One array of count values for every variable slot the program reads.
+//    count     - How many rows there are.
+//    arena     - Where the registers go, for instance threadArena().  They are only needed during the
+//                call, so the arena can be reset as soon as it returns.
+//OUTPUT:
+//    out       - The answer for every row.
+//    gradients - One array of count derivatives for every slot up to program.variableCount.  All NaN,
+//                like the answers, if the program failed to compile or the arena has run out of memory.
+//RETURNS:
+//    none
+template <typename T>
+void evaluateGradientBatch(const Program& program, const T* const* columns, T* out, T* const* gradients, size_t count, Arena& arena)
+{
+    assert(columns != NULL || program.variableCount == 0);
+
+    const int slots = program.variableCount;
+    if (count == 0)
+        return;
+
+    if (!program.ok())
+    {
+        failGradientBatch(slots, out, gradients, count);
+        return;
+    }
+
+    const BatchKernels<T>& kernels = batchKernels<T>();
+    const Instruction* code = program.code.data();
+    const size_t instructions = program.code.size();
+
+    GradientBlocks<T> blocks;
+    blocks.storage = arena.allocate<T>(instructions * kGradientLanes);
+    blocks.adjoint = arena.allocate<T>(instructions * kGradientLanes);
+    blocks.r = arena.allocate<const T*>(instructions);
+    blocks.picked = arena.allocate<unsigned char>(instructions);
+    blocks.ran = arena.allocate<unsigned char>(instructions);
+    blocks.zeros = arena.allocate<T>(kGradientLanes);
+    blocks.ones = arena.allocate<T>(kGradientLanes);
+    blocks.halves = arena.allocate<T>(kGradientLanes);
+    blocks.scratch = arena.allocate<T>(kGradientLanes);
+    blocks.other = arena.allocate<T>(kGradientLanes);
+    unsigned char* depends = arena.allocate<unsigned char>(instructions);
+    const T** block = arena.allocate<const T*>(slots + 1);
+    T** derivatives = arena.allocate<T*>(slots + 1);
+    if (blocks.storage == NULL || blocks.adjoint == NULL || blocks.r == NULL || blocks.picked == NULL || blocks.ran == NULL ||
+        blocks.zeros == NULL || blocks.ones == NULL || blocks.halves == NULL || blocks.scratch == NULL || blocks.other == NULL ||
+        depends == NULL || block == NULL || derivatives == NULL)
+    {
+        failGradientBatch(slots, out, gradients, count);
+        return;
+    }
+
+    std::fill(blocks.zeros, blocks.zeros + kGradientLanes, T(0));
+    std::fill(blocks.ones, blocks.ones + kGradientLanes, T(1));
+    std::fill(blocks.halves, blocks.halves + kGradientLanes, T(0.5));
+    for (size_t i = 0; i < instructions; i++)
+    {
+        if (code[i].op == OpCode::Constant)
+            std::fill(blocks.storage + i * kGradientLanes, blocks.storage + (i + 1) * kGradientLanes, T(program.constants[code[i].lhs]));
+
+        blocks.r[i] = blocks.storage + i * kGradientLanes;
+    }
+
+    findDependents(program, depends);
+
+    for (size_t row = 0; row < count; row += kGradientLanes)
+    {
+        size_t lanes = std::min(kGradientLanes, count - row);
+        for (int slot = 0; slot < slots; slot++)
+        {
+            block[slot] = columns[slot] + row;
+            derivatives[slot] = gradients[slot] + row;
+            std::fill(derivatives[slot], derivatives[slot] + lanes, T(0));
+        }
+
+        runForwards(program, kernels, block, lanes, blocks);
+        std::copy(blocks.r[instructions - 1], blocks.r[instructions - 1] + lanes, out + row);
+
+        for (size_t i = 0; i < instructions; i++)
+        {
+            if (depends[i])
+                std::fill(blocks.adjoint + i * kGradientLanes, blocks.adjoint + i * kGradientLanes + lanes, T(0));
+        }
+        std::fill(blocks.adjoint + (instructions - 1) * kGradientLanes, blocks.adjoint + (instructions - 1) * kGradientLanes + lanes, T(1));
+        sweepBackwards(program, kernels, depends, lanes, blocks, derivatives);
+    }
+}
+
+template void evaluateGradientBatch<float>(const Program& program, const float* const* columns, float* out, float* const* gradients, size_t count, Arena& arena);
+template void evaluateGradientBatch<double>(const Program& program, const double* const* columns, double* out, double* const* gradients, size_t count, Arena& arena);
@@ -0,0 +1,269 @@
+#ifndef CALCULATOR_GRADIENT_H
+#define CALCULATOR_GRADIENT_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+
+#include "compiler.h"
+#include "arena.h"
+
+//The sensitivity of a formula to each of its N variables can be found by finite differences, evaluating
+//it again with every variable nudged up and down, but that is 2N more evaluations and only as accurate as
+//the nudge allows.  Reverse mode differentiation gets every partial derivative at once, exactly (to
+//rounding), for about the cost of three evaluations however many variables there are.
+//
+//evaluateGradient() runs a compiled program once, forwards, and as it goes records a tape: for every
+//instruction whose value depends on a variable, which earlier entries it was calculated from and the
+//derivative of its value with respect to each of them.  The tape is then swept backwards once, passing
+//every entry's adjoint (the derivative of the answer with respect to it) on to the entries it came from,
+//until only the variables are left:
+//     price * qty * (1 - rate)
+//
+//     tape                           adjoint, swept from the bottom up
+//     e0 = price                     qty * (1 - rate)
+//     e1 = qty                       price * (1 - rate)
+//     e2 = rate                      -price * qty
+//     e3 = e0 * e1   d/e0 qty, d/e1 price                 (1 - rate)
+//     e4 = 1 - e2    d/e2 -1                              price * qty
+//     e5 = e3 * e4   d/e3 (1 - rate), d/e4 price * qty    1
+//Constants and everything calculated from nothing but constants, comparisons included, have no entry.
+//The tape is a flat array of the entries in the order they were recorded, taken from an arena, so
+//recording it costs nothing but writing the entries.  A conditional only records the answer it picks,
+//which makes the derivative of x > 0 ? x * x : -x that of x * x where x is positive and -x elsewhere.
+//
+//Where a function has no derivative these are used: abs() has 0 at 0, min() and max() take the one of
+//their arguments they give, and the power of a constant base or exponent is differentiated with respect
+//to the other one only, so 2 ^ x at x = 3 is 8 log(2) and (-2) ^ 3 differentiated by the base is 12.
+//An entry whose adjoint is 0 passes nothing on, so 0 * sqrt(x) has a derivative of 0 at x = 0, not NaN.
+//
+//evaluateGradientBatch() does the same for many rows at once, taking columns as evaluateBatch() does.
+//A block of rows is run forwards with the batch kernels and then swept backwards with them too, over
+//every register which depends on a variable, so the whole program is the tape; each row passes adjoints
+//only into the answer it picked.  The sweep needs a few kernels for every instruction, which makes the
+//whole of it cost about five times evaluateBatch(), still however many variables there are.
+//So the two sum every adjoint in the same order, the tape has an entry for every load of a variable, and
+//for every min(), max() and conditional, which passes its adjoint on unchanged, as a register does, and
+//every partial is multiplied by the adjoint the same way.  In the same arithmetic, such as the batch
+//kernels run one lane at a time, the derivatives of evaluateGradient() are bit for bit those of
+//evaluateGradientBatch().
+
+//Function declarations
+template <typename T>
+void evaluateGradientBatch(const Program& program, const T* const* columns, T* out, T* const* gradients, size_t count, Arena& arena);
+
+//NAME: TapeEntry
+//DESCRIPTION:  One value the answer depends on: the entries it was calculated from, -1 for an operand
+//              which doesn't depend on any variable, and the derivative of the value with respect to each.
+template <typename T>
+struct TapeEntry
+{
+    int lhs;
+    int rhs;
+    T dlhs;
+    T drhs;
+};
+
+//NAME: failGradient
+//DESCRIPTION:  Gives NaN for every derivative of a program which can't be differentiated.
+//INPUT:
+//    slots - How many derivatives there are.
+//OUTPUT:
+//    gradient - NaN for each of them.
+//RETURNS:
+//    NaN, for the answer.
+template <typename T>
+T failGradient(int slots, T* gradient)
+{
+    std::fill(gradient, gradient + slots, std::numeric_limits<T>::quiet_NaN());
+    return std::numeric_limits<T>::quiet_NaN();
+}
+
+//NAME: evaluateGradient
+//DESCRIPTION:  Runs a compiled program, recording the tape, and sweeps it backwards for the derivative of
+//              the answer with respect to every variable.  The answer is exactly what evaluate() gives.
+//INPUT:
+//    program   - The program from compile().
+//    variables - The value of every slot the program reads.
+//    arena     - Where the tape goes, for instance threadArena().  It is only needed during the call, so
+//                the arena can be reset as soon as it returns.
+//OUTPUT:
+//    gradient  - The derivative with respect to every slot up to program.variableCount, 0 for the slots
+//                the answer doesn't depend on.  All NaN if the program failed to compile or the arena has
+//                run out of memory.
+//RETURNS:
+//    The value calculated from the expression, NaN if there is no gradient.
+template <typename T>
+T evaluateGradient(const Program& program, const T* variables, T* gradient, Arena& arena)
+{
+    using std::log;
+    using std::pow;
+
+    const int slots = program.variableCount;
+    if (!program.ok())
+        return failGradient(slots, gradient);
+
+    assert(variables != NULL || slots == 0);
+
+    const Instruction* code = program.code.data();
+    const int count = (int)program.code.size();
+
+    //The registers of evaluate(), the tape entry holding each of them or -1 if it is a constant, and the
+    //tape, whose first entries are the variables.
+    T* r = arena.allocate<T>(count);
+    int* node = arena.allocate<int>(count);
+    TapeEntry<T>* tape = arena.allocate<TapeEntry<T>>(slots + count);
+    T* adjoint = arena.allocate<T>(slots + count);
+    if (r == NULL || node == NULL || tape == NULL || adjoint == NULL)
+        return failGradient(slots, gradient);
+
+    int size = slots;
+    auto record = [&](int i, int lhs, int rhs, T dlhs, T drhs)
+    {
+        int first = node[lhs];
+        int second = rhs < 0 ? -1 : node[rhs];
+        if (first < 0 && second < 0)
+        {
+            node[i] = -1;
+            return;
+        }
+
+        tape[size] = { first, second, dlhs, drhs };
+        node[i] = size++;
+    };
+
+    for (int i = 0; i < count; i++)
+    {
+        const Instruction& in = code[i];
+        switch (in.op)
+        {
+        case OpCode::Constant:
+            r[i] = T(program.constants[in.lhs]);
+            node[i] = -1;
+            break;
+
+        case OpCode::Variable:
+            //Every load has an entry of its own, as every register has an adjoint in evaluateGradientBatch().
+            r[i] = variables[in.lhs];
+            tape[size] = { in.lhs, -1, T(1), T(0) };
+            node[i] = size++;
+            break;
+
+        case OpCode::Negate:
+            r[i] = r[in.lhs] * -1;
+            record(i, in.lhs, -1, T(-1), T(0));
+            break;
+
+        case OpCode::Add:
+            r[i] = r[in.lhs] + r[in.rhs];
+            record(i, in.lhs, in.rhs, T(1), T(1));
+            break;
+
+        case OpCode::Subtract:
+            r[i] = r[in.lhs] - r[in.rhs];
+            record(i, in.lhs, in.rhs, T(1), T(-1));
+            break;
+
+        case OpCode::Multiply:
+            r[i] = r[in.lhs] * r[in.rhs];
+            record(i, in.lhs, in.rhs, r[in.rhs], r[in.lhs]);
+            break;
+
+        case OpCode::Divide:
+            r[i] = r[in.lhs] / r[in.rhs];
+            record(i, in.lhs, in.rhs, T(1) / r[in.rhs], -r[i] / r[in.rhs]);
+            break;
+
+        case OpCode::Power:
+            //The logarithm of a negative base is NaN, and is only needed if the exponent isn't a constant.
+            r[i] = applyFunction(Function::Power, r[in.lhs], r[in.rhs]);
+            record(i, in.lhs, in.rhs, node[in.lhs] < 0 ? T(0) : r[in.rhs] * pow(r[in.lhs], r[in.rhs] - 1),
+                   node[in.rhs] < 0 ? T(0) : r[i] * log(r[in.lhs]));
+            break;
+
+        case OpCode::Min:
+            //min() and max() give one of their arguments, and pass their adjoint on to it.
+            r[i] = applyFunction(Function::Min, r[in.lhs], r[in.rhs]);
+            record(i, r[in.lhs] < r[in.rhs] ? in.lhs : in.rhs, -1, T(1), T(0));
+            break;
+
+        case OpCode::Max:
+            r[i] = applyFunction(Function::Max, r[in.lhs], r[in.rhs]);
+            record(i, r[in.lhs] > r[in.rhs] ? in.lhs : in.rhs, -1, T(1), T(0));
+            break;
+
+        case OpCode::Sqrt:
+            r[i] = applyFunction(Function::Sqrt, r[in.lhs], r[in.lhs]);
+            record(i, in.lhs, -1, T(0.5) / r[i], T(0));
+            break;
+
+        case OpCode::Exp:
+            r[i] = applyFunction(Function::Exp, r[in.lhs], r[in.lhs]);
+            record(i, in.lhs, -1, r[i], T(0));
+            break;
+
+        case OpCode::Log:
+            r[i] = applyFunction(Function::Log, r[in.lhs], r[in.lhs]);
+            record(i, in.lhs, -1, T(1) / r[in.lhs], T(0));
+            break;
+
+        case OpCode::Abs:
+            //At 0, and for NaN, nothing is passed on, not even an infinite adjoint times 0.
+            r[i] = applyFunction(Function::Abs, r[in.lhs], r[in.lhs]);
+            if (r[in.lhs] > 0 || r[in.lhs] < 0)
+                record(i, in.lhs, -1, r[in.lhs] > 0 ? T(1) : T(-1), T(0));
+            else
+                node[i] = -1;
+            break;
+
+        case OpCode::Branch:
+            r[i] = r[in.lhs] != 0 ? T(1) : T(0);
+            node[i] = -1;
+            if (r[i] == 0)
+                i = in.rhs;
+            break;
+
+        case OpCode::Jump:
+            //The answer picked is the Merge's value, and the Merge passes its adjoint on to it.
+            r[in.rhs] = r[in.lhs];
+            record(in.rhs, in.lhs, -1, T(1), T(0));
+            i = in.rhs;
+            break;
+
+        case OpCode::Merge:
+            r[i] = r[in.rhs];
+            record(i, in.rhs, -1, T(1), T(0));
+            break;
+
+        default:
+            //The comparisons are 1 or 0 whatever their arguments are close to, so they have no entry.
+            r[i] = applyFunction(codeFunction(in.op), r[in.lhs], r[in.rhs]);
+            node[i] = -1;
+            break;
+        }
+    }
+
+    std::fill(adjoint, adjoint + size, T(0));
+    if (node[count - 1] >= 0)
+        adjoint[node[count - 1]] = T(1);
+
+    for (int entry = size - 1; entry >= slots; entry--)
+    {
+        const T passed = adjoint[entry];
+        if (passed == 0)
+            continue;
+
+        const TapeEntry<T>& e = tape[entry];
+        if (e.lhs >= 0)
+            adjoint[e.lhs] += passed * e.dlhs;
+        if (e.rhs >= 0)
+            adjoint[e.rhs] += passed * e.drhs;
+    }
+
+    std::copy(adjoint, adjoint + slots, gradient);
+    return r[count - 1];
+}
+
+#endif
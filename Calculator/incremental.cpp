@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <bit>
+
+#include "incremental.h"
+
+//NAME: IncrementalProgram::IncrementalProgram
+//DESCRIPTION:  Evaluates a program once, remembering every register, and works out which instructions
+//              depend on every variable.
+//INPUT:
+//    program   - The program from compile(), optimized or not.
+//    variables - The value of every slot the program reads, NULL to start them all at 0.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+IncrementalProgram::IncrementalProgram(const Program& program, const double* variables)
+    : source(program), inputs(program.variableCount, 0.0), lowestWord(0), highestWord(-1), recalculated(0)
+{
+    if (variables != NULL)
+        std::copy(variables, variables + program.variableCount, inputs.begin());
+
+    const int count = (int)source.code.size();
+    const int words = (count + 63) / 64;
+    registers.assign(count, 0.0);
+    pending.assign(words, 0);
+    lowestWord = words;
+
+    //One variable at a time: an instruction depends on it if it loads it or reads a register that does.
+    std::vector<unsigned char> depends(count);
+    dependentStart.push_back(0);
+    for (int slot = 0; slot < source.variableCount; slot++)
+    {
+        int first = count;
+        int last = -1;
+        for (int i = 0; i < count; i++)
+        {
+            const Instruction& in = source.code[i];
+            switch (in.op)
+            {
+            case OpCode::Constant: depends[i] = 0;                                  break;
+            case OpCode::Variable: depends[i] = in.lhs == slot;                     break;
+            case OpCode::Merge:
+                {
+                    //Anything either answer depends on makes the Branch run again, to decide which is kept.
+                    unsigned char answers = 0;
+                    for (int k = in.lhs + 1; k < i; k++)
+                        answers |= depends[k];
+
+                    depends[in.lhs] |= answers;
+                    if (depends[in.lhs])
+                        first = std::min(first, in.lhs);
+
+                    depends[i] = depends[in.lhs] | depends[in.rhs] | depends[source.code[in.lhs].rhs];
+                }
+                break;
+            default:
+                depends[i] = depends[in.lhs] | (isUnary(in.op) ? 0 : depends[in.rhs]);
+                break;
+            }
+
+            if (depends[i])
+            {
+                first = std::min(first, i);
+                last = i;
+            }
+        }
+
+        firstWord.push_back(first / 64);
+        for (int word = first / 64; word <= last / 64 && last >= 0; word++)
+        {
+            uint64_t bits = 0;
+            for (int bit = 0; bit < 64 && word * 64 + bit < count; bit++)
+                if (depends[word * 64 + bit])
+                    bits |= (uint64_t)1 << bit;
+
+            dependents.push_back(bits);
+        }
+
+        dependentStart.push_back((int)dependents.size());
+    }
+
+    //The first time around everything has to be calculated, except the answers conditionals don't pick.
+    setPending(0, count - 1, true);
+    evaluate();
+}
+
+//NAME: IncrementalProgram::set
+//DESCRIPTION:  Changes a variable.  Nothing is recalculated until the next evaluate(), so any number of
+//              variables can be changed first and the instructions they share are only run once.
+//INPUT:
+//    slot  - The slot of the variable.
+//    value - Its new value.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void IncrementalProgram::set(int slot, double value)
+{
+    assert(slot >= 0 && slot < (int)inputs.size());
+
+    //The very same bits, the sign of zero and NaNs included, can't change anything.
+    if (std::bit_cast<uint64_t>(inputs[slot]) == std::bit_cast<uint64_t>(value))
+        return;
+
+    inputs[slot] = value;
+
+    int words = dependentStart[slot + 1] - dependentStart[slot];
+    if (words == 0)
+        return;
+
+    const uint64_t* bits = &dependents[dependentStart[slot]];
+    uint64_t* waiting = &pending[firstWord[slot]];
+    for (int i = 0; i < words; i++)
+        waiting[i] |= bits[i];
+
+    lowestWord = std::min(lowestWord, firstWord[slot]);
+    highestWord = std::max(highestWord, firstWord[slot] + words - 1);
+}
+
+//NAME: IncrementalProgram::evaluate
+//DESCRIPTION:  Brings the answer up to date with the variables set since the last time, running every
+//              instruction waiting from the lowest to the highest.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The value calculated from the expression, NaN if the program failed to compile.
+double IncrementalProgram::evaluate()
+{
+    if (!source.ok())
+        return std::numeric_limits<double>::quiet_NaN();
+
+    //A Branch changes the bits after it, so they are read again after every instruction.
+    recalculated = 0;
+    for (int word = lowestWord; word <= highestWord; word++)
+    {
+        while (pending[word] != 0)
+        {
+            int bit = std::countr_zero(pending[word]);
+            pending[word] &= pending[word] - 1;
+            recalculate(word * 64 + bit);
+            recalculated++;
+        }
+    }
+
+    lowestWord = (int)pending.size();
+    highestWord = -1;
+    return registers.back();
+}
+
+//NAME: IncrementalProgram::recalculate
+//DESCRIPTION:  Runs one instruction, the same way evaluate<double>() would.
+//INPUT:
+//    instruction - The instruction.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void IncrementalProgram::recalculate(int instruction)
+{
+    const Instruction& in = source.code[instruction];
+    double* r = registers.data();
+
+    switch (in.op)
+    {
+    case OpCode::Constant: r[instruction] = source.constants[in.lhs];   break;
+    case OpCode::Variable: r[instruction] = inputs[in.lhs];             break;
+    case OpCode::Negate:   r[instruction] = r[in.lhs] * -1;             break;
+    case OpCode::Add:      r[instruction] = r[in.lhs] + r[in.rhs];      break;
+    case OpCode::Subtract: r[instruction] = r[in.lhs] - r[in.rhs];      break;
+    case OpCode::Multiply: r[instruction] = r[in.lhs] * r[in.rhs];      break;
+    case OpCode::Divide:   r[instruction] = r[in.lhs] / r[in.rhs];      break;
+    case OpCode::Jump:                                                  break;
+    case OpCode::Merge:
+        {
+            //The Jump doesn't store the first answer here: it isn't run again when only that answer changes.
+            const Instruction& jump = source.code[source.code[in.lhs].rhs];
+            r[instruction] = r[in.lhs] != 0 ? r[jump.lhs] : r[in.rhs];
+        }
+        break;
+    case OpCode::Branch:
+        {
+            const int jump = in.rhs;
+            const int merge = source.code[jump].rhs;
+            const double taken = r[in.lhs] != 0 ? 1 : 0;
+            const bool changed = taken != r[instruction];
+            r[instruction] = taken;
+
+            //The Jump and the Merge run whichever answer is picked.
+            if (taken != 0)
+            {
+                setPending(jump + 1, merge - 1, false);
+                if (changed)
+                    setPending(instruction + 1, jump - 1, true);
+            }
+            else
+            {
+                setPending(instruction + 1, jump - 1, false);
+                if (changed)
+                    setPending(jump + 1, merge - 1, true);
+            }
+        }
+        break;
+    default:               r[instruction] = applyFunction(codeFunction(in.op), r[in.lhs], r[in.rhs]);  break;
+    }
+}
+
+//NAME: IncrementalProgram::setPending
+//DESCRIPTION:  Sets or clears the bits of a range of instructions waiting to be run again.
+//INPUT:
+//    first   - The first instruction.
+//    last    - The last instruction, before first if there are none.
+//    waiting - True to set the bits, false to clear them.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void IncrementalProgram::setPending(int first, int last, bool waiting)
+{
+    for (int i = first; i <= last; i++)
+    {
+        uint64_t bit = (uint64_t)1 << (i % 64);
+        if (waiting)
+            pending[i / 64] |= bit;
+        else
+            pending[i / 64] &= ~bit;
+    }
+
+    if (waiting && first <= last)
+    {
+        lowestWord = std::min(lowestWord, first / 64);
+        highestWord = std::max(highestWord, last / 64);
+    }
+}
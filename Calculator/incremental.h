@@ -0,0 +1,73 @@
+#ifndef CALCULATOR_INCREMENTAL_H
+#define CALCULATOR_INCREMENTAL_H
+
+#include <cstdint>
+#include <vector>
+
+#include "compiler.h"
+
+//evaluate() runs every instruction of a program every time, even when only one of its inputs has changed
+//and most of the formula comes out exactly as it did before.  An IncrementalProgram keeps the value of
+//every register from the last time, and knows for every variable which instructions depend on it, however
+//indirectly.  When variables change only those instructions are run again, in program order:
+//     a * b + c * d
+//
+//     r0 = a  r1 = b  r2 = r0 * r1
+//     r3 = c  r4 = d  r5 = r3 * r4     Setting d runs r4, r5 and r6 again; r0 to r2 keep their values.
+//     r6 = r2 + r5
+//An update therefore costs about as much as the part of the formula that depends on what changed, not
+//the whole formula.
+//
+//What depends on a variable is worked out once, as one bit per instruction covering the instructions
+//from the first to the last one that depend on it.  set() adds those bits to the ones waiting, 64 at a
+//time, and evaluate() runs the instructions whose bits are set from the lowest to the highest.  Everything
+//an instruction reads comes before it, so its operands are always up to date by the time it runs.
+//
+//Only the answer a conditional picks is kept up to date.  Its Branch depends on everything either answer
+//depends on, and when it runs it takes the bits of the answer not picked off again.  If the condition has
+//changed its mind, every instruction of the answer now picked is run, since nothing has kept them up to
+//date while it wasn't.
+//The answers are bit for bit those of evaluate<double>().
+
+//NAME: IncrementalProgram
+//DESCRIPTION:  A compiled program which remembers its registers and only recalculates what changed.
+//              It has its own copy of the variables, changed with set().
+class IncrementalProgram
+{
+public:
+    IncrementalProgram(const Program& program, const double* variables = NULL);
+
+    double get(int slot) const { return inputs[slot]; }
+
+    void set(int slot, double value);
+
+    double evaluate();
+
+    int lastRecalculated() const { return recalculated; }
+
+    const Program& program() const { return source; }
+
+private:
+    void recalculate(int instruction);
+
+    void setPending(int first, int last, bool waiting);
+
+    Program source;
+    std::vector<double> inputs;
+    std::vector<double> registers;
+
+    //The instructions depending on each variable, one list of words after the other: the bits of slot s
+    //are dependents[dependentStart[s]] up to dependents[dependentStart[s + 1]], the first of them for
+    //instructions firstWord[s] * 64 and up.
+    std::vector<int> dependentStart;
+    std::vector<int> firstWord;
+    std::vector<uint64_t> dependents;
+
+    //One bit for every instruction waiting to be run again, and the range of words they are in.
+    std::vector<uint64_t> pending;
+    int lowestWord;
+    int highestWord;
+    int recalculated;
+};
+
+#endif
@@ -0,0 +1,204 @@
+#include <cstdio>
+#include <mutex>
+
+#include "instrument.h"
+
+//The counters of every thread which has counted anything are kept in a list so they can be added up.
+//The list is only touched when a thread starts or stops counting, and by instrumentSnapshot().
+//A thread which stops adds its counters to the retired ones first, so nothing it counted is lost.
+
+//NAME: Registry
+//DESCRIPTION:  The list of every thread's counters, and what the finished threads counted.
+struct Registry
+{
+    std::mutex mutex;
+    ThreadCounters* first;
+    InstrumentSnapshot retired;
+};
+
+//NAME: registry
+//DESCRIPTION:  The one list of counters.
+static Registry& registry()
+{
+    static Registry instance = {};
+    return instance;
+}
+
+//NAME: ThreadCounters::ThreadCounters
+//DESCRIPTION:  Starts a thread's counters at zero and adds them to the list.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+ThreadCounters::ThreadCounters() : maxDepth(0), maxParenthesis(0), depth(0), previous(NULL), next(NULL)
+{
+    for (int i = 0; i < kStageCount; i++)
+    {
+        calls[i].store(0, std::memory_order_relaxed);
+        cycles[i].store(0, std::memory_order_relaxed);
+    }
+
+    Registry& list = registry();
+    std::lock_guard<std::mutex> lock(list.mutex);
+    next = list.first;
+    if (next != NULL)
+        next->previous = this;
+    list.first = this;
+}
+
+//NAME: ThreadCounters::~ThreadCounters
+//DESCRIPTION:  Adds a finished thread's counters to the retired ones and takes them off the list.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+ThreadCounters::~ThreadCounters()
+{
+    Registry& list = registry();
+    std::lock_guard<std::mutex> lock(list.mutex);
+    for (int i = 0; i < kStageCount; i++)
+    {
+        list.retired.stages[i].calls += calls[i].load(std::memory_order_relaxed);
+        list.retired.stages[i].cycles += cycles[i].load(std::memory_order_relaxed);
+    }
+
+    if (maxDepth.load(std::memory_order_relaxed) > list.retired.maxDepth)
+        list.retired.maxDepth = maxDepth.load(std::memory_order_relaxed);
+    if (maxParenthesis.load(std::memory_order_relaxed) > list.retired.maxParenthesis)
+        list.retired.maxParenthesis = maxParenthesis.load(std::memory_order_relaxed);
+    list.retired.threads++;
+
+    if (previous != NULL)
+        previous->next = next;
+    else
+        list.first = next;
+    if (next != NULL)
+        next->previous = previous;
+}
+
+//NAME: instrumentEnabled
+//DESCRIPTION:  Checks to see if the parser was built with CALC_INSTRUMENT, and so counts anything.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if it counts.
+bool instrumentEnabled()
+{
+#if defined(CALC_INSTRUMENT)
+    return true;
+#else
+    return false;
+#endif
+}
+
+//NAME: instrumentSnapshot
+//DESCRIPTION:  Adds up the counters of every thread, running or finished.  Threads carry on counting
+//              while this reads, so a snapshot may miss the last few calls.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The counters.  All zero without CALC_INSTRUMENT.
+InstrumentSnapshot instrumentSnapshot()
+{
+    Registry& list = registry();
+    std::lock_guard<std::mutex> lock(list.mutex);
+
+    InstrumentSnapshot snapshot = list.retired;
+    for (ThreadCounters* counters = list.first; counters != NULL; counters = counters->next)
+    {
+        for (int i = 0; i < kStageCount; i++)
+        {
+            snapshot.stages[i].calls += counters->calls[i].load(std::memory_order_relaxed);
+            snapshot.stages[i].cycles += counters->cycles[i].load(std::memory_order_relaxed);
+        }
+
+        if (counters->maxDepth.load(std::memory_order_relaxed) > snapshot.maxDepth)
+            snapshot.maxDepth = counters->maxDepth.load(std::memory_order_relaxed);
+        if (counters->maxParenthesis.load(std::memory_order_relaxed) > snapshot.maxParenthesis)
+            snapshot.maxParenthesis = counters->maxParenthesis.load(std::memory_order_relaxed);
+        snapshot.threads++;
+    }
+
+    return snapshot;
+}
+
+//NAME: stageName
+//DESCRIPTION:  The name of a stage, as it is written in the source.
+//INPUT:
+//    stage - The stage.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Its name.
+const char* stageName(Stage stage)
+{
+    switch (stage)
+    {
+    case Stage::MakeFloat:          return "makeFloat";
+    case Stage::TokenizeNumbers:    return "tokenizeNumbers";
+    case Stage::TokenizePower:      return "tokenizePower";
+    case Stage::TokenizeMulDiv:     return "tokenizeMulDiv";
+    case Stage::TokenizeExpression: return "tokenizeExpression";
+    case Stage::TokenizeSum:        return "tokenizeSum";
+    case Stage::TokenizeComparison: return "tokenizeComparison";
+    case Stage::TokenizeAnd:        return "tokenizeAnd";
+    case Stage::TokenizeOr:         return "tokenizeOr";
+    }
+
+    return "unknown";
+}
+
+//NAME: formatPrometheus
+//DESCRIPTION:  Writes a snapshot in the Prometheus text exposition format, ready to be served to a scraper:
+//                  calculator_stage_calls_total{stage="makeFloat"} 1200
+//                  calculator_stage_cycles_total{stage="makeFloat"} 96000
+//                  calculator_max_depth 7
+//                  calculator_max_parenthesis 3
+//INPUT:
+//    snapshot - The counters from instrumentSnapshot().
+//OUTPUT:
+//    none
+//RETURNS:
+//    The text.
+std::string formatPrometheus(const InstrumentSnapshot& snapshot)
+{
+    std::string text;
+    char line[256];
+
+    text += "# HELP calculator_stage_calls_total Calls to each stage of the parser.\n";
+    text += "# TYPE calculator_stage_calls_total counter\n";
+    for (int i = 0; i < kStageCount; i++)
+    {
+        snprintf(line, sizeof(line), "calculator_stage_calls_total{stage=\"%s\"} %llu\n", stageName((Stage)i),
+                 (unsigned long long)snapshot.stages[i].calls);
+        text += line;
+    }
+
+    text += "# HELP calculator_stage_cycles_total Cycles spent in each stage of the parser, including the stages it calls.\n";
+    text += "# TYPE calculator_stage_cycles_total counter\n";
+    for (int i = 0; i < kStageCount; i++)
+    {
+        snprintf(line, sizeof(line), "calculator_stage_cycles_total{stage=\"%s\"} %llu\n", stageName((Stage)i),
+                 (unsigned long long)snapshot.stages[i].cycles);
+        text += line;
+    }
+
+    snprintf(line, sizeof(line), "# HELP calculator_max_depth Deepest the parser stages have called each other.\n"
+                                 "# TYPE calculator_max_depth gauge\ncalculator_max_depth %d\n", snapshot.maxDepth);
+    text += line;
+    snprintf(line, sizeof(line), "# HELP calculator_max_parenthesis Most parentheses open at once.\n"
+                                 "# TYPE calculator_max_parenthesis gauge\ncalculator_max_parenthesis %d\n", snapshot.maxParenthesis);
+    text += line;
+    snprintf(line, sizeof(line), "# HELP calculator_instrumented_threads Threads which have counted anything.\n"
+                                 "# TYPE calculator_instrumented_threads gauge\ncalculator_instrumented_threads %d\n", snapshot.threads);
+    text += line;
+    return text;
+}
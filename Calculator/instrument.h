@@ -0,0 +1,189 @@
+#ifndef CALCULATOR_INSTRUMENT_H
+#define CALCULATOR_INSTRUMENT_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define CALC_RDTSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define CALC_RDTSC 1
+#endif
+
+//When solving suddenly gets slower it helps to know which part of the parser the time goes to.  Built with
+//CALC_INSTRUMENT defined, the parser counts the calls to makeFloat() and every tokenize function, from
+//tokenizeNumbers() up to tokenizeExpression(), and the processor cycles spent in them, and remembers how deep
+//the recursion and the parentheses have ever gone.  Without CALC_INSTRUMENT all of that compiles to nothing at all.
+//
+//The cycles are those of the time stamp counter (rdtsc) on x86 and nanoseconds elsewhere, and they include
+//everything a stage calls: tokenizeSum() includes the tokenizeMulDiv() calls it makes, and so on.
+//Reading the counter costs a few dozen cycles, which on short expressions is more than the stage itself,
+//so the cycles are best compared with each other rather than taken as the real cost.
+//
+//Every thread counts into its own counters, which only it ever writes to, so counting needs no lock and
+//no atomic read-modify-write.  instrumentSnapshot() adds up those of every thread, including the ones
+//which have finished, and formatPrometheus() writes a snapshot in the Prometheus text format.
+//Solving while compiling, see solveConstant(), counts nothing.
+
+//NAME: Stage
+//DESCRIPTION:  The parts of the parser which are counted.
+enum class Stage : unsigned char
+{
+    MakeFloat,
+    TokenizeNumbers,
+    TokenizePower,
+    TokenizeMulDiv,
+    TokenizeExpression,
+    TokenizeSum,
+    TokenizeComparison,
+    TokenizeAnd,
+    TokenizeOr,
+};
+
+static const int kStageCount = 9;
+
+//NAME: StageCounters
+//DESCRIPTION:  How often a stage was called and how many cycles it took altogether.
+struct StageCounters
+{
+    uint64_t calls;
+    uint64_t cycles;
+};
+
+//NAME: InstrumentSnapshot
+//DESCRIPTION:  The counters of every thread added up.  maxDepth is the deepest the counted stages have
+//              called each other, maxParenthesis the most parentheses ever open at once.
+struct InstrumentSnapshot
+{
+    StageCounters stages[kStageCount];
+    int maxDepth;
+    int maxParenthesis;
+    int threads;
+};
+
+//NAME: ThreadCounters
+//DESCRIPTION:  The counters of one thread.  Only that thread writes to them, with plain relaxed stores;
+//              being atomic only lets instrumentSnapshot() read them from another thread at any time.
+struct ThreadCounters
+{
+    ThreadCounters();
+
+    ~ThreadCounters();
+
+    ThreadCounters(const ThreadCounters&) = delete;
+
+    ThreadCounters& operator=(const ThreadCounters&) = delete;
+
+    std::atomic<uint64_t> calls[kStageCount];
+    std::atomic<uint64_t> cycles[kStageCount];
+    std::atomic<int> maxDepth;
+    std::atomic<int> maxParenthesis;
+    int depth;
+
+    //The other threads' counters, see instrument.cpp.
+    ThreadCounters* previous;
+    ThreadCounters* next;
+};
+
+//Function declarations
+bool instrumentEnabled();
+
+InstrumentSnapshot instrumentSnapshot();
+
+std::string formatPrometheus(const InstrumentSnapshot& snapshot);
+
+const char* stageName(Stage stage);
+
+
+//NAME: readCycles
+//DESCRIPTION:  The time stamp counter on x86, nanoseconds on a steady clock elsewhere.
+inline uint64_t readCycles()
+{
+#if defined(CALC_RDTSC)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+#if defined(CALC_INSTRUMENT)
+
+//NAME: threadCounters
+//DESCRIPTION:  The counters of the calling thread, created the first time it counts anything.
+inline ThreadCounters& threadCounters()
+{
+    thread_local ThreadCounters counters;
+    return counters;
+}
+
+//NAME: bump
+//DESCRIPTION:  Adds to a counter only this thread writes to: a plain load and store, nothing locked.
+inline void bump(std::atomic<uint64_t>& counter, uint64_t amount)
+{
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+//NAME: raiseMark
+//DESCRIPTION:  Raises a high-water mark only this thread writes to.
+inline void raiseMark(std::atomic<int>& mark, int value)
+{
+    if (value > mark.load(std::memory_order_relaxed))
+        mark.store(value, std::memory_order_relaxed);
+}
+
+//NAME: StageTimer
+//DESCRIPTION:  Counts one call to a stage, from where it is declared to the end of the block.
+class StageTimer
+{
+public:
+    constexpr explicit StageTimer(Stage stage) : stage(stage), start(0)
+    {
+        if (!std::is_constant_evaluated())
+        {
+            ThreadCounters& counters = threadCounters();
+            raiseMark(counters.maxDepth, ++counters.depth);
+            start = readCycles();
+        }
+    }
+
+    constexpr ~StageTimer()
+    {
+        if (!std::is_constant_evaluated())
+        {
+            uint64_t cycles = readCycles() - start;
+            ThreadCounters& counters = threadCounters();
+            bump(counters.calls[(int)stage], 1);
+            bump(counters.cycles[(int)stage], cycles);
+            counters.depth--;
+        }
+    }
+
+private:
+    Stage stage;
+    uint64_t start;
+};
+
+//NAME: trackParenthesis
+//DESCRIPTION:  Remembers how many parentheses are open, if it is more than ever before.
+constexpr void trackParenthesis(int open)
+{
+    if (!std::is_constant_evaluated())
+        raiseMark(threadCounters().maxParenthesis, open);
+}
+
+#define CALC_TIME_STAGE(stage) StageTimer calcStageTimer(stage)
+#define CALC_TRACK_PARENTHESIS(open) trackParenthesis(open)
+
+#else
+
+#define CALC_TIME_STAGE(stage) ((void)0)
+#define CALC_TRACK_PARENTHESIS(open) ((void)0)
+
+#endif
+
+#endif
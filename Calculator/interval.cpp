@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "interval.h"
+
+//How many units in the last place the ends of exp(), log() and ^ are moved out by.  The standard library
+//and the batch kernels are each within 1 of the exact answer, so within 2 of each other; one more covers
+//a unit which halves where the answer crosses a power of 2.
+static const int kWidenUnits = 3;
+
+static const double kInfinity = std::numeric_limits<double>::infinity();
+
+//NAME: below
+//DESCRIPTION:  A number kWidenUnits units in the last place below another.
+//INPUT:
+//    value - The number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The smaller number, -infinity for -infinity.
+static double below(double value)
+{
+    for (int unit = 0; unit < kWidenUnits; unit++)
+        value = std::nextafter(value, -kInfinity);
+    return value;
+}
+
+//NAME: above
+//DESCRIPTION:  A number kWidenUnits units in the last place above another.
+//INPUT:
+//    value - The number.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The larger number, infinity for infinity.
+static double above(double value)
+{
+    for (int unit = 0; unit < kWidenUnits; unit++)
+        value = std::nextafter(value, kInfinity);
+    return value;
+}
+
+//NAME: spanning
+//DESCRIPTION:  The interval from the smallest to the largest of the values an operation gives at the ends
+//              of its operands.  A NaN among them, such as 0 * infinity, may be the answer of a row, but
+//              the values next to it are bounded by the others.
+//INPUT:
+//    ends  - The values.
+//    count - How many there are.
+//    nan   - Whether the answer may be NaN whatever the values are.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval, everything if every value is NaN.
+static Interval spanning(const double* ends, int count, bool nan)
+{
+    double lo = kInfinity;
+    double hi = -kInfinity;
+    bool any = false;
+    for (int end = 0; end < count; end++)
+    {
+        if (std::isnan(ends[end]))
+        {
+            nan = true;
+            continue;
+        }
+
+        lo = std::min(lo, ends[end]);
+        hi = std::max(hi, ends[end]);
+        any = true;
+    }
+
+    return any ? Interval(lo, hi, nan) : Interval::everything(true);
+}
+
+//NAME: hasInfinity
+//DESCRIPTION:  Whether an interval holds infinity or -infinity.
+//INPUT:
+//    value - The interval.
+//OUTPUT:
+//    none
+//RETURNS:
+//    true if either end is infinite.
+static bool hasInfinity(const Interval& value)
+{
+    return std::isinf(value.lo) || std::isinf(value.hi);
+}
+
+//NAME: sum
+//DESCRIPTION:  The interval of a sum or difference from its smallest and largest possible values.  Either
+//              is NaN only where infinity meets -infinity, which makes the answer NaN or infinite.
+//INPUT:
+//    lo  - The smallest value.
+//    hi  - The largest value.
+//    nan - Whether an operand may be NaN, or infinity meet -infinity.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval.
+static Interval sum(double lo, double hi, bool nan)
+{
+    if (std::isnan(lo))
+    {
+        lo = -kInfinity;
+        nan = true;
+    }
+
+    if (std::isnan(hi))
+    {
+        hi = kInfinity;
+        nan = true;
+    }
+
+    return Interval(lo, hi, nan);
+}
+
+//NAME: operator+
+//DESCRIPTION:  Every sum of a value of one interval and a value of the other.
+//INPUT:
+//    first  - The first operand.
+//    second - The second.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval of the sums.
+Interval operator+(const Interval& first, const Interval& second)
+{
+    bool opposite = (first.lo == -kInfinity && second.hi == kInfinity) || (first.hi == kInfinity && second.lo == -kInfinity);
+    return sum(first.lo + second.lo, first.hi + second.hi, first.nan || second.nan || opposite);
+}
+
+//NAME: operator-
+//DESCRIPTION:  Every difference of a value of one interval and a value of the other.
+//INPUT:
+//    first  - The first operand.
+//    second - The second.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval of the differences.
+Interval operator-(const Interval& first, const Interval& second)
+{
+    bool alike = (first.lo == -kInfinity && second.lo == -kInfinity) || (first.hi == kInfinity && second.hi == kInfinity);
+    return sum(first.lo - second.hi, first.hi - second.lo, first.nan || second.nan || alike);
+}
+
+//NAME: operator*
+//DESCRIPTION:  Every product of a value of one interval and a value of the other.  0 * infinity is NaN
+//              even where the 0 is inside an interval rather than at its end.
+//INPUT:
+//    first  - The first operand.
+//    second - The second.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval of the products.
+Interval operator*(const Interval& first, const Interval& second)
+{
+    const double ends[] = {
+        first.lo * second.lo, first.lo * second.hi, first.hi * second.lo, first.hi * second.hi,
+    };
+    bool zeroByInfinity = (first.contains(0) && hasInfinity(second)) || (second.contains(0) && hasInfinity(first));
+    return spanning(ends, 4, first.nan || second.nan || zeroByInfinity);
+}
+
+//NAME: operator/
+//DESCRIPTION:  Every quotient of a value of one interval and a value of the other.  A divisor which may be
+//              0 may give any infinity, so the answer is everything, and NaN as well for 0 / 0.
+//INPUT:
+//    first  - The dividend.
+//    second - The divisor.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval of the quotients.
+Interval operator/(const Interval& first, const Interval& second)
+{
+    bool nan = first.nan || second.nan;
+    if (second.lo <= 0 && second.hi >= 0)
+        return Interval::everything(nan || first.contains(0) || (hasInfinity(first) && hasInfinity(second)));
+
+    const double ends[] = {
+        first.lo / second.lo, first.lo / second.hi, first.hi / second.lo, first.hi / second.hi,
+    };
+    return spanning(ends, 4, nan);
+}
+
+//NAME: hull
+//DESCRIPTION:  The smallest interval holding both of two.
+//INPUT:
+//    first  - One interval.
+//    second - The other.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval holding both.
+Interval hull(const Interval& first, const Interval& second)
+{
+    return Interval(std::min(first.lo, second.lo), std::max(first.hi, second.hi), first.nan || second.nan);
+}
+
+//NAME: power
+//DESCRIPTION:  Every power of a value of the base to a value of the exponent, as std::pow() gives them.
+//              A whole exponent on its own is taken as an odd or even power of any base.  Otherwise a
+//              positive base gives its extremes at the ends of both, and a negative one may give NaN.
+//INPUT:
+//    base     - The base.
+//    exponent - The exponent.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval of the powers.
+static Interval power(const Interval& base, const Interval& exponent)
+{
+    bool nan = base.nan || exponent.nan;
+    double n = exponent.lo;
+    if (n == exponent.hi && !exponent.nan && std::isfinite(n) && std::floor(n) == n)
+    {
+        //x ^ 0 is 1 even for NaN.
+        if (n == 0)
+            return Interval(1);
+
+        bool even = std::fmod(n, 2) == 0;
+        double lo = std::pow(base.lo, n);
+        double hi = std::pow(base.hi, n);
+        if (base.contains(0))
+        {
+            if (n < 0)
+                return Interval::everything(base.nan);
+            if (even)
+                return Interval(0, above(std::max(lo, hi)), base.nan);
+        }
+
+        return Interval(below(std::min(lo, hi)), above(std::max(lo, hi)), base.nan);
+    }
+
+    //0 ^ y for negative y is infinity, or -infinity for -0 and an odd y.
+    if (base.lo > 0 || (base.lo == 0 && exponent.lo >= 0))
+    {
+        const double ends[] = {
+            std::pow(base.lo, exponent.lo), std::pow(base.lo, exponent.hi),
+            std::pow(base.hi, exponent.lo), std::pow(base.hi, exponent.hi),
+        };
+        Interval powers = spanning(ends, 4, nan);
+        return Interval(below(powers.lo), above(powers.hi), powers.nan);
+    }
+
+    return Interval::everything(nan || base.lo < 0);
+}
+
+//NAME: less
+//DESCRIPTION:  Whether a value of one interval is less than, or no greater than, a value of the other.
+//INPUT:
+//    first  - The left hand side.
+//    second - The right hand side.
+//    equal  - Whether values which are the same hold.
+//OUTPUT:
+//    none
+//RETURNS:
+//    1 if it holds for every pair of values, 0 if it holds for none, otherwise the interval from 0 to 1.
+static Interval less(const Interval& first, const Interval& second, bool equal)
+{
+    //A comparison with NaN never holds.
+    bool always = equal ? first.hi <= second.lo : first.hi < second.lo;
+    bool never = equal ? first.lo > second.hi : first.lo >= second.hi;
+    if (always && !first.nan && !second.nan)
+        return Interval(1);
+    if (never)
+        return Interval(0);
+    return Interval(0, 1);
+}
+
+//NAME: equal
+//DESCRIPTION:  Whether a value of one interval is the same as a value of the other.
+//INPUT:
+//    first  - The left hand side.
+//    second - The right hand side.
+//    holds  - What the comparison gives where they are the same, 1 for == and 0 for !=.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The comparison if it is the same for every pair of values, otherwise the interval from 0 to 1.
+static Interval equal(const Interval& first, const Interval& second, double holds)
+{
+    //NaN is unequal to everything.
+    if (first.hi < second.lo || second.hi < first.lo)
+        return Interval(1 - holds);
+    if (first.lo == first.hi && second.lo == second.hi && !first.nan && !second.nan)
+        return Interval(holds);
+    return Interval(0, 1);
+}
+
+//NAME: applyFunction
+//DESCRIPTION:  Every value a function gives for the values of its arguments, as applyFunction() gives
+//              them for doubles.  min(x, y) is x < y ? x : y, so it is y when x is NaN and NaN when y is.
+//INPUT:
+//    function - The function.
+//    first    - Its first argument.
+//    second   - Its second argument, ignored by functions taking one.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The interval of the results.
+Interval applyFunction(Function function, Interval first, Interval second)
+{
+    switch (function)
+    {
+    case Function::Power:
+        return power(first, second);
+    case Function::Min:
+        {
+            Interval smaller(std::min(first.lo, second.lo), std::min(first.hi, second.hi), second.nan);
+            return first.nan ? hull(smaller, second) : smaller;
+        }
+    case Function::Max:
+        {
+            Interval larger(std::max(first.lo, second.lo), std::max(first.hi, second.hi), second.nan);
+            return first.nan ? hull(larger, second) : larger;
+        }
+    case Function::Sqrt:
+        if (first.hi < 0)
+            return Interval::everything(true);
+        return Interval(std::sqrt(std::max(first.lo, 0.0)), std::sqrt(first.hi), first.nan || first.lo < 0);
+    case Function::Exp:
+        return Interval(std::max(below(std::exp(first.lo)), 0.0), above(std::exp(first.hi)), first.nan);
+    case Function::Log:
+        if (first.hi < 0)
+            return Interval::everything(true);
+        return Interval(first.lo <= 0 ? -kInfinity : below(std::log(first.lo)), above(std::log(first.hi)), first.nan || first.lo < 0);
+    case Function::Abs:
+        if (first.hi < 0)
+            return Interval(-first.hi, -first.lo, first.nan);
+        if (first.lo < 0)
+            return Interval(0, std::max(-first.lo, first.hi), first.nan);
+        return first;
+    case Function::Less:         return less(first, second, false);
+    case Function::LessEqual:    return less(first, second, true);
+    case Function::Greater:      return less(second, first, false);
+    case Function::GreaterEqual: return less(second, first, true);
+    case Function::Equal:        return equal(first, second, 1);
+    case Function::NotEqual:     return equal(first, second, 0);
+    }
+
+    return Interval::everything(true);
+}
+
+//NAME: evaluate
+//DESCRIPTION:  Runs a compiled program over the range of every variable.  A conditional whose condition
+//              may be either 0 or not runs both its answers, and its Merge holds both.
+//INPUT:
+//    program   - The program from compile().
+//    variables - The range of every slot the program reads.
+//OUTPUT:
+//    none
+//RETURNS:
+//    An interval holding the answer for every value of the variables in their ranges, everything and NaN
+//    if the program failed to compile.
+template <>
+Interval evaluate<Interval>(const Program& program, const Interval* variables)
+{
+    if (!program.ok())
+        return Interval::everything(true);
+
+    assert(variables != NULL || program.variableCount == 0);
+
+    RegisterFile<Interval> registers(program.code.size());
+    Interval* r = registers.r;
+
+    const Instruction* code = program.code.data();
+    const int count = (int)program.code.size();
+    for (int i = 0; i < count; i++)
+    {
+        const Instruction& in = code[i];
+        switch (in.op)
+        {
+        case OpCode::Constant: r[i] = Interval(program.constants[in.lhs]);  break;
+        case OpCode::Variable: r[i] = variables[in.lhs];                    break;
+        case OpCode::Negate:   r[i] = Interval(-r[in.lhs].hi, -r[in.lhs].lo, r[in.lhs].nan);  break;
+        case OpCode::Add:      r[i] = r[in.lhs] + r[in.rhs];                break;
+        case OpCode::Subtract: r[i] = r[in.lhs] - r[in.rhs];                break;
+        case OpCode::Multiply: r[i] = r[in.lhs] * r[in.rhs];                break;
+        case OpCode::Divide:   r[i] = r[in.lhs] / r[in.rhs];                break;
+        case OpCode::Branch:
+            //1 for the first answer only, 0 for the other only and [0, 1] for both.  NaN isn't 0.
+            if (!r[in.lhs].contains(0))
+                r[i] = Interval(1);
+            else if (r[in.lhs].lo == 0 && r[in.lhs].hi == 0 && !r[in.lhs].nan)
+            {
+                r[i] = Interval(0);
+                i = in.rhs;
+            }
+            else
+                r[i] = Interval(0, 1);
+            break;
+        case OpCode::Jump:
+            r[in.rhs] = r[in.lhs];
+            if (r[code[in.rhs].lhs].lo != 0)
+                i = in.rhs;
+            break;
+        case OpCode::Merge:
+            r[i] = r[in.lhs].hi != 0 ? hull(r[i], r[in.rhs]) : r[in.rhs];
+            break;
+        default:
+            r[i] = applyFunction(codeFunction(in.op), r[in.lhs], r[in.rhs]);
+            break;
+        }
+    }
+
+    return r[count - 1];
+}
@@ -0,0 +1,85 @@
+#ifndef CALCULATOR_INTERVAL_H
+#define CALCULATOR_INTERVAL_H
+
+#include <cmath>
+#include <limits>
+
+#include "functions.h"
+#include "compiler.h"
+
+//Before a block of rows is evaluated it can often be shown that none of them can pass a filter: if qty is
+//between 1 and 10 and price between 2 and 3 in this block, price * qty is between 2 and 30, and a query for
+//price * qty > 50 can skip the block without looking at a single row of it.  evaluate<Interval>() runs a
+//compiled program once over the range of every variable instead of its value and gives a range which holds
+//the answer of every row whose variables are in theirs, in a single pass however many rows there are.
+//
+//The range an instruction gives is worked out from those of its operands: the extremes of a product are
+//among those of the four products of their ends, those of sqrt() are the roots of its ends, and so on.
+//A comparison is 1 or 0 where it can only go one way, and [0, 1] where it could go either:
+//     x in [1, 10], y in [4, 5]
+//
+//     x * y            [4, 50]
+//     x < y            [0, 1]
+//     x + 10 < y       [0, 0]
+//     x < y ? x : y    [1, 10]       Both answers are taken where the condition could be either.
+//A conditional whose condition may be either runs both its answers and gives everything either could give;
+//otherwise it runs only the one it picks, as evaluate() does.
+//
+//The ranges bound what the engines give, not what exact arithmetic would: + - * / and sqrt() are rounded
+//to the nearest double, and a rounding to nearest never puts a larger number below a smaller one, so the
+//ends worked out in double already bound every row worked out in double.  exp(), log() and ^ aren't
+//rounded that exactly, by the standard library or by the batch kernels, so their ends are moved out by a
+//few units in the last place.  The answers of evaluate(), evaluateBatch<double>(), IncrementalProgram and
+//NativeCode are all inside the range; those of a program optimized with OptimizeOptions::relaxed, or
+//evaluated in float, may be just outside it.
+//
+//Division by a range which holds 0 gives everything, -infinity to infinity, where solve() would report
+//DivisionByZero at that division: a row may divide by zero, and then nothing is known about its answer.
+//Any row may give NaN where a function isn't defined for part of its range, 0 / 0, infinity - infinity
+//and so on; an Interval says whether it may be NaN as well as where its other values are.  A range which
+//may only be NaN, such as that of sqrt() of negative numbers, is given as everything and NaN.
+
+//NAME: Interval
+//DESCRIPTION:  Every value from lo to hi, ends included, and NaN as well if nan is set.  The ends may be
+//              infinite.  A single number is the interval from it to itself.
+struct Interval
+{
+    Interval() : lo(0), hi(0), nan(false) {}
+
+    Interval(double value) : lo(value), hi(value), nan(false)
+    {
+        if (std::isnan(value))
+            *this = everything(true);
+    }
+
+    Interval(double lo, double hi, bool nan = false) : lo(lo), hi(hi), nan(nan) {}
+
+    static Interval everything(bool nan)
+    {
+        return Interval(-std::numeric_limits<double>::infinity(), std::numeric_limits<double>::infinity(), nan);
+    }
+
+    bool contains(double value) const { return std::isnan(value) ? nan : lo <= value && value <= hi; }
+
+    double lo;
+    double hi;
+    bool nan;
+};
+
+//Function declarations
+Interval operator+(const Interval& first, const Interval& second);
+
+Interval operator-(const Interval& first, const Interval& second);
+
+Interval operator*(const Interval& first, const Interval& second);
+
+Interval operator/(const Interval& first, const Interval& second);
+
+Interval hull(const Interval& first, const Interval& second);
+
+Interval applyFunction(Function function, Interval first, Interval second);
+
+template <>
+Interval evaluate<Interval>(const Program& program, const Interval* variables);
+
+#endif
@@ -0,0 +1,575 @@
+#ifndef CALCULATOR_ITERATIVE_H
+#define CALCULATOR_ITERATIVE_H
+
+#include <memory>
+#include <new>
+
+#include "parser.h"
+
+//The recursive descent parser in parser.h costs three nested calls for every level of parentheses, so an
+//expression nested a few thousand levels deep can run a thread with a small stack out of room.
+//parseExpressionIterative() recognizes exactly the same grammar, calls the actions in exactly the same
+//order and reports the same errors, but with a single loop and a fixed size stack of its own.
+//
+//A level of parentheses only has to be remembered if something in it is waiting for the parentheses
+//to be finished, such as the 1 + in 1 + (2 * 3).  Levels which are opened before anything else in
+//their parent, as in ((((x)))) or -(-(-(y))), have nothing to remember but where they were opened and
+//whether they were negated, and both can be read back out of the expression itself when the level
+//closes.  Those levels cost nothing, so they can be nested as deep as anybody likes.
+//Only levels with an operator waiting use one of the kParseStackDepth frames; an expression which
+//needs more than that fails with ErrorCode::TooDeep instead of crashing.  The first kInlineParseFrames
+//of them are kept on the stack, which is all but the most deeply nested expressions need, and only an
+//expression which needs more moves them to the heap, so the parser needs no more than a couple of
+//kilobytes of a small thread stack.
+
+//Powers and function calls are levels too.  A power is opened by its ^ and lasts as long as the power
+//does, and a call by the parenthesis after the function's name; both always use a frame.  So does a
+//conditional: its ? opens a level for the first answer, which its : turns into the level of the other
+//one, and that lasts until whatever ends the level the conditional is in.  Comparisons, && and || wait
+//on the right hand side in the level they are in, like sums and products do.
+
+//How many levels of parentheses with an operator waiting on them can be open at once.
+static const int kParseStackDepth = 256;
+
+//How many of them are kept on the stack before they are moved to the heap.
+static const int kInlineParseFrames = 16;
+
+//NAME: LevelKind
+//DESCRIPTION:  What opened a level.
+enum class LevelKind : unsigned char
+{
+    Expression,     //The whole expression.
+    Parenthesis,
+    Call,           //The arguments of a function.
+    Power,          //What a base is raised to.
+    Then,           //The answer of a conditional if its condition holds, up to the :.
+    Otherwise,      //The answer if it doesn't.
+};
+
+//NAME: ParseLevel
+//DESCRIPTION:  One level of parentheses while it is being parsed: the sum, product, comparison, && and ||
+//              still waiting for their right hand side, where the level was opened and whether it is negated.
+//              The operators are '\0' and the positions of the others NULL when nothing is waiting.
+//              first is the base of a power, the first argument of a call once its comma has been found,
+//              or the condition of a conditional, whose first answer is in then once its : has been found.
+//              open is where a power starts or the ? of a conditional rather than a parenthesis, and NULL
+//              for the whole expression.
+template <typename Actions>
+struct ParseLevel
+{
+    typename Actions::Value sum;
+    typename Actions::Value product;
+    typename Actions::Value comparand;
+    typename Actions::Value conjunction;
+    typename Actions::Value disjunction;
+    typename Actions::Value disjunctionTrue;
+    typename Actions::Value first;
+    typename Actions::Value then;
+    const char* divisor;
+    const char* comparisonAt;
+    const char* conjunctionAt;
+    const char* disjunctionAt;
+    const char* open;
+    const char* name;
+    char sumOperator;
+    char productOperator;
+    LevelKind kind;
+    Function function;
+    Function comparison;
+    int arguments;
+    bool negative;
+
+    //A level can be opened without a frame if its parent is a parenthesis which hasn't seen anything yet.
+    bool isEmpty() const
+    {
+        return kind == LevelKind::Parenthesis && sumOperator == '\0' && productOperator == '\0' &&
+               comparisonAt == NULL && conjunctionAt == NULL && disjunctionAt == NULL;
+    }
+
+    void start(LevelKind levelKind, const char* at, bool isNegative)
+    {
+        kind = levelKind;
+        open = at;
+        negative = isNegative;
+        sumOperator = '\0';
+        productOperator = '\0';
+        comparisonAt = NULL;
+        conjunctionAt = NULL;
+        disjunctionAt = NULL;
+    }
+};
+
+//NAME: ParseFrame
+//DESCRIPTION:  A level which had to be set aside, and how many levels were opened without a frame on top of it.
+template <typename Actions>
+struct ParseFrame
+{
+    ParseLevel<Actions> level;
+    size_t hidden;
+};
+
+//NAME: ParseStack
+//DESCRIPTION:  The levels which had to be set aside, kept in frames on the stack until there are more
+//              than kInlineParseFrames of them and in kParseStackDepth frames on the heap from then on.
+template <typename Actions>
+struct ParseStack
+{
+    ParseStack() : frames(local), depth(0) {}
+
+    ParseStack(const ParseStack&) = delete;
+
+    ParseStack& operator=(const ParseStack&) = delete;
+
+    //NAME: push
+    //DESCRIPTION:  Sets a level aside.
+    //INPUT:
+    //    level  - The level.
+    //    hidden - How many levels were opened without a frame on top of it.
+    //OUTPUT:
+    //    none
+    //RETURNS:
+    //    ErrorCode::TooDeep if there are kParseStackDepth levels set aside already, ErrorCode::OutOfMemory
+    //    if there wasn't the memory to move them to the heap, and ErrorCode::None otherwise.
+    ErrorCode push(const ParseLevel<Actions>& level, size_t hidden)
+    {
+        if (depth == kParseStackDepth)
+            return ErrorCode::TooDeep;
+
+        if (depth == kInlineParseFrames && frames == local)
+        {
+            heap.reset(new (std::nothrow) ParseFrame<Actions>[kParseStackDepth]);
+            if (heap == NULL)
+                return ErrorCode::OutOfMemory;
+
+            for (int i = 0; i < depth; i++)
+                heap[i] = local[i];
+
+            frames = heap.get();
+        }
+
+        frames[depth].level = level;
+        frames[depth].hidden = hidden;
+        depth++;
+        return ErrorCode::None;
+    }
+
+    //NAME: pop
+    //DESCRIPTION:  Takes back the level set aside last.  There has to be one.
+    //INPUT:
+    //    none
+    //OUTPUT:
+    //    level  - The level.
+    //    hidden - How many levels were opened without a frame on top of it.
+    //RETURNS:
+    //    none
+    void pop(ParseLevel<Actions>& level, size_t& hidden)
+    {
+        assert(depth > 0);
+
+        depth--;
+        level = frames[depth].level;
+        hidden = frames[depth].hidden;
+    }
+
+    ParseFrame<Actions> local[kInlineParseFrames];
+    std::unique_ptr<ParseFrame<Actions>[]> heap;
+    ParseFrame<Actions>* frames;
+    int depth;
+};
+
+//NAME: isUnaryMinus
+//DESCRIPTION:  Checks to see if the '-' in front of an open parenthesis negates it, rather than subtracting
+//              it from what came before.  Like tokenizePower() it negates when it starts an operand: at the
+//              start of the expression, or after an operator, an open parenthesis or a comma.
+//INPUT:
+//    begin - The start of the expression.
+//    open  - The open parenthesis.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the parenthesis is negated.
+inline bool isUnaryMinus(const char* begin, const char* open)
+{
+    if (open == begin || open[-1] != '-')
+        return false;
+
+    const char* before = open - 1;
+    while (before > begin && isSpace(before[-1]))
+        before--;
+
+    return before == begin || isOperator(before[-1]) || before[-1] == '(' || before[-1] == ',';
+}
+
+//NAME: parseExpressionIterative
+//DESCRIPTION:  Parses a complete expression like parseExpression(), without recursion.
+//INPUT:
+//    eq  - The expression.
+//INPUT/OUTPUT:
+//    actions - What to do with the numbers and operators that are found.  Holds the error, if any.
+//RETURNS:
+//    The value of the expression.  Meaningless if actions.failed().
+template <typename Actions>
+typename Actions::Value parseExpressionIterative(const char* eq, Actions& actions)
+{
+    assert(eq != NULL);
+
+    const char* begin = eq;
+
+    ParseStack<Actions> stack;
+
+    //The level being parsed.  The whole expression is a level without an open parenthesis.
+    ParseLevel<Actions> level;
+    level.start(LevelKind::Expression, NULL, false);
+
+    //Levels opened without a frame since the last frame was pushed.
+    size_t hidden = 0;
+
+    typename Actions::Value value;
+    while (true)
+    {
+        //An operand: spaces, an optional minus sign and then a parenthesis, call, variable or number.
+        eq = skipSpaces(eq);
+
+        bool hasNegative = false;
+        if (*eq == '-')
+        {
+            hasNegative = true;
+            eq++;
+        }
+
+        const char* open = eq;
+        const char* name = NULL;
+        Function function = Function::Power;
+        if (isIdentifierStart(*eq))
+        {
+            const char* end = eq;
+            while (isIdentifierChar(*end))
+                end++;
+
+            open = skipSpaces(end);
+            if (*open != '(')
+                open = eq;
+            else if (findFunction(eq, end - eq, function))
+                name = eq;
+            else
+            {
+                actions.fail(ErrorCode::UnknownFunction, eq);
+                return actions.number(0);
+            }
+        }
+
+        if (*open == '(')
+        {
+            if (name == NULL && level.isEmpty())
+                hidden++;
+            else
+            {
+                ErrorCode pushed = stack.push(level, hidden);
+                if (pushed != ErrorCode::None)
+                {
+                    actions.fail(pushed, open);
+                    return actions.number(0);
+                }
+
+                hidden = 0;
+            }
+
+            level.start(name != NULL ? LevelKind::Call : LevelKind::Parenthesis, open, hasNegative);
+            level.name = name;
+            level.function = function;
+            level.arguments = 0;
+            eq = open + 1;
+            continue;
+        }
+
+        value = tokenizeLeaf(eq, actions);
+        if (actions.failed())
+            return value;
+
+        //The minus sign in front of the operand, which has to wait in case the operand is raised to a power.
+        bool negateNext = hasNegative;
+
+        //The operators after the operand, and the ends of any levels closed by it.
+        while (true)
+        {
+            eq = skipSpaces(eq);
+
+            if ((characterClass(*eq) & kPowerClass) != 0)
+            {
+                ErrorCode pushed = stack.push(level, hidden);
+                if (pushed != ErrorCode::None)
+                {
+                    actions.fail(pushed, eq);
+                    return actions.number(0);
+                }
+
+                hidden = 0;
+
+                eq++;
+                eq = skipSpaces(eq);
+
+                level.start(LevelKind::Power, eq, negateNext);
+                level.first = value;
+                break;
+            }
+
+            if (negateNext)
+            {
+                value = actions.negate(value);
+                negateNext = false;
+            }
+
+            //A power is over as soon as its operand is.
+            if (level.kind == LevelKind::Power)
+            {
+                value = actions.call(Function::Power, level.first, value, level.open);
+                if (actions.failed())
+                    return value;
+
+                negateNext = level.negative;
+                stack.pop(level, hidden);
+                continue;
+            }
+
+            if (level.productOperator != '\0')
+            {
+                if (level.productOperator == '*')
+                    value = actions.multiply(level.product, value);
+                else
+                    value = actions.divide(level.product, value, level.divisor);
+
+                level.productOperator = '\0';
+                if (actions.failed())
+                    return value;
+            }
+
+            if ((characterClass(*eq) & kProductClass) != 0)
+            {
+                level.product = value;
+                level.productOperator = *eq;
+                eq++;
+
+                eq = skipSpaces(eq);
+
+                level.divisor = eq;
+                break;
+            }
+
+            if (level.sumOperator != '\0')
+            {
+                if (level.sumOperator == '+')
+                    value = actions.add(level.sum, value);
+                else
+                    value = actions.subtract(level.sum, value);
+
+                level.sumOperator = '\0';
+            }
+
+            if ((characterClass(*eq) & kSumClass) != 0)
+            {
+                level.sum = value;
+                level.sumOperator = *eq;
+                eq++;
+                break;
+            }
+
+            if (level.comparisonAt != NULL)
+            {
+                value = actions.call(level.comparison, level.comparand, value, level.comparisonAt);
+                level.comparisonAt = NULL;
+                if (actions.failed())
+                    return value;
+            }
+
+            Function comparison = Function::Less;
+            int length = findComparison(eq, comparison);
+            if (length != 0)
+            {
+                level.comparand = value;
+                level.comparison = comparison;
+                level.comparisonAt = eq;
+                eq += length;
+                break;
+            }
+
+            //The conditionals standing for && and ||, see tokenizeAnd() and tokenizeOr().
+            if (level.conjunctionAt != NULL)
+            {
+                typename Actions::Value zero = actions.number(0);
+                typename Actions::Value truth = actions.call(Function::NotEqual, value, zero, level.conjunctionAt);
+                actions.beginElse(level.conjunction, truth);
+
+                typename Actions::Value otherwise = actions.number(0);
+                value = actions.endConditional(level.conjunction, truth, otherwise);
+                level.conjunctionAt = NULL;
+                if (actions.failed())
+                    return value;
+            }
+
+            if (eq[0] == '&' && eq[1] == '&')
+            {
+                level.conjunction = value;
+                level.conjunctionAt = eq;
+                eq += 2;
+
+                actions.beginThen(value);
+                break;
+            }
+
+            if (level.disjunctionAt != NULL)
+            {
+                typename Actions::Value zero = actions.number(0);
+                typename Actions::Value truth = actions.call(Function::NotEqual, value, zero, level.disjunctionAt);
+                value = actions.endConditional(level.disjunction, level.disjunctionTrue, truth);
+                level.disjunctionAt = NULL;
+                if (actions.failed())
+                    return value;
+            }
+
+            if (eq[0] == '|' && eq[1] == '|')
+            {
+                level.disjunction = value;
+                level.disjunctionAt = eq;
+                eq += 2;
+
+                actions.beginThen(value);
+                level.disjunctionTrue = actions.number(1);
+                actions.beginElse(value, level.disjunctionTrue);
+                break;
+            }
+
+            if (*eq == '?')
+            {
+                ErrorCode pushed = stack.push(level, hidden);
+                if (pushed != ErrorCode::None)
+                {
+                    actions.fail(pushed, eq);
+                    return actions.number(0);
+                }
+
+                hidden = 0;
+
+                actions.beginThen(value);
+                level.start(LevelKind::Then, eq, false);
+                level.first = value;
+                eq++;
+                break;
+            }
+
+            //The first answer of a conditional ends at its :, the other one with the level around it.
+            if (level.kind == LevelKind::Then)
+            {
+                if (*eq != ':')
+                {
+                    actions.fail(ErrorCode::UnmatchedConditional, level.open);
+                    return value;
+                }
+
+                eq++;
+                actions.beginElse(level.first, value);
+                level.start(LevelKind::Otherwise, level.open, false);
+                level.then = value;
+                break;
+            }
+
+            if (level.kind == LevelKind::Otherwise)
+            {
+                value = actions.endConditional(level.first, level.then, value);
+                if (actions.failed())
+                    return value;
+
+                stack.pop(level, hidden);
+                continue;
+            }
+
+            //The level is over.  Anything but a closing parenthesis means it was never closed.
+            if (level.kind == LevelKind::Expression)
+            {
+                if (*eq == ')')
+                    actions.fail(ErrorCode::UnmatchedParenthesis, eq);
+                else if (*eq != '\0')
+                    actions.fail(ErrorCode::UnexpectedCharacter, eq);
+
+                return value;
+            }
+
+            if (level.kind == LevelKind::Call)
+            {
+                //The comma between two arguments starts the next one, any other comma is one too many.
+                const int wanted = functionArguments(level.function);
+                if (*eq == ',' && level.arguments + 1 < wanted)
+                {
+                    level.first = value;
+                    level.arguments++;
+                    eq++;
+                    break;
+                }
+
+                if (*eq == ',' || (*eq == ')' && level.arguments + 1 < wanted))
+                {
+                    actions.fail(ErrorCode::ArgumentCount, eq);
+                    return value;
+                }
+            }
+
+            if (*eq != ')')
+            {
+                actions.fail(ErrorCode::UnmatchedParenthesis, level.open);
+                return value;
+            }
+
+            eq++;
+            negateNext = level.negative;
+
+            if (level.kind == LevelKind::Call)
+            {
+                if (functionArguments(level.function) == 2)
+                    value = actions.call(level.function, level.first, value, level.name);
+                else
+                    value = actions.call(level.function, value, level.name);
+
+                if (actions.failed())
+                    return value;
+            }
+
+            if (hidden > 0)
+            {
+                //The parent was opened right before this level with nothing but spaces in between.
+                const char* parent = level.open - (level.negative ? 2 : 1);
+                while (isSpace(*parent))
+                    parent--;
+
+                hidden--;
+                level.start(LevelKind::Parenthesis, parent, isUnaryMinus(begin, parent));
+            }
+            else
+            {
+                stack.pop(level, hidden);
+            }
+        }
+    }
+}
+
+//NAME: solveIterative
+//DESCRIPTION:  solve() without recursion, for expressions which may be nested very deeply.
+//INPUT:
+//    eq        - The expression to evaluate.
+//    variables - The values of the variables the expression uses, NULL if there are none.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The answer, or the error and where in eq it was found.
+template <typename T = double>
+Result<T> solveIterative(const char* eq, const VariableTable* variables = NULL)
+{
+    Evaluator<T> evaluator(variables);
+    T answer = parseExpressionIterative(eq, evaluator);
+
+    Result<T> result;
+    result.value = answer;
+    result.error = evaluator.error;
+    result.offset = evaluator.failed() ? (int)(evaluator.errorAt - eq) : 0;
+    return result;
+}
+
+#endif
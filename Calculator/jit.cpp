@@ -0,0 +1,486 @@
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "jit.h"
+
+#if defined(CALC_JIT_X64)
+
+//The two pointers a NativeFunction is called with arrive in different registers on Windows and
+//everywhere else, and Windows expects xmm6 and up to be preserved, so those aren't used there.
+#if defined(_WIN32)
+static const int kVariablesRegister = 1;    //rcx
+static const int kSpillRegister = 2;        //rdx
+static const int kXmmRegisters = 6;
+#else
+static const int kVariablesRegister = 7;    //rdi
+static const int kSpillRegister = 6;        //rsi
+static const int kXmmRegisters = 16;
+#endif
+
+//NAME: Location
+//DESCRIPTION:  Where the value of one register of the program can be found while the code is generated.
+struct Location
+{
+    enum Kind { Constant, Variable, Xmm, Spill };
+
+    Kind kind;
+    int index;
+};
+
+//NAME: X64Emitter
+//DESCRIPTION:  Encodes the handful of SSE2 instructions the generated code uses.
+//              Operands are either an xmm register or a Location in memory.  Constants are addressed
+//              relative to the instruction, so their offsets are filled in once the code is complete
+//              and the constant pool is placed after it.
+class X64Emitter
+{
+public:
+    void movsdLoad(int xmm, const Location& from) { operation(0xF2, 0x10, xmm, from); }
+
+    void movsdStore(const Location& to, int xmm) { operation(0xF2, 0x11, xmm, to); }
+
+    void movapd(int xmm, int from) { operation(0x66, 0x28, xmm, xmmLocation(from)); }
+
+    void operation(unsigned char prefix, unsigned char opcode, int xmm, const Location& operand);
+
+    void ret() { code.push_back(0xC3); }
+
+    int constant(double value);
+
+    bool finish(const std::vector<double>& programConstants, std::vector<unsigned char>& out);
+
+    static Location xmmLocation(int xmm) { Location location = { Location::Xmm, xmm }; return location; }
+
+private:
+    void displacement(int value);
+
+    std::vector<unsigned char> code;
+    std::vector<double> extraConstants;
+    std::vector<std::pair<size_t, int> > fixups;
+};
+
+//NAME: X64Emitter::operation
+//DESCRIPTION:  Emits prefix 0F opcode with an xmm register and a register or memory operand.
+void X64Emitter::operation(unsigned char prefix, unsigned char opcode, int xmm, const Location& operand)
+{
+    int base = 0;
+    if (operand.kind == Location::Xmm)
+        base = operand.index;
+    else if (operand.kind == Location::Variable)
+        base = kVariablesRegister;
+    else if (operand.kind == Location::Spill)
+        base = kSpillRegister;
+
+    code.push_back(prefix);
+
+    unsigned char rex = (unsigned char)(0x40 | ((xmm >> 3) << 2) | (base >> 3));
+    if (rex != 0x40)
+        code.push_back(rex);
+
+    code.push_back(0x0F);
+    code.push_back(opcode);
+
+    unsigned char reg = (unsigned char)((xmm & 7) << 3);
+    switch (operand.kind)
+    {
+    case Location::Xmm:
+        code.push_back((unsigned char)(0xC0 | reg | (base & 7)));
+        break;
+
+    case Location::Constant:
+        //[rip + displacement], counted from the end of the instruction.
+        code.push_back((unsigned char)(0x05 | reg));
+        fixups.push_back(std::make_pair(code.size(), operand.index));
+        displacement(0);
+        break;
+
+    default:
+    {
+        //[base + offset].  None of the base registers used need a SIB byte.
+        int offset = operand.index * (int)sizeof(double);
+        if (offset < 128)
+        {
+            code.push_back((unsigned char)(0x40 | reg | (base & 7)));
+            code.push_back((unsigned char)offset);
+        }
+        else
+        {
+            code.push_back((unsigned char)(0x80 | reg | (base & 7)));
+            displacement(offset);
+        }
+        break;
+    }
+    }
+}
+
+//NAME: X64Emitter::displacement
+//DESCRIPTION:  Appends a 32 bit little endian value.
+void X64Emitter::displacement(int value)
+{
+    for (int i = 0; i < 4; i++)
+        code.push_back((unsigned char)((unsigned)value >> (8 * i)));
+}
+
+//NAME: X64Emitter::constant
+//DESCRIPTION:  A constant the program itself doesn't have, such as the -1 negation multiplies by.
+//              Its index follows those of the program's own constants, see finish().
+int X64Emitter::constant(double value)
+{
+    extraConstants.push_back(value);
+    return -(int)extraConstants.size();
+}
+
+//NAME: X64Emitter::finish
+//DESCRIPTION:  Places the constant pool after the code and fills in the offsets of every constant.
+//INPUT:
+//    programConstants - The constant pool of the program.
+//OUTPUT:
+//    out              - The code followed by the constants.
+//RETURNS:
+//    False if the code is too large to address its constants.
+bool X64Emitter::finish(const std::vector<double>& programConstants, std::vector<unsigned char>& out)
+{
+    out = code;
+    while (out.size() % sizeof(double) != 0)
+        out.push_back(0xCC);
+
+    size_t pool = out.size();
+    size_t extra = pool + programConstants.size() * sizeof(double);
+    out.resize(extra + extraConstants.size() * sizeof(double));
+    if (!programConstants.empty())
+        memcpy(&out[pool], programConstants.data(), programConstants.size() * sizeof(double));
+    if (!extraConstants.empty())
+        memcpy(&out[extra], extraConstants.data(), extraConstants.size() * sizeof(double));
+
+    if (out.size() > 0x7FFFFFFF)
+        return false;
+
+    for (size_t i = 0; i < fixups.size(); i++)
+    {
+        size_t at = fixups[i].first;
+        int index = fixups[i].second;
+        size_t target = index >= 0 ? pool + index * sizeof(double) : extra + (-index - 1) * sizeof(double);
+
+        int value = (int)(target - (at + 4));
+        for (int b = 0; b < 4; b++)
+            out[at + b] = (unsigned char)((unsigned)value >> (8 * b));
+    }
+
+    return true;
+}
+
+//NAME: generate
+//DESCRIPTION:  Translates a program into x86-64 machine code, see jit.h.
+//INPUT:
+//    program - A program which compiled.
+//OUTPUT:
+//    out     - The code and its constants.
+//    spills  - How many values the code may store in the spill area.
+//RETURNS:
+//    False if the program can't be translated.
+static bool generate(const Program& program, std::vector<unsigned char>& out, int& spills)
+{
+    const int count = (int)program.code.size();
+
+    //The last instruction reading each register; the answer is needed until the very end.
+    //Powers, exp(), log() and abs() would need calls or constants of their own, and comparisons and conditionals
+    //code that isn't a straight run, so they are left to evaluate().
+    std::vector<int> lastUse(count, -1);
+    for (int i = 0; i < count; i++)
+    {
+        const Instruction& in = program.code[i];
+        if (in.op == OpCode::Constant || in.op == OpCode::Variable)
+            continue;
+        if (in.op == OpCode::Power || in.op == OpCode::Exp || in.op == OpCode::Log || in.op >= OpCode::Abs)
+            return false;
+
+        lastUse[in.lhs] = i;
+        if (!isUnary(in.op))
+            lastUse[in.rhs] = i;
+    }
+    lastUse[count - 1] = count;
+
+    X64Emitter emit;
+    std::vector<Location> where(count);
+    int owner[kXmmRegisters];
+    for (int x = 0; x < kXmmRegisters; x++)
+        owner[x] = -1;
+
+    int minusOne = -1;
+    spills = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        const Instruction& in = program.code[i];
+        if (in.op == OpCode::Constant || in.op == OpCode::Variable)
+        {
+            where[i].kind = in.op == OpCode::Constant ? Location::Constant : Location::Variable;
+            where[i].index = in.lhs;
+            continue;
+        }
+
+        //Negation is multiplication by -1, exactly like evaluate(), so NaNs come out the same.
+        //minsd and maxsd are exactly min() and max() of functions.h, NaNs included.
+        unsigned char opcode;
+        int lhs = in.lhs;
+        int other = -1;
+        Location rhs;
+        switch (in.op)
+        {
+        case OpCode::Add:      opcode = 0x58; break;
+        case OpCode::Subtract: opcode = 0x5C; break;
+        case OpCode::Divide:   opcode = 0x5E; break;
+        case OpCode::Min:      opcode = 0x5D; break;
+        case OpCode::Max:      opcode = 0x5F; break;
+        case OpCode::Sqrt:     opcode = 0x51; break;
+        default:               opcode = 0x59; break;
+        }
+
+        if (in.op == OpCode::Negate)
+        {
+            if (minusOne < 0)
+                minusOne = emit.constant(-1);
+
+            rhs.kind = Location::Constant;
+            rhs.index = minusOne;
+        }
+        else if (in.op == OpCode::Sqrt)
+        {
+            //sqrtsd only reads its source, so the operand stays where it is.
+            rhs = where[lhs];
+        }
+        else
+        {
+            //Addition and multiplication can overwrite whichever operand isn't needed any more.
+            bool commutes = in.op == OpCode::Add || in.op == OpCode::Multiply;
+            other = in.rhs;
+            bool lhsFree = where[lhs].kind == Location::Xmm && lastUse[lhs] == i;
+            bool rhsFree = where[other].kind == Location::Xmm && lastUse[other] == i;
+            if (commutes && !lhsFree && rhsFree)
+                std::swap(lhs, other);
+
+            rhs = where[other];
+        }
+
+        //The result goes into lhs's register if lhs isn't needed after this, otherwise into a new one.
+        int target;
+        if (where[lhs].kind == Location::Xmm && lastUse[lhs] == i)
+            target = where[lhs].index;
+        else
+        {
+            target = -1;
+            for (int x = 0; x < kXmmRegisters && target < 0; x++)
+            {
+                if (owner[x] < 0)
+                    target = x;
+            }
+
+            if (target < 0)
+            {
+                //Spill whatever is needed furthest in the future, except the operands.
+                for (int x = 0; x < kXmmRegisters; x++)
+                {
+                    bool isOperand = (where[lhs].kind == Location::Xmm && where[lhs].index == x) ||
+                                     (rhs.kind == Location::Xmm && rhs.index == x);
+                    if (!isOperand && (target < 0 || lastUse[owner[x]] > lastUse[owner[target]]))
+                        target = x;
+                }
+
+                Location spill = { Location::Spill, spills++ };
+                emit.movsdStore(spill, target);
+                where[owner[target]] = spill;
+                owner[target] = -1;
+            }
+
+            if (where[lhs].kind == Location::Xmm)
+                emit.movapd(target, where[lhs].index);
+            else
+                emit.movsdLoad(target, where[lhs]);
+        }
+
+        emit.operation(0xF2, opcode, target, rhs);
+
+        //Registers read for the last time are free again.
+        if (where[lhs].kind == Location::Xmm && lastUse[lhs] == i)
+            owner[where[lhs].index] = -1;
+        if (other >= 0 && where[other].kind == Location::Xmm && lastUse[other] == i)
+            owner[where[other].index] = -1;
+
+        owner[target] = i;
+        where[i] = X64Emitter::xmmLocation(target);
+
+        //Nothing reads a register optimize() would have removed.
+        if (lastUse[i] < 0)
+            owner[target] = -1;
+    }
+
+    const Location& answer = where[count - 1];
+    if (answer.kind != Location::Xmm)
+        emit.movsdLoad(0, answer);
+    else if (answer.index != 0)
+        emit.movapd(0, answer.index);
+    emit.ret();
+
+    return emit.finish(program.constants, out);
+}
+
+#endif
+
+//NAME: jitSupported
+//DESCRIPTION:  Checks to see if programs can be compiled to machine code on this platform.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if NativeCode::compile() can succeed.
+bool jitSupported()
+{
+#if defined(CALC_JIT_X64)
+    return true;
+#else
+    return false;
+#endif
+}
+
+//NAME: NativeCode::compile
+//DESCRIPTION:  Translates a program into machine code and makes it executable.  The memory is only ever
+//              writable or executable, never both.
+//INPUT:
+//    program - The program from compile(), optimized or not.
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if the program failed to compile, the platform isn't supported or the memory couldn't be had.
+bool NativeCode::compile(const Program& program)
+{
+    release();
+    if (!program.ok() || program.code.empty())
+        return false;
+
+#if defined(CALC_JIT_X64)
+    std::vector<unsigned char> bytes;
+    int spillCount;
+    if (!generate(program, bytes, spillCount))
+        return false;
+
+#if defined(_WIN32)
+    void* block = VirtualAlloc(NULL, bytes.size(), MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (block == NULL)
+        return false;
+
+    memcpy(block, bytes.data(), bytes.size());
+    DWORD previous;
+    if (!VirtualProtect(block, bytes.size(), PAGE_EXECUTE_READ, &previous))
+    {
+        VirtualFree(block, 0, MEM_RELEASE);
+        return false;
+    }
+
+    FlushInstructionCache(GetCurrentProcess(), block, bytes.size());
+#else
+    void* block = mmap(NULL, bytes.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+        return false;
+
+    memcpy(block, bytes.data(), bytes.size());
+    if (mprotect(block, bytes.size(), PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(block, bytes.size());
+        return false;
+    }
+#endif
+
+    memory = block;
+    length = bytes.size();
+    entry = (NativeFunction)block;
+    spills = spillCount;
+    return true;
+#else
+    return false;
+#endif
+}
+
+//NAME: NativeCode::release
+//DESCRIPTION:  Frees the code, if there is any.
+void NativeCode::release()
+{
+    if (memory != NULL)
+    {
+#if defined(_WIN32)
+        VirtualFree(memory, 0, MEM_RELEASE);
+#else
+        munmap(memory, length);
+#endif
+    }
+
+    memory = NULL;
+    length = 0;
+    entry = NULL;
+    spills = 0;
+}
+
+//NAME: HotProgram::HotProgram
+//DESCRIPTION:  Starts out interpreting a program.
+//INPUT:
+//    program   - The program from compile().  It is copied.
+//    threshold - How many evaluations before it is compiled to machine code; 0 compiles it right away.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+HotProgram::HotProgram(const Program& program, uint64_t threshold) :
+    source(program), threshold(threshold), evaluations(0), native(NULL)
+{
+    if (threshold == 0)
+        promote();
+}
+
+//NAME: HotProgram::evaluate
+//DESCRIPTION:  Evaluates the program, as machine code once it has become hot.
+//INPUT:
+//    variables - The value of every slot the program reads.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The same answer as evaluate<double>().
+double HotProgram::evaluate(const double* variables)
+{
+    NativeFunction function = native.load(std::memory_order_acquire);
+    if (function == NULL)
+    {
+        //Exactly one caller sees the count reach the threshold, and that one compiles the program.
+        if (evaluations.fetch_add(1, std::memory_order_relaxed) + 1 == threshold)
+            promote();
+
+        return ::evaluate(source, variables);
+    }
+
+    double inlineSpill[kInlineRegisters];
+    std::vector<double> heapSpill;
+
+    double* spill = inlineSpill;
+    if (code.spillCount() > kInlineRegisters)
+    {
+        heapSpill.resize(code.spillCount());
+        spill = heapSpill.data();
+    }
+
+    return function(variables, spill);
+}
+
+//NAME: HotProgram::promote
+//DESCRIPTION:  Compiles the program to machine code.  If that fails it stays interpreted.
+void HotProgram::promote()
+{
+    if (code.compile(source))
+        native.store(code.function(), std::memory_order_release);
+}
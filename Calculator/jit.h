@@ -0,0 +1,108 @@
+#ifndef CALCULATOR_JIT_H
+#define CALCULATOR_JIT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "compiler.h"
+
+//evaluate() spends most of its time deciding what to do next: loading the instruction, jumping through
+//the switch and fetching the operands out of the register array.  A formula evaluated billions of times
+//can skip all of that by being translated once more, into machine code for the processor it runs on.
+//NativeCode turns a Program into a function which is nothing but a straight run of SSE2 instructions:
+//     price * qty * (1 - rate)
+//
+//     movsd  xmm0, [variables + 0]
+//     mulsd  xmm0, [variables + 8]
+//     movsd  xmm1, [constant 1]
+//     subsd  xmm1, [variables + 16]
+//     mulsd  xmm0, xmm1
+//     ret
+//Constants and variables are read straight from memory by the instructions that use them.  Every other
+//register of the program lives in an xmm register from the instruction that writes it to the last one
+//that reads it, so xmm registers are reused as the program goes.  When more values are alive at once than
+//there are xmm registers, the one needed furthest in the future is stored in a spill area the caller
+//provides, which keeps the function from touching the stack at all.
+//The answers are bit for bit those of evaluate<double>(), negation included: it multiplies by -1 too.
+//sqrt(), min() and max() are single instructions as well; a program raising to a power, calling exp(),
+//log() or abs(), or comparing or choosing between answers can't be translated and stays with evaluate().
+//
+//Only x86-64 is supported, on Windows and elsewhere; everywhere else, or with CALC_NO_JIT defined,
+//NativeCode::compile() just returns false.
+//
+//HotProgram decides when that is worth it.  Generating code costs about as much as a few thousand
+//evaluations, so a program is interpreted until it has been evaluated a given number of times and only
+//then compiled to machine code.  If that isn't possible it simply keeps interpreting.
+
+#if (defined(_M_X64) || defined(__x86_64__)) && !defined(CALC_NO_JIT)
+#define CALC_JIT_X64 1
+#endif
+
+//How many evaluations it takes for a HotProgram to be compiled to machine code.
+static const uint64_t kDefaultJitThreshold = 1000;
+
+//NAME: NativeFunction
+//DESCRIPTION:  A program compiled to machine code.  spill must have room for NativeCode::spillCount() values.
+typedef double (*NativeFunction)(const double* variables, double* spill);
+
+//NAME: NativeCode
+//DESCRIPTION:  The executable memory holding one compiled program.
+class NativeCode
+{
+public:
+    NativeCode() : memory(NULL), length(0), entry(NULL), spills(0) {}
+
+    ~NativeCode() { release(); }
+
+    NativeCode(const NativeCode&) = delete;
+
+    NativeCode& operator=(const NativeCode&) = delete;
+
+    bool compile(const Program& program);
+
+    void release();
+
+    NativeFunction function() const { return entry; }
+
+    int spillCount() const { return spills; }
+
+private:
+    void* memory;
+    size_t length;
+    NativeFunction entry;
+    int spills;
+};
+
+//NAME: HotProgram
+//DESCRIPTION:  A program which is interpreted until it is used often enough, then run as machine code.
+//              evaluate() may be called from any number of threads at once.
+class HotProgram
+{
+public:
+    explicit HotProgram(const Program& program, uint64_t threshold = kDefaultJitThreshold);
+
+    HotProgram(const HotProgram&) = delete;
+
+    HotProgram& operator=(const HotProgram&) = delete;
+
+    double evaluate(const double* variables = NULL);
+
+    bool isNative() const { return native.load(std::memory_order_acquire) != NULL; }
+
+    const Program& program() const { return source; }
+
+private:
+    void promote();
+
+    Program source;
+    uint64_t threshold;
+    std::atomic<uint64_t> evaluations;
+    std::atomic<NativeFunction> native;
+    NativeCode code;
+};
+
+//Function declarations
+bool jitSupported();
+
+#endif
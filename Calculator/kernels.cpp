@@ -0,0 +1,1105 @@
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "kernels.h"
+
+#if defined(CALC_X86)
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+#if defined(CALC_NEON)
+#include <arm_neon.h>
+#endif
+
+//MSVC lets any function use any intrinsic, GCC and Clang want to be told which functions may.
+#if defined(_MSC_VER) && !defined(__clang__)
+#define CALC_TARGET(isa)
+#else
+#define CALC_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+//The plain C++ loops.  These always work and also finish the lanes left over by the vector loops.
+template <typename T>
+static void scalarNegate(const T* a, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = a[i] * -1;
+}
+
+#define CALC_SCALAR_BINARY(name, op)                                          \
+template <typename T>                                                         \
+static void name(const T* a, const T* b, T* out, size_t count)                \
+{                                                                             \
+    for (size_t i = 0; i < count; i++)                                        \
+        out[i] = a[i] op b[i];                                                \
+}
+
+CALC_SCALAR_BINARY(scalarAdd, +)
+CALC_SCALAR_BINARY(scalarSubtract, -)
+CALC_SCALAR_BINARY(scalarMultiply, *)
+CALC_SCALAR_BINARY(scalarDivide, /)
+
+//min() and max() exactly as functions.h has them, which is also what minps and maxps do.
+template <typename T>
+static inline T laneMin(T a, T b)
+{
+    return a < b ? a : b;
+}
+
+template <typename T>
+static inline T laneMax(T a, T b)
+{
+    return a > b ? a : b;
+}
+
+template <typename T>
+static void scalarMin(const T* a, const T* b, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = laneMin(a[i], b[i]);
+}
+
+template <typename T>
+static void scalarMax(const T* a, const T* b, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = laneMax(a[i], b[i]);
+}
+
+//Comparisons give 1 where they hold and 0 where they don't, exactly as applyFunction() does.
+#define CALC_SCALAR_COMPARE(name, op)                                         \
+template <typename T>                                                         \
+static void name(const T* a, const T* b, T* out, size_t count)                \
+{                                                                             \
+    for (size_t i = 0; i < count; i++)                                        \
+        out[i] = a[i] op b[i] ? T(1) : T(0);                                  \
+}
+
+CALC_SCALAR_COMPARE(scalarLess, <)
+CALC_SCALAR_COMPARE(scalarLessEqual, <=)
+CALC_SCALAR_COMPARE(scalarGreater, >)
+CALC_SCALAR_COMPARE(scalarGreaterEqual, >=)
+CALC_SCALAR_COMPARE(scalarEqual, ==)
+CALC_SCALAR_COMPARE(scalarNotEqual, !=)
+
+template <typename T>
+static void scalarSelect(const T* condition, const T* a, const T* b, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = condition[i] != 0 ? a[i] : b[i];
+}
+
+template <typename T>
+static void scalarPower(const T* a, const T* b, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = std::pow(a[i], b[i]);
+}
+
+template <typename T>
+static void scalarSqrt(const T* a, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = std::sqrt(a[i]);
+}
+
+template <typename T>
+static void scalarAbs(const T* a, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        out[i] = std::fabs(a[i]);
+}
+
+//exp() and log() are approximated with polynomials, the same way fdlibm does it, one lane at a time
+//here and several at a time in the vector loops.  They are written once, with the operations they need
+//as macros whose names start with P: the vector loops define those for their intrinsics, and the plain
+//C++ ones below just do the arithmetic.  Each lane is worked on as an integer as well as a number, to
+//take a number apart into its exponent and mantissa or to make a power of two.
+//    P_LOAD(p), P_STORE(p, v)   - Read and write lanes.
+//    P_SET(c)                   - Every lane c.
+//    P_ADD, P_SUB, P_MUL, P_DIV - Arithmetic.
+//    P_MIN, P_MAX               - Anything for NaNs, they are dealt with separately.
+//    P_EQ, P_LT                 - Comparisons giving a mask, P_SELECT(mask, a, b) picks a where it is set.
+//                                 The comparison kernels also use P_LE, P_GT, P_GE and P_NE, and P_TRUTH(mask),
+//                                 which is 1 where the mask is set and 0 where it isn't.
+//    P_IADD, P_IAND, P_IOR      - Integer arithmetic on the bits of every lane, with a constant.
+//    P_ISHL, P_ISHR             - Logical shifts of the bits of every lane.
+//Their arguments are expressions of their own, so every intermediate value is named; the macros are
+//only ever called with those names and constants.
+template <typename T>
+using LaneBits = std::conditional_t<sizeof(T) == 8, uint64_t, uint32_t>;
+
+template <typename T>
+static inline T laneIntegerAdd(T v, LaneBits<T> c)
+{
+    return std::bit_cast<T>((LaneBits<T>)(std::bit_cast<LaneBits<T>>(v) + c));
+}
+
+template <typename T>
+static inline T laneAnd(T v, LaneBits<T> c)
+{
+    return std::bit_cast<T>((LaneBits<T>)(std::bit_cast<LaneBits<T>>(v) & c));
+}
+
+template <typename T>
+static inline T laneOr(T v, LaneBits<T> c)
+{
+    return std::bit_cast<T>((LaneBits<T>)(std::bit_cast<LaneBits<T>>(v) | c));
+}
+
+template <typename T>
+static inline T laneShiftLeft(T v, int bits)
+{
+    return std::bit_cast<T>((LaneBits<T>)(std::bit_cast<LaneBits<T>>(v) << bits));
+}
+
+template <typename T>
+static inline T laneShiftRight(T v, int bits)
+{
+    return std::bit_cast<T>((LaneBits<T>)(std::bit_cast<LaneBits<T>>(v) >> bits));
+}
+
+#define CALC_SCALAR_LOAD(p)             (*(p))
+#define CALC_SCALAR_STORE(p, v)         (*(p) = (v))
+#define CALC_SCALAR_SET(c)              (c)
+#define CALC_SCALAR_ADD(a, b)           ((a) + (b))
+#define CALC_SCALAR_SUB(a, b)           ((a) - (b))
+#define CALC_SCALAR_MUL(a, b)           ((a) * (b))
+#define CALC_SCALAR_DIV(a, b)           ((a) / (b))
+#define CALC_SCALAR_MIN(a, b)           laneMin(a, b)
+#define CALC_SCALAR_MAX(a, b)           laneMax(a, b)
+#define CALC_SCALAR_EQ(a, b)            ((a) == (b))
+#define CALC_SCALAR_LT(a, b)            ((a) < (b))
+#define CALC_SCALAR_SELECT(mask, a, b)  ((mask) ? (a) : (b))
+#define CALC_SCALAR_IADD(v, c)          laneIntegerAdd(v, c)
+#define CALC_SCALAR_IAND(v, c)          laneAnd(v, c)
+#define CALC_SCALAR_IOR(v, c)           laneOr(v, c)
+#define CALC_SCALAR_ISHL(v, bits)       laneShiftLeft(v, bits)
+#define CALC_SCALAR_ISHR(v, bits)       laneShiftRight(v, bits)
+
+//NAME: CALC_EXP_PD
+//DESCRIPTION:  result = exp(x) for doubles.  x = k ln2 + r with |r| <= ln2 / 2, exp(r) from fdlibm's
+//              polynomial, and 2^k made straight from its bits in two halves, so that results which are
+//              denormal are rounded only once.  NaN stays NaN, and x is clamped to where exp() over- or
+//              underflows anyway.
+#define CALC_EXP_PD(P, vector, mask, x, result)                                                             \
+{                                                                                                           \
+    const mask isNumber = P##_EQ(x, x);                                                                     \
+    const vector clamped = P##_MIN(P##_MAX(x, P##_SET(-746.0)), P##_SET(710.0));                            \
+    const vector scaled = P##_MUL(clamped, P##_SET(1.44269504088896338700e+00));                            \
+    const vector k = P##_SUB(P##_ADD(scaled, P##_SET(0x1.8p52)), P##_SET(0x1.8p52));                        \
+    const vector hi = P##_SUB(clamped, P##_MUL(k, P##_SET(6.93147180369123816490e-01)));                    \
+    const vector lo = P##_MUL(k, P##_SET(1.90821492927058770002e-10));                                      \
+    const vector r = P##_SUB(hi, lo);                                                                       \
+    const vector t = P##_MUL(r, r);                                                                         \
+    const vector p5 = P##_MUL(t, P##_SET(4.13813679705723846039e-08));                                      \
+    const vector p4 = P##_MUL(t, P##_ADD(P##_SET(-1.65339022054652515390e-06), p5));                        \
+    const vector p3 = P##_MUL(t, P##_ADD(P##_SET(6.61375632143793436117e-05), p4));                         \
+    const vector p2 = P##_MUL(t, P##_ADD(P##_SET(-2.77777777770155933842e-03), p3));                        \
+    const vector c = P##_SUB(r, P##_MUL(t, P##_ADD(P##_SET(1.66666666666666019037e-01), p2)));              \
+    const vector quotient = P##_DIV(P##_MUL(r, c), P##_SUB(P##_SET(2.0), c));                               \
+    const vector estimate = P##_SUB(P##_SET(1.0), P##_SUB(P##_SUB(lo, quotient), hi));                      \
+    const vector half = P##_MUL(k, P##_SET(0.5));                                                           \
+    const vector k1 = P##_SUB(P##_ADD(P##_SUB(half, P##_SET(0.25)), P##_SET(0x1.8p52)), P##_SET(0x1.8p52)); \
+    const vector k2 = P##_SUB(k, k1);                                                                       \
+    const vector scale1 = P##_ISHL(P##_ADD(k1, P##_SET(0x1.8p52 + 1023.0)), 52);                            \
+    const vector scale2 = P##_ISHL(P##_ADD(k2, P##_SET(0x1.8p52 + 1023.0)), 52);                            \
+    const vector scaled1 = P##_MUL(estimate, scale1);                                                       \
+    result = P##_SELECT(isNumber, P##_MUL(scaled1, scale2), P##_ADD(x, x));                                 \
+}
+
+//NAME: CALC_EXP_PS
+//DESCRIPTION:  result = exp(x) for floats, like CALC_EXP_PD with the polynomial of FreeBSD's expf().
+#define CALC_EXP_PS(P, vector, mask, x, result)                                                                \
+{                                                                                                              \
+    const mask isNumber = P##_EQ(x, x);                                                                        \
+    const vector clamped = P##_MIN(P##_MAX(x, P##_SET(-104.0f)), P##_SET(89.0f));                              \
+    const vector scaled = P##_MUL(clamped, P##_SET(1.4426950216e+00f));                                        \
+    const vector k = P##_SUB(P##_ADD(scaled, P##_SET(0x1.8p23f)), P##_SET(0x1.8p23f));                         \
+    const vector hi = P##_SUB(clamped, P##_MUL(k, P##_SET(6.9314575195e-01f)));                                \
+    const vector lo = P##_MUL(k, P##_SET(1.4286067653e-06f));                                                  \
+    const vector r = P##_SUB(hi, lo);                                                                          \
+    const vector t = P##_MUL(r, r);                                                                            \
+    const vector p2 = P##_MUL(t, P##_SET(-2.7667332906e-3f));                                                  \
+    const vector c = P##_SUB(r, P##_MUL(t, P##_ADD(P##_SET(1.6666625440e-1f), p2)));                           \
+    const vector quotient = P##_DIV(P##_MUL(r, c), P##_SUB(P##_SET(2.0f), c));                                 \
+    const vector estimate = P##_SUB(P##_SET(1.0f), P##_SUB(P##_SUB(lo, quotient), hi));                        \
+    const vector half = P##_MUL(k, P##_SET(0.5f));                                                             \
+    const vector k1 = P##_SUB(P##_ADD(P##_SUB(half, P##_SET(0.25f)), P##_SET(0x1.8p23f)), P##_SET(0x1.8p23f)); \
+    const vector k2 = P##_SUB(k, k1);                                                                          \
+    const vector scale1 = P##_ISHL(P##_ADD(k1, P##_SET(0x1.8p23f + 127.0f)), 23);                              \
+    const vector scale2 = P##_ISHL(P##_ADD(k2, P##_SET(0x1.8p23f + 127.0f)), 23);                              \
+    const vector scaled1 = P##_MUL(estimate, scale1);                                                          \
+    result = P##_SELECT(isNumber, P##_MUL(scaled1, scale2), P##_ADD(x, x));                                    \
+}
+
+//NAME: CALC_LOG_PD
+//DESCRIPTION:  result = log(x) for doubles.  x = 2^k m with sqrt(2)/2 <= m < sqrt(2), taken apart with
+//              integer arithmetic on its bits after denormals have been scaled up, and log(m) from
+//              fdlibm's polynomial in s = (m - 1) / (m + 1).  Zero gives -infinity, negative numbers
+//              and NaN give NaN and infinity stays infinity.
+#define CALC_LOG_PD(P, vector, mask, x, result)                                                                           \
+{                                                                                                                         \
+    const mask isDenormal = P##_LT(x, P##_SET(0x1p-1022));                                                                \
+    const vector normal = P##_SELECT(isDenormal, P##_MUL(x, P##_SET(0x1p54)), x);                                         \
+    const vector bits = P##_IADD(normal, 0x00095f6200000000ull);                                                          \
+    const vector exponent = P##_SUB(P##_IOR(P##_ISHR(bits, 52), 0x4330000000000000ull), P##_SET(0x1p52));                 \
+    const vector k = P##_SUB(exponent, P##_SELECT(isDenormal, P##_SET(1023.0 + 54.0), P##_SET(1023.0)));                  \
+    const vector f = P##_SUB(P##_IADD(P##_IAND(bits, 0x000fffffffffffffull), 0x3fe6a09e00000000ull), P##_SET(1.0));       \
+    const vector s = P##_DIV(f, P##_ADD(P##_SET(2.0), f));                                                                \
+    const vector z = P##_MUL(s, s);                                                                                       \
+    const vector w = P##_MUL(z, z);                                                                                       \
+    const vector t6 = P##_MUL(w, P##_SET(1.531383769920937332e-01));                                                      \
+    const vector t4 = P##_MUL(w, P##_ADD(P##_SET(2.222219843214978396e-01), t6));                                         \
+    const vector t1 = P##_MUL(w, P##_ADD(P##_SET(3.999999999940941908e-01), t4));                                         \
+    const vector t7 = P##_MUL(w, P##_SET(1.479819860511658591e-01));                                                      \
+    const vector t5 = P##_MUL(w, P##_ADD(P##_SET(1.818357216161805012e-01), t7));                                         \
+    const vector t3 = P##_MUL(w, P##_ADD(P##_SET(2.857142874366239149e-01), t5));                                         \
+    const vector t2 = P##_MUL(z, P##_ADD(P##_SET(6.666666666666735130e-01), t3));                                         \
+    const vector R = P##_ADD(t2, t1);                                                                                     \
+    const vector hfsq = P##_MUL(P##_MUL(P##_SET(0.5), f), f);                                                             \
+    const vector sum = P##_ADD(P##_MUL(s, P##_ADD(hfsq, R)), P##_MUL(k, P##_SET(1.90821492927058770002e-10)));            \
+    const vector estimate = P##_SUB(P##_MUL(k, P##_SET(6.93147180369123816490e-01)), P##_SUB(P##_SUB(hfsq, sum), f));     \
+    const vector infinite = P##_SELECT(P##_EQ(x, P##_SET(HUGE_VAL)), x, estimate);                                        \
+    const vector zero = P##_SELECT(P##_EQ(x, P##_SET(0.0)), P##_SET(-HUGE_VAL), infinite);                                \
+    const vector negative = P##_SELECT(P##_LT(x, P##_SET(0.0)), P##_SET(std::numeric_limits<double>::quiet_NaN()), zero); \
+    result = P##_SELECT(P##_EQ(x, x), negative, P##_ADD(x, x));                                                           \
+}
+
+//NAME: CALC_LOG_PS
+//DESCRIPTION:  result = log(x) for floats, like CALC_LOG_PD with the polynomial of FreeBSD's logf().
+#define CALC_LOG_PS(P, vector, mask, x, result)                                                                           \
+{                                                                                                                         \
+    const mask isDenormal = P##_LT(x, P##_SET(0x1p-126f));                                                                \
+    const vector normal = P##_SELECT(isDenormal, P##_MUL(x, P##_SET(0x1p25f)), x);                                        \
+    const vector bits = P##_IADD(normal, 0x004afb0du);                                                                    \
+    const vector exponent = P##_SUB(P##_IOR(P##_ISHR(bits, 23), 0x4b000000u), P##_SET(0x1p23f));                          \
+    const vector k = P##_SUB(exponent, P##_SELECT(isDenormal, P##_SET(127.0f + 25.0f), P##_SET(127.0f)));                 \
+    const vector f = P##_SUB(P##_IADD(P##_IAND(bits, 0x007fffffu), 0x3f3504f3u), P##_SET(1.0f));                          \
+    const vector s = P##_DIV(f, P##_ADD(P##_SET(2.0f), f));                                                               \
+    const vector z = P##_MUL(s, s);                                                                                       \
+    const vector w = P##_MUL(z, z);                                                                                       \
+    const vector t1 = P##_MUL(w, P##_ADD(P##_SET(0xccce13.0p-25f), P##_MUL(w, P##_SET(0xf89e26.0p-26f))));                \
+    const vector t2 = P##_MUL(z, P##_ADD(P##_SET(0xaaaaaa.0p-24f), P##_MUL(w, P##_SET(0x91e9ee.0p-25f))));                \
+    const vector R = P##_ADD(t2, t1);                                                                                     \
+    const vector hfsq = P##_MUL(P##_MUL(P##_SET(0.5f), f), f);                                                            \
+    const vector sum = P##_ADD(P##_MUL(s, P##_ADD(hfsq, R)), P##_MUL(k, P##_SET(9.0580006145e-06f)));                     \
+    const vector estimate = P##_SUB(P##_MUL(k, P##_SET(6.9313812256e-01f)), P##_SUB(P##_SUB(hfsq, sum), f));              \
+    const vector infinite = P##_SELECT(P##_EQ(x, P##_SET(HUGE_VALF)), x, estimate);                                       \
+    const vector zero = P##_SELECT(P##_EQ(x, P##_SET(0.0f)), P##_SET(-HUGE_VALF), infinite);                              \
+    const vector negative = P##_SELECT(P##_LT(x, P##_SET(0.0f)), P##_SET(std::numeric_limits<float>::quiet_NaN()), zero); \
+    result = P##_SELECT(P##_EQ(x, x), negative, P##_ADD(x, x));                                                           \
+}
+
+template <typename T>
+static void scalarExp(const T* a, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const T x = a[i];
+        if constexpr (sizeof(T) == 8)
+            CALC_EXP_PD(CALC_SCALAR, T, bool, x, out[i])
+        else
+            CALC_EXP_PS(CALC_SCALAR, T, bool, x, out[i])
+    }
+}
+
+template <typename T>
+static void scalarLog(const T* a, T* out, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        const T x = a[i];
+        if constexpr (sizeof(T) == 8)
+            CALC_LOG_PD(CALC_SCALAR, T, bool, x, out[i])
+        else
+            CALC_LOG_PS(CALC_SCALAR, T, bool, x, out[i])
+    }
+}
+
+//NAME: fixPower
+//DESCRIPTION:  x^y for floats is exp(y log|x|), calculated in double by the kernels of powerPs().  That is
+//              right for every x and y except those where y log|x| is 0 * infinity, and the sign.
+//INPUT:
+//    x         - The base.
+//    y         - The power.
+//    magnitude - exp(y log|x|), rounded to float.
+//OUTPUT:
+//    none
+//RETURNS:
+//    x^y exactly as pow() has it for the special cases.
+static inline float fixPower(float x, float y, float magnitude)
+{
+    //pow(x, 0), pow(1, y) and pow(-1, +-infinity) are all 1.
+    if (y == 0 || x == 1 || (x == -1 && std::isinf(y)))
+        return 1;
+
+    if (!std::signbit(x) || std::isnan(x))
+        return magnitude;
+
+    //A negative base only has a power if y is an integer, and it is negative for odd ones.  Floats this
+    //large are all even.
+    bool isInteger = std::floor(y) == y;
+    if (isInteger && std::fabs(y) < 16777216.0f && ((int32_t)y & 1) != 0)
+        return -magnitude;
+    if (!isInteger && x != 0 && !std::isinf(x))
+        return std::numeric_limits<float>::quiet_NaN();
+
+    return magnitude;
+}
+
+//How many lanes powerPs() converts to double at a time.
+static const size_t kPowerLanes = 64;
+
+//NAME: powerPs
+//DESCRIPTION:  x^y for floats, using the exp() and log() kernels for doubles.  The error of those is far
+//              below what a float can show, so the answer is a float's rounding of the exact power.
+//INPUT:
+//    logarithm   - The log() kernel for doubles.
+//    exponential - The exp() kernel for doubles.
+//    a, b        - The bases and the powers.
+//OUTPUT:
+//    out         - The results.  May be the same array as a or b.
+//RETURNS:
+//    none
+static void powerPs(void (*logarithm)(const double*, double*, size_t), void (*exponential)(const double*, double*, size_t),
+                    const float* a, const float* b, float* out, size_t count)
+{
+    double lanes[kPowerLanes];
+    for (size_t start = 0; start < count; start += kPowerLanes)
+    {
+        const size_t n = count - start < kPowerLanes ? count - start : kPowerLanes;
+        for (size_t i = 0; i < n; i++)
+            lanes[i] = std::fabs((double)a[start + i]);
+
+        logarithm(lanes, lanes, n);
+        for (size_t i = 0; i < n; i++)
+            lanes[i] *= (double)b[start + i];
+
+        exponential(lanes, lanes, n);
+        for (size_t i = 0; i < n; i++)
+            out[start + i] = fixPower(a[start + i], b[start + i], (float)lanes[i]);
+    }
+}
+
+//Only floats raise to a power without pow(); doubles would need log() and exp() far more precise than these.
+template <typename T>
+static void scalarPowerKernel(const T* a, const T* b, T* out, size_t count)
+{
+    if constexpr (sizeof(T) == 4)
+        powerPs(scalarLog<double>, scalarExp<double>, a, b, out, count);
+    else
+        scalarPower(a, b, out, count);
+}
+
+//NAME: leaveVector
+//DESCRIPTION:  Called with the vector type a loop used before it hands over to the narrower code in tail.
+//              SSE code runs much slower while the upper halves of the AVX registers are in use, and the
+//              compiler doesn't clear them before jumping to the tail, nor does the tail before returning,
+//              so every SSE function called afterwards would pay for it too, std::pow() included.
+//              Nothing has to be done after any other vector type.
+template <typename Vector>
+static inline void leaveVector(const Vector*)
+{
+}
+
+#if defined(CALC_X86)
+CALC_TARGET("avx") static inline void leaveVector(const __m256*) { _mm256_zeroupper(); }
+
+CALC_TARGET("avx") static inline void leaveVector(const __m256d*) { _mm256_zeroupper(); }
+
+CALC_TARGET("avx512f") static inline void leaveVector(const __m512*) { _mm256_zeroupper(); }
+
+CALC_TARGET("avx512f") static inline void leaveVector(const __m512d*) { _mm256_zeroupper(); }
+#endif
+
+//The vector loops are the same for every instruction set and lane type, only the intrinsics differ.
+//    name      - The function to define.
+//    target    - CALC_TARGET() of what the function may use, if the compiler has to be told.
+//    T         - The lane type.
+//    width     - How many lanes a vector holds.
+//    vector    - The vector type.
+//    load      - Loads a vector from memory, store writes one back.
+//    intrinsic - The operation on two vectors (unary: on one).
+//    tail      - The narrower function which finishes the lanes that don't fill a whole vector.
+//Before the tail runs, leaveVector() tidies up after the vectors.
+#define CALC_VECTOR_UNARY(name, target, T, width, vector, load, store, intrinsic, tail) \
+target                                                                                  \
+static void name(const T* a, T* out, size_t count)                                      \
+{                                                                                       \
+    size_t i = 0;                                                                       \
+    for (; i + 2 * width <= count; i += 2 * width)                                      \
+    {                                                                                   \
+        vector x = load(a + i);                                                         \
+        vector y = load(a + i + width);                                                 \
+        store(out + i, intrinsic(x));                                                   \
+        store(out + i + width, intrinsic(y));                                           \
+    }                                                                                   \
+                                                                                        \
+    leaveVector((const vector*)NULL);                                                   \
+    tail(a + i, out + i, count - i);                                                    \
+}
+
+#define CALC_VECTOR_BINARY(name, target, T, width, vector, load, store, intrinsic, tail)  \
+target                                                                                    \
+static void name(const T* a, const T* b, T* out, size_t count)                            \
+{                                                                                         \
+    size_t i = 0;                                                                         \
+    for (; i + 2 * width <= count; i += 2 * width)                                        \
+    {                                                                                     \
+        vector x = intrinsic(load(a + i), load(b + i));                                   \
+        vector y = intrinsic(load(a + i + width), load(b + i + width));                   \
+        store(out + i, x);                                                                \
+        store(out + i + width, y);                                                        \
+    }                                                                                     \
+                                                                                          \
+    leaveVector((const vector*)NULL);                                                     \
+    tail(a + i, b + i, out + i, count - i);                                               \
+}
+
+//The same for the lanes of CALC_EXP_PD and the others, with the operations of P, a vector at a time.
+#define CALC_VECTOR_LANES(name, target, T, width, vector, mask, P, lanes, tail)               \
+target                                                                                    \
+static void name(const T* a, T* out, size_t count)                                        \
+{                                                                                         \
+    size_t i = 0;                                                                         \
+    for (; i + width <= count; i += width)                                                \
+    {                                                                                     \
+        const vector x = P##_LOAD(a + i);                                                 \
+        vector y;                                                                         \
+        lanes(P, vector, mask, x, y)                                                      \
+        P##_STORE(out + i, y);                                                            \
+    }                                                                                     \
+                                                                                          \
+    leaveVector((const vector*)NULL);                                                     \
+    tail(a + i, out + i, count - i);                                                      \
+}
+
+//Comparisons with the operations of P, which turn the mask compare gives into 1 and 0.
+#define CALC_VECTOR_COMPARE(name, target, T, width, vector, mask, P, compare, tail)          \
+target                                                                                    \
+static void name(const T* a, const T* b, T* out, size_t count)                            \
+{                                                                                         \
+    size_t i = 0;                                                                         \
+    for (; i + width <= count; i += width)                                                \
+    {                                                                                     \
+        const mask holds = P##_##compare(P##_LOAD(a + i), P##_LOAD(b + i));               \
+        P##_STORE(out + i, P##_TRUTH(holds));                                             \
+    }                                                                                     \
+                                                                                          \
+    leaveVector((const vector*)NULL);                                                     \
+    tail(a + i, b + i, out + i, count - i);                                               \
+}
+
+//Picking a where the condition isn't 0 and b where it is.  NaN isn't 0.
+#define CALC_VECTOR_SELECT(name, target, T, width, vector, mask, P, tail)                    \
+target                                                                                    \
+static void name(const T* condition, const T* a, const T* b, T* out, size_t count)        \
+{                                                                                         \
+    size_t i = 0;                                                                         \
+    for (; i + width <= count; i += width)                                                \
+    {                                                                                     \
+        const mask taken = P##_NE(P##_LOAD(condition + i), P##_SET(0));                   \
+        P##_STORE(out + i, P##_SELECT(taken, P##_LOAD(a + i), P##_LOAD(b + i)));          \
+    }                                                                                     \
+                                                                                          \
+    leaveVector((const vector*)NULL);                                                     \
+    tail(condition + i, a + i, b + i, out + i, count - i);                                \
+}
+
+#if defined(CALC_X86)
+//Flipping the sign bit is the same as multiplying by -1.
+#define CALC_SSE_NEGATE_PS(x) _mm_xor_ps(x, _mm_set1_ps(-0.0f))
+#define CALC_SSE_NEGATE_PD(x) _mm_xor_pd(x, _mm_set1_pd(-0.0))
+#define CALC_AVX_NEGATE_PS(x) _mm256_xor_ps(x, _mm256_set1_ps(-0.0f))
+#define CALC_AVX_NEGATE_PD(x) _mm256_xor_pd(x, _mm256_set1_pd(-0.0))
+
+//Clearing it is abs().
+#define CALC_SSE_ABS_PS(x) _mm_andnot_ps(_mm_set1_ps(-0.0f), x)
+#define CALC_SSE_ABS_PD(x) _mm_andnot_pd(_mm_set1_pd(-0.0), x)
+#define CALC_AVX_ABS_PS(x) _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x)
+#define CALC_AVX_ABS_PD(x) _mm256_andnot_pd(_mm256_set1_pd(-0.0), x)
+
+//AVX-512F only has the bitwise operations for integers; the ones for floats and doubles need AVX-512DQ.
+#define CALC_AVX512_NEGATE_PS(x) _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(x), _mm512_set1_epi32((int)0x80000000u)))
+#define CALC_AVX512_NEGATE_PD(x) _mm512_castsi512_pd(_mm512_xor_si512(_mm512_castpd_si512(x), _mm512_set1_epi64((long long)0x8000000000000000ull)))
+
+//The operations of CALC_EXP_PD and the others.
+#define CALC_SSE_PD_LOAD(p)             _mm_loadu_pd(p)
+#define CALC_SSE_PD_STORE(p, v)         _mm_storeu_pd(p, v)
+#define CALC_SSE_PD_SET(c)              _mm_set1_pd(c)
+#define CALC_SSE_PD_ADD(a, b)           _mm_add_pd(a, b)
+#define CALC_SSE_PD_SUB(a, b)           _mm_sub_pd(a, b)
+#define CALC_SSE_PD_MUL(a, b)           _mm_mul_pd(a, b)
+#define CALC_SSE_PD_DIV(a, b)           _mm_div_pd(a, b)
+#define CALC_SSE_PD_MIN(a, b)           _mm_min_pd(a, b)
+#define CALC_SSE_PD_MAX(a, b)           _mm_max_pd(a, b)
+#define CALC_SSE_PD_EQ(a, b)            _mm_cmpeq_pd(a, b)
+#define CALC_SSE_PD_LT(a, b)            _mm_cmplt_pd(a, b)
+#define CALC_SSE_PD_LE(a, b)            _mm_cmple_pd(a, b)
+#define CALC_SSE_PD_GT(a, b)            _mm_cmpgt_pd(a, b)
+#define CALC_SSE_PD_GE(a, b)            _mm_cmpge_pd(a, b)
+#define CALC_SSE_PD_NE(a, b)            _mm_cmpneq_pd(a, b)
+#define CALC_SSE_PD_TRUTH(mask)         _mm_and_pd(mask, _mm_set1_pd(1.0))
+#define CALC_SSE_PD_SELECT(mask, a, b)  _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b))
+#define CALC_SSE_PD_IADD(v, c)          _mm_castsi128_pd(_mm_add_epi64(_mm_castpd_si128(v), _mm_set1_epi64x((long long)(c))))
+#define CALC_SSE_PD_IAND(v, c)          _mm_castsi128_pd(_mm_and_si128(_mm_castpd_si128(v), _mm_set1_epi64x((long long)(c))))
+#define CALC_SSE_PD_IOR(v, c)           _mm_castsi128_pd(_mm_or_si128(_mm_castpd_si128(v), _mm_set1_epi64x((long long)(c))))
+#define CALC_SSE_PD_ISHL(v, bits)       _mm_castsi128_pd(_mm_slli_epi64(_mm_castpd_si128(v), bits))
+#define CALC_SSE_PD_ISHR(v, bits)       _mm_castsi128_pd(_mm_srli_epi64(_mm_castpd_si128(v), bits))
+
+#define CALC_SSE_PS_LOAD(p)             _mm_loadu_ps(p)
+#define CALC_SSE_PS_STORE(p, v)         _mm_storeu_ps(p, v)
+#define CALC_SSE_PS_SET(c)              _mm_set1_ps(c)
+#define CALC_SSE_PS_ADD(a, b)           _mm_add_ps(a, b)
+#define CALC_SSE_PS_SUB(a, b)           _mm_sub_ps(a, b)
+#define CALC_SSE_PS_MUL(a, b)           _mm_mul_ps(a, b)
+#define CALC_SSE_PS_DIV(a, b)           _mm_div_ps(a, b)
+#define CALC_SSE_PS_MIN(a, b)           _mm_min_ps(a, b)
+#define CALC_SSE_PS_MAX(a, b)           _mm_max_ps(a, b)
+#define CALC_SSE_PS_EQ(a, b)            _mm_cmpeq_ps(a, b)
+#define CALC_SSE_PS_LT(a, b)            _mm_cmplt_ps(a, b)
+#define CALC_SSE_PS_LE(a, b)            _mm_cmple_ps(a, b)
+#define CALC_SSE_PS_GT(a, b)            _mm_cmpgt_ps(a, b)
+#define CALC_SSE_PS_GE(a, b)            _mm_cmpge_ps(a, b)
+#define CALC_SSE_PS_NE(a, b)            _mm_cmpneq_ps(a, b)
+#define CALC_SSE_PS_TRUTH(mask)         _mm_and_ps(mask, _mm_set1_ps(1.0f))
+#define CALC_SSE_PS_SELECT(mask, a, b)  _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b))
+#define CALC_SSE_PS_IADD(v, c)          _mm_castsi128_ps(_mm_add_epi32(_mm_castps_si128(v), _mm_set1_epi32((int)(c))))
+#define CALC_SSE_PS_IAND(v, c)          _mm_castsi128_ps(_mm_and_si128(_mm_castps_si128(v), _mm_set1_epi32((int)(c))))
+#define CALC_SSE_PS_IOR(v, c)           _mm_castsi128_ps(_mm_or_si128(_mm_castps_si128(v), _mm_set1_epi32((int)(c))))
+#define CALC_SSE_PS_ISHL(v, bits)       _mm_castsi128_ps(_mm_slli_epi32(_mm_castps_si128(v), bits))
+#define CALC_SSE_PS_ISHR(v, bits)       _mm_castsi128_ps(_mm_srli_epi32(_mm_castps_si128(v), bits))
+
+#define CALC_AVX_PD_LOAD(p)             _mm256_loadu_pd(p)
+#define CALC_AVX_PD_STORE(p, v)         _mm256_storeu_pd(p, v)
+#define CALC_AVX_PD_SET(c)              _mm256_set1_pd(c)
+#define CALC_AVX_PD_ADD(a, b)           _mm256_add_pd(a, b)
+#define CALC_AVX_PD_SUB(a, b)           _mm256_sub_pd(a, b)
+#define CALC_AVX_PD_MUL(a, b)           _mm256_mul_pd(a, b)
+#define CALC_AVX_PD_DIV(a, b)           _mm256_div_pd(a, b)
+#define CALC_AVX_PD_MIN(a, b)           _mm256_min_pd(a, b)
+#define CALC_AVX_PD_MAX(a, b)           _mm256_max_pd(a, b)
+#define CALC_AVX_PD_EQ(a, b)            _mm256_cmp_pd(a, b, _CMP_EQ_OQ)
+#define CALC_AVX_PD_LT(a, b)            _mm256_cmp_pd(a, b, _CMP_LT_OQ)
+#define CALC_AVX_PD_LE(a, b)            _mm256_cmp_pd(a, b, _CMP_LE_OQ)
+#define CALC_AVX_PD_GT(a, b)            _mm256_cmp_pd(a, b, _CMP_GT_OQ)
+#define CALC_AVX_PD_GE(a, b)            _mm256_cmp_pd(a, b, _CMP_GE_OQ)
+#define CALC_AVX_PD_NE(a, b)            _mm256_cmp_pd(a, b, _CMP_NEQ_UQ)
+#define CALC_AVX_PD_TRUTH(mask)         _mm256_and_pd(mask, _mm256_set1_pd(1.0))
+#define CALC_AVX_PD_SELECT(mask, a, b)  _mm256_blendv_pd(b, a, mask)
+#define CALC_AVX_PD_IADD(v, c)          _mm256_castsi256_pd(_mm256_add_epi64(_mm256_castpd_si256(v), _mm256_set1_epi64x((long long)(c))))
+#define CALC_AVX_PD_IAND(v, c)          _mm256_castsi256_pd(_mm256_and_si256(_mm256_castpd_si256(v), _mm256_set1_epi64x((long long)(c))))
+#define CALC_AVX_PD_IOR(v, c)           _mm256_castsi256_pd(_mm256_or_si256(_mm256_castpd_si256(v), _mm256_set1_epi64x((long long)(c))))
+#define CALC_AVX_PD_ISHL(v, bits)       _mm256_castsi256_pd(_mm256_slli_epi64(_mm256_castpd_si256(v), bits))
+#define CALC_AVX_PD_ISHR(v, bits)       _mm256_castsi256_pd(_mm256_srli_epi64(_mm256_castpd_si256(v), bits))
+
+#define CALC_AVX_PS_LOAD(p)             _mm256_loadu_ps(p)
+#define CALC_AVX_PS_STORE(p, v)         _mm256_storeu_ps(p, v)
+#define CALC_AVX_PS_SET(c)              _mm256_set1_ps(c)
+#define CALC_AVX_PS_ADD(a, b)           _mm256_add_ps(a, b)
+#define CALC_AVX_PS_SUB(a, b)           _mm256_sub_ps(a, b)
+#define CALC_AVX_PS_MUL(a, b)           _mm256_mul_ps(a, b)
+#define CALC_AVX_PS_DIV(a, b)           _mm256_div_ps(a, b)
+#define CALC_AVX_PS_MIN(a, b)           _mm256_min_ps(a, b)
+#define CALC_AVX_PS_MAX(a, b)           _mm256_max_ps(a, b)
+#define CALC_AVX_PS_EQ(a, b)            _mm256_cmp_ps(a, b, _CMP_EQ_OQ)
+#define CALC_AVX_PS_LT(a, b)            _mm256_cmp_ps(a, b, _CMP_LT_OQ)
+#define CALC_AVX_PS_LE(a, b)            _mm256_cmp_ps(a, b, _CMP_LE_OQ)
+#define CALC_AVX_PS_GT(a, b)            _mm256_cmp_ps(a, b, _CMP_GT_OQ)
+#define CALC_AVX_PS_GE(a, b)            _mm256_cmp_ps(a, b, _CMP_GE_OQ)
+#define CALC_AVX_PS_NE(a, b)            _mm256_cmp_ps(a, b, _CMP_NEQ_UQ)
+#define CALC_AVX_PS_TRUTH(mask)         _mm256_and_ps(mask, _mm256_set1_ps(1.0f))
+#define CALC_AVX_PS_SELECT(mask, a, b)  _mm256_blendv_ps(b, a, mask)
+#define CALC_AVX_PS_IADD(v, c)          _mm256_castsi256_ps(_mm256_add_epi32(_mm256_castps_si256(v), _mm256_set1_epi32((int)(c))))
+#define CALC_AVX_PS_IAND(v, c)          _mm256_castsi256_ps(_mm256_and_si256(_mm256_castps_si256(v), _mm256_set1_epi32((int)(c))))
+#define CALC_AVX_PS_IOR(v, c)           _mm256_castsi256_ps(_mm256_or_si256(_mm256_castps_si256(v), _mm256_set1_epi32((int)(c))))
+#define CALC_AVX_PS_ISHL(v, bits)       _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_castps_si256(v), bits))
+#define CALC_AVX_PS_ISHR(v, bits)       _mm256_castsi256_ps(_mm256_srli_epi32(_mm256_castps_si256(v), bits))
+
+//Comparisons give a mask register with a bit per lane rather than a vector.
+#define CALC_AVX512_PD_LOAD(p)             _mm512_loadu_pd(p)
+#define CALC_AVX512_PD_STORE(p, v)         _mm512_storeu_pd(p, v)
+#define CALC_AVX512_PD_SET(c)              _mm512_set1_pd(c)
+#define CALC_AVX512_PD_ADD(a, b)           _mm512_add_pd(a, b)
+#define CALC_AVX512_PD_SUB(a, b)           _mm512_sub_pd(a, b)
+#define CALC_AVX512_PD_MUL(a, b)           _mm512_mul_pd(a, b)
+#define CALC_AVX512_PD_DIV(a, b)           _mm512_div_pd(a, b)
+#define CALC_AVX512_PD_MIN(a, b)           _mm512_min_pd(a, b)
+#define CALC_AVX512_PD_MAX(a, b)           _mm512_max_pd(a, b)
+#define CALC_AVX512_PD_EQ(a, b)            _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ)
+#define CALC_AVX512_PD_LT(a, b)            _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ)
+#define CALC_AVX512_PD_LE(a, b)            _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ)
+#define CALC_AVX512_PD_GT(a, b)            _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ)
+#define CALC_AVX512_PD_GE(a, b)            _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ)
+#define CALC_AVX512_PD_NE(a, b)            _mm512_cmp_pd_mask(a, b, _CMP_NEQ_UQ)
+#define CALC_AVX512_PD_TRUTH(mask)         _mm512_maskz_mov_pd(mask, _mm512_set1_pd(1.0))
+#define CALC_AVX512_PD_SELECT(mask, a, b)  _mm512_mask_blend_pd(mask, b, a)
+#define CALC_AVX512_PD_IADD(v, c)          _mm512_castsi512_pd(_mm512_add_epi64(_mm512_castpd_si512(v), _mm512_set1_epi64((long long)(c))))
+#define CALC_AVX512_PD_IAND(v, c)          _mm512_castsi512_pd(_mm512_and_si512(_mm512_castpd_si512(v), _mm512_set1_epi64((long long)(c))))
+#define CALC_AVX512_PD_IOR(v, c)           _mm512_castsi512_pd(_mm512_or_si512(_mm512_castpd_si512(v), _mm512_set1_epi64((long long)(c))))
+#define CALC_AVX512_PD_ISHL(v, bits)       _mm512_castsi512_pd(_mm512_slli_epi64(_mm512_castpd_si512(v), bits))
+#define CALC_AVX512_PD_ISHR(v, bits)       _mm512_castsi512_pd(_mm512_srli_epi64(_mm512_castpd_si512(v), bits))
+
+#define CALC_AVX512_PS_LOAD(p)             _mm512_loadu_ps(p)
+#define CALC_AVX512_PS_STORE(p, v)         _mm512_storeu_ps(p, v)
+#define CALC_AVX512_PS_SET(c)              _mm512_set1_ps(c)
+#define CALC_AVX512_PS_ADD(a, b)           _mm512_add_ps(a, b)
+#define CALC_AVX512_PS_SUB(a, b)           _mm512_sub_ps(a, b)
+#define CALC_AVX512_PS_MUL(a, b)           _mm512_mul_ps(a, b)
+#define CALC_AVX512_PS_DIV(a, b)           _mm512_div_ps(a, b)
+#define CALC_AVX512_PS_MIN(a, b)           _mm512_min_ps(a, b)
+#define CALC_AVX512_PS_MAX(a, b)           _mm512_max_ps(a, b)
+#define CALC_AVX512_PS_EQ(a, b)            _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ)
+#define CALC_AVX512_PS_LT(a, b)            _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ)
+#define CALC_AVX512_PS_LE(a, b)            _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ)
+#define CALC_AVX512_PS_GT(a, b)            _mm512_cmp_ps_mask(a, b, _CMP_GT_OQ)
+#define CALC_AVX512_PS_GE(a, b)            _mm512_cmp_ps_mask(a, b, _CMP_GE_OQ)
+#define CALC_AVX512_PS_NE(a, b)            _mm512_cmp_ps_mask(a, b, _CMP_NEQ_UQ)
+#define CALC_AVX512_PS_TRUTH(mask)         _mm512_maskz_mov_ps(mask, _mm512_set1_ps(1.0f))
+#define CALC_AVX512_PS_SELECT(mask, a, b)  _mm512_mask_blend_ps(mask, b, a)
+#define CALC_AVX512_PS_IADD(v, c)          _mm512_castsi512_ps(_mm512_add_epi32(_mm512_castps_si512(v), _mm512_set1_epi32((int)(c))))
+#define CALC_AVX512_PS_IAND(v, c)          _mm512_castsi512_ps(_mm512_and_si512(_mm512_castps_si512(v), _mm512_set1_epi32((int)(c))))
+#define CALC_AVX512_PS_IOR(v, c)           _mm512_castsi512_ps(_mm512_or_si512(_mm512_castps_si512(v), _mm512_set1_epi32((int)(c))))
+#define CALC_AVX512_PS_ISHL(v, bits)       _mm512_castsi512_ps(_mm512_slli_epi32(_mm512_castps_si512(v), bits))
+#define CALC_AVX512_PS_ISHR(v, bits)       _mm512_castsi512_ps(_mm512_srli_epi32(_mm512_castps_si512(v), bits))
+
+//SSE - four floats or two doubles at a time.  Every x86 processor we build for has it.
+CALC_VECTOR_UNARY(sseNegatePs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, CALC_SSE_NEGATE_PS, scalarNegate<float>)
+CALC_VECTOR_BINARY(sseAddPs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_add_ps, scalarAdd<float>)
+CALC_VECTOR_BINARY(sseSubtractPs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_sub_ps, scalarSubtract<float>)
+CALC_VECTOR_BINARY(sseMultiplyPs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_mul_ps, scalarMultiply<float>)
+CALC_VECTOR_BINARY(sseDividePs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_div_ps, scalarDivide<float>)
+CALC_VECTOR_BINARY(sseMinPs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_min_ps, scalarMin<float>)
+CALC_VECTOR_BINARY(sseMaxPs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_max_ps, scalarMax<float>)
+CALC_VECTOR_UNARY(sseSqrtPs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, _mm_sqrt_ps, scalarSqrt<float>)
+CALC_VECTOR_UNARY(sseAbsPs, CALC_TARGET("sse2"), float, 4, __m128, _mm_loadu_ps, _mm_storeu_ps, CALC_SSE_ABS_PS, scalarAbs<float>)
+CALC_VECTOR_LANES(sseExpPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, CALC_EXP_PS, scalarExp<float>)
+CALC_VECTOR_LANES(sseLogPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, CALC_LOG_PS, scalarLog<float>)
+CALC_VECTOR_COMPARE(sseLessPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, LT, scalarLess<float>)
+CALC_VECTOR_COMPARE(sseLessEqualPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, LE, scalarLessEqual<float>)
+CALC_VECTOR_COMPARE(sseGreaterPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, GT, scalarGreater<float>)
+CALC_VECTOR_COMPARE(sseGreaterEqualPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, GE, scalarGreaterEqual<float>)
+CALC_VECTOR_COMPARE(sseEqualPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, EQ, scalarEqual<float>)
+CALC_VECTOR_COMPARE(sseNotEqualPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, NE, scalarNotEqual<float>)
+CALC_VECTOR_SELECT(sseSelectPs, CALC_TARGET("sse2"), float, 4, __m128, __m128, CALC_SSE_PS, scalarSelect<float>)
+
+CALC_VECTOR_UNARY(sseNegatePd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, CALC_SSE_NEGATE_PD, scalarNegate<double>)
+CALC_VECTOR_BINARY(sseAddPd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_add_pd, scalarAdd<double>)
+CALC_VECTOR_BINARY(sseSubtractPd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_sub_pd, scalarSubtract<double>)
+CALC_VECTOR_BINARY(sseMultiplyPd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_mul_pd, scalarMultiply<double>)
+CALC_VECTOR_BINARY(sseDividePd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_div_pd, scalarDivide<double>)
+CALC_VECTOR_BINARY(sseMinPd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_min_pd, scalarMin<double>)
+CALC_VECTOR_BINARY(sseMaxPd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_max_pd, scalarMax<double>)
+CALC_VECTOR_UNARY(sseSqrtPd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, _mm_sqrt_pd, scalarSqrt<double>)
+CALC_VECTOR_UNARY(sseAbsPd, CALC_TARGET("sse2"), double, 2, __m128d, _mm_loadu_pd, _mm_storeu_pd, CALC_SSE_ABS_PD, scalarAbs<double>)
+CALC_VECTOR_LANES(sseExpPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, CALC_EXP_PD, scalarExp<double>)
+CALC_VECTOR_LANES(sseLogPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, CALC_LOG_PD, scalarLog<double>)
+CALC_VECTOR_COMPARE(sseLessPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, LT, scalarLess<double>)
+CALC_VECTOR_COMPARE(sseLessEqualPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, LE, scalarLessEqual<double>)
+CALC_VECTOR_COMPARE(sseGreaterPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, GT, scalarGreater<double>)
+CALC_VECTOR_COMPARE(sseGreaterEqualPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, GE, scalarGreaterEqual<double>)
+CALC_VECTOR_COMPARE(sseEqualPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, EQ, scalarEqual<double>)
+CALC_VECTOR_COMPARE(sseNotEqualPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, NE, scalarNotEqual<double>)
+CALC_VECTOR_SELECT(sseSelectPd, CALC_TARGET("sse2"), double, 2, __m128d, __m128d, CALC_SSE_PD, scalarSelect<double>)
+
+//AVX2 - eight floats or four doubles at a time, two registers per pass to hide the latency of each operation.
+CALC_VECTOR_UNARY(avx2NegatePs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, CALC_AVX_NEGATE_PS, sseNegatePs)
+CALC_VECTOR_BINARY(avx2AddPs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_add_ps, sseAddPs)
+CALC_VECTOR_BINARY(avx2SubtractPs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_sub_ps, sseSubtractPs)
+CALC_VECTOR_BINARY(avx2MultiplyPs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_mul_ps, sseMultiplyPs)
+CALC_VECTOR_BINARY(avx2DividePs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_div_ps, sseDividePs)
+CALC_VECTOR_BINARY(avx2MinPs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_min_ps, sseMinPs)
+CALC_VECTOR_BINARY(avx2MaxPs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_max_ps, sseMaxPs)
+CALC_VECTOR_UNARY(avx2SqrtPs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_sqrt_ps, sseSqrtPs)
+CALC_VECTOR_UNARY(avx2AbsPs, CALC_TARGET("avx2"), float, 8, __m256, _mm256_loadu_ps, _mm256_storeu_ps, CALC_AVX_ABS_PS, sseAbsPs)
+CALC_VECTOR_LANES(avx2ExpPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, CALC_EXP_PS, sseExpPs)
+CALC_VECTOR_LANES(avx2LogPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, CALC_LOG_PS, sseLogPs)
+CALC_VECTOR_COMPARE(avx2LessPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, LT, sseLessPs)
+CALC_VECTOR_COMPARE(avx2LessEqualPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, LE, sseLessEqualPs)
+CALC_VECTOR_COMPARE(avx2GreaterPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, GT, sseGreaterPs)
+CALC_VECTOR_COMPARE(avx2GreaterEqualPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, GE, sseGreaterEqualPs)
+CALC_VECTOR_COMPARE(avx2EqualPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, EQ, sseEqualPs)
+CALC_VECTOR_COMPARE(avx2NotEqualPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, NE, sseNotEqualPs)
+CALC_VECTOR_SELECT(avx2SelectPs, CALC_TARGET("avx2"), float, 8, __m256, __m256, CALC_AVX_PS, sseSelectPs)
+
+CALC_VECTOR_UNARY(avx2NegatePd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, CALC_AVX_NEGATE_PD, sseNegatePd)
+CALC_VECTOR_BINARY(avx2AddPd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd, sseAddPd)
+CALC_VECTOR_BINARY(avx2SubtractPd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sub_pd, sseSubtractPd)
+CALC_VECTOR_BINARY(avx2MultiplyPd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd, sseMultiplyPd)
+CALC_VECTOR_BINARY(avx2DividePd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd, sseDividePd)
+CALC_VECTOR_BINARY(avx2MinPd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_min_pd, sseMinPd)
+CALC_VECTOR_BINARY(avx2MaxPd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_max_pd, sseMaxPd)
+CALC_VECTOR_UNARY(avx2SqrtPd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sqrt_pd, sseSqrtPd)
+CALC_VECTOR_UNARY(avx2AbsPd, CALC_TARGET("avx2"), double, 4, __m256d, _mm256_loadu_pd, _mm256_storeu_pd, CALC_AVX_ABS_PD, sseAbsPd)
+CALC_VECTOR_LANES(avx2ExpPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, CALC_EXP_PD, sseExpPd)
+CALC_VECTOR_LANES(avx2LogPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, CALC_LOG_PD, sseLogPd)
+CALC_VECTOR_COMPARE(avx2LessPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, LT, sseLessPd)
+CALC_VECTOR_COMPARE(avx2LessEqualPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, LE, sseLessEqualPd)
+CALC_VECTOR_COMPARE(avx2GreaterPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, GT, sseGreaterPd)
+CALC_VECTOR_COMPARE(avx2GreaterEqualPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, GE, sseGreaterEqualPd)
+CALC_VECTOR_COMPARE(avx2EqualPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, EQ, sseEqualPd)
+CALC_VECTOR_COMPARE(avx2NotEqualPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, NE, sseNotEqualPd)
+CALC_VECTOR_SELECT(avx2SelectPd, CALC_TARGET("avx2"), double, 4, __m256d, __m256d, CALC_AVX_PD, sseSelectPd)
+
+//AVX-512 - sixteen floats or eight doubles at a time, handing what is left to the AVX2 loops.
+CALC_VECTOR_UNARY(avx512NegatePs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, CALC_AVX512_NEGATE_PS, avx2NegatePs)
+CALC_VECTOR_BINARY(avx512AddPs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_add_ps, avx2AddPs)
+CALC_VECTOR_BINARY(avx512SubtractPs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_sub_ps, avx2SubtractPs)
+CALC_VECTOR_BINARY(avx512MultiplyPs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_mul_ps, avx2MultiplyPs)
+CALC_VECTOR_BINARY(avx512DividePs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_div_ps, avx2DividePs)
+CALC_VECTOR_BINARY(avx512MinPs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_min_ps, avx2MinPs)
+CALC_VECTOR_BINARY(avx512MaxPs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_max_ps, avx2MaxPs)
+CALC_VECTOR_UNARY(avx512SqrtPs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_sqrt_ps, avx2SqrtPs)
+CALC_VECTOR_UNARY(avx512AbsPs, CALC_TARGET("avx512f"), float, 16, __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_abs_ps, avx2AbsPs)
+CALC_VECTOR_LANES(avx512ExpPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, CALC_EXP_PS, avx2ExpPs)
+CALC_VECTOR_LANES(avx512LogPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, CALC_LOG_PS, avx2LogPs)
+CALC_VECTOR_COMPARE(avx512LessPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, LT, avx2LessPs)
+CALC_VECTOR_COMPARE(avx512LessEqualPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, LE, avx2LessEqualPs)
+CALC_VECTOR_COMPARE(avx512GreaterPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, GT, avx2GreaterPs)
+CALC_VECTOR_COMPARE(avx512GreaterEqualPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, GE, avx2GreaterEqualPs)
+CALC_VECTOR_COMPARE(avx512EqualPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, EQ, avx2EqualPs)
+CALC_VECTOR_COMPARE(avx512NotEqualPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, NE, avx2NotEqualPs)
+CALC_VECTOR_SELECT(avx512SelectPs, CALC_TARGET("avx512f"), float, 16, __m512, __mmask16, CALC_AVX512_PS, avx2SelectPs)
+
+CALC_VECTOR_UNARY(avx512NegatePd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, CALC_AVX512_NEGATE_PD, avx2NegatePd)
+CALC_VECTOR_BINARY(avx512AddPd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_add_pd, avx2AddPd)
+CALC_VECTOR_BINARY(avx512SubtractPd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_sub_pd, avx2SubtractPd)
+CALC_VECTOR_BINARY(avx512MultiplyPd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_mul_pd, avx2MultiplyPd)
+CALC_VECTOR_BINARY(avx512DividePd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_div_pd, avx2DividePd)
+CALC_VECTOR_BINARY(avx512MinPd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_min_pd, avx2MinPd)
+CALC_VECTOR_BINARY(avx512MaxPd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_max_pd, avx2MaxPd)
+CALC_VECTOR_UNARY(avx512SqrtPd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_sqrt_pd, avx2SqrtPd)
+CALC_VECTOR_UNARY(avx512AbsPd, CALC_TARGET("avx512f"), double, 8, __m512d, _mm512_loadu_pd, _mm512_storeu_pd, _mm512_abs_pd, avx2AbsPd)
+CALC_VECTOR_LANES(avx512ExpPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, CALC_EXP_PD, avx2ExpPd)
+CALC_VECTOR_LANES(avx512LogPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, CALC_LOG_PD, avx2LogPd)
+CALC_VECTOR_COMPARE(avx512LessPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, LT, avx2LessPd)
+CALC_VECTOR_COMPARE(avx512LessEqualPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, LE, avx2LessEqualPd)
+CALC_VECTOR_COMPARE(avx512GreaterPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, GT, avx2GreaterPd)
+CALC_VECTOR_COMPARE(avx512GreaterEqualPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, GE, avx2GreaterEqualPd)
+CALC_VECTOR_COMPARE(avx512EqualPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, EQ, avx2EqualPd)
+CALC_VECTOR_COMPARE(avx512NotEqualPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, NE, avx2NotEqualPd)
+CALC_VECTOR_SELECT(avx512SelectPd, CALC_TARGET("avx512f"), double, 8, __m512d, __mmask8, CALC_AVX512_PD, avx2SelectPd)
+
+//x^y for floats goes through the double kernels of the same instruction set.
+static void ssePowerPs(const float* a, const float* b, float* out, size_t count)
+{
+    powerPs(sseLogPd, sseExpPd, a, b, out, count);
+}
+
+static void avx2PowerPs(const float* a, const float* b, float* out, size_t count)
+{
+    powerPs(avx2LogPd, avx2ExpPd, a, b, out, count);
+}
+
+static void avx512PowerPs(const float* a, const float* b, float* out, size_t count)
+{
+    powerPs(avx512LogPd, avx512ExpPd, a, b, out, count);
+}
+
+//NAME: hasAvx2
+//DESCRIPTION:  Checks to see if both the processor and the operating system support AVX2.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the AVX2 kernels can be used.
+static bool hasAvx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    //The processor has to support AVX and the operating system has to save the YMM registers.
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    //The compiler's check already makes sure the operating system saves the YMM registers.
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+
+//NAME: hasAvx512
+//DESCRIPTION:  Checks to see if both the processor and the operating system support AVX-512F.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the AVX-512 kernels can be used.
+static bool hasAvx512()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+        return false;
+
+    //The operating system has to save the mask registers and all 512 bits of all 32 ZMM registers.
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    if (!osxsave || (_xgetbv(0) & 0xe6) != 0xe6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 16)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512f") != 0;
+#endif
+}
+#endif
+
+#if defined(CALC_NEON)
+//vminq and vmaxq give NaN if either lane is one, min() and max() the second operand.
+static inline float32x4_t neonMinPs(float32x4_t a, float32x4_t b) { return vbslq_f32(vcltq_f32(a, b), a, b); }
+static inline float32x4_t neonMaxPs(float32x4_t a, float32x4_t b) { return vbslq_f32(vcgtq_f32(a, b), a, b); }
+static inline float64x2_t neonMinPd(float64x2_t a, float64x2_t b) { return vbslq_f64(vcltq_f64(a, b), a, b); }
+static inline float64x2_t neonMaxPd(float64x2_t a, float64x2_t b) { return vbslq_f64(vcgtq_f64(a, b), a, b); }
+
+//The operations of CALC_EXP_PD and the others.
+#define CALC_NEON_PD_LOAD(p)            vld1q_f64(p)
+#define CALC_NEON_PD_STORE(p, v)        vst1q_f64(p, v)
+#define CALC_NEON_PD_SET(c)             vdupq_n_f64(c)
+#define CALC_NEON_PD_ADD(a, b)          vaddq_f64(a, b)
+#define CALC_NEON_PD_SUB(a, b)          vsubq_f64(a, b)
+#define CALC_NEON_PD_MUL(a, b)          vmulq_f64(a, b)
+#define CALC_NEON_PD_DIV(a, b)          vdivq_f64(a, b)
+#define CALC_NEON_PD_MIN(a, b)          vminq_f64(a, b)
+#define CALC_NEON_PD_MAX(a, b)          vmaxq_f64(a, b)
+#define CALC_NEON_PD_EQ(a, b)           vceqq_f64(a, b)
+#define CALC_NEON_PD_LT(a, b)           vcltq_f64(a, b)
+#define CALC_NEON_PD_LE(a, b)           vcleq_f64(a, b)
+#define CALC_NEON_PD_GT(a, b)           vcgtq_f64(a, b)
+#define CALC_NEON_PD_GE(a, b)           vcgeq_f64(a, b)
+#define CALC_NEON_PD_NE(a, b)           vreinterpretq_u64_u32(vmvnq_u32(vreinterpretq_u32_u64(vceqq_f64(a, b))))
+#define CALC_NEON_PD_TRUTH(mask)        vreinterpretq_f64_u64(vandq_u64(mask, vreinterpretq_u64_f64(vdupq_n_f64(1.0))))
+#define CALC_NEON_PD_SELECT(mask, a, b) vbslq_f64(mask, a, b)
+#define CALC_NEON_PD_IADD(v, c)         vreinterpretq_f64_u64(vaddq_u64(vreinterpretq_u64_f64(v), vdupq_n_u64(c)))
+#define CALC_NEON_PD_IAND(v, c)         vreinterpretq_f64_u64(vandq_u64(vreinterpretq_u64_f64(v), vdupq_n_u64(c)))
+#define CALC_NEON_PD_IOR(v, c)          vreinterpretq_f64_u64(vorrq_u64(vreinterpretq_u64_f64(v), vdupq_n_u64(c)))
+#define CALC_NEON_PD_ISHL(v, bits)      vreinterpretq_f64_u64(vshlq_n_u64(vreinterpretq_u64_f64(v), bits))
+#define CALC_NEON_PD_ISHR(v, bits)      vreinterpretq_f64_u64(vshrq_n_u64(vreinterpretq_u64_f64(v), bits))
+
+#define CALC_NEON_PS_LOAD(p)            vld1q_f32(p)
+#define CALC_NEON_PS_STORE(p, v)        vst1q_f32(p, v)
+#define CALC_NEON_PS_SET(c)             vdupq_n_f32(c)
+#define CALC_NEON_PS_ADD(a, b)          vaddq_f32(a, b)
+#define CALC_NEON_PS_SUB(a, b)          vsubq_f32(a, b)
+#define CALC_NEON_PS_MUL(a, b)          vmulq_f32(a, b)
+#define CALC_NEON_PS_DIV(a, b)          vdivq_f32(a, b)
+#define CALC_NEON_PS_MIN(a, b)          vminq_f32(a, b)
+#define CALC_NEON_PS_MAX(a, b)          vmaxq_f32(a, b)
+#define CALC_NEON_PS_EQ(a, b)           vceqq_f32(a, b)
+#define CALC_NEON_PS_LT(a, b)           vcltq_f32(a, b)
+#define CALC_NEON_PS_LE(a, b)           vcleq_f32(a, b)
+#define CALC_NEON_PS_GT(a, b)           vcgtq_f32(a, b)
+#define CALC_NEON_PS_GE(a, b)           vcgeq_f32(a, b)
+#define CALC_NEON_PS_NE(a, b)           vmvnq_u32(vceqq_f32(a, b))
+#define CALC_NEON_PS_TRUTH(mask)        vreinterpretq_f32_u32(vandq_u32(mask, vreinterpretq_u32_f32(vdupq_n_f32(1.0f))))
+#define CALC_NEON_PS_SELECT(mask, a, b) vbslq_f32(mask, a, b)
+#define CALC_NEON_PS_IADD(v, c)         vreinterpretq_f32_u32(vaddq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(c)))
+#define CALC_NEON_PS_IAND(v, c)         vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(c)))
+#define CALC_NEON_PS_IOR(v, c)          vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(v), vdupq_n_u32(c)))
+#define CALC_NEON_PS_ISHL(v, bits)      vreinterpretq_f32_u32(vshlq_n_u32(vreinterpretq_u32_f32(v), bits))
+#define CALC_NEON_PS_ISHR(v, bits)      vreinterpretq_f32_u32(vshrq_n_u32(vreinterpretq_u32_f32(v), bits))
+
+//NEON - four floats or two doubles at a time.  Every AArch64 processor has it.
+CALC_VECTOR_UNARY(neonNegatePs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, vnegq_f32, scalarNegate<float>)
+CALC_VECTOR_BINARY(neonAddPs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, vaddq_f32, scalarAdd<float>)
+CALC_VECTOR_BINARY(neonSubtractPs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, vsubq_f32, scalarSubtract<float>)
+CALC_VECTOR_BINARY(neonMultiplyPs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, vmulq_f32, scalarMultiply<float>)
+CALC_VECTOR_BINARY(neonDividePs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, vdivq_f32, scalarDivide<float>)
+CALC_VECTOR_BINARY(neonMinimumPs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, neonMinPs, scalarMin<float>)
+CALC_VECTOR_BINARY(neonMaximumPs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, neonMaxPs, scalarMax<float>)
+CALC_VECTOR_UNARY(neonSqrtPs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, vsqrtq_f32, scalarSqrt<float>)
+CALC_VECTOR_UNARY(neonAbsPs, , float, 4, float32x4_t, vld1q_f32, vst1q_f32, vabsq_f32, scalarAbs<float>)
+CALC_VECTOR_LANES(neonExpPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, CALC_EXP_PS, scalarExp<float>)
+CALC_VECTOR_LANES(neonLogPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, CALC_LOG_PS, scalarLog<float>)
+CALC_VECTOR_COMPARE(neonLessPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, LT, scalarLess<float>)
+CALC_VECTOR_COMPARE(neonLessEqualPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, LE, scalarLessEqual<float>)
+CALC_VECTOR_COMPARE(neonGreaterPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, GT, scalarGreater<float>)
+CALC_VECTOR_COMPARE(neonGreaterEqualPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, GE, scalarGreaterEqual<float>)
+CALC_VECTOR_COMPARE(neonEqualPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, EQ, scalarEqual<float>)
+CALC_VECTOR_COMPARE(neonNotEqualPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, NE, scalarNotEqual<float>)
+CALC_VECTOR_SELECT(neonSelectPs, , float, 4, float32x4_t, uint32x4_t, CALC_NEON_PS, scalarSelect<float>)
+
+CALC_VECTOR_UNARY(neonNegatePd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, vnegq_f64, scalarNegate<double>)
+CALC_VECTOR_BINARY(neonAddPd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, vaddq_f64, scalarAdd<double>)
+CALC_VECTOR_BINARY(neonSubtractPd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, vsubq_f64, scalarSubtract<double>)
+CALC_VECTOR_BINARY(neonMultiplyPd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, vmulq_f64, scalarMultiply<double>)
+CALC_VECTOR_BINARY(neonDividePd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, vdivq_f64, scalarDivide<double>)
+CALC_VECTOR_BINARY(neonMinimumPd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, neonMinPd, scalarMin<double>)
+CALC_VECTOR_BINARY(neonMaximumPd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, neonMaxPd, scalarMax<double>)
+CALC_VECTOR_UNARY(neonSqrtPd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, vsqrtq_f64, scalarSqrt<double>)
+CALC_VECTOR_UNARY(neonAbsPd, , double, 2, float64x2_t, vld1q_f64, vst1q_f64, vabsq_f64, scalarAbs<double>)
+CALC_VECTOR_LANES(neonExpPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, CALC_EXP_PD, scalarExp<double>)
+CALC_VECTOR_LANES(neonLogPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, CALC_LOG_PD, scalarLog<double>)
+CALC_VECTOR_COMPARE(neonLessPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, LT, scalarLess<double>)
+CALC_VECTOR_COMPARE(neonLessEqualPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, LE, scalarLessEqual<double>)
+CALC_VECTOR_COMPARE(neonGreaterPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, GT, scalarGreater<double>)
+CALC_VECTOR_COMPARE(neonGreaterEqualPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, GE, scalarGreaterEqual<double>)
+CALC_VECTOR_COMPARE(neonEqualPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, EQ, scalarEqual<double>)
+CALC_VECTOR_COMPARE(neonNotEqualPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, NE, scalarNotEqual<double>)
+CALC_VECTOR_SELECT(neonSelectPd, , double, 2, float64x2_t, uint64x2_t, CALC_NEON_PD, scalarSelect<double>)
+
+static void neonPowerPs(const float* a, const float* b, float* out, size_t count)
+{
+    powerPs(neonLogPd, neonExpPd, a, b, out, count);
+}
+#endif
+
+//NAME: scalarKernels
+//DESCRIPTION:  The plain C++ kernels, for checking the vector ones against.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The scalar kernels.
+template <typename T>
+const BatchKernels<T>& scalarKernels()
+{
+    static const BatchKernels<T> kernels = { "scalar", scalarNegate<T>, scalarAdd<T>, scalarSubtract<T>, scalarMultiply<T>, scalarDivide<T>,
+                                             scalarPowerKernel<T>, scalarMin<T>, scalarMax<T>, scalarSqrt<T>, scalarExp<T>, scalarLog<T>, scalarAbs<T>,
+                                             scalarLess<T>, scalarLessEqual<T>, scalarGreater<T>, scalarGreaterEqual<T>, scalarEqual<T>, scalarNotEqual<T>, scalarSelect<T> };
+    return kernels;
+}
+
+template const BatchKernels<float>& scalarKernels<float>();
+template const BatchKernels<double>& scalarKernels<double>();
+
+//NAME: nthSupported
+//DESCRIPTION:  Picks one of the kernel sets the processor supports.
+//INPUT:
+//    sets      - Every set built for this processor architecture, widest first.
+//    supported - Whether the processor can run each of them.
+//    count     - How many there are.
+//    index     - Which of the supported ones to give, 0 for the widest.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The set, NULL if there are no more.
+template <typename T>
+static const BatchKernels<T>* nthSupported(const BatchKernels<T>* const* sets, const bool* supported, int count, int index)
+{
+    for (int set = 0; set < count; set++)
+    {
+        if (supported[set] && index-- == 0)
+            return sets[set];
+    }
+
+    return NULL;
+}
+
+//NAME: supportedKernels
+//DESCRIPTION:  The vector kernels of every instruction set this processor can run, widest first.  Each one
+//              was compiled for its own instruction set, so one build runs the best of them everywhere.
+//INPUT:
+//    index - Which of them to give, from 0.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The kernels, NULL past the last, and for index 0 if there are no vector kernels at all.
+template <>
+const BatchKernels<float>* supportedKernels<float>(int index)
+{
+#if defined(CALC_X86)
+    static const BatchKernels<float> avx512 = { "avx512", avx512NegatePs, avx512AddPs, avx512SubtractPs, avx512MultiplyPs, avx512DividePs,
+                                                avx512PowerPs, avx512MinPs, avx512MaxPs, avx512SqrtPs, avx512ExpPs, avx512LogPs, avx512AbsPs,
+                                                avx512LessPs, avx512LessEqualPs, avx512GreaterPs, avx512GreaterEqualPs, avx512EqualPs, avx512NotEqualPs, avx512SelectPs };
+    static const BatchKernels<float> avx2 = { "avx2", avx2NegatePs, avx2AddPs, avx2SubtractPs, avx2MultiplyPs, avx2DividePs,
+                                              avx2PowerPs, avx2MinPs, avx2MaxPs, avx2SqrtPs, avx2ExpPs, avx2LogPs, avx2AbsPs,
+                                              avx2LessPs, avx2LessEqualPs, avx2GreaterPs, avx2GreaterEqualPs, avx2EqualPs, avx2NotEqualPs, avx2SelectPs };
+    static const BatchKernels<float> sse = { "sse", sseNegatePs, sseAddPs, sseSubtractPs, sseMultiplyPs, sseDividePs,
+                                             ssePowerPs, sseMinPs, sseMaxPs, sseSqrtPs, sseExpPs, sseLogPs, sseAbsPs,
+                                             sseLessPs, sseLessEqualPs, sseGreaterPs, sseGreaterEqualPs, sseEqualPs, sseNotEqualPs, sseSelectPs };
+
+    static const BatchKernels<float>* const sets[] = { &avx512, &avx2, &sse };
+    static const bool supported[] = { hasAvx512(), hasAvx2(), true };
+    return nthSupported(sets, supported, 3, index);
+#elif defined(CALC_NEON)
+    static const BatchKernels<float> neon = { "neon", neonNegatePs, neonAddPs, neonSubtractPs, neonMultiplyPs, neonDividePs,
+                                              neonPowerPs, neonMinimumPs, neonMaximumPs, neonSqrtPs, neonExpPs, neonLogPs, neonAbsPs,
+                                              neonLessPs, neonLessEqualPs, neonGreaterPs, neonGreaterEqualPs, neonEqualPs, neonNotEqualPs, neonSelectPs };
+    return index == 0 ? &neon : NULL;
+#else
+    return NULL;
+#endif
+}
+
+template <>
+const BatchKernels<double>* supportedKernels<double>(int index)
+{
+#if defined(CALC_X86)
+    static const BatchKernels<double> avx512 = { "avx512", avx512NegatePd, avx512AddPd, avx512SubtractPd, avx512MultiplyPd, avx512DividePd,
+                                                 scalarPower<double>, avx512MinPd, avx512MaxPd, avx512SqrtPd, avx512ExpPd, avx512LogPd, avx512AbsPd,
+                                                 avx512LessPd, avx512LessEqualPd, avx512GreaterPd, avx512GreaterEqualPd, avx512EqualPd, avx512NotEqualPd, avx512SelectPd };
+    static const BatchKernels<double> avx2 = { "avx2", avx2NegatePd, avx2AddPd, avx2SubtractPd, avx2MultiplyPd, avx2DividePd,
+                                               scalarPower<double>, avx2MinPd, avx2MaxPd, avx2SqrtPd, avx2ExpPd, avx2LogPd, avx2AbsPd,
+                                               avx2LessPd, avx2LessEqualPd, avx2GreaterPd, avx2GreaterEqualPd, avx2EqualPd, avx2NotEqualPd, avx2SelectPd };
+    static const BatchKernels<double> sse = { "sse", sseNegatePd, sseAddPd, sseSubtractPd, sseMultiplyPd, sseDividePd,
+                                              scalarPower<double>, sseMinPd, sseMaxPd, sseSqrtPd, sseExpPd, sseLogPd, sseAbsPd,
+                                              sseLessPd, sseLessEqualPd, sseGreaterPd, sseGreaterEqualPd, sseEqualPd, sseNotEqualPd, sseSelectPd };
+
+    static const BatchKernels<double>* const sets[] = { &avx512, &avx2, &sse };
+    static const bool supported[] = { hasAvx512(), hasAvx2(), true };
+    return nthSupported(sets, supported, 3, index);
+#elif defined(CALC_NEON)
+    static const BatchKernels<double> neon = { "neon", neonNegatePd, neonAddPd, neonSubtractPd, neonMultiplyPd, neonDividePd,
+                                               scalarPower<double>, neonMinimumPd, neonMaximumPd, neonSqrtPd, neonExpPd, neonLogPd, neonAbsPd,
+                                               neonLessPd, neonLessEqualPd, neonGreaterPd, neonGreaterEqualPd, neonEqualPd, neonNotEqualPd, neonSelectPd };
+    return index == 0 ? &neon : NULL;
+#else
+    return NULL;
+#endif
+}
+
+//NAME: selectKernels
+//DESCRIPTION:  Picks the widest kernels this processor can run.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The kernels to use.
+template <typename T>
+static const BatchKernels<T>& selectKernels()
+{
+    const BatchKernels<T>* widest = supportedKernels<T>(0);
+    return widest != NULL ? *widest : scalarKernels<T>();
+}
+
+//NAME: batchKernels
+//DESCRIPTION:  The kernels the batch evaluator uses.  The processor is only checked the first time.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The best kernels for this processor.
+template <typename T>
+const BatchKernels<T>& batchKernels()
+{
+    static const BatchKernels<T>& kernels = selectKernels<T>();
+    return kernels;
+}
+
+template const BatchKernels<float>& batchKernels<float>();
+template const BatchKernels<double>& batchKernels<double>();
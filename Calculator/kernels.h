@@ -0,0 +1,73 @@
+#ifndef CALCULATOR_KERNELS_H
+#define CALCULATOR_KERNELS_H
+
+#include <cstddef>
+
+//The batch evaluator runs every instruction over a whole block of rows at once.  The loops doing
+//that work are written once per instruction set (plain C++, SSE, AVX2, AVX-512 and NEON) and the best
+//one the processor supports is picked the first time batchKernels() is called.  Each function is
+//compiled for its own instruction set while the rest of the program is compiled for the oldest
+//processor it should run on, so the same binary runs AVX-512 where there is AVX-512 and SSE where
+//there is nothing better.
+//
+//exp() and log() are the only operations without an instruction of their own.  They are done with the
+//polynomials fdlibm uses, which need nothing but arithmetic, comparisons and integer operations on the
+//bits, so they vectorize like everything else.  Measured against the exact answer over millions of
+//arguments, every instruction set included, and including denormals, the results are within 1 ULP for
+//doubles and 0.9 ULP for floats.  Infinities, NaNs, 0 and negative numbers give what std::exp() and
+//std::log() give.  x ^ y for floats is exp(y log(x)) worked out in double, within 0.5 ULP; for doubles
+//that wouldn't be accurate enough, so each lane calls std::pow().
+//
+//Comparisons give 1 or 0 in every lane, as applyFunction() does.  Conditionals are run over every lane
+//of a block whose condition doesn't go the same way everywhere, and select() picks each lane's answer.
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CALC_X86 1
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define CALC_NEON 1
+#endif
+
+//NAME: BatchKernels
+//DESCRIPTION:  One implementation of every operation the batch evaluator needs, for lanes of type T
+//              (float or double).  Each function works through count lanes: out[i] = a[i] op b[i],
+//              and for select() out[i] = condition[i] != 0 ? a[i] : b[i].  out may be the same array as
+//              any of them.
+template <typename T>
+struct BatchKernels
+{
+    const char* name;
+
+    void (*negate)(const T* a, T* out, size_t count);
+    void (*add)(const T* a, const T* b, T* out, size_t count);
+    void (*subtract)(const T* a, const T* b, T* out, size_t count);
+    void (*multiply)(const T* a, const T* b, T* out, size_t count);
+    void (*divide)(const T* a, const T* b, T* out, size_t count);
+    void (*power)(const T* a, const T* b, T* out, size_t count);
+    void (*minimum)(const T* a, const T* b, T* out, size_t count);
+    void (*maximum)(const T* a, const T* b, T* out, size_t count);
+    void (*squareRoot)(const T* a, T* out, size_t count);
+    void (*exponential)(const T* a, T* out, size_t count);
+    void (*logarithm)(const T* a, T* out, size_t count);
+    void (*absolute)(const T* a, T* out, size_t count);
+    void (*less)(const T* a, const T* b, T* out, size_t count);
+    void (*lessEqual)(const T* a, const T* b, T* out, size_t count);
+    void (*greater)(const T* a, const T* b, T* out, size_t count);
+    void (*greaterEqual)(const T* a, const T* b, T* out, size_t count);
+    void (*equal)(const T* a, const T* b, T* out, size_t count);
+    void (*notEqual)(const T* a, const T* b, T* out, size_t count);
+    void (*select)(const T* condition, const T* a, const T* b, T* out, size_t count);
+};
+
+//Function declarations
+template <typename T>
+const BatchKernels<T>& scalarKernels();
+
+template <typename T>
+const BatchKernels<T>* supportedKernels(int index);
+
+template <typename T>
+const BatchKernels<T>& batchKernels();
+
+#endif
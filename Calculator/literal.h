@@ -0,0 +1,728 @@
+#ifndef CALCULATOR_LITERAL_H
+#define CALCULATOR_LITERAL_H
+
+#include <bit>
+#include <cfloat>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <system_error>
+#include <type_traits>
+
+#include "characters.h"
+
+//Converting a literal such as 3.08 or 1e-9 from text is the most expensive thing the parser does, so it
+//is done in two steps which both avoid floating point arithmetic for as long as possible:
+//  1. scanDecimal() reads the digits into a 64 bit integer mantissa and a power of ten:
+//         "12.345e2" -> 12345 and 10^(2 - 3)
+//     Runs of eight digits are converted at once with a handful of integer multiplications (SWAR).
+//  2. DecimalConverter<T> turns the mantissa and power of ten into T.  When both are small enough to be
+//     represented exactly (the common case), a single multiplication or division gives the correctly
+//     rounded answer (Clinger's fast path).  Anything else is handed to std::from_chars, which is slower
+//     but always correctly rounded.
+//
+//Both steps can also run while compiling (see solveConstant() in parser.h).  from_chars can't, so in that
+//case every literal is converted exactly with big integers by exactDecimal() instead, which is slow but
+//gives the same bits the running program would.
+//
+//Reading eight digits at once may read up to seven bytes past the end of the literal.  This is only done
+//when those bytes are on the same memory page as the literal so it can never fault; it is turned off
+//for builds with the address sanitizer, which can't tell the difference, or by defining CALC_NO_OVERREAD
+//(see characters.h).
+
+//A 64 bit mantissa holds any 19 digit number.
+static const int kMaxMantissaDigits = 19;
+
+//NAME: DecimalLiteral
+//DESCRIPTION:  A literal split into value = mantissa * 10^exponent.
+//              truncated is set when there were more significant digits than the mantissa holds;
+//              begin and end then still point at the text so it can be converted exactly.
+struct DecimalLiteral
+{
+    uint64_t mantissa;
+    int exponent;
+    bool truncated;
+    const char* begin;
+    const char* end;
+};
+
+//NAME: canReadEight
+//DESCRIPTION:  Checks to see if eight bytes can be loaded starting at p without crossing into the next
+//              memory page, which might not exist.
+//INPUT:
+//    p - Where the load would start.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the load is safe.
+constexpr bool canReadEight(const char* p)
+{
+    //Nothing can be read as a word while compiling.
+    if (std::is_constant_evaluated())
+        return false;
+
+#if defined(CALC_NO_OVERREAD)
+    (void)p;
+    return false;
+#else
+    return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - 8;
+#endif
+}
+
+//NAME: loadEight
+//DESCRIPTION:  Loads eight characters so that the first one is in the lowest byte.
+//INPUT:
+//    p - The characters to load.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The characters as one little endian word.
+inline uint64_t loadEight(const char* p)
+{
+    uint64_t chunk;
+    memcpy(&chunk, p, sizeof(chunk));
+    if constexpr (std::endian::native == std::endian::big)
+        chunk = ((chunk & 0x00000000FFFFFFFFull) << 32) | ((chunk & 0xFFFFFFFF00000000ull) >> 32),
+        chunk = ((chunk & 0x0000FFFF0000FFFFull) << 16) | ((chunk & 0xFFFF0000FFFF0000ull) >> 16),
+        chunk = ((chunk & 0x00FF00FF00FF00FFull) << 8) | ((chunk & 0xFF00FF00FF00FF00ull) >> 8);
+
+    return chunk;
+}
+
+//NAME: isEightDigits
+//DESCRIPTION:  Checks to see if all eight characters in a word are between '0' and '9'.
+//              Every byte must be 0x30 - 0x39: the high nibble is 3, and adding 6 doesn't carry into it.
+//INPUT:
+//    chunk - The characters from loadEight().
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if all eight are digits.
+inline bool isEightDigits(uint64_t chunk)
+{
+    return (((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4))
+            == 0x3333333333333333ull);
+}
+
+//NAME: parseEightDigits
+//DESCRIPTION:  Converts eight digits to their value.  Neighbouring digits are combined into pairs,
+//              the pairs into groups of four and those into the final eight with one multiplication each.
+//INPUT:
+//    chunk - Eight digits from loadEight().
+//OUTPUT:
+//    none
+//RETURNS:
+//    The value of the digits, 0 - 99999999.
+inline uint32_t parseEightDigits(uint64_t chunk)
+{
+    chunk = (chunk & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+    chunk = (chunk & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+    return (uint32_t)((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32);
+}
+
+//NAME: scanDigits
+//DESCRIPTION:  Adds a run of digits to the mantissa.  Every digit after the decimal point that makes it into
+//              the mantissa scales it down by ten, and every digit before the point that doesn't fit scales
+//              it up by ten.  Leading zeros don't use up any room.
+//INPUT:
+//    fraction - True if the digits are after the decimal point.
+//INPUT/OUTPUT:
+//    p        - The first digit, left after the last one.
+//    literal  - The mantissa, exponent and truncated flag to update.
+//    digits   - How many significant digits the mantissa holds so far.
+//OUTPUT:
+//    none
+//RETURNS:
+//    How many digits were found, whether they fit or not.
+constexpr int scanDigits(const char*& p, bool fraction, DecimalLiteral& literal, int& digits)
+{
+    const char* start = p;
+
+    while (digits + 8 <= kMaxMantissaDigits && canReadEight(p))
+    {
+        uint64_t chunk = loadEight(p);
+        if (!isEightDigits(chunk))
+            break;
+
+        literal.mantissa = literal.mantissa * 100000000 + parseEightDigits(chunk);
+        if (literal.mantissa != 0)
+            digits += 8;
+        if (fraction)
+            literal.exponent -= 8;
+
+        p += 8;
+    }
+
+    while (digits < kMaxMantissaDigits && *p >= '0' && *p <= '9')
+    {
+        literal.mantissa = literal.mantissa * 10 + (uint64_t)(*p - '0');
+        if (literal.mantissa != 0)
+            digits++;
+        if (fraction)
+            literal.exponent--;
+
+        p++;
+    }
+
+    if (*p >= '0' && *p <= '9')
+    {
+        //The mantissa is full, the rest of the digits only count.  A dropped zero doesn't change the
+        //value, anything else does.
+        const char* rest = p;
+        bool nonZero = false;
+        p = skipDigits(p, nonZero);
+        if (nonZero)
+            literal.truncated = true;
+        if (!fraction)
+            literal.exponent += (int)(p - rest);
+    }
+
+    return (int)(p - start);
+}
+
+//Exponents are held here once they are past it, which is beyond the range of every type a literal is
+//converted to, Decimal128's +-999999999 included, so a literal held there is still infinity or zero
+//whatever its digits are.
+static const int kMaxLiteralExponent = 1 << 30;
+
+//NAME: scanDecimal
+//DESCRIPTION:  Reads a literal without a sign: digits, an optional decimal point followed by more digits,
+//              and an optional exponent (e or E, an optional sign, and at least one digit).
+//              A second decimal point ends the literal, as in 12.3.5
+//INPUT:
+//    eq      - The first character of the literal.
+//OUTPUT:
+//    literal - The mantissa and exponent.  literal.end is where the scan stopped, eq if there were no digits.
+//RETURNS:
+//    none
+constexpr void scanDecimal(const char* eq, DecimalLiteral& literal)
+{
+    literal.mantissa = 0;
+    literal.exponent = 0;
+    literal.truncated = false;
+    literal.begin = eq;
+
+    const char* p = eq;
+    int digits = 0;
+    int found = scanDigits(p, false, literal, digits);
+    if (*p == '.')
+    {
+        p++;
+        found += scanDigits(p, true, literal, digits);
+    }
+
+    if (found == 0)
+    {
+        literal.end = eq;
+        return;
+    }
+
+    //The exponent only belongs to the literal if there is at least one digit in it.
+    if (*p == 'e' || *p == 'E')
+    {
+        const char* q = p + 1;
+        bool negative = false;
+        if (*q == '+' || *q == '-')
+        {
+            negative = (*q == '-');
+            q++;
+        }
+
+        if (*q >= '0' && *q <= '9')
+        {
+            int64_t value = 0;
+            while (*q >= '0' && *q <= '9')
+            {
+                //Anything this big is infinity or zero anyway, there is no need to keep counting.
+                if (value < kMaxLiteralExponent)
+                    value = value * 10 + (*q - '0');
+                q++;
+            }
+
+            int64_t exponent = literal.exponent + (negative ? -value : value);
+            if (exponent > kMaxLiteralExponent)
+                exponent = kMaxLiteralExponent;
+            if (exponent < -kMaxLiteralExponent)
+                exponent = -kMaxLiteralExponent;
+
+            literal.exponent = (int)exponent;
+            p = q;
+        }
+    }
+
+    literal.end = p;
+}
+
+//The powers of ten every floating point type represents exactly.
+template <typename T>
+inline constexpr T kExactPowersOfTen[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+//NAME: exactPowerOfTen
+//DESCRIPTION:  10^exponent for the exponents T represents exactly.
+template <typename T>
+constexpr T exactPowerOfTen(int exponent)
+{
+    return kExactPowersOfTen<T>[exponent];
+}
+
+//NAME: fromCharsFallback
+//DESCRIPTION:  Converts the literal's text exactly, for the cases the fast path can't handle.
+template <typename T>
+inline T fromCharsFallback(const DecimalLiteral& literal)
+{
+    T value = 0;
+    std::from_chars_result result = std::from_chars(literal.begin, literal.end, value, std::chars_format::general);
+
+    //from_chars doesn't touch the value if it's out of range.  The mantissa has at most 19 digits,
+    //which is nowhere near enough to matter, so it's the exponent that decides which way it went.
+    if (result.ec == std::errc::result_out_of_range)
+        return literal.exponent > 0 ? std::numeric_limits<T>::infinity() : T(0);
+
+    return value;
+}
+
+//More significant digits than any double needs to be rounded correctly.  Any digits after these only
+//count for being there, see exactDecimal().
+static const int kMaxExactDigits = 800;
+
+//NAME: WideInteger
+//DESCRIPTION:  An unsigned integer of up to Limbs * 32 bits, with just the operations exactDecimal() and
+//              Decimal128 need.
+//              The limbs are stored lowest first; size is how many of them are in use.
+template <int Limbs>
+struct WideInteger
+{
+    constexpr WideInteger() : limbs(), size(0) {}
+
+    constexpr bool isZero() const { return size == 0; }
+
+    constexpr void multiplyAdd(uint32_t factor, uint32_t addend)
+    {
+        uint64_t carry = addend;
+        for (int i = 0; i < size; i++)
+        {
+            uint64_t product = (uint64_t)limbs[i] * factor + carry;
+            limbs[i] = (uint32_t)product;
+            carry = product >> 32;
+        }
+
+        if (carry != 0)
+            limbs[size++] = (uint32_t)carry;
+    }
+
+    constexpr void multiplyPowerOfTen(int exponent)
+    {
+        for (; exponent >= 9; exponent -= 9)
+            multiplyAdd(1000000000, 0);
+        for (; exponent > 0; exponent--)
+            multiplyAdd(10, 0);
+    }
+
+    constexpr void shiftLeft(int bits)
+    {
+        if (size == 0)
+            return;
+
+        int words = bits / 32;
+        bits %= 32;
+        for (int i = size - 1; i >= 0; i--)
+            limbs[i + words] = limbs[i];
+        for (int i = 0; i < words; i++)
+            limbs[i] = 0;
+        size += words;
+
+        if (bits != 0)
+        {
+            uint32_t carry = 0;
+            for (int i = words; i < size; i++)
+            {
+                uint32_t limb = limbs[i];
+                limbs[i] = (limb << bits) | carry;
+                carry = limb >> (32 - bits);
+            }
+
+            if (carry != 0)
+                limbs[size++] = carry;
+        }
+    }
+
+    constexpr void shiftRight(int bits)
+    {
+        int words = bits / 32;
+        bits %= 32;
+        if (words >= size)
+        {
+            size = 0;
+            return;
+        }
+
+        for (int i = 0; i + words < size; i++)
+        {
+            uint32_t high = (bits != 0 && i + words + 1 < size) ? limbs[i + words + 1] << (32 - bits) : 0;
+            limbs[i] = (limbs[i + words] >> bits) | high;
+        }
+
+        size -= words;
+        while (size > 0 && limbs[size - 1] == 0)
+            size--;
+    }
+
+    constexpr int bitLength() const
+    {
+        if (size == 0)
+            return 0;
+
+        return (size - 1) * 32 + (32 - std::countl_zero(limbs[size - 1]));
+    }
+
+    constexpr bool bit(int index) const { return index / 32 < size && ((limbs[index / 32] >> (index % 32)) & 1) != 0; }
+
+    constexpr void setBit(int index)
+    {
+        while (size <= index / 32)
+            limbs[size++] = 0;
+        limbs[index / 32] |= (uint32_t)1 << (index % 32);
+    }
+
+    constexpr bool anyBitBelow(int index) const
+    {
+        for (int i = 0; i < size && i * 32 < index; i++)
+        {
+            uint32_t mask = index - i * 32 >= 32 ? 0xFFFFFFFFu : (((uint32_t)1 << (index - i * 32)) - 1);
+            if ((limbs[i] & mask) != 0)
+                return true;
+        }
+
+        return false;
+    }
+
+    constexpr bool isLess(const WideInteger& other) const
+    {
+        if (size != other.size)
+            return size < other.size;
+
+        for (int i = size - 1; i >= 0; i--)
+        {
+            if (limbs[i] != other.limbs[i])
+                return limbs[i] < other.limbs[i];
+        }
+
+        return false;
+    }
+
+    constexpr void add(const WideInteger& other)
+    {
+        int longest = size > other.size ? size : other.size;
+        uint64_t carry = 0;
+        for (int i = 0; i < longest; i++)
+        {
+            uint64_t sum = (uint64_t)(i < size ? limbs[i] : 0) + (i < other.size ? other.limbs[i] : 0) + carry;
+            limbs[i] = (uint32_t)sum;
+            carry = sum >> 32;
+        }
+
+        size = longest;
+        if (carry != 0)
+            limbs[size++] = (uint32_t)carry;
+    }
+
+    //Leaves the quotient and returns the remainder.
+    constexpr uint32_t divideSmall(uint32_t divisor)
+    {
+        uint64_t remainder = 0;
+        for (int i = size - 1; i >= 0; i--)
+        {
+            uint64_t dividend = (remainder << 32) | limbs[i];
+            limbs[i] = (uint32_t)(dividend / divisor);
+            remainder = dividend % divisor;
+        }
+
+        while (size > 0 && limbs[size - 1] == 0)
+            size--;
+
+        return (uint32_t)remainder;
+    }
+
+    //Only for other <= *this.
+    constexpr void subtract(const WideInteger& other)
+    {
+        int64_t borrow = 0;
+        for (int i = 0; i < size; i++)
+        {
+            int64_t difference = (int64_t)limbs[i] - (i < other.size ? other.limbs[i] : 0) - borrow;
+            borrow = difference < 0;
+            limbs[i] = (uint32_t)(difference + (borrow << 32));
+        }
+
+        while (size > 0 && limbs[size - 1] == 0)
+            size--;
+    }
+
+    uint32_t limbs[Limbs];
+    int size;
+};
+
+//NAME: exactDecimal
+//DESCRIPTION:  Converts a literal to the nearest T, ties to even, with arbitrary precision arithmetic.
+//              The value scaled by a power of two is divided into an integer q with a couple more bits
+//              than T holds, and q is then rounded to T's precision (less for denormals) with whatever is
+//              left over deciding the ties.  This is the conversion used while compiling; it takes far
+//              too long for the running program, which has from_chars.
+//INPUT:
+//    literal - The literal; only its text is used.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The correctly rounded value.
+template <typename T>
+constexpr T exactDecimal(const DecimalLiteral& literal)
+{
+    typedef std::numeric_limits<T> Limits;
+
+    //Enough room for the largest numerator or denominator any literal in T's range can need.
+    constexpr int kLimbs = ((kMaxExactDigits + Limits::max_digits10 - Limits::min_exponent10 + Limits::max_exponent10 + 2) * 10 / 3
+                            + Limits::digits + 96) / 32;
+
+    //The digits become the integer digits * 10^exponent, digits beyond kMaxExactDigits a single 1.
+    WideInteger<kLimbs> numerator;
+    int exponent = 0;
+    int significant = 0;
+    bool dropped = false;
+    bool fraction = false;
+    const char* p = literal.begin;
+    for (; p < literal.end && *p != 'e' && *p != 'E'; p++)
+    {
+        if (*p == '.')
+        {
+            fraction = true;
+            continue;
+        }
+
+        if (significant == 0 && *p == '0')
+        {
+            if (fraction)
+                exponent--;
+            continue;
+        }
+
+        if (significant < kMaxExactDigits)
+        {
+            numerator.multiplyAdd(10, (uint32_t)(*p - '0'));
+            significant++;
+            if (fraction)
+                exponent--;
+        }
+        else
+        {
+            dropped = dropped || *p != '0';
+            if (!fraction)
+                exponent++;
+        }
+    }
+
+    if (p < literal.end)
+    {
+        p++;
+        bool negative = (*p == '-');
+        if (*p == '+' || *p == '-')
+            p++;
+
+        int value = 0;
+        for (; p < literal.end; p++)
+        {
+            if (value < 100000)
+                value = value * 10 + (*p - '0');
+        }
+
+        exponent += negative ? -value : value;
+    }
+
+    if (significant == 0)
+        return T(0);
+
+    if (dropped)
+    {
+        numerator.multiplyAdd(10, 1);
+        significant++;
+        exponent--;
+    }
+
+    //The value is at least 10^magnitude and less than 10^(magnitude + 1).
+    int magnitude = significant - 1 + exponent;
+    if (magnitude > Limits::max_exponent10)
+        return Limits::infinity();
+    if (magnitude < Limits::min_exponent10 - Limits::max_digits10)
+        return T(0);
+
+    WideInteger<kLimbs> denominator;
+    denominator.multiplyAdd(1, 1);
+    if (exponent >= 0)
+        numerator.multiplyPowerOfTen(exponent);
+    else
+        denominator.multiplyPowerOfTen(-exponent);
+
+    //Scale so that q = numerator * 2^scale / denominator has at least digits + 2 bits.
+    int scale = Limits::digits + 3 - (numerator.bitLength() - denominator.bitLength());
+    if (scale >= 0)
+        numerator.shiftLeft(scale);
+    else
+        denominator.shiftLeft(-scale);
+
+    //Long division one bit at a time.  The quotient only has the last few bits, everything above them is
+    //less than the denominator and can go straight into the remainder.
+    int bits = numerator.bitLength() - denominator.bitLength() + 1;
+    WideInteger<kLimbs> quotient;
+    WideInteger<kLimbs> remainder = numerator;
+    remainder.shiftRight(bits);
+    for (int i = bits - 1; i >= 0; i--)
+    {
+        remainder.shiftLeft(1);
+        if (numerator.bit(i))
+        {
+            if (remainder.isZero())
+                remainder.multiplyAdd(1, 1);
+            else
+                remainder.limbs[0] |= 1;
+        }
+
+        if (!remainder.isLess(denominator))
+        {
+            remainder.subtract(denominator);
+            quotient.setBit(i);
+        }
+    }
+
+    //The value is quotient * 2^-scale; keep as many bits as T has at that size.
+    const int length = quotient.bitLength();
+    const int top = length - 1 - scale;
+    int kept = Limits::digits;
+    if (top < Limits::min_exponent - 1)
+        kept -= Limits::min_exponent - 1 - top;
+    if (kept < 0)
+        return T(0);
+
+    int shift = length - kept;
+    uint64_t mantissa = 0;
+    for (int i = length - 1; i >= shift; i--)
+        mantissa = (mantissa << 1) | (quotient.bit(i) ? 1 : 0);
+
+    bool half = quotient.bit(shift - 1);
+    bool sticky = quotient.anyBitBelow(shift - 1) || !remainder.isZero();
+    if (half && (sticky || (mantissa & 1) != 0))
+    {
+        //All ones rounds up to the next power of two, which needs one bit more.
+        if (kept > 0 && mantissa == ~(uint64_t)0 >> (64 - kept))
+        {
+            mantissa = (uint64_t)1 << (kept - 1);
+            shift++;
+        }
+        else
+            mantissa++;
+    }
+
+    int power = shift - scale;
+    if (mantissa != 0 && (64 - std::countl_zero(mantissa)) - 1 + power > Limits::max_exponent - 1)
+        return Limits::infinity();
+
+    //Every step only changes the exponent, so none of them rounds.
+    T value = T(mantissa);
+    for (; power >= 32; power -= 32)
+        value *= T(4294967296.0);
+    for (; power <= -32; power += 32)
+        value *= T(1 / 4294967296.0);
+    for (; power > 0; power--)
+        value *= 2;
+    for (; power < 0; power++)
+        value /= 2;
+
+    return value;
+}
+
+//NAME: DecimalConverter
+//DESCRIPTION:  Turns a DecimalLiteral into a T.  Types without a specialization are converted through double.
+template <typename T>
+struct DecimalConverter
+{
+    static constexpr T convert(const DecimalLiteral& literal);
+};
+
+template <>
+struct DecimalConverter<double>
+{
+    static constexpr double convert(const DecimalLiteral& literal)
+    {
+        if (std::is_constant_evaluated())
+            return exactDecimal<double>(literal);
+
+        //The fast path needs the mantissa and power of ten to be exact doubles and every operation
+        //to be rounded to double, which isn't the case with x87 extended precision.
+#if FLT_EVAL_METHOD == 0
+        const uint64_t kMaxExact = (uint64_t)1 << 53;
+        if (!literal.truncated && literal.mantissa <= kMaxExact)
+        {
+            double mantissa = (double)literal.mantissa;
+            if (literal.mantissa == 0)
+                return 0;
+            if (literal.exponent >= 0 && literal.exponent <= 22)
+                return mantissa * exactPowerOfTen<double>(literal.exponent);
+            if (literal.exponent < 0 && literal.exponent >= -22)
+                return mantissa / exactPowerOfTen<double>(-literal.exponent);
+        }
+#endif
+
+        return fromCharsFallback<double>(literal);
+    }
+};
+
+template <>
+struct DecimalConverter<float>
+{
+    static constexpr float convert(const DecimalLiteral& literal)
+    {
+        if (std::is_constant_evaluated())
+            return exactDecimal<float>(literal);
+
+#if FLT_EVAL_METHOD == 0
+        const uint64_t kMaxExact = (uint64_t)1 << 24;
+        if (!literal.truncated && literal.mantissa <= kMaxExact)
+        {
+            float mantissa = (float)literal.mantissa;
+            if (literal.mantissa == 0)
+                return 0;
+            if (literal.exponent >= 0 && literal.exponent <= 10)
+                return mantissa * exactPowerOfTen<float>(literal.exponent);
+            if (literal.exponent < 0 && literal.exponent >= -10)
+                return mantissa / exactPowerOfTen<float>(-literal.exponent);
+        }
+#endif
+
+        return fromCharsFallback<float>(literal);
+    }
+};
+
+template <>
+struct DecimalConverter<long double>
+{
+    static constexpr long double convert(const DecimalLiteral& literal)
+    {
+        if (std::is_constant_evaluated())
+            return exactDecimal<long double>(literal);
+
+        if (!literal.truncated && literal.mantissa == 0)
+            return 0;
+
+        return fromCharsFallback<long double>(literal);
+    }
+};
+
+template <typename T>
+constexpr T DecimalConverter<T>::convert(const DecimalLiteral& literal)
+{
+    return T(DecimalConverter<double>::convert(literal));
+}
+
+#endif
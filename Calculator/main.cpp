@@ -1,365 +1,267 @@
 #include <cstdio>
-#include <cassert>
-
-//Infix expressions are generally more complicated for a computer to process - primarily due to parentheses.  
-//Dijkstra's Shunting Yard algorithm converts an infix expression to postfix (Polish notation) to allow for simple
-//calculation using a stack.  I had begun writing this algorithm as I remembered that polish notation is easier, but 
-//I could not see a way to preserve the "no alloc" constraint or employ recursion.
-//Another method is to recursively parse the infix expression until a parenthesis is reached, which would signify another "sub-expression"
-//which could be parsed in the same way recursively.
-//This is called a Recursive Descent Parser.
-//     expression
-//|------------------|
-//3 + 4 - (3 * 3) / 4
-//        |_____|
-//        sub-expr
-//
-//Time complexity: O(n)  This should be a O(n) algorithm where n = string length.  
-//Space complexity: O(1) as no additional data is created with the exception of a few local primitives. 
-//                  The functions on the stack will vary depending on how many operators and parenthesized expressions
-//                  there are.
-
-
-//Function declarations
-float tokenizeNumbers(const char*& eq, int& countParenthesis);
-
-float tokenizeExpression(const char*& eq, int& countParenthesis);
-
-float tokenizeMulDiv(const char*& eq, int& countParenthesis);
-
-//NAME: isDigit
-//DESCRIPTION:  Checks to see if a character is between 0 and 9.
-//INPUT: 
-//    c - The character to check.
-//OUTPUT:
-//    none
-//RETURNS:
-//    True if the character falls between 0 and 9.
-bool isDigit(char c)
-{
-    return ((c >= '0') && (c <= '9'));
-}
-
-//NAME: toDigit
-//DESCRIPTION:  Converts a character to its integer equivalent.
-//INPUT: 
-//    c - The character to check.
-//OUTPUT:
-//    none
-//RETURNS:
-//    The integer equivalent of c.
-int toDigit(char c)
-{
-    //I believe ASCII goes from 48 to 57 for 0 - 9.
-    return c - '0';
-}
-
-//NAME: isOperator
-//DESCRIPTION:  Checks to see if a character is an operator.
-//INPUT: 
-//    c - The character to check.
-//OUTPUT:
-//    none
-//RETURNS:
-//    True if the character is any of the four operators.
-bool isOperator(char c)
-{
-    static char operators[] = { '+', '-' , '/', '*' };
-    const int maxOperators = 4;
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "parser.h"
+#include "iterative.h"
+#include "compiler.h"
+#include "ast.h"
+#include "optimizer.h"
+#include "jit.h"
+#include "incremental.h"
+#include "shared.h"
+#include "archive.h"
+#include "batch.h"
+#include "gradient.h"
+#include "interval.h"
+#include "kernels.h"
+#include "parallel.h"
+#include "fixed.h"
+#include "decimal.h"
+#include "cache.h"
+#include "stream.h"
+#include "instrument.h"
+#include "server.h"
+
+constexpr const char* kExpressions[] = {
+    "-((6+4))* -(2+2) - -1",
+    "6/5-4-45+3.08",
+    "0.34+ -34/45-2",
+    "(0.03)*73-2",
+    "(20-23 + -5 * (12 / (34 + 3) - 3))",
+    "-25 + 4 * -(32 - 45 / 5 - -6)",
+    "0.0003101 - 34 * (4 + 5) / 23",
+    "1 + ((1 + 1) + 3) + 4 * 5 / 6 - 7",
+    "9 / 8/7 /6/5/4  /  3 /  2/1",
+    "-( -(-( -(2+3*4)+2 )-1)+ 0)",
+};
 
-    for (int i = 0; i < maxOperators; i++)
-        if (c == operators[i])
-            return true;
+//These are rounded.
+constexpr float kAnswers[] = {
+    41.0f,
+    -44.72f,
+    -2.41556f,
+    0.19f,
+    10.3784f,
+    -141.0f,
+    -13.3040f,
+    2.33333f,
+    0.00022321f,
+    11.0f,
+};
 
-    return false;
-}
+constexpr size_t kExpressionCount = sizeof(kExpressions) / sizeof(kExpressions[0]);
 
-//NAME: makeFloat
-//DESCRIPTION:  Converts a string to a float.
-//              Starts scanning from eq until a non-digit character.
-//              Performs the same function as atof.
-//INPUT: 
-//    eq  - The string to convert.
-//OUTPUT:
-//    end - This pointer marks where the scan stopped.  It should not be a digit.
-//RETURNS:
-//    The float representation of the string.
-float makeFloat(const char* eq, const char*& end)
+int main(int argc, char* argv[])
 {
-    //Make sure that the string is non-NULL.
-    assert(eq != NULL);
-
-    //The mantissa.
-    float beforeDecimal = 0.0;
-
-    //The fractional part.
-    float afterDecimal = 0.0;
-
-    //We use this value to determine by how much the fraction
-    //should be divided by ten.
-    int divisor = 1;
-
-    //The number could be negative.
-    int sign = 1;
-
-    bool isFraction = false;
-
-    //If the first character is a negative then we have a negative number.
-    if (*eq == '-')
+    //Calculator [-g digits | -f decimals] <file> solves every line of the file, or of standard input for -.
+    //Answers are as short as they can be without losing anything, unless -g or -f asks for %g or %f.
+    NumberFormat format;
+    int arg = 1;
+    if (argc > 3 && (strcmp(argv[1], "-g") == 0 || strcmp(argv[1], "-f") == 0))
     {
-        sign = -1;
-        eq++;
+        format = NumberFormat(argv[1][1] == 'g' ? NumberStyle::Significant : NumberStyle::Fixed, atoi(argv[2]));
+        arg = 3;
     }
 
-    //Continue scanning until we reach a character that isn't a digit
-    //or decimal point.
-    while (isDigit(*eq) || *eq == '.')
+    //Calculator [-g digits | -f decimals] --serve <address> solves batches sent to it until it is killed, see server.h.
+    if (argc > arg + 1 && strcmp(argv[arg], "--serve") == 0)
     {
-        //If this character is a digit, are we before or after
-        //the decimal point?
-        if (isDigit(*eq))
-        {
-            if (isFraction)
-            {
-                //This is the fractional part after the decimal.
-                afterDecimal = (afterDecimal * 10) + toDigit(*eq);
-                divisor = divisor * 10;
-            }
-            else
-            {
-                //This is the mantissa.
-                beforeDecimal = (beforeDecimal * 10) + toDigit(*eq);
-            }
-        }
-        else if (*eq == '.')
+        ServerOptions options;
+        options.format = format;
+        Server server(options);
+        if (!server.listen(argv[arg + 1]))
         {
-            //We've found a decimal point, but this might not be the first we've found.
-            if (isFraction)
-            {
-                //We've found a decimal point but are already in the fractional part, 
-                //so we are dealing with a string like so: 12.3.5
-                //  And we are located here:                   ^
-                end = eq;
-
-                //Update the end pointer and return the value.
-                return sign * (beforeDecimal + (afterDecimal / divisor));
-            }
-            else
-                isFraction = true;
+            fprintf(stderr, "Calculator: can't listen on %s\n", argv[arg + 1]);
+            return 1;
         }
 
-        eq++;
+        return server.run() ? 0 : 1;
     }
 
-    //Update the end pointer and return the value.
-    end = eq;
-    return sign * (beforeDecimal + (afterDecimal / divisor));
-}
-
-//NAME: tokenizeNumbers
-//DESCRIPTION:  By order of operations, the lowest possible sub-expression to be parsed
-//              is one in parenthesis.  We will assume that even a number by itself is 
-//              surrounded by parentheses: (5) + (6) + (4 - 3)
-//              This function will therefore look for any numbers.  When it finds a parentheses
-//              it will evaluate that expression until it boils it down to just one number,
-//              and then we're back here.
-//INPUT/OUTPUT:
-//    eq  - The pointer to where we currently are in the expression.
-//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
-//                       Should be back to zero when the expression is done.
-//RETURNS:
-//    The float value representing the value in parentheses.
-float tokenizeNumbers(const char*& eq, int& countParenthesis)
-{
-    //Border condition check
-    assert(eq != NULL);
-
-    //Spaces don't matter to us
-    while (*eq == ' ')
-        eq++;
-
-    //So at this point we are sitting here in our hypothetical expression
-    //-(4+6)
-    //^
-    bool hasNegative = false;
-    if (*eq == '-')
-    {
-        hasNegative = true;
-        eq++;
-    }
-
-    //We've found an open parenthesis!  This means we can recursively parse
-    //another expression in exactly the same way we've been doing so far.
-    if (*eq == '(')
-    {
-        eq++;
-        countParenthesis++;
+    if (argc > arg)
+        return strcmp(argv[arg], "-") == 0 ? streamInput(stdin, stdout, format) : streamFile(argv[arg], stdout, format);
 
-        float calculated = tokenizeExpression(eq, countParenthesis);
-        assert(*eq == ')'); //Tokenize parentheses should always leave off at the closing parenthesis!
+    for(size_t i = 0; i < kExpressionCount; ++i)
+        printf("Expression #%d: %s = %g = %g\n", (int)i, kExpressions[i], solve(kExpressions[i]).value, kAnswers[i]);
 
-        eq++;
-        countParenthesis--;
+    //An expression known when the program is built is solved by the compiler; nothing is left to do here.
+    constexpr double kFolded = solveConstant(kExpressions[4]);
+    printf("Constant: %s = %g\n", kExpressions[4], kFolded);
 
-        if (hasNegative)
-            return calculated * -1;
-        else
-            return calculated;
+    //The same expressions again, but parsed only once up front.
+    for(size_t i = 0; i < kExpressionCount; ++i)
+    {
+        Program program = compile(kExpressions[i]);
+        printf("Compiled #%d: %d instruction(s) = %g\n", (int)i, (int)program.code.size(), evaluate(program));
     }
 
-    //Convert the character string to a float, and then update the current position
-    //in our string to be after this float.
-    const char* eptr;
-    float toNumber = makeFloat(eq, eptr);
-
-    //It would be bad if the float value was zero characters long.  This is 
-    //a very unexpected error condition.
-    assert(eptr != eq);
-
-    //Update the current pointer of our expression to the end pointer after make float.
-    eq = eptr;
+    //The same expression in every precision.
+    printf("%s: float %.9g, double %.17g, long double %.21Lg, fixed %.17g\n", kExpressions[1],
+           solve<float>(kExpressions[1]).value, solve<double>(kExpressions[1]).value,
+           solve<long double>(kExpressions[1]).value, solve<Fixed64>(kExpressions[1]).value.toDouble());
 
-    if (hasNegative)
-        return toNumber * -1;
-    else
-        return toNumber;
-}
+    //And exactly, digit for digit.
+    char exact[kLongestDecimal];
+    size_t exactLength = formatDecimal(solve<Decimal128>(kExpressions[1]).value, exact, sizeof(exact));
+    printf("%s: decimal %.*s\n", kExpressions[1], (int)exactLength, exact);
 
-//NAME: tokenizeMulDiv
-//DESCRIPTION:  Multiplication and division have higher priority than addition or subtraction.  
-//              We should therefore look at these first.  The only thing with higher priority
-//              are parentheses.  We consider all numbers to be surrounded by parentheses as well, 
-//              this way we can retrieve numbers before the operator that applies to them.
-//INPUT/OUTPUT:
-//    eq  - The pointer to where we currently are in the expression.
-//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
-//                       Should be back to zero when the expression is done.
-//RETURNS:
-//    The float value representing the value after a multiplication or division.
-float tokenizeMulDiv(const char*& eq, int& countParenthesis)
-{
-    //Always extract numbers or sub-expressions first!
-    float first = tokenizeNumbers(eq, countParenthesis);
+    //A formula with variables is compiled once and then evaluated for every set of inputs.
+    VariableTable variables;
+    int price = variables.define("price");
+    int qty = variables.define("qty");
+    int rate = variables.define("rate", 0.25);
 
-    //It's ok to loop infinitely when he have a definitive out in the loop.
-    while (true)
+    Program formula = compile("price * qty * (1 - rate)", variables);
+    for (int i = 1; i <= 3; ++i)
     {
-        //Ignore spaces.
-        while (*eq == ' ')
-            eq++;
-
-        //Let's look at an operator.  
-        //If eq isn't pointing at a division or multiplication symbol
-        //there is nothing for us to do here, return the number from tokenizeNumbers.
-        char opr = *eq;
-        if (opr != '*' && opr != '/')
-            return first;
-
-        eq++;
-
-        //If we've gotten this far it means we must be either dividing or multiplying,
-        //so let's get the second number and figure out what to do.
-        //Again this function 'tokenizeNumbers' will either evaluate a set of parentheses
-        //or directly give us the number if there are no parentheses.
-        float second = tokenizeNumbers(eq, countParenthesis);
-
-        if (opr != '/')
-        {
-            first = first * second;
-        }
-        else
-        {
-            //Division by zero is a bad thing.
-            assert(second != 0);
-            first = first / second;
-        }
+        variables.set(price, 9.5 * i);
+        variables.set(qty, i * 2);
+        printf("price = %g, qty = %g, rate = %g: %g = %g\n", variables.get(price), variables.get(qty), variables.get(rate),
+               evaluate(formula, variables.values()), solve("price * qty * (1 - rate)", variables).value);
     }
-}
 
-//NAME: tokenizeExpression
-//DESCRIPTION:  The top level function which begins the parse.  This function is called 
-//              also when parsing from parentheses.  Despite being the top level function,
-//              this function is actually the last one to do any evaluation, which is why it
-//              handles addition and subtraction.
-//INPUT/OUTPUT:
-//    eq  - The pointer to where we currently are in the expression.
-//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
-//                       Should be back to zero when the expression is done.
-//RETURNS:
-//    The float value calculated from the expression.
-float tokenizeExpression(const char*& eq, int& countParenthesis)
-{
-    //Always scan for a multiplication or division first, as these have higher priority.
-    //We might end up back in this function through this call.
-    double first = tokenizeMulDiv(eq, countParenthesis);
-    while (true)
+    //The formula as a tree, as it was written, in memory which is reused for the next one.
+    Ast tree = parseTree("price * qty * (1 - rate)", threadArena(), variables);
+    printf("Tree: %d node(s) = %g\n", tree.size(), evaluate(tree, variables.values()));
+    threadArena().reset();
+
+    //Generated formulas are often full of steps that don't change the answer.
+    VariableTable generated;
+    generated.define("x", 3);
+    generated.define("y", 8);
+    Program redundant = compile("x * 1 + -(-(y)) / 4 - -x", generated);
+    int before = (int)redundant.code.size();
+    optimize(redundant);
+    printf("Optimized: %d instruction(s) down to %d = %g\n", before, (int)redundant.code.size(),
+           evaluate(redundant, generated.values()));
+
+    //Formulas with pieces in common calculate each of those pieces only once.
+    const char* const kFamily[] = { "price * qty * (1 - rate) - 2", "price * qty * (1 - rate) * 12", "5 / (qty * price * (1 - rate))" };
+    SharedProgram family = compileShared(kFamily, variables);
+    double familyAnswers[3];
+    evaluateShared(family, variables.values(), familyAnswers);
+    printf("Shared: %g, %g, %g in %d instruction(s)\n", familyAnswers[0], familyAnswers[1], familyAnswers[2],
+           (int)family.program.code.size());
+
+    //Compiled formulas can be kept in an archive and used again right where it lies, without compiling them.
+    Program kept[] = { formula, compile("price * (1 - rate)", variables) };
+    std::vector<char> packed = packArchive(kept, &variables);
+    Archive archive;
+    if (archive.attach(packed.data(), packed.size()))
+        printf("Archived: %d formula(s) in %d byte(s) = %g, %g\n", archive.size(), (int)packed.size(),
+               evaluate(archive.program(0), variables.values()), evaluate(archive.program(1), variables.values()));
+
+    //A formula evaluated over and over is turned into machine code once it has been used often enough.
+    HotProgram hot(formula, 100);
+    double hotAnswer = 0;
+    for (int i = 0; i < 1000; ++i)
+        hotAnswer = hot.evaluate(variables.values());
+    printf("Hot: %s after 1000 evaluations = %g\n", hot.isNative() ? "native" : "interpreted", hotAnswer);
+
+    //When only one input changes, only the instructions it feeds into are run again.
+    IncrementalProgram incremental(formula, variables.values());
+    incremental.set(rate, 0.5);
+    double incrementalAnswer = incremental.evaluate();
+    printf("Incremental: rate = 0.5 = %g, %d of %d instruction(s) run again\n", incrementalAnswer,
+           incremental.lastRecalculated(), (int)formula.code.size());
+
+    //The same formula for a whole column of rows at once.
+    const int kRows = 5;
+    float prices[kRows], quantities[kRows], rates[kRows], answers[kRows];
+    for (int i = 0; i < kRows; ++i)
     {
-        //Ignore spaces.
-        while (*eq == ' ')
-            eq++;
-
-        //Similar to tokenizeMulDiv, except this time with addition or subtraction.
-        //This is also what boots us out of the recursion when everything is done.
-        char opr = *eq;
-        if (opr != '+' && opr != '-')
-            return first;
-        eq++;
-
-        //If we've gotten this far, it means that we legitimately have an addition or
-        //subtraction; however the second number might be an expression itself.
-        //Let's check for this.
-        double second = tokenizeMulDiv(eq, countParenthesis);
-        if (opr == '+')
-            first = first + second;
-        else
-            first = first - second;
+        prices[i] = 9.5f * (i + 1);
+        quantities[i] = (float)(i * 2);
+        rates[i] = 0.05f * i;
     }
-}
 
-static float solve(const char* eq)
-{
-    assert(eq != NULL);
-
-    int pCount = 0;
-    float answer = tokenizeExpression(eq, pCount);
-
-    //We shouldn't have unmatched parentheses unless the expression was malformed.
-    assert(pCount == 0); 
-
-    return answer;
-}
+    const float* columns[3];
+    columns[price] = prices;
+    columns[qty] = quantities;
+    columns[rate] = rates;
+    evaluateBatch(formula, columns, answers, kRows);
+
+    for (int i = 0; i < kRows; ++i)
+        printf("Batch (%s) row %d: %g\n", batchKernels<float>().name, i, answers[i]);
+
+    //Every sensitivity of the formula from one run forwards and one sweep back, instead of nudging each input.
+    double gradient[3];
+    double gradientAnswer = evaluateGradient(formula, variables.values(), gradient, threadArena());
+    threadArena().reset();
+    printf("Gradient: %g, d/price = %g, d/qty = %g, d/rate = %g\n", gradientAnswer, gradient[price], gradient[qty], gradient[rate]);
+
+    //And for every row of the columns at once.
+    float priceSlopes[kRows], qtySlopes[kRows], rateSlopes[kRows];
+    float* slopes[3];
+    slopes[price] = priceSlopes;
+    slopes[qty] = qtySlopes;
+    slopes[rate] = rateSlopes;
+    evaluateGradientBatch(formula, columns, answers, slopes, kRows, threadArena());
+    threadArena().reset();
+    printf("Gradient batch row %d: %g, d/price = %g, d/qty = %g, d/rate = %g\n", kRows - 1, answers[kRows - 1],
+           priceSlopes[kRows - 1], qtySlopes[kRows - 1], rateSlopes[kRows - 1]);
+
+    //The range of the formula over the ranges of the columns, without evaluating a row, so a query for
+    //answers above it can skip the whole block.
+    Interval ranges[3];
+    ranges[price] = Interval(prices[0], prices[kRows - 1]);
+    ranges[qty] = Interval(quantities[0], quantities[kRows - 1]);
+    ranges[rate] = Interval(rates[0], rates[kRows - 1]);
+    Interval bounds = evaluate(formula, ranges);
+    printf("Bounds: [%g, %g] over the block, %s for answers above 400\n", bounds.lo, bounds.hi,
+           bounds.hi <= 400 && !bounds.nan ? "skipped" : "evaluated");
+
+    //All of the expressions at once, spread over every processor.
+    double parallelAnswers[kExpressionCount];
+    solveAll(kExpressions, parallelAnswers);
+
+    for(size_t i = 0; i < kExpressionCount; ++i)
+        printf("Parallel #%d: %g\n", (int)i, parallelAnswers[i]);
+
+    //Expressions that only differ in their spacing share one entry in the cache.
+    SolveCache cache;
+    const char* const kRepeated[] = { "6/5-4-45+3.08", " 6 / 5 - 4 - 45 + 3.08 ", "6/5 -4-45 +3.08", "1 2" };
+    for(size_t i = 0; i < sizeof(kRepeated) / sizeof(kRepeated[0]); ++i)
+    {
+        Result<double> result = cache.solve(kRepeated[i]);
+        printf("Cached #%d: %s = %g (%s)\n", (int)i, kRepeated[i], result.value, result.ok() ? "ok" : errorMessage(result.error));
+    }
 
-const char* const kExpressions[] = {
-    "-((6+4))* -(2+2) - -1",
-    "6/5-4-45+3.08",
-    "0.34+ -34/45-2",
-    "(0.03)*73-2",
-    "(20-23 + -5 * (12 / (34 + 3) - 3))",
-    "-25 + 4 * -(32 - 45 / 5 - -6)",
-    "0.0003101 - 34 * (4 + 5) / 23",
-    "1 + ((1 + 1) + 3) + 4 * 5 / 6 - 7",
-    "9 / 8/7 /6/5/4  /  3 /  2/1",
-    "-( -(-( -(2+3*4)+2 )-1)+ 0)",
-};
+    printf("Cache: %llu hit(s), %llu miss(es)\n", (unsigned long long)cache.hits(), (unsigned long long)cache.misses());
+
+    //Machine generated expressions can be nested far deeper than the recursive parser likes.
+    std::string nested;
+    for (int i = 0; i < 100000; ++i)
+        nested += "-(";
+    nested += "2";
+    nested.append(100000, ')');
+    printf("Nested %d levels: %g\n", 100000, solveIterative(nested.c_str()).value);
+
+    //Powers and functions, also for whole columns at once.
+    const char* const kMath = "sqrt(price) + 2 ^ 3 ^ 2 - max(qty, 3) * abs(-rate) + log(exp(1))";
+    Program math = compile(kMath, variables);
+    evaluateBatch(math, columns, answers, kRows);
+    printf("%s = %g, batch row 0 = %g\n", kMath, solve(kMath, variables).value, answers[0]);
+
+    //Conditionals only calculate the answer they pick.
+    const char* const kRule = "qty > 3 && rate < 0.5 ? price * qty * (1 - rate) : price * qty";
+    Program rule = compile(kRule, variables);
+    evaluateBatch(rule, columns, answers, kRows);
+    printf("%s = %g, batch row %d = %g\n", kRule, solve(kRule, variables).value, kRows - 1, answers[kRows - 1]);
+
+    //Malformed expressions are reported instead of stopping the program.
+    const char* const kMalformed[] = { "(1 + 2", "4 / (2 - 2)", "3 * ", "1 + 2)", "2 * y", "sqrt(-1)", "min(1)", "cos(0)", "1 ? 2" };
+    for(size_t i = 0; i < sizeof(kMalformed) / sizeof(kMalformed[0]); ++i)
+    {
+        Result<double> result = solve(kMalformed[i]);
+        printf("Malformed #%d: %s: %s at offset %d\n", (int)i, kMalformed[i], errorMessage(result.error), result.offset);
+    }
 
-//These are rounded.
-const float kAnswers[] = {
-    41.0f,
-    -44.72f,
-    -2.41556f,
-    0.19f,
-    10.3784f,
-    -141.0f,
-    -13.3040f,
-    2.33333f,
-    0.00022321f,
-    11.0f,
-};
+    //Built with CALC_INSTRUMENT, everything above has been counted.
+    if (instrumentEnabled())
+        fputs(formatPrometheus(instrumentSnapshot()).c_str(), stdout);
 
-int main(int argc, char* argv[])
-{
-    for(int i = 0; i < (sizeof(kExpressions) / sizeof(kExpressions[0])); ++i)
-        printf("Expression #%d: %s = %g = %g\n", i, kExpressions[i], solve(kExpressions[i]), kAnswers[i]);
-    
     return 0;
 }
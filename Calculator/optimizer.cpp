@@ -0,0 +1,450 @@
+#include <cmath>
+#include <utility>
+
+#include "optimizer.h"
+
+//NAME: Rewriter
+//DESCRIPTION:  Builds the optimized program one instruction at a time.  Every operation looks at the
+//              instructions that produce its operands and emits the cheapest equivalent it can find,
+//              which may be no instruction at all, just one of the operands.
+class Rewriter
+{
+public:
+    Rewriter(Program& program, const OptimizeOptions& options) : program(program), options(options) {}
+
+    int constant(double value);
+
+    int variable(int slot) { return emit(OpCode::Variable, slot, 0); }
+
+    int negate(int value);
+
+    int add(int first, int second);
+
+    int subtract(int first, int second);
+
+    int multiply(int first, int second);
+
+    int divide(int first, int second);
+
+    int call(Function function, int first, int second);
+
+    int branch(int condition);
+
+    int jump(int value);
+
+    int merge(int branch, int otherwise);
+
+private:
+    int emit(OpCode op, int lhs, int rhs);
+
+    bool isConstant(int value, double& constant) const;
+
+    bool isConstantEqual(int value, double expected) const;
+
+    bool isNegate(int value, int& operand) const;
+
+    bool hasConstantOperand(int value, OpCode op, int& operand, double& constant) const;
+
+    Program& program;
+    const OptimizeOptions& options;
+
+    //The Branches whose Jump hasn't been emitted yet, innermost last.
+    std::vector<int> branches;
+};
+
+//NAME: isExactReciprocal
+//DESCRIPTION:  Checks to see if 1 / value can be represented exactly, so that multiplying by it gives
+//              the same answer as dividing by value: value must be a power of two and neither it nor
+//              its reciprocal may be denormal.  Programs can be evaluated in float, so that has to hold
+//              for float as well.
+//INPUT:
+//    value - The divisor.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if dividing by value can be replaced by multiplying by 1 / value.
+static bool isExactReciprocal(double value)
+{
+    int exponent;
+    double fraction = std::frexp(value, &exponent);
+    if (fraction != 0.5 && fraction != -0.5)
+        return false;
+
+    return std::isnormal((float)value) && std::isnormal((float)(1 / value));
+}
+
+//NAME: Rewriter::constant
+//DESCRIPTION:  Emits a constant.
+//INPUT:
+//    value - The value of the constant.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the constant.
+int Rewriter::constant(double value)
+{
+    program.constants.push_back(value);
+    return emit(OpCode::Constant, (int)program.constants.size() - 1, 0);
+}
+
+//NAME: Rewriter::negate
+//DESCRIPTION:  -value.  Negating a negation cancels out.
+int Rewriter::negate(int value)
+{
+    double c;
+    int operand;
+    if (isConstant(value, c))
+        return constant(Evaluator<double>().negate(c));
+    if (isNegate(value, operand))
+        return operand;
+
+    return emit(OpCode::Negate, value, 0);
+}
+
+//NAME: Rewriter::add
+//DESCRIPTION:  first + second.
+int Rewriter::add(int first, int second)
+{
+    double a, b;
+    int operand;
+    if (isConstant(first, a) && isConstant(second, b))
+        return constant(Evaluator<double>().add(a, b));
+
+    //a + -b is a - b and -a + b is b - a.
+    if (isNegate(second, operand))
+        return subtract(first, operand);
+    if (isNegate(first, operand))
+        return subtract(second, operand);
+
+    //Adding -0 never changes anything, adding +0 turns -0 into +0.
+    if (isConstantEqual(second, -0.0) || (options.relaxed && isConstantEqual(second, 0.0)))
+        return first;
+    if (isConstantEqual(first, -0.0) || (options.relaxed && isConstantEqual(first, 0.0)))
+        return second;
+
+    if (options.relaxed)
+    {
+        //(x + c1) + c2 is x + (c1 + c2) and (x - c1) + c2 is x + (c2 - c1).
+        if (isConstant(first, a) && !isConstant(second, b))
+            std::swap(first, second);
+        if (isConstant(second, b))
+        {
+            int x;
+            double c;
+            if (hasConstantOperand(first, OpCode::Add, x, c) && std::isfinite(c + b))
+                return add(x, constant(c + b));
+            if (hasConstantOperand(first, OpCode::Subtract, x, c) && std::isfinite(b - c))
+                return add(x, constant(b - c));
+        }
+    }
+
+    return emit(OpCode::Add, first, second);
+}
+
+//NAME: Rewriter::subtract
+//DESCRIPTION:  first - second.
+int Rewriter::subtract(int first, int second)
+{
+    double a, b;
+    int operand;
+    if (isConstant(first, a) && isConstant(second, b))
+        return constant(Evaluator<double>().subtract(a, b));
+
+    //a - -b is a + b.
+    if (isNegate(second, operand))
+        return add(first, operand);
+
+    //x - 0 is always x, -0 - x is always -x and so is 0 - x except for the sign of a zero.
+    if (isConstantEqual(second, 0.0))
+        return first;
+    if (isConstantEqual(first, -0.0) || (options.relaxed && isConstantEqual(first, 0.0)))
+        return negate(second);
+
+    //(x + c1) - c2 is x + (c1 - c2) and (x - c1) - c2 is x - (c1 + c2).
+    if (options.relaxed && isConstant(second, b))
+    {
+        int x;
+        double c;
+        if (hasConstantOperand(first, OpCode::Add, x, c) && std::isfinite(c - b))
+            return add(x, constant(c - b));
+        if (hasConstantOperand(first, OpCode::Subtract, x, c) && std::isfinite(c + b))
+            return subtract(x, constant(c + b));
+    }
+
+    return emit(OpCode::Subtract, first, second);
+}
+
+//NAME: Rewriter::multiply
+//DESCRIPTION:  first * second.
+int Rewriter::multiply(int first, int second)
+{
+    double a, b;
+    int x, y;
+    if (isConstant(first, a) && isConstant(second, b))
+        return constant(Evaluator<double>().multiply(a, b));
+
+    //Keep the constant on the right so there is only one case to check.
+    if (isConstant(first, a))
+        std::swap(first, second);
+
+    if (isConstant(second, b))
+    {
+        if (b == 1)
+            return first;
+        if (b == -1)
+            return negate(first);
+
+        //-x * c is x * -c.
+        if (isNegate(first, x))
+            return multiply(x, constant(-b));
+
+        //(x * c1) * c2 is x * (c1 * c2), unless that overflows or underflows: x * 1e300 * 1e300 is 0 for
+        //x = 0, and x * inf would be NaN.
+        double c;
+        if (options.relaxed && hasConstantOperand(first, OpCode::Multiply, x, c) && std::isnormal(c * b))
+            return multiply(x, constant(c * b));
+    }
+
+    //-x * -y is x * y.
+    if (isNegate(first, x) && isNegate(second, y))
+        return multiply(x, y);
+
+    return emit(OpCode::Multiply, first, second);
+}
+
+//NAME: Rewriter::divide
+//DESCRIPTION:  first / second.  Division by a constant becomes the much cheaper multiplication by its
+//              reciprocal whenever that gives the same answer, or always if relaxed.
+int Rewriter::divide(int first, int second)
+{
+    double a, b;
+    int x, y;
+
+    //Dividing by a constant zero is reported by compile(), it is left alone here.
+    if (isConstant(first, a) && isConstant(second, b) && b != 0)
+        return constant(Evaluator<double>().divide(a, b, NULL));
+
+    if (isConstant(second, b) && b != 0 && std::isfinite(b))
+    {
+        if (b == 1)
+            return first;
+        if (b == -1)
+            return negate(first);
+        if (isExactReciprocal(b) || (options.relaxed && std::isnormal(1 / b)))
+            return multiply(first, constant(1 / b));
+    }
+
+    //-x / -y is x / y.
+    if (isNegate(first, x) && isNegate(second, y))
+        return divide(x, y);
+
+    return emit(OpCode::Divide, first, second);
+}
+
+//NAME: Rewriter::call
+//DESCRIPTION:  A function, second is ignored by those taking one argument.  Functions of constants are
+//              calculated as long as the constants are in their domain.
+int Rewriter::call(Function function, int first, int second)
+{
+    double a, b;
+    int x;
+    const bool unary = functionArguments(function) == 1;
+    if (isConstant(first, a) && (unary || isConstant(second, b)))
+    {
+        if (unary)
+            b = a;
+        if (checkDomain(function, a, b) == ErrorCode::None)
+            return constant(applyFunction(function, a, b));
+    }
+
+    if (function == Function::Power && isConstant(second, b))
+    {
+        //x ^ 1 is always x.  x ^ 2 is x * x, which pow() may round differently.
+        if (b == 1)
+            return first;
+        if (b == 2 && options.relaxed)
+            return multiply(first, first);
+    }
+
+    //abs(-x) and abs(abs(x)) are abs(x).
+    if (function == Function::Abs)
+    {
+        if (isNegate(first, x))
+            return call(function, x, x);
+        if (program.code[first].op == OpCode::Abs)
+            return first;
+    }
+
+    return emit(functionCode(function), first, unary ? 0 : second);
+}
+
+//NAME: Rewriter::branch
+//DESCRIPTION:  The Branch of a conditional.  Where it goes isn't known until its Jump is emitted.
+int Rewriter::branch(int condition)
+{
+    branches.push_back(emit(OpCode::Branch, condition, -1));
+    return branches.back();
+}
+
+//NAME: Rewriter::jump
+//DESCRIPTION:  The Jump after the first answer of the innermost conditional.
+int Rewriter::jump(int value)
+{
+    int jump = emit(OpCode::Jump, value, -1);
+    program.code[branches.back()].rhs = jump;
+    branches.pop_back();
+    return jump;
+}
+
+//NAME: Rewriter::merge
+//DESCRIPTION:  The Merge at the end of a conditional.
+int Rewriter::merge(int branch, int otherwise)
+{
+    int merge = emit(OpCode::Merge, branch, otherwise);
+    program.code[program.code[branch].rhs].rhs = merge;
+    return merge;
+}
+
+//NAME: Rewriter::emit
+//DESCRIPTION:  Appends an instruction to the program.
+int Rewriter::emit(OpCode op, int lhs, int rhs)
+{
+    Instruction instruction = { op, lhs, rhs };
+    program.code.push_back(instruction);
+    return (int)program.code.size() - 1;
+}
+
+//NAME: Rewriter::isConstant
+//DESCRIPTION:  Checks to see if a register holds a constant and returns its value.
+bool Rewriter::isConstant(int value, double& constant) const
+{
+    if (program.code[value].op != OpCode::Constant)
+        return false;
+
+    constant = program.constants[program.code[value].lhs];
+    return true;
+}
+
+//NAME: Rewriter::isConstantEqual
+//DESCRIPTION:  Checks to see if a register holds exactly the given constant, including the sign of zero.
+bool Rewriter::isConstantEqual(int value, double expected) const
+{
+    double constant;
+    return isConstant(value, constant) && constant == expected && std::signbit(constant) == std::signbit(expected);
+}
+
+//NAME: Rewriter::isNegate
+//DESCRIPTION:  Checks to see if a register holds a negation and returns what is negated.
+bool Rewriter::isNegate(int value, int& operand) const
+{
+    if (program.code[value].op != OpCode::Negate)
+        return false;
+
+    operand = program.code[value].lhs;
+    return true;
+}
+
+//NAME: Rewriter::hasConstantOperand
+//DESCRIPTION:  Checks to see if a register holds x op c with a constant c and returns both.
+bool Rewriter::hasConstantOperand(int value, OpCode op, int& operand, double& constant) const
+{
+    const Instruction& in = program.code[value];
+    if (in.op != op || !isConstant(in.rhs, constant))
+        return false;
+
+    operand = in.lhs;
+    return true;
+}
+
+//NAME: optimize
+//DESCRIPTION:  Simplifies a compiled program so it does less work every time it is evaluated.
+//              The program is rebuilt instruction by instruction, then everything the answer doesn't
+//              depend on is removed and the registers and constants are renumbered.
+//INPUT:
+//    options - Which rewrites are allowed.
+//INPUT/OUTPUT:
+//    program - The program from compile().  A program which failed to compile is left alone.
+//RETURNS:
+//    none
+void optimize(Program& program, const OptimizeOptions& options)
+{
+    if (!program.ok() || program.code.empty())
+        return;
+
+    Program rewritten;
+    Rewriter rewriter(rewritten, options);
+
+    //Where each of the original registers ended up.
+    std::vector<int> moved(program.code.size());
+    for (size_t i = 0; i < program.code.size(); i++)
+    {
+        const Instruction& in = program.code[i];
+        switch (in.op)
+        {
+        case OpCode::Constant: moved[i] = rewriter.constant(program.constants[in.lhs]);        break;
+        case OpCode::Variable: moved[i] = rewriter.variable(in.lhs);                           break;
+        case OpCode::Negate:   moved[i] = rewriter.negate(moved[in.lhs]);                      break;
+        case OpCode::Add:      moved[i] = rewriter.add(moved[in.lhs], moved[in.rhs]);          break;
+        case OpCode::Subtract: moved[i] = rewriter.subtract(moved[in.lhs], moved[in.rhs]);     break;
+        case OpCode::Multiply: moved[i] = rewriter.multiply(moved[in.lhs], moved[in.rhs]);     break;
+        case OpCode::Divide:   moved[i] = rewriter.divide(moved[in.lhs], moved[in.rhs]);       break;
+        case OpCode::Branch:   moved[i] = rewriter.branch(moved[in.lhs]);                      break;
+        case OpCode::Jump:     moved[i] = rewriter.jump(moved[in.lhs]);                        break;
+        case OpCode::Merge:    moved[i] = rewriter.merge(moved[in.lhs], moved[in.rhs]);        break;
+        default:
+            moved[i] = rewriter.call(codeFunction(in.op), moved[in.lhs], moved[isUnary(in.op) ? in.lhs : in.rhs]);
+            break;
+        }
+    }
+
+    //Operands always come before the instruction reading them, so one pass backwards from the answer
+    //finds everything it depends on.  Nothing after the answer can be needed.  A Merge needs the Jump
+    //which stores into it as well as its Branch, and only ever keeps both of them.
+    int answer = moved.back();
+    std::vector<char> live(answer + 1, 0);
+    live[answer] = 1;
+    for (int i = answer; i >= 0; i--)
+    {
+        const Instruction& in = rewritten.code[i];
+        if (!live[i] || in.op == OpCode::Constant || in.op == OpCode::Variable)
+            continue;
+
+        live[in.lhs] = 1;
+        if (!isUnary(in.op))
+            live[in.rhs] = 1;
+        if (in.op == OpCode::Merge)
+            live[rewritten.code[in.lhs].rhs] = 1;
+    }
+
+    std::vector<int> renumbered(answer + 1, -1);
+    program.code.clear();
+    program.constants.clear();
+    for (int i = 0; i <= answer; i++)
+    {
+        if (!live[i])
+            continue;
+
+        Instruction in = rewritten.code[i];
+        if (in.op == OpCode::Constant)
+        {
+            program.constants.push_back(rewritten.constants[in.lhs]);
+            in.lhs = (int)program.constants.size() - 1;
+        }
+        else if (in.op != OpCode::Variable)
+        {
+            in.lhs = renumbered[in.lhs];
+            if (!isUnary(in.op))
+                in.rhs = renumbered[in.rhs];
+        }
+
+        renumbered[i] = (int)program.code.size();
+        program.code.push_back(in);
+    }
+
+    //Branches and Jumps go to instructions after them, which have only just been renumbered.
+    for (Instruction& in : program.code)
+    {
+        if (hasTarget(in.op))
+            in.rhs = renumbered[in.rhs];
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef CALCULATOR_OPTIMIZER_H
+#define CALCULATOR_OPTIMIZER_H
+
+#include "compiler.h"
+
+//compile() already calculates every sub-expression made of constants only, but what is left often still
+//does work that doesn't change the answer, especially in generated formulas:
+//     x * 1          ->  x
+//     -(-(y))        ->  y
+//     a - -b         ->  a + b
+//     -a * 3         ->  a * -3
+//     x / 4          ->  x * 0.25
+//     x ^ 1          ->  x
+//     abs(-x)        ->  abs(x)
+//optimize() rewrites these and anything that becomes constant along the way, then drops the
+//instructions nothing reads any more so evaluate() has less to do.
+//
+//By default only rewrites which give bit for bit the same floating point answer are made: x / 4 becomes
+//x * 0.25 because 0.25 is exact, but x / 10 stays a division, and x + 0 stays because -0 + 0 is +0.
+//OptimizeOptions::relaxed also allows the ones that may differ in the last bit or the sign of a zero:
+//dividing by any constant, dropping + 0, combining constants across operators such as (x + 1) + 2, and
+//x ^ 2 becoming x * x.  Constants are never combined into one which overflows or underflows, which would
+//change far more than the last bit.
+//Fixed64 rounds products and quotients differently, so its answers may differ in the last bit either way.
+
+//NAME: OptimizeOptions
+//DESCRIPTION:  Which rewrites optimize() is allowed to make.
+struct OptimizeOptions
+{
+    OptimizeOptions() : relaxed(false) {}
+
+    bool relaxed;
+};
+
+//Function declarations
+void optimize(Program& program, const OptimizeOptions& options = OptimizeOptions());
+
+#endif
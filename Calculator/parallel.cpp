@@ -0,0 +1,68 @@
+#include <cassert>
+#include <cmath>
+
+#include "parallel.h"
+#include "parser.h"
+
+//How many expressions a thread takes at a time.  Enough to make handing them out cheap
+//compared to solving them, few enough that a handful of long expressions still spread out.
+static const size_t kSolveGrain = 32;
+
+//NAME: solveAll
+//DESCRIPTION:  Solves every expression in the list using every processor.
+//INPUT:
+//    expressions - The expressions to solve.
+//OUTPUT:
+//    answers     - The answer to expressions[i] is written to answers[i].  Must be as long as expressions.
+//                  Malformed expressions get NaN.
+//RETURNS:
+//    none
+void solveAll(std::span<const char* const> expressions, std::span<double> answers)
+{
+    solveAll(expressions, answers, defaultThreadPool());
+}
+
+//NAME: solveAll
+//DESCRIPTION:  Solves every expression in the list on the threads of the given pool.
+//INPUT:
+//    expressions - The expressions to solve.
+//    pool        - The threads to use.
+//OUTPUT:
+//    answers     - The answer to expressions[i] is written to answers[i].  Must be as long as expressions.
+//                  Malformed expressions get NaN.
+//RETURNS:
+//    none
+void solveAll(std::span<const char* const> expressions, std::span<double> answers, ThreadPool& pool)
+{
+    assert(answers.size() >= expressions.size());
+
+    pool.parallelFor(expressions.size(), kSolveGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            Result<double> result = solve(expressions[i]);
+            answers[i] = result.ok() ? result.value : NAN;
+        }
+    });
+}
+
+//NAME: solveAll
+//DESCRIPTION:  Solves every expression in the list on the threads of the given pool, keeping
+//              the error of every expression which turns out to be malformed.
+//INPUT:
+//    expressions - The expressions to solve.
+//    pool        - The threads to use.
+//OUTPUT:
+//    results     - The result of expressions[i] is written to results[i].  Must be as long as expressions.
+//RETURNS:
+//    none
+void solveAll(std::span<const char* const> expressions, std::span<Result<double> > results, ThreadPool& pool)
+{
+    assert(results.size() >= expressions.size());
+
+    pool.parallelFor(expressions.size(), kSolveGrain, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            results[i] = solve(expressions[i]);
+    });
+}
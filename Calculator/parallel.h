@@ -0,0 +1,20 @@
+#ifndef CALCULATOR_PARALLEL_H
+#define CALCULATOR_PARALLEL_H
+
+#include <span>
+
+#include "errors.h"
+#include "thread_pool.h"
+
+//solve() over a whole list of independent expressions, spread across every processor.
+//A malformed expression only spoils its own answer: it comes out as NaN, or as a Result carrying the
+//error for callers that want to know what was wrong with it.
+
+//Function declarations
+void solveAll(std::span<const char* const> expressions, std::span<double> answers);
+
+void solveAll(std::span<const char* const> expressions, std::span<double> answers, ThreadPool& pool);
+
+void solveAll(std::span<const char* const> expressions, std::span<Result<double> > results, ThreadPool& pool);
+
+#endif
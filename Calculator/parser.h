@@ -0,0 +1,921 @@
+#ifndef CALCULATOR_PARSER_H
+#define CALCULATOR_PARSER_H
+
+#include <cassert>
+#include <cstddef>
+
+#include "characters.h"
+#include "errors.h"
+#include "functions.h"
+#include "instrument.h"
+#include "literal.h"
+#include "variables.h"
+
+//Infix expressions are generally more complicated for a computer to process - primarily due to parentheses.
+//Dijkstra's Shunting Yard algorithm converts an infix expression to postfix (Polish notation) to allow for simple
+//calculation using a stack.  I had begun writing this algorithm as I remembered that polish notation is easier, but
+//I could not see a way to preserve the "no alloc" constraint or employ recursion.
+//Another method is to recursively parse the infix expression until a parenthesis is reached, which would signify another "sub-expression"
+//which could be parsed in the same way recursively.
+//This is called a Recursive Descent Parser.
+//     expression
+//|------------------|
+//3 + 4 - (3 * 3) / 4
+//        |_____|
+//        sub-expr
+//
+//Below the sums are the comparisons, then && and ||, and last of all the conditional, which is what a
+//parenthesis or an argument holds:
+//     expression  := or [ '?' expression ':' expression ]       right associative, like C
+//     or          := and { '||' and }
+//     and         := comparison { '&&' comparison }
+//     comparison  := sum { ( '<' | '<=' | '>' | '>=' | '==' | '!=' ) sum }
+//     sum         := product { ( '+' | '-' ) product }
+//a && b is a ? (b != 0) : 0 and a || b is a ? 1 : (b != 0), so the parser only ever reports conditionals.
+//
+//Time complexity: O(n)  This should be a O(n) algorithm where n = string length.
+//Space complexity: O(1) as no additional data is created with the exception of a few local primitives.
+//                  The functions on the stack will vary depending on how many operators and parenthesized expressions
+//                  there are.
+//
+//The tokenizer functions only recognize the grammar.  What happens when a number, a negation or an operator
+//is found is decided by an "actions" object passed along with the expression:
+//    Actions::Value                  - The type every sub-expression produces.
+//    number(Number)                  - Called for every literal.
+//    variable(name, length)          - Called for every identifier such as x or rate.
+//    negate(Value)                   - Called for a leading minus sign.
+//    add/subtract/multiply           - Called with the two operands of a binary operator.
+//    divide(Value, Value, at)        - Also given where the divisor starts, in case it turns out to be zero.
+//    call(Function, Value, at)       - Called with the argument of a function taking one, and where its name starts.
+//    call(Function, Value, Value, at) - Called for min, max, ^ and the comparisons, see functions.h.  For ^,
+//                                      at is where the power starts, for a comparison its operator.
+//    beginThen(condition)            - Called after the condition of a conditional, before the answer if it holds.
+//    beginElse(condition, then)      - Called after that answer, before the answer if it doesn't hold.
+//    endConditional(condition, then, otherwise) - Called after both, for the value of the conditional.
+//                                      Both answers are always parsed, but the one the condition doesn't
+//                                      pick should be neither calculated nor checked for errors: in
+//                                      x != 0 ? 1 / x : 0 dividing by zero is no error.
+//    fail(ErrorCode, at) / failed()  - From ErrorState, records the first error in the expression.
+//    Actions::Number                 - The type literals are converted to.
+//Evaluator (below) calculates the answer directly while it parses.  The compiler in compiler.h uses the very
+//same functions to record the expression once so it can be evaluated again without parsing.
+//
+//Everything here is constexpr, so an expression known when the program is built can be solved by the
+//compiler instead, see solveConstant().
+
+
+//NAME: isDigit
+//DESCRIPTION:  Checks to see if a character is between 0 and 9.
+//INPUT: 
+//    c - The character to check.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the character falls between 0 and 9.
+constexpr bool isDigit(char c)
+{
+    return (characterClass(c) & kDigitClass) != 0;
+}
+
+//NAME: toDigit
+//DESCRIPTION:  Converts a character to its integer equivalent.
+//INPUT: 
+//    c - The character to check.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The integer equivalent of c.
+constexpr int toDigit(char c)
+{
+    //I believe ASCII goes from 48 to 57 for 0 - 9.
+    return c - '0';
+}
+
+//NAME: isOperator
+//DESCRIPTION:  Checks to see if a character is an operator.
+//INPUT: 
+//    c - The character to check.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the character is any of the operators or a character of one, ^, comparisons and
+//    conditionals included.
+constexpr bool isOperator(char c)
+{
+    return (characterClass(c) & (kSumClass | kProductClass | kPowerClass | kComparisonClass | kConditionalClass)) != 0;
+}
+
+//NAME: isIdentifierStart
+//DESCRIPTION:  Checks to see if a character can begin the name of a variable.
+//INPUT:
+//    c - The character to check.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the character is a letter or an underscore.
+constexpr bool isIdentifierStart(char c)
+{
+    return (characterClass(c) & kIdentifierStartClass) != 0;
+}
+
+//NAME: isIdentifierChar
+//DESCRIPTION:  Checks to see if a character can be part of the name of a variable.
+//INPUT:
+//    c - The character to check.
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if the character is a letter, a digit or an underscore.
+constexpr bool isIdentifierChar(char c)
+{
+    return (characterClass(c) & kIdentifierClass) != 0;
+}
+
+//NAME: makeFloat
+//DESCRIPTION:  Converts a string to a number of type T.
+//              Starts scanning from eq until the end of the literal, which may have a decimal point
+//              and an exponent such as 1e-9 or 2.5E+3.
+//              Performs the same function as atof, but is correctly rounded and much faster; see literal.h.
+//INPUT: 
+//    eq  - The string to convert.
+//OUTPUT:
+//    end - This pointer marks where the scan stopped.  It should not be a digit.
+//          If there wasn't a single digit to convert it is left at eq.
+//RETURNS:
+//    The T representation of the string.
+template <typename T>
+constexpr T makeFloat(const char* eq, const char*& end)
+{
+    CALC_TIME_STAGE(Stage::MakeFloat);
+
+    //Make sure that the string is non-NULL.
+    assert(eq != NULL);
+
+    //The number could be negative.
+    bool negative = (*eq == '-');
+
+    DecimalLiteral literal;
+    scanDecimal(negative ? eq + 1 : eq, literal);
+
+    //Not a number at all, such as "-" or "."
+    if (literal.end == literal.begin)
+    {
+        end = eq;
+        return T(0);
+    }
+
+    //Update the end pointer and return the value.
+    end = literal.end;
+    T value = DecimalConverter<T>::convert(literal);
+    return negative ? -value : value;
+}
+
+//NAME: Evaluator
+//DESCRIPTION:  The actions which calculate the value of the expression while it is being parsed.
+//              This is what solve() uses.  Variables are looked up by name in the table they were
+//              bound to as they are found, except in an answer which isn't taken, just as compile()
+//              drops the answer of a constant condition along with its names.
+//              T is the type every number and every step of the calculation uses, for instance float for
+//              speed, double or long double for precision, Fixed64 for integer-only arithmetic or
+//              Decimal128 for exact decimal digits.
+template <typename T>
+struct Evaluator : ErrorState
+{
+    typedef T Value;
+    typedef T Number;
+
+    constexpr explicit Evaluator(const VariableTable* variables = NULL) : variables(variables), skipping(0) {}
+
+    constexpr Value number(Number value) { return value; }
+
+    constexpr Value variable(const char* name, size_t length)
+    {
+        if (skipping > 0)
+            return 0;
+
+        //Every name in the expression has to be bound before it can be evaluated.
+        int slot = (variables != NULL) ? variables->find(name, length) : -1;
+        if (slot < 0)
+        {
+            fail(ErrorCode::UnknownVariable, name);
+            return 0;
+        }
+
+        return Value(variables->get(slot));
+    }
+
+    constexpr Value negate(Value value) { return value * -1; }
+
+    constexpr Value add(Value first, Value second) { return first + second; }
+
+    constexpr Value subtract(Value first, Value second) { return first - second; }
+
+    constexpr Value multiply(Value first, Value second) { return first * second; }
+
+    constexpr Value divide(Value first, Value second, const char* at)
+    {
+        //Division by zero is a bad thing.  Unless it is never calculated.
+        if (skipping > 0)
+            return 0;
+        if (second == 0)
+        {
+            fail(ErrorCode::DivisionByZero, at);
+            return 0;
+        }
+
+        return first / second;
+    }
+
+    constexpr Value call(Function function, Value argument, const char* at) { return call(function, argument, argument, at); }
+
+    constexpr Value call(Function function, Value first, Value second, const char* at)
+    {
+        if (skipping > 0)
+            return 0;
+
+        //sqrt(-1) is as bad as dividing by zero.
+        ErrorCode error = checkDomain(function, first, second);
+        if (error != ErrorCode::None)
+        {
+            fail(error, at);
+            return 0;
+        }
+
+        return applyFunction(function, first, second);
+    }
+
+    //skipping counts the conditionals opened since the answer which isn't taken started, that one
+    //included, so the answer can be found where it ends; while it isn't 0 nothing is calculated.
+    constexpr void beginThen(Value condition)
+    {
+        if (skipping > 0)
+            skipping++;
+        else if (condition == 0)
+            skipping = 1;
+    }
+
+    constexpr void beginElse(Value, Value)
+    {
+        //The answer which was skipped is over, or the one which was taken is.
+        if (skipping == 1)
+            skipping = 0;
+        else if (skipping == 0)
+            skipping = 1;
+    }
+
+    constexpr Value endConditional(Value, Value then, Value otherwise)
+    {
+        if (skipping > 1)
+        {
+            skipping--;
+            return 0;
+        }
+
+        //Skipping still means the first answer was the one taken.
+        if (skipping == 1)
+        {
+            skipping = 0;
+            return then;
+        }
+
+        return otherwise;
+    }
+
+    const VariableTable* variables;
+    int skipping;
+};
+
+template <typename Actions>
+constexpr typename Actions::Value tokenizeNumbers(const char*& eq, int& countParenthesis, Actions& actions);
+
+template <typename Actions>
+constexpr typename Actions::Value tokenizeExpression(const char*& eq, int& countParenthesis, Actions& actions);
+
+template <typename Actions>
+constexpr typename Actions::Value tokenizePower(const char*& eq, int& countParenthesis, Actions& actions);
+
+template <typename Actions>
+constexpr typename Actions::Value tokenizeMulDiv(const char*& eq, int& countParenthesis, Actions& actions);
+
+template <typename Actions>
+constexpr typename Actions::Value tokenizeSum(const char*& eq, int& countParenthesis, Actions& actions);
+
+//NAME: tokenizeLeaf
+//DESCRIPTION:  Looks for a variable or a number, the operands which don't contain anything else.
+//              The unary minus in front of it, if any, has already been taken by tokenizePower().
+//INPUT/OUTPUT:
+//    eq      - The pointer to where we currently are in the expression, left after the operand.
+//    actions - What to do with the operand that is found.
+//RETURNS:
+//    The value of the operand.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeLeaf(const char*& eq, Actions& actions)
+{
+    //A name such as x or rate stands for whatever value it has been bound to.
+    if (isIdentifierStart(*eq))
+    {
+        const char* name = eq;
+        while (isIdentifierChar(*eq))
+            eq++;
+
+        return actions.variable(name, eq - name);
+    }
+
+    //Convert the character string to a number, and then update the current position
+    //in our string to be after this number.
+    const char* eptr;
+    typename Actions::Number toNumber = makeFloat<typename Actions::Number>(eq, eptr);
+
+    //It would be bad if the float value was zero characters long.  Whatever is here,
+    //it isn't something we can calculate with.
+    if (eptr == eq)
+    {
+        actions.fail(ErrorCode::ExpectedNumber, eq);
+        return actions.number(0);
+    }
+
+    //Update the current pointer of our expression to the end pointer after makeFloat.
+    eq = eptr;
+    return actions.number(toNumber);
+}
+
+//NAME: tokenizeCall
+//DESCRIPTION:  Parses the arguments of a function, each of them a whole expression of its own, and calls it.
+//INPUT:
+//    function - The function being called.
+//    name     - Where its name starts.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression, the open parenthesis after the name.
+//          Left after the closing parenthesis.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value the function returns.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeCall(Function function, const char* name, const char*& eq, int& countParenthesis,
+                                               Actions& actions)
+{
+    const char* open = eq;
+    eq++;
+    countParenthesis++;
+    CALC_TRACK_PARENTHESIS(countParenthesis);
+
+    typename Actions::Value first = tokenizeExpression(eq, countParenthesis, actions);
+    if (actions.failed())
+        return first;
+
+    typename Actions::Value second = first;
+    if (functionArguments(function) == 2)
+    {
+        if (*eq != ',')
+        {
+            actions.fail(*eq == ')' ? ErrorCode::ArgumentCount : ErrorCode::UnmatchedParenthesis, *eq == ')' ? eq : open);
+            return first;
+        }
+
+        eq++;
+        second = tokenizeExpression(eq, countParenthesis, actions);
+        if (actions.failed())
+            return first;
+    }
+
+    //One argument too many is found at its comma.
+    if (*eq != ')')
+    {
+        actions.fail(*eq == ',' ? ErrorCode::ArgumentCount : ErrorCode::UnmatchedParenthesis, *eq == ',' ? eq : open);
+        return first;
+    }
+
+    eq++;
+    countParenthesis--;
+
+    if (functionArguments(function) == 2)
+        return actions.call(function, first, second, name);
+    else
+        return actions.call(function, first, name);
+}
+
+//NAME: tokenizeNumbers
+//DESCRIPTION:  By order of operations, the lowest possible sub-expression to be parsed
+//              is one in parenthesis.  We will assume that even a number by itself is
+//              surrounded by parentheses: (5) + (6) + (4 - 3)
+//              This function will therefore look for any numbers, variables or function calls.  When it finds
+//              a parentheses it will evaluate that expression until it boils it down to just one number,
+//              and then we're back here.  Spaces and a leading minus sign have already been taken by
+//              tokenizePower().
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//                       Should be back to zero when the expression is done.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value representing the value in parentheses.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeNumbers(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizeNumbers);
+
+    //Border condition check
+    assert(eq != NULL);
+
+    //We've found an open parenthesis!  This means we can recursively parse
+    //another expression in exactly the same way we've been doing so far.
+    if (*eq == '(')
+    {
+        const char* open = eq;
+        eq++;
+        countParenthesis++;
+        CALC_TRACK_PARENTHESIS(countParenthesis);
+
+        typename Actions::Value calculated = tokenizeExpression(eq, countParenthesis, actions);
+        if (actions.failed())
+            return calculated;
+
+        //Tokenize parentheses should always leave off at the closing parenthesis!
+        //If it didn't, this one is never closed.
+        if (*eq != ')')
+        {
+            actions.fail(ErrorCode::UnmatchedParenthesis, open);
+            return calculated;
+        }
+
+        eq++;
+        countParenthesis--;
+        return calculated;
+    }
+
+    //A name followed by an open parenthesis calls a function, anything else is a variable.
+    if (isIdentifierStart(*eq))
+    {
+        const char* end = eq;
+        while (isIdentifierChar(*end))
+            end++;
+
+        const char* open = skipSpaces(end);
+        if (*open == '(')
+        {
+            Function function = Function::Power;
+            if (!findFunction(eq, end - eq, function))
+            {
+                actions.fail(ErrorCode::UnknownFunction, eq);
+                return actions.number(0);
+            }
+
+            const char* name = eq;
+            eq = open;
+            return tokenizeCall(function, name, eq, countParenthesis, actions);
+        }
+    }
+
+    return tokenizeLeaf(eq, actions);
+}
+
+//NAME: tokenizePower
+//DESCRIPTION:  Powers come before multiplication and division, and a minus sign in front of one negates
+//              the whole power, the way -2^2 is -4 on paper.  They are right associative, 2^3^2 is 2^9,
+//              so the power is parsed by calling this function again, which also lets it be negative: 2^-1.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value representing the value after raising to a power.
+template <typename Actions>
+constexpr typename Actions::Value tokenizePower(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizePower);
+
+    //So at this point we are sitting here in our hypothetical expression
+    //-(4+6)
+    //^
+    eq = skipSpaces(eq);
+
+    bool hasNegative = false;
+    if (*eq == '-')
+    {
+        hasNegative = true;
+        eq++;
+    }
+
+    typename Actions::Value base = tokenizeNumbers(eq, countParenthesis, actions);
+    if (actions.failed())
+        return base;
+
+    eq = skipSpaces(eq);
+    if ((characterClass(*eq) & kPowerClass) != 0)
+    {
+        eq++;
+        eq = skipSpaces(eq);
+
+        const char* power = eq;
+        typename Actions::Value exponent = tokenizePower(eq, countParenthesis, actions);
+        if (actions.failed())
+            return base;
+
+        base = actions.call(Function::Power, base, exponent, power);
+        if (actions.failed())
+            return base;
+    }
+
+    if (hasNegative)
+        return actions.negate(base);
+    else
+        return base;
+}
+
+//NAME: tokenizeMulDiv
+//DESCRIPTION:  Multiplication and division have higher priority than addition or subtraction.
+//              We should therefore look at these first.  The only things with higher priority
+//              are powers and parentheses.  We consider all numbers to be surrounded by parentheses as well,
+//              this way we can retrieve numbers before the operator that applies to them.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//                       Should be back to zero when the expression is done.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value representing the value after a multiplication or division.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeMulDiv(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizeMulDiv);
+
+    //Always extract powers, numbers or sub-expressions first!
+    typename Actions::Value first = tokenizePower(eq, countParenthesis, actions);
+
+    //It's ok to loop infinitely when he have a definitive out in the loop.
+    while (true)
+    {
+        //Once something has gone wrong there is no point in going on.
+        if (actions.failed())
+            return first;
+
+        //Ignore spaces.
+        eq = skipSpaces(eq);
+
+        //Let's look at an operator.
+        //If eq isn't pointing at a division or multiplication symbol
+        //there is nothing for us to do here, return the number from tokenizeNumbers.
+        char opr = *eq;
+        if ((characterClass(opr) & kProductClass) == 0)
+            return first;
+
+        eq++;
+
+        //If we've gotten this far it means we must be either dividing or multiplying,
+        //so let's get the second number and figure out what to do.
+        //Again this function 'tokenizePower' will either evaluate a set of parentheses
+        //or directly give us the number if there are no parentheses.
+        eq = skipSpaces(eq);
+
+        const char* divisor = eq;
+        typename Actions::Value second = tokenizePower(eq, countParenthesis, actions);
+        if (actions.failed())
+            return first;
+
+        if (opr != '/')
+            first = actions.multiply(first, second);
+        else
+            first = actions.divide(first, second, divisor);
+    }
+}
+
+//NAME: tokenizeSum
+//DESCRIPTION:  Addition and subtraction come after everything but comparisons and conditionals, which
+//              is why this function is the last of the arithmetic to do any evaluation.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//                       Should be back to zero when the expression is done.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value calculated from the sum.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeSum(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizeSum);
+
+    //Always scan for a multiplication or division first, as these have higher priority.
+    //We might end up back in this function through this call.
+    typename Actions::Value first = tokenizeMulDiv(eq, countParenthesis, actions);
+    while (true)
+    {
+        if (actions.failed())
+            return first;
+
+        //Ignore spaces.
+        eq = skipSpaces(eq);
+
+        //Similar to tokenizeMulDiv, except this time with addition or subtraction.
+        //This is also what boots us out of the recursion when everything is done.
+        char opr = *eq;
+        if ((characterClass(opr) & kSumClass) == 0)
+            return first;
+        eq++;
+
+        //If we've gotten this far, it means that we legitimately have an addition or
+        //subtraction; however the second number might be an expression itself.
+        //Let's check for this.
+        typename Actions::Value second = tokenizeMulDiv(eq, countParenthesis, actions);
+        if (actions.failed())
+            return first;
+
+        if (opr == '+')
+            first = actions.add(first, second);
+        else
+            first = actions.subtract(first, second);
+    }
+}
+
+//NAME: findComparison
+//DESCRIPTION:  Checks to see if a comparison starts at eq.  A lone = or ! isn't one.
+//INPUT:
+//    eq - Where the comparison may start.
+//OUTPUT:
+//    function - The comparison, if there is one.
+//RETURNS:
+//    How many characters the comparison has, 0 if there isn't one.
+constexpr int findComparison(const char* eq, Function& function)
+{
+    if ((characterClass(*eq) & kComparisonClass) == 0)
+        return 0;
+
+    const bool orEqual = eq[1] == '=';
+    switch (*eq)
+    {
+    case '<': function = orEqual ? Function::LessEqual : Function::Less;        break;
+    case '>': function = orEqual ? Function::GreaterEqual : Function::Greater;  break;
+    case '=': function = Function::Equal;                                       break;
+    default:  function = Function::NotEqual;                                    break;
+    }
+
+    if (!orEqual && (*eq == '=' || *eq == '!'))
+        return 0;
+
+    return orEqual ? 2 : 1;
+}
+
+//NAME: tokenizeComparison
+//DESCRIPTION:  Comparisons come after sums, 1 + 2 < 4 is 3 < 4, and from the left like C, so 3 > 2 > 1 is
+//              1 > 1, which is 0.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value of the comparison, 1 or 0, or of the sum if there isn't one.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeComparison(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizeComparison);
+
+    typename Actions::Value first = tokenizeSum(eq, countParenthesis, actions);
+    while (true)
+    {
+        if (actions.failed())
+            return first;
+
+        eq = skipSpaces(eq);
+
+        Function comparison = Function::Less;
+        const char* at = eq;
+        int length = findComparison(eq, comparison);
+        if (length == 0)
+            return first;
+        eq += length;
+
+        typename Actions::Value second = tokenizeSum(eq, countParenthesis, actions);
+        if (actions.failed())
+            return first;
+
+        first = actions.call(comparison, first, second, at);
+    }
+}
+
+//NAME: tokenizeAnd
+//DESCRIPTION:  a && b is 1 if both a and b aren't 0, and 0 otherwise.  Like in C, b is only looked at if
+//              a isn't 0, so it is recorded as the conditional a ? (b != 0) : 0.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value of the &&, or of the comparison if there isn't one.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeAnd(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizeAnd);
+
+    typename Actions::Value first = tokenizeComparison(eq, countParenthesis, actions);
+    while (true)
+    {
+        if (actions.failed())
+            return first;
+
+        eq = skipSpaces(eq);
+        if (eq[0] != '&' || eq[1] != '&')
+            return first;
+
+        const char* at = eq;
+        eq += 2;
+
+        actions.beginThen(first);
+        typename Actions::Value second = tokenizeComparison(eq, countParenthesis, actions);
+        if (actions.failed())
+            return first;
+
+        typename Actions::Value zero = actions.number(0);
+        typename Actions::Value truth = actions.call(Function::NotEqual, second, zero, at);
+        actions.beginElse(first, truth);
+
+        typename Actions::Value otherwise = actions.number(0);
+        first = actions.endConditional(first, truth, otherwise);
+    }
+}
+
+//NAME: tokenizeOr
+//DESCRIPTION:  a || b is 1 if either a or b isn't 0, and 0 otherwise.  b is only looked at if a is 0,
+//              so it is recorded as the conditional a ? 1 : (b != 0).  && comes first, as in C.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value of the ||, or of the && if there isn't one.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeOr(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizeOr);
+
+    typename Actions::Value first = tokenizeAnd(eq, countParenthesis, actions);
+    while (true)
+    {
+        if (actions.failed())
+            return first;
+
+        eq = skipSpaces(eq);
+        if (eq[0] != '|' || eq[1] != '|')
+            return first;
+
+        const char* at = eq;
+        eq += 2;
+
+        actions.beginThen(first);
+        typename Actions::Value one = actions.number(1);
+        actions.beginElse(first, one);
+
+        typename Actions::Value second = tokenizeAnd(eq, countParenthesis, actions);
+        if (actions.failed())
+            return first;
+
+        typename Actions::Value zero = actions.number(0);
+        typename Actions::Value truth = actions.call(Function::NotEqual, second, zero, at);
+        first = actions.endConditional(first, one, truth);
+    }
+}
+
+//NAME: tokenizeExpression
+//DESCRIPTION:  The top level function which begins the parse.  This function is called also when parsing
+//              from parentheses and for the arguments of a function.  It handles the conditional
+//              condition ? then : otherwise, which is right associative, so a ? b : c ? d : e is
+//              a ? b : (c ? d : e), and has a whole expression between the ? and the : as in C.
+//INPUT/OUTPUT:
+//    eq  - The pointer to where we currently are in the expression.
+//    countParenthesis - The counter which keeps track of how many parentheses we've come across.
+//                       Should be back to zero when the expression is done.
+//    actions - What to do with the numbers and operators that are found.
+//RETURNS:
+//    The value calculated from the expression.
+template <typename Actions>
+constexpr typename Actions::Value tokenizeExpression(const char*& eq, int& countParenthesis, Actions& actions)
+{
+    CALC_TIME_STAGE(Stage::TokenizeExpression);
+
+    typename Actions::Value condition = tokenizeOr(eq, countParenthesis, actions);
+    if (actions.failed())
+        return condition;
+
+    eq = skipSpaces(eq);
+    if (*eq != '?')
+        return condition;
+
+    const char* question = eq;
+    eq++;
+
+    actions.beginThen(condition);
+    typename Actions::Value then = tokenizeExpression(eq, countParenthesis, actions);
+    if (actions.failed())
+        return condition;
+
+    //The first answer stops at anything it doesn't understand, which has to be the : of the other one.
+    if (*eq != ':')
+    {
+        actions.fail(ErrorCode::UnmatchedConditional, question);
+        return condition;
+    }
+
+    eq++;
+    actions.beginElse(condition, then);
+    typename Actions::Value otherwise = tokenizeExpression(eq, countParenthesis, actions);
+    if (actions.failed())
+        return condition;
+
+    return actions.endConditional(condition, then, otherwise);
+}
+
+//NAME: parseExpression
+//DESCRIPTION:  Parses a complete expression, which has to end with the end of the string.
+//              Anything left over means the expression was malformed.
+//INPUT:
+//    eq  - The expression.
+//INPUT/OUTPUT:
+//    actions - What to do with the numbers and operators that are found.  Holds the error, if any.
+//RETURNS:
+//    The value of the expression.  Meaningless if actions.failed().
+template <typename Actions>
+constexpr typename Actions::Value parseExpression(const char* eq, Actions& actions)
+{
+    assert(eq != NULL);
+
+    int pCount = 0;
+    typename Actions::Value value = tokenizeExpression(eq, pCount, actions);
+    if (actions.failed())
+        return value;
+
+    //tokenizeExpression stops at the first thing it doesn't understand, spaces already skipped.
+    //A closing parenthesis here was never opened.
+    if (*eq == ')')
+        actions.fail(ErrorCode::UnmatchedParenthesis, eq);
+    else if (*eq != '\0')
+        actions.fail(ErrorCode::UnexpectedCharacter, eq);
+
+    return value;
+}
+
+//NAME: solve
+//DESCRIPTION:  Evaluates a complete expression using arithmetic of type T.
+//INPUT:
+//    eq        - The expression to evaluate.
+//    variables - The values of the variables the expression uses, NULL if there are none.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The answer, or the error and where in eq it was found.
+template <typename T = double>
+constexpr Result<T> solve(const char* eq, const VariableTable* variables = NULL)
+{
+    Evaluator<T> evaluator(variables);
+    T answer = parseExpression(eq, evaluator);
+
+    Result<T> result;
+    result.value = answer;
+    result.error = evaluator.error;
+    result.offset = evaluator.failed() ? (int)(evaluator.errorAt - eq) : 0;
+    return result;
+}
+
+//NAME: malformedConstantExpression
+//DESCRIPTION:  Deliberately not constexpr: solveConstant() calls it for a malformed expression, which
+//              can't be done while compiling, so the compiler reports the call as an error.
+inline void malformedConstantExpression(ErrorCode, int)
+{
+}
+
+//NAME: solveConstant
+//DESCRIPTION:  Evaluates an expression which is known when the program is built, such as a string literal,
+//              while compiling:
+//                  constexpr double kRate = solveConstant("0.0325 / 12");
+//              The answer is a constant, exactly what solve() would calculate at run time.  An expression
+//              solve() would report an error for, including one with variables, doesn't compile.
+//INPUT:
+//    eq - The expression to evaluate.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The answer.
+template <typename T = double>
+consteval T solveConstant(const char* eq)
+{
+    Result<T> result = solve<T>(eq);
+    if (!result.ok())
+        malformedConstantExpression(result.error, result.offset);
+
+    return result.value;
+}
+
+//NAME: solve
+//DESCRIPTION:  Evaluates a complete expression which may refer to variables using arithmetic of type T.
+//INPUT:
+//    eq        - The expression to evaluate.
+//    variables - The values of the variables the expression uses.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The answer, or the error and where in eq it was found.
+template <typename T = double>
+Result<T> solve(const char* eq, const VariableTable& variables)
+{
+    return solve<T>(eq, &variables);
+}
+
+#endif
@@ -0,0 +1,706 @@
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "server.h"
+#include "stream.h"
+
+#if defined(CALC_SERVER_EPOLL)
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+//The length and the id in front of every frame.
+static const size_t kFrameHeader = 8;
+
+//How much is read from a connection at a time.
+static const size_t kReadSize = 64 << 10;
+
+//What epoll tells apart events by: the listener, the workers waking run() up, then the connections.
+static const uint64_t kListenerKey = 0;
+static const uint64_t kWakeupKey = 1;
+static const uint64_t kFirstConnection = 2;
+
+//NAME: Job
+//DESCRIPTION:  One request to be solved, or one response to be sent, and the connection it belongs to.
+struct Job
+{
+    uint64_t connection;
+    uint32_t id;
+    std::string text;
+};
+
+//NAME: Connection
+//DESCRIPTION:  A client.  input holds what has been read but not yet made into requests, output the
+//              responses not yet sent, the first of them sent up to written.  A client which has sent
+//              everything it is going to may shut down its side; it still gets all of its responses.
+struct Connection
+{
+    int socket;
+    uint64_t key;
+    std::string input;
+    std::deque<std::string> output;
+    size_t written;
+    int inFlight;
+    bool reading;
+    bool writing;
+    bool finished;
+    bool closed;
+};
+
+//NAME: ServerState
+//DESCRIPTION:  Everything a running server needs: its sockets, its connections and its workers.
+struct ServerState
+{
+    ServerState() : listener(-1), poller(-1), wakeup(-1), boundPort(0), nextKey(kFirstConnection), stopping(false) {}
+
+    int listener;
+    int poller;
+    int wakeup;
+    int boundPort;
+    std::string unixPath;
+
+    //Only the thread running run() touches the connections.
+    std::unordered_map<uint64_t, Connection*> connections;
+    uint64_t nextKey;
+
+    //Requests waiting for a worker, and responses waiting to be sent.
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<Job> requests;
+    std::deque<Job> responses;
+    bool stopping;
+
+    std::vector<std::thread> workers;
+};
+
+//NAME: serverSupported
+//DESCRIPTION:  Checks to see if a server can run on this platform.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    True if it can.
+bool serverSupported()
+{
+#if defined(CALC_SERVER_EPOLL)
+    return true;
+#else
+    return false;
+#endif
+}
+
+//NAME: Server::Server
+//DESCRIPTION:  Creates a server which isn't listening yet.
+//INPUT:
+//    options - How it works.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+Server::Server(const ServerOptions& options) : options(options), state(new ServerState())
+{
+}
+
+#if defined(CALC_SERVER_EPOLL)
+
+//NAME: putWord
+//DESCRIPTION:  Writes a 32 bit number as 4 little endian bytes.
+static void putWord(char* bytes, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        bytes[i] = (char)(value >> (8 * i));
+}
+
+//NAME: getWord
+//DESCRIPTION:  Reads 4 little endian bytes as a 32 bit number.
+static uint32_t getWord(const char* bytes)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+        value |= (uint32_t)(unsigned char)bytes[i] << (8 * i);
+    return value;
+}
+
+//NAME: solveRequests
+//DESCRIPTION:  What every worker does: solves requests until the server stops, and hands every response
+//              back to run() to be sent.
+//INPUT:
+//    format - How to write the answers.
+//INPUT/OUTPUT:
+//    state  - The server.
+//RETURNS:
+//    none
+static void solveRequests(ServerState& state, NumberFormat format)
+{
+    OutputBuffer out;
+    for (;;)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.ready.wait(lock, [&] { return state.stopping || !state.requests.empty(); });
+            if (state.stopping)
+                return;
+
+            job = std::move(state.requests.front());
+            state.requests.pop_front();
+        }
+
+        //The header is filled in once the length of the answers is known.  A request is solved by the one
+        //worker which took it, line by line, rather than spread over every worker with solveAll(): the
+        //other workers stay free for the requests behind it, so a large request never holds up small ones.
+        out.clear();
+        out.commit(kFrameHeader);
+        evaluateLines(job.text.data(), job.text.data() + job.text.size(), out, format);
+
+        job.text.assign(out.data(), out.size());
+        if (out.failed())
+            job.text.resize(kFrameHeader);
+        putWord(&job.text[0], (uint32_t)(job.text.size() - 4));
+        putWord(&job.text[4], job.id);
+
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.responses.push_back(std::move(job));
+        }
+
+        uint64_t one = 1;
+        if (::write(state.wakeup, &one, sizeof(one)) < 0)
+        {
+            //The counter is already full, so run() is going to wake up anyway.
+        }
+    }
+}
+
+//NAME: watch
+//DESCRIPTION:  Tells epoll which events of a connection run() wants to hear about.
+static void watch(ServerState& state, Connection& connection)
+{
+    epoll_event event = {};
+    event.events = (connection.reading ? (uint32_t)EPOLLIN : 0) | (connection.writing ? (uint32_t)EPOLLOUT : 0);
+    event.data.u64 = connection.key;
+    epoll_ctl(state.poller, EPOLL_CTL_MOD, connection.socket, &event);
+}
+
+//NAME: closeConnection
+//DESCRIPTION:  Hangs up on a client.  The connection is only forgotten once none of its requests are
+//              being solved any more; their responses are thrown away.
+static void closeConnection(ServerState& state, Connection& connection)
+{
+    if (!connection.closed)
+    {
+        epoll_ctl(state.poller, EPOLL_CTL_DEL, connection.socket, NULL);
+        ::close(connection.socket);
+        connection.closed = true;
+        connection.input.clear();
+        connection.output.clear();
+    }
+
+    if (connection.inFlight == 0)
+    {
+        state.connections.erase(connection.key);
+        delete &connection;
+    }
+}
+
+//NAME: sendResponses
+//DESCRIPTION:  Sends as much of a connection's responses as the socket takes without waiting.
+//RETURNS:
+//    False if the connection broke and was closed.
+static bool sendResponses(ServerState& state, Connection& connection)
+{
+    while (!connection.output.empty())
+    {
+        const std::string& response = connection.output.front();
+        ssize_t sent = ::send(connection.socket, response.data() + connection.written,
+                              response.size() - connection.written, MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+            closeConnection(state, connection);
+            return false;
+        }
+
+        connection.written += (size_t)sent;
+        if (connection.written == response.size())
+        {
+            connection.output.pop_front();
+            connection.written = 0;
+        }
+    }
+
+    if (connection.output.empty() && connection.finished && connection.inFlight == 0)
+    {
+        closeConnection(state, connection);
+        return false;
+    }
+
+    //Only ask to hear about room in the socket while there is something waiting for it.
+    bool writing = !connection.output.empty();
+    if (writing != connection.writing)
+    {
+        connection.writing = writing;
+        watch(state, connection);
+    }
+
+    return true;
+}
+
+//NAME: takeRequests
+//DESCRIPTION:  Hands every complete request read from a connection to the workers, as long as the
+//              connection doesn't have too many being solved already.
+//RETURNS:
+//    False if the connection sent a frame that is too long and was closed.
+static bool takeRequests(ServerState& state, Connection& connection)
+{
+    size_t used = 0;
+    int taken = 0;
+    while (connection.inFlight < kServerMaxInFlight && connection.input.size() - used >= kFrameHeader)
+    {
+        const char* frame = connection.input.data() + used;
+        uint32_t length = getWord(frame);
+        if (length < 4 || length > kServerMaxFrame - 4)
+        {
+            closeConnection(state, connection);
+            return false;
+        }
+
+        if (connection.input.size() - used < 4 + (size_t)length)
+            break;
+
+        Job job;
+        job.connection = connection.key;
+        job.id = getWord(frame + 4);
+        job.text.assign(frame + kFrameHeader, length - 4);
+        {
+            std::lock_guard<std::mutex> lock(state.mutex);
+            state.requests.push_back(std::move(job));
+        }
+
+        connection.inFlight++;
+        taken++;
+        used += 4 + (size_t)length;
+    }
+
+    connection.input.erase(0, used);
+    if (taken == 1)
+        state.ready.notify_one();
+    else if (taken > 1)
+        state.ready.notify_all();
+
+    //Stop reading while the workers catch up; finishing a request starts it again.
+    bool reading = !connection.finished && connection.inFlight < kServerMaxInFlight;
+    if (reading != connection.reading)
+    {
+        connection.reading = reading;
+        watch(state, connection);
+    }
+
+    return true;
+}
+
+//NAME: receiveRequests
+//DESCRIPTION:  Reads everything a client has sent so far.
+static void receiveRequests(ServerState& state, Connection& connection)
+{
+    for (;;)
+    {
+        size_t size = connection.input.size();
+        connection.input.resize(size + kReadSize);
+        ssize_t received = ::recv(connection.socket, &connection.input[size], kReadSize, 0);
+        connection.input.resize(size + (received > 0 ? (size_t)received : 0));
+
+        if (received > 0)
+        {
+            if (!takeRequests(state, connection))
+                return;
+            if (!connection.reading)
+                return;
+            continue;
+        }
+
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+
+        if (received < 0)
+        {
+            closeConnection(state, connection);
+            return;
+        }
+
+        //The client has sent everything; answer what it asked and then hang up.
+        connection.finished = true;
+        connection.reading = false;
+        watch(state, connection);
+        sendResponses(state, connection);
+        return;
+    }
+}
+
+//NAME: acceptClients
+//DESCRIPTION:  Takes every client waiting to connect.
+static void acceptClients(ServerState& state)
+{
+    for (;;)
+    {
+        int client = accept4(state.listener, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+
+        //Responses are whole frames already, so waiting to fill a packet only adds delay.
+        int on = 1;
+        setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        Connection* connection = new Connection();
+        connection->socket = client;
+        connection->key = state.nextKey++;
+        connection->written = 0;
+        connection->inFlight = 0;
+        connection->reading = true;
+        connection->writing = false;
+        connection->finished = false;
+        connection->closed = false;
+        state.connections[connection->key] = connection;
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = connection->key;
+        if (epoll_ctl(state.poller, EPOLL_CTL_ADD, client, &event) != 0)
+            closeConnection(state, *connection);
+    }
+}
+
+//NAME: deliverResponses
+//DESCRIPTION:  Queues every response the workers have finished on its connection, and sends them.
+static void deliverResponses(ServerState& state)
+{
+    uint64_t count;
+    if (::read(state.wakeup, &count, sizeof(count)) < 0)
+    {
+        //Nothing to clear; the responses are checked regardless.
+    }
+
+    std::deque<Job> finished;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        finished.swap(state.responses);
+    }
+
+    std::vector<uint64_t> touched;
+    for (size_t i = 0; i < finished.size(); i++)
+    {
+        std::unordered_map<uint64_t, Connection*>::iterator found = state.connections.find(finished[i].connection);
+        if (found == state.connections.end())
+            continue;
+
+        Connection& connection = *found->second;
+        connection.inFlight--;
+        if (connection.closed)
+        {
+            closeConnection(state, connection);
+            continue;
+        }
+
+        connection.output.push_back(std::move(finished[i].text));
+        touched.push_back(connection.key);
+    }
+
+    for (size_t i = 0; i < touched.size(); i++)
+    {
+        std::unordered_map<uint64_t, Connection*>::iterator found = state.connections.find(touched[i]);
+        if (found == state.connections.end() || found->second->closed)
+            continue;
+
+        //The requests which had to wait can go to the workers now, before a client which has sent
+        //everything is hung up on for having no more responses coming.
+        Connection& connection = *found->second;
+        if (takeRequests(state, connection) && sendResponses(state, connection) && connection.reading)
+            receiveRequests(state, connection);
+    }
+}
+
+//NAME: openListener
+//DESCRIPTION:  Creates the listening socket for an address: "unix:<path>" for a Unix socket,
+//              "<host>:<port>" or just "<port>" for TCP, on 127.0.0.1 when no host is given.
+//RETURNS:
+//    The socket, or -1 if it couldn't be created.
+static int openListener(ServerState& state, const char* address)
+{
+    if (strncmp(address, "unix:", 5) == 0)
+    {
+        sockaddr_un local = {};
+        local.sun_family = AF_UNIX;
+        if (strlen(address + 5) >= sizeof(local.sun_path))
+            return -1;
+        strcpy(local.sun_path, address + 5);
+
+        int listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listener < 0)
+            return -1;
+
+        //A socket left behind by a server that didn't stop cleanly would be in the way.
+        unlink(local.sun_path);
+        if (bind(listener, (sockaddr*)&local, sizeof(local)) != 0 || ::listen(listener, SOMAXCONN) != 0)
+        {
+            ::close(listener);
+            return -1;
+        }
+
+        state.unixPath = local.sun_path;
+        return listener;
+    }
+
+    std::string host = "127.0.0.1";
+    const char* port = address;
+    const char* colon = strrchr(address, ':');
+    if (colon != NULL)
+    {
+        host.assign(address, colon);
+        port = colon + 1;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    addrinfo* found = NULL;
+    if (getaddrinfo(host.c_str(), port, &hints, &found) != 0)
+        return -1;
+
+    int listener = -1;
+    for (addrinfo* candidate = found; candidate != NULL && listener < 0; candidate = candidate->ai_next)
+    {
+        listener = ::socket(candidate->ai_family, candidate->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, candidate->ai_protocol);
+        if (listener < 0)
+            continue;
+
+        int on = 1;
+        setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (bind(listener, candidate->ai_addr, candidate->ai_addrlen) != 0 || ::listen(listener, SOMAXCONN) != 0)
+        {
+            ::close(listener);
+            listener = -1;
+            continue;
+        }
+
+        sockaddr_storage bound;
+        socklen_t length = sizeof(bound);
+        if (getsockname(listener, (sockaddr*)&bound, &length) == 0)
+            state.boundPort = bound.ss_family == AF_INET6 ? ntohs(((sockaddr_in6*)&bound)->sin6_port)
+                                                          : ntohs(((sockaddr_in*)&bound)->sin_port);
+    }
+
+    freeaddrinfo(found);
+    return listener;
+}
+
+//NAME: Server::~Server
+//DESCRIPTION:  Stops the workers, hangs up on every client and closes the sockets.
+//              run() must have returned already.
+Server::~Server()
+{
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->stopping = true;
+    }
+    state->ready.notify_all();
+    for (size_t i = 0; i < state->workers.size(); i++)
+        state->workers[i].join();
+
+    for (std::unordered_map<uint64_t, Connection*>::iterator it = state->connections.begin(); it != state->connections.end(); ++it)
+    {
+        if (!it->second->closed)
+            ::close(it->second->socket);
+        delete it->second;
+    }
+
+    if (state->listener >= 0)
+        ::close(state->listener);
+    if (!state->unixPath.empty())
+        unlink(state->unixPath.c_str());
+    if (state->poller >= 0)
+        ::close(state->poller);
+    if (state->wakeup >= 0)
+        ::close(state->wakeup);
+}
+
+//NAME: Server::listen
+//DESCRIPTION:  Starts listening for clients, and starts the workers.
+//INPUT:
+//    address - "unix:<path>" for a Unix socket, "<host>:<port>" or "<port>" for TCP.  Port 0 picks
+//              any free port, see port().
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if the address can't be listened on.
+bool Server::listen(const char* address)
+{
+    if (state->listener >= 0)
+        return false;
+
+    state->listener = openListener(*state, address);
+    if (state->listener < 0)
+        return false;
+
+    state->poller = epoll_create1(EPOLL_CLOEXEC);
+    state->wakeup = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (state->poller < 0 || state->wakeup < 0)
+        return false;
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u64 = kListenerKey;
+    epoll_ctl(state->poller, EPOLL_CTL_ADD, state->listener, &event);
+    event.data.u64 = kWakeupKey;
+    epoll_ctl(state->poller, EPOLL_CTL_ADD, state->wakeup, &event);
+
+    unsigned threads = options.threads != 0 ? options.threads : std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+    for (unsigned i = 0; i < threads; i++)
+        state->workers.emplace_back(solveRequests, std::ref(*state), options.format);
+
+    return true;
+}
+
+//NAME: Server::run
+//DESCRIPTION:  Serves clients until stop() is called.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if the server isn't listening, or waiting for clients failed.
+bool Server::run()
+{
+    if (state->listener < 0)
+        return false;
+
+    const int kEvents = 64;
+    epoll_event events[kEvents];
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (state->stopping)
+                return true;
+        }
+
+        int count = epoll_wait(state->poller, events, kEvents, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            uint64_t key = events[i].data.u64;
+            if (key == kListenerKey)
+            {
+                acceptClients(*state);
+                continue;
+            }
+            if (key == kWakeupKey)
+            {
+                deliverResponses(*state);
+                continue;
+            }
+
+            //An earlier event may have closed the connection already.
+            std::unordered_map<uint64_t, Connection*>::iterator found = state->connections.find(key);
+            if (found == state->connections.end() || found->second->closed)
+                continue;
+
+            //Nothing can be sent to a client which is gone altogether.
+            Connection& connection = *found->second;
+            if (events[i].events & (EPOLLHUP | EPOLLERR))
+                closeConnection(*state, connection);
+            else if ((events[i].events & EPOLLOUT) && !sendResponses(*state, connection))
+                continue;
+            else if (events[i].events & EPOLLIN)
+                receiveRequests(*state, connection);
+        }
+    }
+}
+
+//NAME: Server::stop
+//DESCRIPTION:  Makes run() return as soon as it can.  Safe to call from any thread.
+void Server::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(state->mutex);
+        state->stopping = true;
+    }
+    state->ready.notify_all();
+
+    uint64_t one = 1;
+    if (state->wakeup >= 0 && ::write(state->wakeup, &one, sizeof(one)) < 0)
+    {
+        //The counter is already full, so run() is going to wake up anyway.
+    }
+}
+
+//NAME: Server::port
+//DESCRIPTION:  The TCP port the server listens on, which is how to find the one port 0 picked.
+//RETURNS:
+//    The port, or 0 for a Unix socket.
+int Server::port() const
+{
+    return state->boundPort;
+}
+
+#else
+
+Server::~Server()
+{
+}
+
+bool Server::listen(const char*)
+{
+    return false;
+}
+
+bool Server::run()
+{
+    return false;
+}
+
+void Server::stop()
+{
+}
+
+int Server::port() const
+{
+    return 0;
+}
+
+#endif
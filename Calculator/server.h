@@ -0,0 +1,77 @@
+#ifndef CALCULATOR_SERVER_H
+#define CALCULATOR_SERVER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "format.h"
+
+//Starting the program for every small job costs far more than solving the job's expressions does.
+//A Server stays resident instead and solves batches of expressions sent to it over a Unix socket or TCP.
+//Every request and every response is one frame, all numbers little endian:
+//     uint32  length of the rest of the frame
+//     uint32  id, chosen by the client
+//     bytes   request:  expressions, one per line, exactly like the input of the streaming mode
+//             response: one line per expression, exactly like the output of the streaming mode
+//A client may send any number of requests without waiting for their answers.  One thread watches every
+//connection with epoll and hands each complete request to a pool of workers, and every response goes
+//back out as soon as it is ready: a large batch doesn't hold up the small ones sent after it, which is
+//why the responses carry the id of their request and may come back in a different order.
+//A connection with kServerMaxInFlight requests being solved isn't read from until one of them is done,
+//and a frame longer than kServerMaxFrame closes the connection.
+//
+//Only Linux is supported; everywhere else, or with CALC_NO_SERVER defined, Server::listen() just fails.
+
+#if defined(__linux__) && !defined(CALC_NO_SERVER)
+#define CALC_SERVER_EPOLL 1
+#endif
+
+//The longest frame a server accepts, length included.
+static const uint32_t kServerMaxFrame = 64 << 20;
+
+//How many requests of one connection may be being solved at once.
+static const int kServerMaxInFlight = 64;
+
+//NAME: ServerOptions
+//DESCRIPTION:  How a server works.  threads is how many workers solve requests, 0 for one per processor.
+struct ServerOptions
+{
+    ServerOptions() : threads(0) {}
+
+    unsigned threads;
+    NumberFormat format;
+};
+
+struct ServerState;
+
+//NAME: Server
+//DESCRIPTION:  Solves batches of expressions for clients connecting to it, until it is stopped.
+class Server
+{
+public:
+    explicit Server(const ServerOptions& options = ServerOptions());
+
+    ~Server();
+
+    Server(const Server&) = delete;
+
+    Server& operator=(const Server&) = delete;
+
+    bool listen(const char* address);
+
+    int port() const;
+
+    bool run();
+
+    void stop();
+
+private:
+    ServerOptions options;
+    std::unique_ptr<ServerState> state;
+};
+
+//Function declarations
+bool serverSupported();
+
+#endif
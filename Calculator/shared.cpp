@@ -0,0 +1,222 @@
+#include <bit>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "optimizer.h"
+#include "shared.h"
+
+//Registers and slots have to fit in 29 bits for an instruction to fit in a 64 bit key.
+static const int kMaxSharedOperand = 1 << 29;
+
+//NAME: Merger
+//DESCRIPTION:  Builds the shared program, adding an instruction only if an identical one isn't there yet.
+class Merger
+{
+public:
+    explicit Merger(Program& program) : program(program) {}
+
+    int constant(double value);
+
+    int instruction(OpCode op, int lhs, int rhs);
+
+    int branch(int condition);
+
+    int jump(int value);
+
+    int merge(int branch, int otherwise);
+
+private:
+    int find(std::unordered_map<uint64_t, int>& map, uint64_t key);
+
+    Program& program;
+
+    //The Branches of the conditionals being added, innermost last.
+    std::vector<int> branches;
+
+    //The register already holding every constant, by its bits, and every other instruction, by its key.
+    std::unordered_map<uint64_t, int> constants;
+    std::unordered_map<uint64_t, int> instructions;
+};
+
+//NAME: Merger::constant
+//DESCRIPTION:  Loads a constant.  -0 and +0 are different constants, as are NaNs with different bits.
+//INPUT:
+//    value - The constant.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding it.
+int Merger::constant(double value)
+{
+    int existing = find(constants, std::bit_cast<uint64_t>(value));
+    if (existing >= 0)
+        return existing;
+
+    program.constants.push_back(value);
+    Instruction in = { OpCode::Constant, (int)program.constants.size() - 1, 0 };
+    program.code.push_back(in);
+    return (int)program.code.size() - 1;
+}
+
+//NAME: Merger::instruction
+//DESCRIPTION:  Adds any instruction but a constant.
+//INPUT:
+//    op  - The operation.
+//    lhs - The first operand, already in the shared program, or the slot of a variable.
+//    rhs - The second operand, already in the shared program.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register holding the result.
+int Merger::instruction(OpCode op, int lhs, int rhs)
+{
+    //a + b is exactly b + a, and a * b is b * a, so they get the same key.
+    if ((op == OpCode::Add || op == OpCode::Multiply) && rhs < lhs)
+        std::swap(lhs, rhs);
+    if (op == OpCode::Variable || isUnary(op))
+        rhs = 0;
+
+    assert(lhs < kMaxSharedOperand && rhs < kMaxSharedOperand);
+    uint64_t key = ((uint64_t)op << 58) | ((uint64_t)lhs << 29) | (uint64_t)rhs;
+
+    int existing = find(instructions, key);
+    if (existing >= 0)
+        return existing;
+
+    Instruction in = { op, lhs, rhs };
+    program.code.push_back(in);
+    if (op == OpCode::Variable && lhs >= program.variableCount)
+        program.variableCount = lhs + 1;
+
+    return (int)program.code.size() - 1;
+}
+
+//NAME: Merger::branch
+//DESCRIPTION:  Adds the Branch of a conditional.  Conditionals are never merged, only what they read.
+//INPUT:
+//    condition - The register of the condition, already in the shared program.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register of the Branch.
+int Merger::branch(int condition)
+{
+    Instruction in = { OpCode::Branch, condition, -1 };
+    program.code.push_back(in);
+    branches.push_back((int)program.code.size() - 1);
+    return branches.back();
+}
+
+//NAME: Merger::jump
+//DESCRIPTION:  Adds the Jump after the first answer of the innermost conditional.
+//INPUT:
+//    value - The register of the first answer, already in the shared program.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register of the Jump.
+int Merger::jump(int value)
+{
+    Instruction in = { OpCode::Jump, value, -1 };
+    program.code.push_back(in);
+    program.code[branches.back()].rhs = (int)program.code.size() - 1;
+    return (int)program.code.size() - 1;
+}
+
+//NAME: Merger::merge
+//DESCRIPTION:  Adds the Merge at the end of the innermost conditional.
+//INPUT:
+//    branch    - The register of its Branch.
+//    otherwise - The register of the other answer, already in the shared program.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The register of the Merge.
+int Merger::merge(int branch, int otherwise)
+{
+    assert(branch == branches.back());
+    branches.pop_back();
+
+    Instruction in = { OpCode::Merge, branch, otherwise };
+    program.code.push_back(in);
+    program.code[program.code[branch].rhs].rhs = (int)program.code.size() - 1;
+    return (int)program.code.size() - 1;
+}
+
+//NAME: Merger::find
+//DESCRIPTION:  Looks for the register already holding a constant or an instruction, and makes the one about
+//              to be added the register for it if there isn't one.  Inside a conditional nothing is made the
+//              register for anything, since it is only written when the answer it is in is picked; what it
+//              needs from outside can still be found.
+//INPUT:
+//    key - The bits of the constant, or the key of the instruction.
+//INPUT/OUTPUT:
+//    map - Where to look.
+//RETURNS:
+//    The register, or -1 if the constant or instruction has to be added.
+int Merger::find(std::unordered_map<uint64_t, int>& map, uint64_t key)
+{
+    if (!branches.empty())
+    {
+        std::unordered_map<uint64_t, int>::const_iterator found = map.find(key);
+        return found == map.end() ? -1 : found->second;
+    }
+
+    std::pair<std::unordered_map<uint64_t, int>::iterator, bool> found =
+        map.insert(std::make_pair(key, (int)program.code.size()));
+    return found.second ? -1 : found.first->second;
+}
+
+//NAME: compileShared
+//DESCRIPTION:  Compiles several formulas into one program which calculates everything they have in
+//              common only once.
+//INPUT:
+//    formulas  - The formulas.
+//INPUT/OUTPUT:
+//    variables - The table to resolve names in.  Names it doesn't know yet are defined in it.
+//RETURNS:
+//    The shared program.  Pass it to evaluateShared() as many times as needed.
+SharedProgram compileShared(std::span<const char* const> formulas, VariableTable& variables)
+{
+    SharedProgram shared;
+    shared.outputs.resize(formulas.size());
+
+    Merger merger(shared.program);
+    std::vector<int> moved;
+    for (size_t f = 0; f < formulas.size(); f++)
+    {
+        Program program = compile(formulas[f], variables);
+        SharedOutput& output = shared.outputs[f];
+        output.answer = -1;
+        output.error = program.error;
+        output.errorOffset = program.errorOffset;
+        if (!program.ok())
+            continue;
+
+        //Optimizing every formula first brings the pieces they share into the same shape.
+        optimize(program);
+
+        //Where each of the formula's registers ended up in the shared program.
+        moved.resize(program.code.size());
+        for (size_t i = 0; i < program.code.size(); i++)
+        {
+            const Instruction& in = program.code[i];
+            switch (in.op)
+            {
+            case OpCode::Constant: moved[i] = merger.constant(program.constants[in.lhs]);                break;
+            case OpCode::Variable: moved[i] = merger.instruction(OpCode::Variable, in.lhs, 0);           break;
+            case OpCode::Negate:   moved[i] = merger.instruction(OpCode::Negate, moved[in.lhs], 0);      break;
+            case OpCode::Branch:   moved[i] = merger.branch(moved[in.lhs]);                              break;
+            case OpCode::Jump:     moved[i] = merger.jump(moved[in.lhs]);                                break;
+            case OpCode::Merge:    moved[i] = merger.merge(moved[in.lhs], moved[in.rhs]);                break;
+            default:               moved[i] = merger.instruction(in.op, moved[in.lhs], moved[in.rhs]);   break;
+            }
+        }
+
+        output.answer = moved.back();
+    }
+
+    return shared;
+}
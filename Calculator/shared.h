@@ -0,0 +1,76 @@
+#ifndef CALCULATOR_SHARED_H
+#define CALCULATOR_SHARED_H
+
+#include <span>
+#include <vector>
+
+#include "compiler.h"
+
+//Formulas often come in families which have large pieces in common:
+//     (x + y) * rate - fee
+//     (x + y) * rate * 12
+//     fee / ((y + x) * rate)
+//Compiling and evaluating them one by one calculates (x + y) * rate three times.  compileShared() puts
+//all of them into a single program instead, in which every distinct calculation appears only once no
+//matter how many formulas contain it, and evaluateShared() runs that program once for all the answers.
+//
+//Every formula is compiled and optimized on its own first, then its instructions are added to the shared
+//program one by one.  An instruction doing the same operation on the same operands as one already there,
+//or loading the same constant or variable, is not added again; the one already there is used instead.
+//Since operands are merged before the instructions reading them, whole sub-expressions are merged this
+//way, and + and * are merged whichever way round their operands are written.
+//Instructions inside a conditional are only merged with ones outside all conditionals, which always run.
+//The answers are bit for bit those evaluate() gives for each formula on its own, except that when both
+//operands of a + or * are NaN, which of the two NaNs comes out may differ.
+
+//NAME: SharedOutput
+//DESCRIPTION:  Where the answer to one of the formulas is: the register of the shared program holding
+//              it, or why there isn't one.
+struct SharedOutput
+{
+    int answer;
+    ErrorCode error;
+    int errorOffset;
+};
+
+//NAME: SharedProgram
+//DESCRIPTION:  Several formulas compiled into one program.  outputs[i] is the answer to formula i.
+//              A malformed formula only spoils its own output.
+struct SharedProgram
+{
+    Program program;
+    std::vector<SharedOutput> outputs;
+};
+
+//Function declarations
+SharedProgram compileShared(std::span<const char* const> formulas, VariableTable& variables);
+
+
+//NAME: evaluateShared
+//DESCRIPTION:  Runs a shared program once using arithmetic of type T, and picks every formula's answer out
+//              of its registers.
+//INPUT:
+//    shared    - The program from compileShared().
+//    variables - The value of every slot the formulas read, for instance VariableTable::values().
+//OUTPUT:
+//    answers   - The answer to formula i is written to answers[i], NaN if it is malformed.  Must have
+//                room for every formula.
+//RETURNS:
+//    none
+template <typename T = double>
+void evaluateShared(const SharedProgram& shared, const T* variables, T* answers)
+{
+    const Program& program = shared.program;
+    assert(variables != NULL || program.variableCount == 0);
+
+    RegisterFile<T> registers(program.code.size());
+    runInstructions(program.code.data(), (int)program.code.size(), program.constants.data(), variables, registers.r);
+
+    for (size_t i = 0; i < shared.outputs.size(); i++)
+    {
+        const SharedOutput& output = shared.outputs[i];
+        answers[i] = output.error == ErrorCode::None ? registers.r[output.answer] : std::numeric_limits<T>::quiet_NaN();
+    }
+}
+
+#endif
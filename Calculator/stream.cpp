@@ -0,0 +1,477 @@
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "stream.h"
+#include "parser.h"
+
+//NAME: OutputBuffer::OutputBuffer
+//DESCRIPTION:  Creates an empty buffer in front of a file.
+//INPUT:
+//    file     - Where the output goes.
+//    capacity - How much is collected before it is written.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+OutputBuffer::OutputBuffer(FILE* file, size_t capacity) :
+    file(file), buffer((char*)malloc(capacity)), capacity(capacity), used(0), error(buffer == NULL)
+{
+}
+
+//NAME: OutputBuffer::~OutputBuffer
+//DESCRIPTION:  Writes out whatever is left, if there is a file.
+OutputBuffer::~OutputBuffer()
+{
+    flush();
+    free(buffer);
+}
+
+//NAME: OutputBuffer::reserve
+//DESCRIPTION:  Makes room for more output, writing out what has been collected if necessary.
+//INPUT:
+//    count - How many bytes are needed.  Must not be more than the capacity.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Where the bytes go.
+char* OutputBuffer::reserve(size_t count)
+{
+    if (capacity - used >= count)
+        return buffer + used;
+
+    if (file != NULL)
+    {
+        flush();
+        return buffer + used;
+    }
+
+    //Without a file the buffer has to hold everything.
+    size_t grown = capacity * 2 > used + count ? capacity * 2 : used + count;
+    char* bigger = (char*)realloc(buffer, grown);
+    if (bigger == NULL)
+    {
+        error = true;
+        used = 0;
+        return buffer;
+    }
+
+    buffer = bigger;
+    capacity = grown;
+    return buffer + used;
+}
+
+//NAME: OutputBuffer::write
+//DESCRIPTION:  Adds text to the output.  Text larger than the buffer is written straight through.
+//INPUT:
+//    text  - The text.
+//    count - How many bytes it has.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void OutputBuffer::write(const char* text, size_t count)
+{
+    if (count > capacity && file != NULL)
+    {
+        flush();
+        if (fwrite(text, 1, count, file) != count)
+            error = true;
+        return;
+    }
+
+    memcpy(reserve(count), text, count);
+    used += count;
+}
+
+//NAME: OutputBuffer::flush
+//DESCRIPTION:  Writes out everything collected so far.  Does nothing without a file.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if anything couldn't be written.
+bool OutputBuffer::flush()
+{
+    if (file == NULL)
+        return !error;
+
+    if (used > 0 && fwrite(buffer, 1, used, file) != used)
+        error = true;
+
+    used = 0;
+    return !error;
+}
+
+//NAME: MappedFile::open
+//DESCRIPTION:  Maps a file into memory.
+//INPUT:
+//    path - The file to map.
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if the file couldn't be opened or mapped.
+bool MappedFile::open(const char* path)
+{
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    length = (size_t)fileSize.QuadPart;
+    if (length == 0)
+    {
+        CloseHandle(file);
+        return true;
+    }
+
+    //The mapping keeps the file open by itself.
+    handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if (handle == NULL)
+        return false;
+
+    view = (const char*)MapViewOfFile(handle, FILE_MAP_READ, 0, 0, 0);
+    if (view == NULL)
+    {
+        close();
+        return false;
+    }
+#else
+    int file = ::open(path, O_RDONLY);
+    if (file < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(file, &info) != 0)
+    {
+        ::close(file);
+        return false;
+    }
+
+    length = (size_t)info.st_size;
+    if (length == 0)
+    {
+        ::close(file);
+        return true;
+    }
+
+    void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);
+    if (mapped == MAP_FAILED)
+    {
+        length = 0;
+        return false;
+    }
+
+    madvise(mapped, length, MADV_SEQUENTIAL);
+    view = (const char*)mapped;
+#endif
+
+    return true;
+}
+
+//NAME: MappedFile::close
+//DESCRIPTION:  Unmaps the file, if one is mapped.
+void MappedFile::close()
+{
+#if defined(_WIN32)
+    if (view != NULL)
+        UnmapViewOfFile(view);
+    if (handle != NULL)
+        CloseHandle(handle);
+#else
+    if (view != NULL)
+        munmap((void*)view, length);
+#endif
+
+    view = NULL;
+    length = 0;
+    handle = NULL;
+}
+
+//NAME: solveLine
+//DESCRIPTION:  Solves the expression at the start of a line.  Like solve(), except the expression ends at
+//              the end of the line ("\n" or "\r\n") as well as at the end of the string.
+//INPUT:
+//    line   - The start of the line.
+//OUTPUT:
+//    result - The answer, or the error and its offset from the start of the line.
+//RETURNS:
+//    Where parsing stopped; the end of the line unless there was an error.
+const char* solveLine(const char* line, Result<double>& result)
+{
+    Evaluator<double> evaluator;
+    const char* eq = line;
+    int countParenthesis = 0;
+    result.value = tokenizeExpression(eq, countParenthesis, evaluator);
+
+    if (!evaluator.failed())
+    {
+        if (*eq == ')')
+            evaluator.fail(ErrorCode::UnmatchedParenthesis, eq);
+        else if (*eq == '\r' && eq[1] == '\n')
+            eq++;
+        else if (*eq != '\n' && *eq != '\0')
+            evaluator.fail(ErrorCode::UnexpectedCharacter, eq);
+    }
+
+    result.error = evaluator.error;
+    result.offset = evaluator.failed() ? (int)(evaluator.errorAt - line) : 0;
+    return eq;
+}
+
+//NAME: writeResult
+//DESCRIPTION:  Writes one answer, or the reason there isn't one, followed by a newline.
+//INPUT:
+//    result - What solveLine() found.
+//    format - How to write the answer.
+//OUTPUT:
+//    out    - Where the line goes.
+//RETURNS:
+//    none
+void writeResult(const Result<double>& result, OutputBuffer& out, const NumberFormat& format)
+{
+    if (result.ok())
+    {
+        char* text = out.reserve(kLongestNumber + 1);
+        size_t length = formatNumber(result.value, text, kLongestNumber, format);
+        text[length] = '\n';
+        out.commit(length + 1);
+        return;
+    }
+
+    const size_t kLongestError = 64;
+
+    char* text = out.reserve(kLongestError);
+    int length = snprintf(text, kLongestError, "error: %s at %d\n", errorMessage(result.error), result.offset);
+    out.commit((size_t)length);
+}
+
+//NAME: evaluateLines
+//DESCRIPTION:  Solves every line in a block of text and writes one line of output for each.
+//              An empty line gives an empty line.  The block does not have to end with a newline.
+//INPUT:
+//    begin  - The first character of the block.
+//    end    - One past the last character.
+//    format - How to write the answers.
+//OUTPUT:
+//    out    - Where the answers go.
+//RETURNS:
+//    How many lines there were.
+size_t evaluateLines(const char* begin, const char* end, OutputBuffer& out, const NumberFormat& format)
+{
+    size_t lines = 0;
+    const char* line = begin;
+    while (line < end)
+    {
+        const char* newline = (const char*)memchr(line, '\n', end - line);
+
+        //The parser needs to find the end of the line by itself, so a last line without a newline
+        //is the only one that has to be copied.
+        std::string last;
+        const char* text = line;
+        if (newline == NULL)
+        {
+            last.assign(line, end);
+            text = last.c_str();
+        }
+
+        if (*text == '\n' || (*text == '\r' && text[1] == '\n') || *text == '\0')
+            out.put('\n');
+        else
+        {
+            Result<double> result;
+            solveLine(text, result);
+            writeResult(result, out, format);
+        }
+
+        lines++;
+        line = newline != NULL ? newline + 1 : end;
+    }
+
+    return lines;
+}
+
+//NAME: streamFile
+//DESCRIPTION:  Solves every line of a file using every processor.
+//INPUT:
+//    path   - The file with one expression per line.
+//    output - Where the answers go.
+//    format - How to write the answers.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Zero on success, like main().
+int streamFile(const char* path, FILE* output, const NumberFormat& format)
+{
+    return streamFile(path, output, defaultThreadPool(), format);
+}
+
+//NAME: chunkEnd
+//DESCRIPTION:  Where the chunk starting at begin ends: just after the first newline at least
+//              kStreamChunkSize bytes in, or at the end of the file.
+static const char* chunkEnd(const char* begin, const char* end)
+{
+    if ((size_t)(end - begin) <= kStreamChunkSize)
+        return end;
+
+    const char* newline = (const char*)memchr(begin + kStreamChunkSize - 1, '\n', end - (begin + kStreamChunkSize - 1));
+    return newline != NULL ? newline + 1 : end;
+}
+
+//NAME: streamFile
+//DESCRIPTION:  Solves every line of a file on the threads of the given pool.
+//              The file is solved a round of chunks at a time; every chunk of a round is solved into
+//              its own buffer, then the buffers are written in order.
+//INPUT:
+//    path   - The file with one expression per line.
+//    output - Where the answers go.
+//    pool   - The threads to use.
+//    format - How to write the answers.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Zero on success, like main().
+int streamFile(const char* path, FILE* output, ThreadPool& pool, const NumberFormat& format)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        fprintf(stderr, "Calculator: can't read %s\n", path);
+        return 1;
+    }
+
+    const char* cursor = file.data();
+    const char* end = file.data() + file.size();
+
+    //Small files, and single processors, don't need any of the machinery.
+    if (pool.size() == 1 || file.size() <= kStreamChunkSize)
+    {
+        OutputBuffer out(output);
+        evaluateLines(cursor, end, out, format);
+        return out.flush() ? 0 : 1;
+    }
+
+    const size_t round = pool.size() * kStreamChunksPerThread;
+    std::vector<const char*> bounds(round + 1);
+    std::vector<std::unique_ptr<OutputBuffer> > chunks(round);
+    for (size_t i = 0; i < round; i++)
+        chunks[i].reset(new OutputBuffer());
+
+    bool failed = false;
+    while (cursor < end && !failed)
+    {
+        size_t count = 0;
+        bounds[0] = cursor;
+        while (count < round && bounds[count] < end)
+        {
+            bounds[count + 1] = chunkEnd(bounds[count], end);
+            count++;
+        }
+
+        pool.parallelFor(count, 1, [&](size_t first, size_t last)
+        {
+            for (size_t i = first; i < last; i++)
+            {
+                chunks[i]->clear();
+                evaluateLines(bounds[i], bounds[i + 1], *chunks[i], format);
+            }
+        });
+
+        for (size_t i = 0; i < count; i++)
+        {
+            if (chunks[i]->failed() || fwrite(chunks[i]->data(), 1, chunks[i]->size(), output) != chunks[i]->size())
+                failed = true;
+        }
+
+        cursor = bounds[count];
+    }
+
+    return failed || fflush(output) != 0 ? 1 : 0;
+}
+
+//NAME: streamInput
+//DESCRIPTION:  Solves every line read from a stream such as standard input, a block at a time.
+//              A line cut in two by the end of a block is moved to the front for the next one.
+//INPUT:
+//    input  - Where the expressions come from.
+//    output - Where the answers go.
+//    format - How to write the answers.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Zero on success, like main().
+int streamInput(FILE* input, FILE* output, const NumberFormat& format)
+{
+    OutputBuffer out(output);
+    std::string block(kStreamBufferSize, '\0');
+    size_t kept = 0;
+
+    while (true)
+    {
+        //A single line longer than the block makes it grow.
+        if (kept == block.size())
+            block.resize(block.size() * 2);
+
+        size_t read = fread(&block[kept], 1, block.size() - kept, input);
+        size_t filled = kept + read;
+        if (read == 0)
+        {
+            evaluateLines(block.data(), block.data() + filled, out, format);
+            break;
+        }
+
+        const char* data = block.data();
+        const char* lastNewline = NULL;
+        for (const char* p = data + filled; p > data; p--)
+        {
+            if (p[-1] == '\n')
+            {
+                lastNewline = p - 1;
+                break;
+            }
+        }
+
+        if (lastNewline == NULL)
+        {
+            kept = filled;
+            continue;
+        }
+
+        size_t complete = (size_t)(lastNewline + 1 - data);
+        evaluateLines(data, data + complete, out, format);
+
+        kept = filled - complete;
+        memmove(&block[0], data + complete, kept);
+    }
+
+    if (ferror(input))
+    {
+        fprintf(stderr, "Calculator: error reading input\n");
+        return 1;
+    }
+
+    return out.flush() ? 0 : 1;
+}
@@ -0,0 +1,118 @@
+#ifndef CALCULATOR_STREAM_H
+#define CALCULATOR_STREAM_H
+
+#include <cstddef>
+#include <cstdio>
+
+#include "errors.h"
+#include "format.h"
+#include "thread_pool.h"
+
+//Bulk evaluation of newline separated expressions, one answer per line:
+//     Calculator expressions.txt > answers.txt
+//     generate | Calculator - > answers.txt
+//A file is mapped into memory and parsed right where it lies; the parser stops at the end of every line
+//by itself, so no line is ever copied into a string of its own.  Standard input is read in large blocks
+//instead.  Answers are collected in a large buffer and written out a buffer at a time, so there is one
+//system call per megabyte or so rather than one per answer.
+//A line that isn't a valid expression gets "error: <message> at <offset>" instead of an answer.
+//Answers are written by formatNumber(), in the shortest form that reads back as the same number unless
+//another NumberFormat is given.
+//
+//A large file is cut into chunks of about kStreamChunkSize bytes, each ending at the end of a line.
+//The chunks are solved on every processor at once, each into a buffer of its own, and the buffers are
+//written out in the order of the chunks so the answers still line up with the input.  A few chunks per
+//thread are solved at a time, so memory use doesn't grow with the size of the file.
+
+//How many bytes are read from standard input and collected for the output at a time.
+static const size_t kStreamBufferSize = 1 << 20;
+
+//How many bytes of input each thread takes at a time.
+static const size_t kStreamChunkSize = 4 << 20;
+
+//How many chunks per thread are solved before their output is written.
+static const size_t kStreamChunksPerThread = 4;
+
+//NAME: OutputBuffer
+//DESCRIPTION:  Collects output in memory and writes it out in large blocks.
+//              Without a file it just keeps growing until everything has been collected, which is how
+//              the chunks of a file are kept apart until they can be written in order.
+class OutputBuffer
+{
+public:
+    explicit OutputBuffer(FILE* file = NULL, size_t capacity = kStreamBufferSize);
+
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer&) = delete;
+
+    OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+    //Room for at least count more bytes; fill it and then commit() what was used.
+    char* reserve(size_t count);
+
+    void commit(size_t count) { used += count; }
+
+    void write(const char* text, size_t count);
+
+    void put(char c) { *reserve(1) = c; used++; }
+
+    bool flush();
+
+    bool failed() const { return error; }
+
+    const char* data() const { return buffer; }
+
+    size_t size() const { return used; }
+
+    void clear() { used = 0; }
+
+private:
+    FILE* file;
+    char* buffer;
+    size_t capacity;
+    size_t used;
+    bool error;
+};
+
+//NAME: MappedFile
+//DESCRIPTION:  A whole file mapped read only into memory.
+class MappedFile
+{
+public:
+    MappedFile() : view(NULL), length(0), handle(NULL) {}
+
+    ~MappedFile() { close(); }
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const char* path);
+
+    void close();
+
+    const char* data() const { return view; }
+
+    size_t size() const { return length; }
+
+private:
+    const char* view;
+    size_t length;
+    void* handle;
+};
+
+//Function declarations
+const char* solveLine(const char* line, Result<double>& result);
+
+void writeResult(const Result<double>& result, OutputBuffer& out, const NumberFormat& format = NumberFormat());
+
+size_t evaluateLines(const char* begin, const char* end, OutputBuffer& out, const NumberFormat& format = NumberFormat());
+
+int streamFile(const char* path, FILE* output, const NumberFormat& format = NumberFormat());
+
+int streamFile(const char* path, FILE* output, ThreadPool& pool, const NumberFormat& format = NumberFormat());
+
+int streamInput(FILE* input, FILE* output, const NumberFormat& format = NumberFormat());
+
+#endif
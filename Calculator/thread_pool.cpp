@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cassert>
+
+#include "thread_pool.h"
+
+//NAME: pack
+//DESCRIPTION:  Packs the chunks [begin, end) of a share into one word.
+//INPUT:
+//    begin - The first chunk.
+//    end   - One past the last chunk.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The packed range.
+static uint64_t pack(uint32_t begin, uint32_t end)
+{
+    return ((uint64_t)begin << 32) | end;
+}
+
+//NAME: ThreadPool::ThreadPool
+//DESCRIPTION:  Starts the threads.  The thread calling parallelFor() always helps out, so one
+//              thread fewer than asked for is started.
+//INPUT:
+//    threads - How many threads should work on every loop.  Zero means one per processor.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+ThreadPool::ThreadPool(unsigned threads) :
+    body(NULL), count(0), grain(1), generation(0), busy(0), stopping(false)
+{
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency();
+    if (threads == 0)
+        threads = 1;
+
+    shares.reset(new Share[threads]);
+    for (unsigned i = 0; i < threads; i++)
+        shares[i].range.store(0, std::memory_order_relaxed);
+
+    for (unsigned i = 1; i < threads; i++)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+//NAME: ThreadPool::~ThreadPool
+//DESCRIPTION:  Stops and joins the threads.
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+//NAME: ThreadPool::parallelFor
+//DESCRIPTION:  Calls body over [0, count) in chunks of grain items, spread over all of the threads,
+//              and returns once every chunk is done.  Chunks may run in any order and at the same time,
+//              so body must be safe to call from several threads.  body must not call parallelFor itself.
+//INPUT:
+//    count - How many items there are.
+//    grain - How many items are handed out at a time.
+//    body  - Called with the range [begin, end) of items to work on.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void ThreadPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body)
+{
+    if (count == 0)
+        return;
+
+    grain = std::max<size_t>(grain, 1);
+
+    //Chunk numbers have to fit in half of a share.
+    const size_t maxChunks = 0xFFFFFFFFu;
+    if ((count + grain - 1) / grain > maxChunks)
+        grain = (count + maxChunks - 1) / maxChunks;
+
+    const size_t chunks = (count + grain - 1) / grain;
+    if (chunks == 1 || size() == 1)
+    {
+        body(0, count);
+        return;
+    }
+
+    //One loop at a time.  Anyone else calling in waits here.
+    std::lock_guard<std::mutex> submit(submitMutex);
+
+    //Deal the chunks out evenly, the first few threads get one extra if they don't divide up.
+    const unsigned threads = size();
+    size_t begin = 0;
+    for (unsigned i = 0; i < threads; i++)
+    {
+        size_t end = begin + chunks / threads + (i < chunks % threads ? 1 : 0);
+        shares[i].range.store(pack((uint32_t)begin, (uint32_t)end), std::memory_order_relaxed);
+        begin = end;
+    }
+
+    this->body = &body;
+    this->count = count;
+    this->grain = grain;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        busy = (unsigned)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    run(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busy == 0; });
+    this->body = NULL;
+}
+
+//NAME: ThreadPool::workerLoop
+//DESCRIPTION:  What every started thread does: sleep until parallelFor() hands out a new loop,
+//              help with it, and report back.
+//INPUT:
+//    index - The share belonging to this thread.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void ThreadPool::workerLoop(unsigned index)
+{
+    uint64_t seen = 0;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping)
+            return;
+
+        seen = generation;
+        lock.unlock();
+
+        run(index);
+
+        lock.lock();
+        if (--busy == 0)
+            done.notify_all();
+    }
+}
+
+//NAME: ThreadPool::run
+//DESCRIPTION:  Works through this thread's share, then keeps stealing until there is nothing left anywhere.
+//INPUT:
+//    index - The share belonging to this thread.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+void ThreadPool::run(unsigned index)
+{
+    uint64_t chunk;
+
+    do
+    {
+        while (take(index, chunk))
+        {
+            size_t begin = (size_t)chunk * grain;
+            size_t end = std::min(begin + grain, count);
+            (*body)(begin, end);
+        }
+    } while (steal(index));
+}
+
+//NAME: ThreadPool::take
+//DESCRIPTION:  Takes the next chunk from the front of a thread's own share.
+//INPUT:
+//    index - The share belonging to this thread.
+//OUTPUT:
+//    chunk - The chunk taken.
+//RETURNS:
+//    False if the share is empty.
+bool ThreadPool::take(unsigned index, uint64_t& chunk)
+{
+    std::atomic<uint64_t>& range = shares[index].range;
+
+    uint64_t current = range.load(std::memory_order_acquire);
+    while (true)
+    {
+        uint32_t begin = (uint32_t)(current >> 32);
+        uint32_t end = (uint32_t)current;
+        if (begin >= end)
+            return false;
+
+        //This only fails when a thief got in first, in which case we try again with what it left us.
+        if (range.compare_exchange_weak(current, pack(begin + 1, end), std::memory_order_acq_rel))
+        {
+            chunk = begin;
+            return true;
+        }
+    }
+}
+
+//NAME: ThreadPool::steal
+//DESCRIPTION:  Moves the back half of another thread's share into this thread's (empty) share.
+//              Only the owner of a share ever fills it again once it's empty, so nobody else
+//              can be writing to our share while we do.
+//INPUT:
+//    index - The share belonging to this thread.
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if every other share is empty.
+bool ThreadPool::steal(unsigned index)
+{
+    const unsigned threads = size();
+    for (unsigned k = 1; k < threads; k++)
+    {
+        std::atomic<uint64_t>& victim = shares[(index + k) % threads].range;
+
+        uint64_t current = victim.load(std::memory_order_acquire);
+        while (true)
+        {
+            uint32_t begin = (uint32_t)(current >> 32);
+            uint32_t end = (uint32_t)current;
+            if (begin >= end)
+                break;
+
+            uint32_t split = end - (end - begin + 1) / 2;
+            if (victim.compare_exchange_weak(current, pack(begin, split), std::memory_order_acq_rel))
+            {
+                shares[index].range.store(pack(split, end), std::memory_order_release);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+//NAME: defaultThreadPool
+//DESCRIPTION:  A pool with one thread per processor, started the first time it is needed.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The shared pool.
+ThreadPool& defaultThreadPool()
+{
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,73 @@
+#ifndef CALCULATOR_THREAD_POOL_H
+#define CALCULATOR_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//A fixed set of threads which split up loops over independent items.
+//The items are cut into chunks and every thread starts with an equal share of them.  A thread works
+//through its own share from the front; when it runs out it steals half of what is left of another
+//thread's share from the back.  Cheap items and expensive items therefore even out by themselves.
+//Every share is a single 64 bit word (first chunk, end chunk) which only its owner and the occasional
+//thief ever touch, so there is no lock or shared counter on the path that hands out work.
+
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = 0);
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return (unsigned)workers.size() + 1; }
+
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+
+private:
+    //NAME: Share
+    //DESCRIPTION:  The chunks still waiting in one thread's share, packed as (begin << 32) | end.
+    //              Each share has a cache line to itself so threads don't slow each other down.
+    struct alignas(64) Share
+    {
+        std::atomic<uint64_t> range;
+    };
+
+    void workerLoop(unsigned index);
+
+    void run(unsigned index);
+
+    bool take(unsigned index, uint64_t& chunk);
+
+    bool steal(unsigned index);
+
+    std::vector<std::thread> workers;
+    std::unique_ptr<Share[]> shares;
+
+    //The loop currently running.  Only changed while no worker is inside run().
+    const std::function<void(size_t, size_t)>* body;
+    size_t count;
+    size_t grain;
+
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+    uint64_t generation;
+    unsigned busy;
+    bool stopping;
+};
+
+//Function declarations
+ThreadPool& defaultThreadPool();
+
+#endif
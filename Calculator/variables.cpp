@@ -0,0 +1,58 @@
+#include <cstring>
+
+#include "variables.h"
+
+//NAME: VariableTable::define
+//DESCRIPTION:  Adds a variable to the table.  Defining a name twice just updates its value.
+//INPUT:
+//    name  - The name of the variable.
+//    value - Its initial value.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The slot of the variable.
+int VariableTable::define(const char* name, double value)
+{
+    int slot = find(name);
+    if (slot < 0)
+    {
+        names.push_back(name);
+        slots.push_back(value);
+        return (int)slots.size() - 1;
+    }
+
+    slots[slot] = value;
+    return slot;
+}
+
+//NAME: VariableTable::find
+//DESCRIPTION:  Looks up a variable by its name.
+//INPUT:
+//    name - The null terminated name of the variable.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The slot of the variable or -1 if it hasn't been defined.
+int VariableTable::find(const char* name) const
+{
+    return find(name, strlen(name));
+}
+
+//NAME: VariableTable::find
+//DESCRIPTION:  Looks up a variable by its name.  The name does not have to be null terminated,
+//              which lets the parser pass a pointer straight into the expression.
+//INPUT:
+//    name   - The name of the variable.
+//    length - How many characters the name has.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The slot of the variable or -1 if it hasn't been defined.
+int VariableTable::find(const char* name, size_t length) const
+{
+    for (size_t i = 0; i < names.size(); i++)
+        if (names[i].size() == length && memcmp(names[i].data(), name, length) == 0)
+            return (int)i;
+
+    return -1;
+}
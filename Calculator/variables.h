@@ -0,0 +1,38 @@
+#ifndef CALCULATOR_VARIABLES_H
+#define CALCULATOR_VARIABLES_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+//NAME: VariableTable
+//DESCRIPTION:  The named values an expression may refer to, such as x, rate or qty.
+//              Every name is given a slot number when it is defined.  The interpreter has to look names
+//              up as it comes across them, but compile() resolves every name to its slot once, so a
+//              compiled program reads the value straight out of values()[slot] when it is evaluated.
+//              Values can then be rebound with set() as often as needed without compiling again.
+class VariableTable
+{
+public:
+    int define(const char* name, double value = 0);
+
+    int find(const char* name) const;
+
+    int find(const char* name, size_t length) const;
+
+    void set(int slot, double value) { slots[slot] = value; }
+
+    double get(int slot) const { return slots[slot]; }
+
+    const char* name(int slot) const { return names[slot].c_str(); }
+
+    int size() const { return (int)slots.size(); }
+
+    const double* values() const { return slots.data(); }
+
+private:
+    std::vector<std::string> names;
+    std::vector<double> slots;
+};
+
+#endif
@@ -0,0 +1,1885 @@
+#include <cfloat>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+#include "../Calculator/parser.h"
+#include "../Calculator/iterative.h"
+#include "../Calculator/compiler.h"
+#include "../Calculator/ast.h"
+#include "../Calculator/optimizer.h"
+#include "../Calculator/shared.h"
+#include "../Calculator/archive.h"
+#include "../Calculator/jit.h"
+#include "../Calculator/incremental.h"
+#include "../Calculator/batch.h"
+#include "../Calculator/kernels.h"
+#include "../Calculator/decimal.h"
+#include "../Calculator/gradient.h"
+#include "../Calculator/interval.h"
+#include "../Calculator/cache.h"
+#include "../Calculator/fixed.h"
+#include "../Calculator/stream.h"
+
+#include "generator.h"
+#include "differential.h"
+
+//The relative error of a rounding to double.
+static const double kUnit = DBL_EPSILON / 2;
+
+//The absolute error a rounding can have near zero, where doubles are denormal or flushed to zero.
+static const double kTiny = DBL_MIN;
+
+//Beyond this a double may have overflowed on the way, so the reference can't say what solve() gets.
+static const double kHuge = 1e300;
+
+//How many divergences a report keeps; past that it only counts them.
+static const size_t kMaxDivergences = 1000;
+
+//The rows of variables every expression is solved over, in the slots of kFuzzVariableNames.
+//They are exact in double, so the reference starts from the values solve() sees.
+static const int kRows = 3;
+
+static const double kRowValues[kRows][kFuzzVariableCount] = {
+    { 1.5, -0.75, 0.0625, 12 },
+    { 2.25, 0.5, -3, 0.125 },
+    { -2.5, 0, 3, -0.375 },
+};
+
+//Below this a derivative, or an adjoint, is near enough to the denormals to have lost some of its digits.
+static const double kSmallSize = DBL_MIN * 0x1p53;
+
+//How many rows the batch evaluator is checked over: the fixed ones, then ramps.
+static const size_t kBatchRows = 150;
+
+//NAME: same
+//DESCRIPTION:  The same answer, bit for bit except that any NaN is the same as any other.
+static bool same(double a, double b)
+{
+    return (std::isnan(a) && std::isnan(b)) || a == b;
+}
+
+//NAME: same
+//DESCRIPTION:  The same fixed point answer, bit for bit.
+static bool same(Fixed64 a, Fixed64 b)
+{
+    return a == b;
+}
+
+//NAME: near
+//DESCRIPTION:  The same answer to within 1e-9, relative to the larger of 1 and b.
+static bool near(double a, double b)
+{
+    return same(a, b) || std::fabs(a - b) <= 1e-9 * std::fmax(1.0, std::fabs(b));
+}
+
+//NAME: diverge
+//DESCRIPTION:  Records a divergence.
+//INPUT:
+//    engine - The engine which doesn't agree.
+//    eq     - The expression.
+//    format - printf style description of what it got and what it should have got.
+//OUTPUT:
+//    none
+//INPUT/OUTPUT:
+//    report - Where the divergence is recorded.
+//RETURNS:
+//    none
+static void diverge(DifferentialReport& report, const char* engine, const char* eq, const char* format, ...)
+{
+    if (report.divergences.size() >= kMaxDivergences)
+        return;
+
+    char detail[256];
+    va_list arguments;
+    va_start(arguments, format);
+    vsnprintf(detail, sizeof(detail), format, arguments);
+    va_end(arguments);
+
+    Divergence divergence;
+    divergence.engine = engine;
+    divergence.expression = eq;
+    divergence.detail = detail;
+    report.divergences.push_back(divergence);
+}
+
+//NAME: ActionLog
+//DESCRIPTION:  Actions which write down every call the parser makes, to compare the two parsers.
+//              A value is the number of the call which made it.
+struct ActionLog : ErrorState
+{
+    typedef int Value;
+    typedef double Number;
+
+    ActionLog() : calls(0) {}
+
+    Value record(const char* format, ...)
+    {
+        char entry[96];
+        va_list arguments;
+        va_start(arguments, format);
+        vsnprintf(entry, sizeof(entry), format, arguments);
+        va_end(arguments);
+
+        log += entry;
+        log += ';';
+        return ++calls;
+    }
+
+    Value number(double value) { return record("N%.17g", value); }
+
+    Value variable(const char* name, size_t length) { return record("V%.*s", (int)length, name); }
+
+    Value negate(Value value) { return record("neg %d", value); }
+
+    Value add(Value first, Value second) { return record("add %d %d", first, second); }
+
+    Value subtract(Value first, Value second) { return record("sub %d %d", first, second); }
+
+    Value multiply(Value first, Value second) { return record("mul %d %d", first, second); }
+
+    Value divide(Value first, Value second, const char* at) { return record("div %d %d @%p", first, second, (const void*)at); }
+
+    Value call(Function function, Value argument, const char* at) { return record("call %d %d @%p", (int)function, argument, (const void*)at); }
+
+    Value call(Function function, Value first, Value second, const char* at)
+    {
+        return record("call %d %d %d @%p", (int)function, first, second, (const void*)at);
+    }
+
+    void beginThen(Value condition) { record("then %d", condition); }
+
+    void beginElse(Value condition, Value then) { record("else %d %d", condition, then); }
+
+    Value endConditional(Value condition, Value then, Value otherwise) { return record("end %d %d %d", condition, then, otherwise); }
+
+    std::string log;
+    int calls;
+};
+
+//NAME: exactValue
+//DESCRIPTION:  The exact value of a double as a decimal, when it fits in 34 digits.  Integers up to 2^112
+//              and numbers with few binary digits after the point do; 0.1 as a double doesn't.
+//INPUT:
+//    value - The double.
+//OUTPUT:
+//    exact - Its value.
+//RETURNS:
+//    True if it fits.
+static bool exactValue(double value, Decimal128& exact)
+{
+    if (!std::isfinite(value))
+        return false;
+    if (value == 0)
+    {
+        exact = Decimal128();
+        return true;
+    }
+
+    int power = 0;
+    uint64_t mantissa = (uint64_t)std::ldexp(std::frexp(std::fabs(value), &power), 53);
+    power -= 53;
+    while ((mantissa & 1) == 0)
+    {
+        mantissa >>= 1;
+        power++;
+    }
+
+    //mantissa * 2^power, as mantissa * 2^power or mantissa * 5^-power * 10^power.
+    double digits = std::log10((double)mantissa) + (power >= 0 ? power * 0.30103 : -power * 0.69898);
+    if (digits > 33.5)
+        return false;
+
+    exact = Decimal128::fromDecimal(mantissa, 0);
+    const Decimal128 factor(power >= 0 ? 2 : 5);
+    for (int i = 0; i < std::abs(power); i++)
+        exact = exact * factor;
+
+    if (power < 0)
+        exact = exact * Decimal128::fromDecimal(1, power);
+    if (value < 0)
+        exact = -exact;
+
+    return true;
+}
+
+//NAME: Reference
+//DESCRIPTION:  Actions which solve an expression with Decimal128, keeping with every value a bound on how
+//              far the double solve() calculates for it can be.  The conditionals are followed the way
+//              Evaluator follows them.  Whenever double could go another way from Decimal128 the
+//              expression is marked unstable and the answer says nothing about solve().
+struct Reference : ErrorState
+{
+    struct Value
+    {
+        Decimal128 exact;
+        double bound;
+    };
+
+    typedef Decimal128 Number;
+
+    explicit Reference(const VariableTable* variables) : variables(variables), skipping(0), unstable(false) {}
+
+    static double magnitude(const Value& value) { return std::fabs(value.exact.toDouble()); }
+
+    //a * b without the NaN of infinity times 0; past kHuge the expression is unstable anyway.
+    static double product(double a, double b) { return a == 0 || b == 0 ? 0 : a * b; }
+
+    //Where solve() rounds the exact answer of an operation on its doubles, which are already within
+    //propagated of the reference.  An answer which is exact all along needs nothing more.
+    Value rounded(const Decimal128& exact, double propagated)
+    {
+        Value value = { exact, 0 };
+        double size = std::fabs(exact.toDouble());
+        if (!(size <= kHuge))
+            unstable = true;
+
+        Decimal128 nearest;
+        if (propagated == 0 && exactValue(exact.toDouble(), nearest) && nearest == exact)
+            return value;
+
+        value.bound = propagated * (1 + kUnit) + kUnit * size + 1e-33 * size + kTiny;
+        return value;
+    }
+
+    //Marks the expression unstable when a value is too close to zero for double to agree on which side it is.
+    void checkSide(const Value& value)
+    {
+        if (value.bound > 0 && magnitude(value) <= value.bound)
+            unstable = true;
+    }
+
+    Value zero() const
+    {
+        Value value = { Decimal128(), 0 };
+        return value;
+    }
+
+    Value number(const Decimal128& literal)
+    {
+        if (skipping > 0)
+            return zero();
+
+        return rounded(literal, 0);
+    }
+
+    Value variable(const char* name, size_t length)
+    {
+        if (skipping > 0)
+            return zero();
+
+        int slot = (variables != NULL) ? variables->find(name, length) : -1;
+        if (slot < 0)
+        {
+            fail(ErrorCode::UnknownVariable, name);
+            return zero();
+        }
+
+        double given = variables->get(slot);
+        Value value = { Decimal128(), 0 };
+        if (!exactValue(given, value.exact))
+            return rounded(Decimal128(given), 0);
+
+        return value;
+    }
+
+    Value negate(const Value& value)
+    {
+        Value negated = { -value.exact, value.bound };
+        return negated;
+    }
+
+    Value add(const Value& first, const Value& second)
+    {
+        if (skipping > 0)
+            return zero();
+
+        return rounded(first.exact + second.exact, first.bound + second.bound);
+    }
+
+    Value subtract(const Value& first, const Value& second)
+    {
+        if (skipping > 0)
+            return zero();
+
+        return rounded(first.exact - second.exact, first.bound + second.bound);
+    }
+
+    Value multiply(const Value& first, const Value& second)
+    {
+        if (skipping > 0)
+            return zero();
+
+        double a = magnitude(first);
+        double b = magnitude(second);
+        return rounded(first.exact * second.exact, product(a, second.bound) + product(b, first.bound) + product(first.bound, second.bound));
+    }
+
+    Value divide(const Value& first, const Value& second, const char* at)
+    {
+        if (skipping > 0)
+            return zero();
+
+        checkSide(second);
+        if (second.exact.isZero())
+        {
+            if (second.bound == 0)
+                fail(ErrorCode::DivisionByZero, at);
+            return zero();
+        }
+        if (unstable)
+            return zero();
+
+        Decimal128 quotient = first.exact / second.exact;
+        double b = magnitude(second);
+        double propagated = (first.bound + product(std::fabs(quotient.toDouble()), second.bound)) / (b - second.bound);
+        return rounded(quotient, first.bound == 0 && second.bound == 0 ? 0 : propagated);
+    }
+
+    Value call(Function function, const Value& argument, const char* at) { return call(function, argument, argument, at); }
+
+    Value call(Function function, const Value& first, const Value& second, const char* at)
+    {
+        if (skipping > 0)
+            return zero();
+
+        switch (function)
+        {
+        case Function::Min:
+        case Function::Max:
+            {
+                //min() and max() never move further than the farther of their arguments.
+                bool takeFirst = function == Function::Min ? first.exact < second.exact : first.exact > second.exact;
+                Value picked = { takeFirst ? first.exact : second.exact, std::fmax(first.bound, second.bound) };
+                return picked;
+            }
+
+        case Function::Abs:
+            {
+                Value absolute = { fabs(first.exact), first.bound };
+                return absolute;
+            }
+
+        case Function::Sqrt: return squareRoot(first, at);
+        case Function::Exp:  return exponential(first);
+        case Function::Log:  return logarithm(first, at);
+        case Function::Power: return power(first, second, at);
+        default:             return compare(function, first, second);
+        }
+    }
+
+    Value compare(Function function, const Value& first, const Value& second)
+    {
+        double gap = std::fabs((first.exact - second.exact).toDouble());
+        double bound = first.bound + second.bound;
+        if (bound > 0 && gap <= bound)
+            unstable = true;
+
+        bool holds = false;
+        switch (function)
+        {
+        case Function::Less:         holds = first.exact < second.exact; break;
+        case Function::LessEqual:    holds = first.exact <= second.exact; break;
+        case Function::Greater:      holds = first.exact > second.exact; break;
+        case Function::GreaterEqual: holds = first.exact >= second.exact; break;
+        case Function::Equal:        holds = first.exact == second.exact; break;
+        default:                     holds = first.exact != second.exact; break;
+        }
+
+        Value answer = { Decimal128(holds ? 1 : 0), 0 };
+        return answer;
+    }
+
+    Value squareRoot(const Value& argument, const char* at)
+    {
+        checkSide(argument);
+        if (argument.exact < Decimal128())
+        {
+            fail(ErrorCode::OutOfDomain, at);
+            return zero();
+        }
+        if (unstable)
+            return zero();
+
+        Decimal128 root = sqrt(argument.exact);
+        double a = magnitude(argument);
+        double propagated = 0;
+        if (argument.bound > 0)
+        {
+            propagated = std::sqrt(argument.bound);
+            if (a > 0)
+                propagated = std::fmin(propagated, argument.bound / std::sqrt(a));
+            propagated += 1e-33 * std::fabs(root.toDouble());
+        }
+
+        return rounded(root, propagated);
+    }
+
+    //exp(), log() and powers which aren't whole go through double in Decimal128, and std::exp() and the
+    //others are only good to about an ULP, so these carry the error of converting to double twice and
+    //of both calculations besides the error of the argument.
+    Value exponential(const Value& argument)
+    {
+        Decimal128 result = exp(argument.exact);
+        if (argument.bound == 0)
+            return rounded(result, 0);
+
+        double size = std::fabs(result.toDouble());
+        double error = argument.bound + kUnit * magnitude(argument);
+        return rounded(result, product(size, std::expm1(error)) + 4 * kUnit * size);
+    }
+
+    Value logarithm(const Value& argument, const char* at)
+    {
+        checkSide(argument);
+        if (argument.exact <= Decimal128())
+        {
+            fail(ErrorCode::OutOfDomain, at);
+            return zero();
+        }
+        if (unstable)
+            return zero();
+
+        Decimal128 result = log(argument.exact);
+        if (argument.bound == 0)
+            return rounded(result, 0);
+
+        double a = magnitude(argument);
+        double relative = (argument.bound + kUnit * a) / a;
+        if (relative >= 0.5)
+        {
+            unstable = true;
+            return zero();
+        }
+
+        double size = std::fabs(result.toDouble());
+        return rounded(result, -std::log1p(-relative) + 4 * kUnit * size + kTiny);
+    }
+
+    Value power(const Value& base, const Value& exponent, const char* at)
+    {
+        checkSide(base);
+        if (unstable)
+            return zero();
+
+        bool exact = base.bound == 0 && exponent.bound == 0;
+        if (base.exact.isZero())
+        {
+            //0 ^ y only depends on the sign of y.
+            checkSide(exponent);
+            if (exponent.exact < Decimal128())
+            {
+                fail(ErrorCode::DivisionByZero, at);
+                return zero();
+            }
+
+            Value answer = { Decimal128(exponent.exact.isZero() ? 1 : 0), 0 };
+            return answer;
+        }
+
+        if (base.exact < Decimal128())
+        {
+            //A negative number only has whole powers, and whether it is whole has to be the same in double.
+            if (exponent.bound > 0)
+            {
+                unstable = true;
+                return zero();
+            }
+            if (floor(exponent.exact) != exponent.exact)
+            {
+                fail(ErrorCode::OutOfDomain, at);
+                return zero();
+            }
+        }
+
+        Decimal128 result = pow(base.exact, exponent.exact);
+        if (exact)
+            return rounded(result, 0);
+
+        //x^y = exp(y log x): how far y log x can move, carried through exp().
+        double a = magnitude(base);
+        double b = magnitude(exponent);
+        double baseError = base.bound + kUnit * a;
+        double exponentError = exponent.bound + kUnit * b;
+        double relative = baseError / a;
+        if (relative >= 0.5)
+        {
+            unstable = true;
+            return zero();
+        }
+
+        double logarithmError = -std::log1p(-relative);
+        double spread = product(exponentError, std::fabs(std::log(a))) + product(b + exponentError, logarithmError);
+        double size = std::fabs(result.toDouble());
+        return rounded(result, product(size, std::expm1(spread)) + 4 * kUnit * size);
+    }
+
+    void beginThen(const Value& condition)
+    {
+        if (skipping > 0)
+        {
+            skipping++;
+            return;
+        }
+
+        checkSide(condition);
+        if (condition.exact.isZero())
+            skipping = 1;
+    }
+
+    void beginElse(const Value&, const Value&)
+    {
+        if (skipping == 1)
+            skipping = 0;
+        else if (skipping == 0)
+            skipping = 1;
+    }
+
+    Value endConditional(const Value&, const Value& then, const Value& otherwise)
+    {
+        if (skipping > 1)
+        {
+            skipping--;
+            return zero();
+        }
+
+        if (skipping == 1)
+        {
+            skipping = 0;
+            return then;
+        }
+
+        return otherwise;
+    }
+
+    const VariableTable* variables;
+    int skipping;
+    bool unstable;
+};
+
+//NAME: checkReference
+//DESCRIPTION:  Checks the answer of an engine against the reference.
+//INPUT:
+//    engine    - The engine.
+//    eq        - The expression.
+//    reference - The reference's answer, and the error it found.
+//    answer    - The engine's answer.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkReference(const char* engine, const char* eq, const Reference::Value& reference, double answer, DifferentialReport& report)
+{
+    double expected = reference.exact.toDouble();
+    double slack = reference.bound > 0 ? kUnit * std::fabs(expected) : 0;
+    if (answer == expected || std::fabs(answer - expected) <= 2 * reference.bound + slack)
+        return;
+
+    char digits[kLongestDecimal];
+    size_t length = formatDecimal(reference.exact, digits, sizeof(digits));
+    diverge(report, engine, eq, "%.17g, the reference is %.*s within %.3g", answer, (int)length, digits, reference.bound);
+}
+
+//NAME: checkParsers
+//DESCRIPTION:  Checks that the iterative parser makes exactly the calls the recursive one makes.
+//INPUT:
+//    eq - The expression.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    False if they don't agree, and nothing else is worth comparing.
+static bool checkParsers(const char* eq, DifferentialReport& report)
+{
+    ActionLog recursive;
+    parseExpression(eq, recursive);
+
+    ActionLog iterative;
+    parseExpressionIterative(eq, iterative);
+
+    if (recursive.error != iterative.error || recursive.errorAt != iterative.errorAt)
+    {
+        diverge(report, "iterative parser", eq, "error %d at %d, the recursive parser %d at %d",
+                (int)iterative.error, iterative.failed() ? (int)(iterative.errorAt - eq) : -1,
+                (int)recursive.error, recursive.failed() ? (int)(recursive.errorAt - eq) : -1);
+        return false;
+    }
+
+    if (recursive.log != iterative.log)
+    {
+        size_t at = 0;
+        while (at < recursive.log.size() && at < iterative.log.size() && recursive.log[at] == iterative.log[at])
+            at++;
+
+        diverge(report, "iterative parser", eq, "calls differ after %.60s", recursive.log.substr(0, at).c_str() + (at > 60 ? at - 60 : 0));
+        return false;
+    }
+
+    return true;
+}
+
+//NAME: isContinuous
+//DESCRIPTION:  Checks to see if a program has no comparison or conditional, whose answer can jump from one
+//              value to another when an operand changes by its last bit.  The relaxed optimizer is allowed
+//              to change the last bit, so only the answers of continuous programs have to stay near.
+static bool isContinuous(const Program& program)
+{
+    for (const Instruction& instruction : program.code)
+    {
+        if (instruction.op >= OpCode::Less)
+            return false;
+    }
+
+    return true;
+}
+
+//NAME: isRuntimeError
+//DESCRIPTION:  An error solve() finds calculating, which a compiled program doesn't look for.
+static bool isRuntimeError(ErrorCode error)
+{
+    return error == ErrorCode::OutOfDomain || error == ErrorCode::DivisionByZero || error == ErrorCode::UnknownVariable;
+}
+
+//NAME: isUndefined
+//DESCRIPTION:  An error in an expression which is well formed, but has no answer for these values.
+static bool isUndefined(ErrorCode error)
+{
+    return error == ErrorCode::OutOfDomain || error == ErrorCode::DivisionByZero;
+}
+
+//NAME: checkType
+//DESCRIPTION:  Checks solve() in another type: an expression which is malformed in double has to be
+//              malformed in the same way, and solveIterative() has to give bit for bit the same answer.
+//              Where to divide by zero or what is out of a function's domain depends on the type, and
+//              finding one stops the parser before any mistake after it.  The answer itself isn't
+//              compared with double's, a float rounds differently and a Fixed64 wraps around.
+//INPUT:
+//    eq     - The expression.
+//    table  - The variables of the row.
+//    solved - What solve() gave in double.
+//    row    - Which row it is.
+//    type   - The name of T.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+template <typename T>
+static void checkType(const char* eq, const VariableTable& table, const Result<double>& solved, int row, const char* type, DifferentialReport& report)
+{
+    char engine[64];
+    Result<T> typed = solve<T>(eq, table);
+    if (!isRuntimeError(typed.error) && !isRuntimeError(solved.error) && (typed.error != solved.error || typed.offset != solved.offset))
+    {
+        snprintf(engine, sizeof(engine), "solve<%s>", type);
+        diverge(report, engine, eq, "row %d: error %d at %d, solve() %d at %d", row, (int)typed.error, typed.offset,
+                (int)solved.error, solved.offset);
+    }
+
+    Result<T> iterative = solveIterative<T>(eq, &table);
+    if (iterative.error != typed.error || iterative.offset != typed.offset || (typed.ok() && !same(iterative.value, typed.value)))
+    {
+        snprintf(engine, sizeof(engine), "solveIterative<%s>", type);
+        diverge(report, engine, eq, "row %d: %.17g error %d at %d, solve() %.17g error %d at %d", row, (double)iterative.value,
+                (int)iterative.error, iterative.offset, (double)typed.value, (int)typed.error, typed.offset);
+    }
+}
+
+//NAME: checkCached
+//DESCRIPTION:  Checks that a cache which has already solved one expression gives exactly what solve()
+//              does for another, so spacing the cache takes to mean nothing really doesn't.
+//INPUT:
+//    first - Solved through the cache first.
+//    eq    - Then this.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkCached(const char* first, const char* eq, DifferentialReport& report)
+{
+    SolveCache cache(16);
+    cache.solve(first);
+
+    Result<double> cached = cache.solve(eq);
+    Result<double> solved = solve(eq);
+    if (cached.error != solved.error || (solved.ok() && !same(cached.value, solved.value)))
+    {
+        diverge(report, "SolveCache", eq, "after \"%s\": %.17g error %d, solve() %.17g error %d", first,
+                cached.value, (int)cached.error, solved.value, (int)solved.error);
+    }
+}
+
+//NAME: checkCache
+//DESCRIPTION:  Checks a SolveCache with the expression after the same expression without any spaces, and
+//              then with a space after every operator and parenthesis.  The spaces don't always mean
+//              nothing, "- 1" is malformed and "1 < = 2" too, and the cache has to tell them apart.
+//              The cache has no variables, so an expression which uses them is only checked for failing.
+//INPUT:
+//    eq - The expression.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkCache(const char* eq, DifferentialReport& report)
+{
+    std::string unspaced;
+    for (const char* at = eq; *at != '\0'; at++)
+    {
+        if (!isSpace(*at))
+            unspaced += *at;
+    }
+
+    std::string spaced;
+    for (char c : unspaced)
+    {
+        spaced += c;
+        if (c != '.' && !isIdentifierChar(c))
+            spaced += ' ';
+    }
+
+    checkCached(unspaced.c_str(), eq, report);
+    checkCached(unspaced.c_str(), spaced.c_str(), report);
+}
+
+//NAME: appendResult
+//DESCRIPTION:  Appends the line writeResult() writes for the answer of solve() to an expression.
+static void appendResult(const std::string& eq, std::string& out)
+{
+    OutputBuffer line;
+    writeResult(solve(eq.c_str()), line);
+    out.append(line.data(), line.size());
+}
+
+//NAME: checkLines
+//DESCRIPTION:  Checks that solveLine() stops at the end of a line and answers just what solve() does, and
+//              that evaluateLines() writes the same for every kind of line: one ending in "\n", one in
+//              "\r\n" whose '\r' is a space to solve(), an empty one and a last one without a newline.
+//              The stream has no variables, so an expression which uses them is only checked for failing.
+//INPUT:
+//    eq - The expression.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkLines(const char* eq, DifferentialReport& report)
+{
+    //An empty expression is an empty line, which gets an empty line rather than an error.
+    if (*eq == '\0')
+        return;
+
+    std::string text = eq;
+    std::string line = text + "\n";
+    Result<double> result;
+    const char* stopped = solveLine(line.c_str(), result);
+    Result<double> solved = solve(eq);
+    if (result.error != solved.error || result.offset != solved.offset || (solved.ok() && !same(result.value, solved.value)))
+    {
+        diverge(report, "solveLine", eq, "%.17g error %d at %d, solve() %.17g error %d at %d", result.value,
+                (int)result.error, result.offset, solved.value, (int)solved.error, solved.offset);
+    }
+    else if (result.ok() && stopped != line.c_str() + text.size())
+    {
+        diverge(report, "solveLine", eq, "stopped at %d, the end of the line is %zu", (int)(stopped - line.c_str()), text.size());
+    }
+
+    std::string block = text + "\n" + text + "\r\n\n" + text;
+    OutputBuffer out;
+    size_t lines = evaluateLines(block.data(), block.data() + block.size(), out);
+
+    std::string expected;
+    appendResult(text, expected);
+    appendResult(text + "\r", expected);
+    expected += '\n';
+    appendResult(text, expected);
+    if (lines != 4 || std::string(out.data(), out.size()) != expected)
+    {
+        diverge(report, "evaluateLines", eq, "%zu lines \"%.*s\", solve() \"%s\"", lines, (int)out.size(), out.data(),
+                expected.c_str());
+    }
+}
+
+//NAME: KernelLane
+//DESCRIPTION:  One lane of the batch evaluator on its own: a T whose every operation is the batch kernel
+//              for it, run over a single lane.  evaluate() of a program in KernelLane gives bit for bit
+//              what evaluateBatch() gives for that row, so the evaluator is checked exactly, and the
+//              kernels themselves against the plain ones by checkKernels().
+template <typename T>
+struct KernelLane
+{
+    KernelLane() : value(0) {}
+
+    KernelLane(double constant) : value((T)constant) {}
+
+    static const BatchKernels<T>& kernels() { return batchKernels<T>(); }
+
+    typedef void (*Unary)(const T*, T*, size_t);
+    typedef void (*Binary)(const T*, const T*, T*, size_t);
+
+    static KernelLane run(Unary kernel, const KernelLane& a)
+    {
+        KernelLane out;
+        kernel(&a.value, &out.value, 1);
+        return out;
+    }
+
+    static KernelLane run(Binary kernel, const KernelLane& a, const KernelLane& b)
+    {
+        KernelLane out;
+        kernel(&a.value, &b.value, &out.value, 1);
+        return out;
+    }
+
+    static bool test(Binary kernel, const KernelLane& a, const KernelLane& b) { return run(kernel, a, b).value != 0; }
+
+    friend KernelLane operator+(const KernelLane& a, const KernelLane& b) { return run(kernels().add, a, b); }
+
+    friend KernelLane operator-(const KernelLane& a, const KernelLane& b) { return run(kernels().subtract, a, b); }
+
+    //evaluate() negates by multiplying by -1, which is bit for bit what the negate kernel does.
+    friend KernelLane operator*(const KernelLane& a, const KernelLane& b) { return run(kernels().multiply, a, b); }
+
+    friend KernelLane operator-(const KernelLane& a) { return run(kernels().negate, a); }
+
+    KernelLane& operator+=(const KernelLane& b) { return *this = *this + b; }
+
+    friend KernelLane operator/(const KernelLane& a, const KernelLane& b) { return run(kernels().divide, a, b); }
+
+    friend bool operator<(const KernelLane& a, const KernelLane& b) { return test(kernels().less, a, b); }
+
+    friend bool operator<=(const KernelLane& a, const KernelLane& b) { return test(kernels().lessEqual, a, b); }
+
+    friend bool operator>(const KernelLane& a, const KernelLane& b) { return test(kernels().greater, a, b); }
+
+    friend bool operator>=(const KernelLane& a, const KernelLane& b) { return test(kernels().greaterEqual, a, b); }
+
+    friend bool operator==(const KernelLane& a, const KernelLane& b) { return test(kernels().equal, a, b); }
+
+    friend bool operator!=(const KernelLane& a, const KernelLane& b) { return test(kernels().notEqual, a, b); }
+
+    friend KernelLane sqrt(const KernelLane& a) { return run(kernels().squareRoot, a); }
+
+    friend KernelLane exp(const KernelLane& a) { return run(kernels().exponential, a); }
+
+    friend KernelLane log(const KernelLane& a) { return run(kernels().logarithm, a); }
+
+    friend KernelLane fabs(const KernelLane& a) { return run(kernels().absolute, a); }
+
+    friend KernelLane pow(const KernelLane& a, const KernelLane& b) { return run(kernels().power, a, b); }
+
+    T value;
+};
+
+//NAME: batchValue
+//DESCRIPTION:  The value of a variable in a row of the batch checks: the rows of kRowValues, then ramps.
+//INPUT:
+//    row  - The row, below kBatchRows.
+//    slot - The variable, below kFuzzVariableCount.
+//OUTPUT:
+//    none
+//RETURNS:
+//    Its value.
+static double batchValue(size_t row, int slot)
+{
+    if (row < (size_t)kRows)
+        return kRowValues[row][slot];
+
+    switch (slot)
+    {
+    case 0:  return 0.3 * (double)row - 20;
+    case 1:  return row % 3 ? -0.75 : 2.0;
+    case 2:  return 1.0 / (double)(row + 1);
+    default: return (double)(row % 7) - 3;
+    }
+}
+
+//NAME: checkBatchOf
+//DESCRIPTION:  Checks evaluateBatch() in T against the same program evaluated one row at a time in
+//              KernelLane<T>, over rows which change from one to the next.
+//INPUT:
+//    eq      - The expression.
+//    program - It compiled.
+//    slots   - How many variables the program reads.
+//    type    - What T is called, for the report.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+template <typename T>
+static void checkBatchOf(const char* eq, const Program& program, int slots, const char* type, DifferentialReport& report)
+{
+    std::vector<T> columns((size_t)slots * kBatchRows, T(0));
+    for (size_t row = 0; row < kBatchRows; row++)
+    {
+        for (int slot = 0; slot < kFuzzVariableCount && slot < slots; slot++)
+            columns[slot * kBatchRows + row] = (T)batchValue(row, slot);
+    }
+
+    std::vector<const T*> pointers(slots);
+    for (int slot = 0; slot < slots; slot++)
+        pointers[slot] = &columns[slot * kBatchRows];
+
+    std::vector<T> answers(kBatchRows);
+    evaluateBatch(program, pointers.data(), answers.data(), kBatchRows);
+
+    std::vector<KernelLane<T>> values(slots + 1);
+    for (size_t row = 0; row < kBatchRows; row++)
+    {
+        for (int slot = 0; slot < slots; slot++)
+            values[slot].value = columns[slot * kBatchRows + row];
+
+        T expected = evaluate(program, values.data()).value;
+        if (!same((double)answers[row], (double)expected))
+        {
+            char engine[64];
+            snprintf(engine, sizeof(engine), "evaluateBatch<%s>", type);
+            diverge(report, engine, eq, "row %zu: %.17g, the row on its own %.17g", row, (double)answers[row], (double)expected);
+            return;
+        }
+    }
+}
+
+//NAME: checkIncremental
+//DESCRIPTION:  Checks an IncrementalProgram against evaluate() as its variables change from row to row,
+//              one at a time and several at once, and back again.
+//INPUT:
+//    eq      - The expression.
+//    program - It compiled.
+//    slots   - How many variables the program reads.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkIncremental(const char* eq, const Program& program, int slots, DifferentialReport& report)
+{
+    if (program.variableCount == 0)
+        return;
+
+    std::vector<double> values(slots + 1, 0.0);
+    for (int slot = 0; slot < kFuzzVariableCount && slot < slots; slot++)
+        values[slot] = kRowValues[0][slot];
+
+    //Slots past the ones the expression reads are none of its business.
+    IncrementalProgram incremental(program, values.data());
+    static const int kSteps[] = { 1, 2, 0, 2, 1, 0 };
+    for (int step = 0; step < (int)(sizeof(kSteps) / sizeof(kSteps[0])); step++)
+    {
+        //Every other step only changes the first variable.
+        int row = kSteps[step];
+        int changed = step % 2 ? 1 : kFuzzVariableCount;
+        for (int slot = 0; slot < changed && slot < program.variableCount; slot++)
+        {
+            values[slot] = kRowValues[row][slot];
+            incremental.set(slot, values[slot]);
+        }
+
+        double answer = incremental.evaluate();
+        double expected = evaluate(program, values.data());
+        if (!same(answer, expected))
+        {
+            diverge(report, "IncrementalProgram", eq, "step %d: %.17g, evaluate() %.17g", step, answer, expected);
+            return;
+        }
+    }
+}
+
+//NAME: Dual
+//DESCRIPTION:  A number carrying its derivative with respect to one variable, which evaluate() of a
+//              program in Dual differentiates forwards, independently of the tape.  size is the same
+//              derivative with the absolute value of every term, which is how far rounding can have
+//              moved a derivative summed up in some other order.  depends is whether it was calculated
+//              from the variable at all, so a partial is only used where the tape has an entry.
+//              bounded is whether every partial used so far, which is on the tape too, is finite, and
+//              smallest and largest are the smallest and largest sizes on the way.  The adjoint the tape
+//              passes to a value is about the size of the answer divided by the value's own, so where that
+//              is beyond the range of a double the tape overflows or underflows though Dual doesn't, after
+//              a size of 0 it could be anything, and a size among the denormals has lost digits of Dual's.
+struct Dual
+{
+    Dual() : value(0), derivative(0), size(0), smallest(INFINITY), largest(0), depends(false), bounded(true) {}
+
+    Dual(double constant) : value(constant), derivative(0), size(0), smallest(INFINITY), largest(0), depends(false), bounded(true) {}
+
+    Dual(double value, double derivative, double size, bool depends)
+        : value(value), derivative(derivative), size(size), smallest(depends ? size : INFINITY), largest(depends ? size : 0),
+          depends(depends), bounded(true) {}
+
+    Dual(double value, double derivative, double size, double smallest, double largest, bool depends, bool bounded)
+        : value(value), derivative(derivative), size(size), smallest(std::fmin(size, smallest)), largest(std::fmax(size, largest)),
+          depends(depends), bounded(bounded) {}
+
+    //The derivative of a function of a: partial times a's, if a depends on the variable at all.
+    static Dual chain(double value, const Dual& a, double partial)
+    {
+        if (!a.depends)
+            return Dual(value);
+
+        return Dual(value, a.derivative * partial, a.size * std::fabs(partial), a.smallest, a.largest, true,
+                    a.bounded && std::isfinite(partial));
+    }
+
+    static Dual chain(double value, const Dual& a, double da, const Dual& b, double db)
+    {
+        Dual first = chain(value, a, da);
+        Dual second = chain(value, b, db);
+        if (!a.depends || !b.depends)
+            return a.depends ? first : second;
+
+        return Dual(value, first.derivative + second.derivative, first.size + second.size, std::fmin(first.smallest, second.smallest),
+                    std::fmax(first.largest, second.largest), true, first.bounded && second.bounded);
+    }
+
+    friend Dual operator+(const Dual& a, const Dual& b) { return chain(a.value + b.value, a, 1, b, 1); }
+
+    friend Dual operator-(const Dual& a, const Dual& b) { return chain(a.value - b.value, a, 1, b, -1); }
+
+    friend Dual operator*(const Dual& a, const Dual& b) { return chain(a.value * b.value, a, b.value, b, a.value); }
+
+    friend Dual operator/(const Dual& a, const Dual& b)
+    {
+        double value = a.value / b.value;
+        return chain(value, a, 1 / b.value, b, -value / b.value);
+    }
+
+    friend bool operator<(const Dual& a, const Dual& b) { return a.value < b.value; }
+
+    friend bool operator<=(const Dual& a, const Dual& b) { return a.value <= b.value; }
+
+    friend bool operator>(const Dual& a, const Dual& b) { return a.value > b.value; }
+
+    friend bool operator>=(const Dual& a, const Dual& b) { return a.value >= b.value; }
+
+    friend bool operator==(const Dual& a, const Dual& b) { return a.value == b.value; }
+
+    friend bool operator!=(const Dual& a, const Dual& b) { return a.value != b.value; }
+
+    friend Dual sqrt(const Dual& a)
+    {
+        double value = std::sqrt(a.value);
+        return chain(value, a, 0.5 / value);
+    }
+
+    friend Dual exp(const Dual& a)
+    {
+        double value = std::exp(a.value);
+        return chain(value, a, value);
+    }
+
+    friend Dual log(const Dual& a) { return chain(std::log(a.value), a, 1 / a.value); }
+
+    friend Dual fabs(const Dual& a) { return chain(std::fabs(a.value), a, a.value > 0 ? 1 : a.value < 0 ? -1 : 0); }
+
+    friend Dual pow(const Dual& a, const Dual& b)
+    {
+        double value = std::pow(a.value, b.value);
+        return chain(value, a, b.value * std::pow(a.value, b.value - 1), b, value * std::log(a.value));
+    }
+
+    double value;
+    double derivative;
+    double size;
+    double smallest;
+    double largest;
+    bool depends;
+    bool bounded;
+};
+
+//NAME: checkGradient
+//DESCRIPTION:  Checks evaluateGradient() against evaluate() for the answer and against Dual for every
+//              derivative, over every row of kRowValues.  Both are reverse mode, so evaluateGradientBatch()
+//              has to give bit for bit what evaluateGradient() does with the batch kernels run one lane at
+//              a time, and its answers what evaluateBatch() gives.
+//              A derivative is only checked against Dual where Dual is finite and so is every partial on
+//              the tape: the tape passes nothing on from an entry whose adjoint is 0, where Dual can end up
+//              with 0 times infinity, and multiplies the partials in the other order, where one of them
+//              being infinite can leave it infinite or NaN while Dual stays finite.
+//INPUT:
+//    eq      - The expression.
+//    program - It compiled.
+//    slots   - How many variables the program reads.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkGradient(const char* eq, const Program& program, int slots, DifferentialReport& report)
+{
+    const int derivatives = program.variableCount;
+    Arena arena;
+
+    std::vector<double> columns((size_t)(derivatives + 1) * kRows, 0.0);
+    std::vector<double> gradientColumns((size_t)(derivatives + 1) * kRows, 0.0);
+    std::vector<const double*> columnPointers(derivatives + 1);
+    std::vector<double*> gradientPointers(derivatives + 1);
+    for (int slot = 0; slot <= derivatives; slot++)
+    {
+        columnPointers[slot] = &columns[(size_t)slot * kRows];
+        gradientPointers[slot] = &gradientColumns[(size_t)slot * kRows];
+        for (int row = 0; row < kRows && slot < kFuzzVariableCount; row++)
+            columns[(size_t)slot * kRows + row] = kRowValues[row][slot];
+    }
+
+    double batchAnswers[kRows];
+    double expectedAnswers[kRows];
+    evaluateGradientBatch(program, columnPointers.data(), batchAnswers, gradientPointers.data(), kRows, arena);
+    evaluateBatch(program, columnPointers.data(), expectedAnswers, kRows);
+
+    std::vector<double> values(slots + 1, 0.0);
+    std::vector<double> gradient(derivatives + 1, 0.0);
+    std::vector<KernelLane<double>> lanes(slots + 1);
+    std::vector<KernelLane<double>> laneGradient(derivatives + 1);
+    std::vector<Dual> duals(slots + 1);
+    for (int row = 0; row < kRows; row++)
+    {
+        for (int slot = 0; slot < kFuzzVariableCount && slot < slots; slot++)
+        {
+            values[slot] = kRowValues[row][slot];
+            lanes[slot].value = kRowValues[row][slot];
+        }
+
+        double answer = evaluateGradient(program, values.data(), gradient.data(), arena);
+        double expected = evaluate(program, values.data());
+        if (!same(answer, expected))
+            diverge(report, "evaluateGradient", eq, "row %d: %.17g, evaluate() %.17g", row, answer, expected);
+
+        if (!same(batchAnswers[row], expectedAnswers[row]))
+            diverge(report, "evaluateGradientBatch", eq, "row %d: %.17g, evaluateBatch() %.17g", row, batchAnswers[row], expectedAnswers[row]);
+
+        evaluateGradient(program, lanes.data(), laneGradient.data(), arena);
+        for (int slot = 0; slot < derivatives; slot++)
+        {
+            const char* name = slot < kFuzzVariableCount ? kFuzzVariableNames[slot] : "?";
+            double batch = gradientPointers[slot][row];
+            if (!same(batch, laneGradient[slot].value))
+            {
+                diverge(report, "evaluateGradientBatch", eq, "row %d: d/%s %.17g, evaluateGradient() of the lane %.17g", row, name,
+                        batch, laneGradient[slot].value);
+            }
+
+            for (int other = 0; other <= slots; other++)
+                duals[other] = Dual(values[other], other == slot ? 1 : 0, other == slot ? 1 : 0, other == slot);
+
+            Dual forward = evaluate(program, duals.data());
+            if (!std::isfinite(forward.derivative) || !std::isfinite(forward.size) || !forward.bounded ||
+                !(forward.smallest > kSmallSize) || forward.size / forward.smallest > DBL_MAX / 1024 ||
+                forward.size / forward.largest < kSmallSize)
+                continue;
+
+            //Rounding each term can move the sum by a few units of the largest, whatever its order.
+            double allowed = 1e-9 * forward.size + kTiny;
+            if (!(std::fabs(gradient[slot] - forward.derivative) <= allowed))
+                diverge(report, "evaluateGradient", eq, "row %d: d/%s %.17g, forwards %.17g", row, name, gradient[slot], forward.derivative);
+        }
+
+        arena.reset();
+    }
+}
+
+//NAME: checkBounds
+//DESCRIPTION:  Checks that an answer is inside the interval evaluate<Interval>() gave for its row.
+//INPUT:
+//    eq     - The expression.
+//    what   - Which rows the interval was evaluated over, for the report.
+//    row    - The row.
+//    answer - Its answer.
+//    bounds - The interval.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    true if it is inside.
+static bool checkBounds(const char* eq, const char* what, size_t row, double answer, const Interval& bounds, DifferentialReport& report)
+{
+    if (bounds.contains(answer))
+        return true;
+
+    diverge(report, "evaluate<Interval>", eq, "%s, row %zu: %.17g outside [%.17g, %.17g]%s", what, row, answer,
+            bounds.lo, bounds.hi, bounds.nan ? " or NaN" : "");
+    return false;
+}
+
+//NAME: checkInterval
+//DESCRIPTION:  Checks that evaluate<Interval>() holds the answers of evaluate() over every row of kRowValues
+//              on its own and over all of them at once, and those of evaluateBatch() over the batch rows.
+//INPUT:
+//    eq      - The expression.
+//    program - It compiled.
+//    slots   - How many variables the program reads.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkInterval(const char* eq, const Program& program, int slots, DifferentialReport& report)
+{
+    std::vector<double> values(slots + 1, 0.0);
+    std::vector<Interval> ranges(slots + 1);
+    double answers[kRows];
+    for (int row = 0; row < kRows; row++)
+    {
+        for (int slot = 0; slot < kFuzzVariableCount && slot < slots; slot++)
+        {
+            values[slot] = kRowValues[row][slot];
+            ranges[slot] = Interval(values[slot]);
+        }
+
+        answers[row] = evaluate(program, values.data());
+        if (!checkBounds(eq, "the row", row, answers[row], evaluate(program, ranges.data()), report))
+            return;
+    }
+
+    for (int slot = 0; slot < kFuzzVariableCount && slot < slots; slot++)
+    {
+        ranges[slot] = Interval(kRowValues[0][slot]);
+        for (int row = 1; row < kRows; row++)
+            ranges[slot] = hull(ranges[slot], Interval(kRowValues[row][slot]));
+    }
+
+    Interval bounds = evaluate(program, ranges.data());
+    for (int row = 0; row < kRows; row++)
+    {
+        if (!checkBounds(eq, "every row", row, answers[row], bounds, report))
+            return;
+    }
+
+    std::vector<double> columns((size_t)slots * kBatchRows, 0.0);
+    std::vector<const double*> pointers(slots);
+    for (int slot = 0; slot < slots; slot++)
+    {
+        pointers[slot] = &columns[slot * kBatchRows];
+        if (slot >= kFuzzVariableCount)
+        {
+            ranges[slot] = Interval(0);
+            continue;
+        }
+
+        ranges[slot] = Interval(batchValue(0, slot));
+        for (size_t row = 0; row < kBatchRows; row++)
+        {
+            columns[slot * kBatchRows + row] = batchValue(row, slot);
+            ranges[slot] = hull(ranges[slot], Interval(columns[slot * kBatchRows + row]));
+        }
+    }
+
+    std::vector<double> batch(kBatchRows);
+    evaluateBatch(program, pointers.data(), batch.data(), kBatchRows);
+    bounds = evaluate(program, ranges.data());
+    for (size_t row = 0; row < kBatchRows; row++)
+    {
+        if (!checkBounds(eq, "the batch", row, batch[row], bounds, report))
+            return;
+    }
+}
+
+//NAME: checkUnbound
+//DESCRIPTION:  Checks that compile() without a table of variables fails where solve() without one does,
+//              at the first name either of them has to look up; the name in an answer which isn't
+//              taken is skipped by solve() and dropped by compile() as long as the condition is a constant.
+//INPUT:
+//    eq - The expression, which may be malformed.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkUnbound(const char* eq, DifferentialReport& report)
+{
+    Result<double> solved = solve(eq);
+    Program program = compile(eq);
+
+    //compile() doesn't calculate, so it can't find what is wrong with the operands of a division or a function.
+    if (solved.error == ErrorCode::OutOfDomain || solved.error == ErrorCode::DivisionByZero)
+        return;
+
+    if (program.error != solved.error || (!program.ok() && program.errorOffset != solved.offset))
+    {
+        diverge(report, "compile", eq, "without variables error %d at %d, solve() %d at %d", (int)program.error,
+                program.errorOffset, (int)solved.error, solved.offset);
+    }
+}
+
+//NAME: checkExpression
+//DESCRIPTION:  Solves an expression with every engine, over every row of kRowValues, and checks that they
+//              all agree with solve() and solve() with the reference.
+//INPUT:
+//    eq        - The expression, which may be malformed.
+//    bound     - How many of kFuzzVariableNames are bound, the others are as unknown as any other name.
+//INPUT/OUTPUT:
+//    report - Where divergences are recorded.
+//RETURNS:
+//    none
+void checkExpression(const char* eq, DifferentialReport& report, int bound)
+{
+    report.checked++;
+    if (!checkParsers(eq, report))
+        return;
+
+    VariableTable tables[kRows];
+    Result<double> solved[kRows];
+    bool malformed = false;
+    bool undefined = false;
+    for (int row = 0; row < kRows; row++)
+    {
+        for (int slot = 0; slot < bound; slot++)
+            tables[row].define(kFuzzVariableNames[slot], kRowValues[row][slot]);
+
+        solved[row] = solve(eq, tables[row]);
+        if (isUndefined(solved[row].error))
+            undefined = true;
+        else if (!solved[row].ok())
+            malformed = true;
+
+        Result<double> iterative = solveIterative(eq, &tables[row]);
+        if (iterative.error != solved[row].error || iterative.offset != solved[row].offset ||
+            (solved[row].ok() && !same(iterative.value, solved[row].value)))
+        {
+            diverge(report, "solveIterative", eq, "row %d: %.17g error %d at %d, solve() %.17g error %d at %d", row,
+                    iterative.value, (int)iterative.error, iterative.offset, solved[row].value, (int)solved[row].error, solved[row].offset);
+        }
+
+        checkType<float>(eq, tables[row], solved[row], row, "float", report);
+        checkType<Fixed64>(eq, tables[row], solved[row], row, "Fixed64", report);
+
+        Reference reference(&tables[row]);
+        Reference::Value exact = parseExpression(eq, reference);
+        if (reference.unstable)
+            continue;
+
+        if (row == 0)
+            report.referenced++;
+
+        if (reference.error != solved[row].error || (reference.failed() && (int)(reference.errorAt - eq) != solved[row].offset))
+        {
+            diverge(report, "solve", eq, "row %d: error %d at %d, the reference %d at %d", row, (int)solved[row].error, solved[row].offset,
+                    (int)reference.error, reference.failed() ? (int)(reference.errorAt - eq) : -1);
+        }
+        else if (solved[row].ok())
+        {
+            checkReference("solve", eq, exact, solved[row].value, report);
+        }
+    }
+
+    if (malformed)
+        report.malformed++;
+    else if (undefined)
+        report.undefined++;
+
+    checkCache(eq, report);
+    checkLines(eq, report);
+    checkUnbound(eq, report);
+
+    VariableTable variables = tables[0];
+    Program program = compile(eq, variables);
+    if (!program.ok())
+    {
+        for (int row = 0; row < kRows; row++)
+        {
+            if (program.error != solved[row].error && !isRuntimeError(solved[row].error))
+                diverge(report, "compile", eq, "error %d, solve() %d", (int)program.error, (int)solved[row].error);
+            else if (program.error == solved[row].error && !isRuntimeError(program.error) && program.errorOffset != solved[row].offset)
+                diverge(report, "compile", eq, "error at %d, solve() at %d", program.errorOffset, solved[row].offset);
+        }
+        return;
+    }
+
+    for (int row = 0; row < kRows; row++)
+    {
+        if (!solved[row].ok() && !isRuntimeError(solved[row].error))
+            diverge(report, "compile", eq, "compiled, solve() reports error %d", (int)solved[row].error);
+    }
+
+    Arena arena;
+    VariableTable treeVariables = tables[0];
+    Ast tree = parseTree(eq, arena, treeVariables);
+    if (!tree.ok())
+        diverge(report, "parseTree", eq, "error %d, compile() succeeded", (int)tree.error);
+
+    Program optimized = program;
+    optimize(optimized);
+
+    OptimizeOptions relaxedOptions;
+    relaxedOptions.relaxed = true;
+    Program relaxed = program;
+    optimize(relaxed, relaxedOptions);
+    bool continuous = isContinuous(program);
+
+    const char* formulas[2] = { eq, "x * 2 + 1" };
+    VariableTable sharedVariables = tables[0];
+    SharedProgram shared = compileShared(formulas, sharedVariables);
+
+    //An archive is used in place, and has to be as aligned as a double.
+    std::vector<char> packed = packArchive(std::span<const Program>(&program, 1), &variables);
+    std::vector<double> archiveMemory(packed.size() / sizeof(double) + 1);
+    memcpy(archiveMemory.data(), packed.data(), packed.size());
+    Archive archive;
+    bool archived = archive.attach(archiveMemory.data(), packed.size());
+    if (!archived || !archive.verify())
+    {
+        diverge(report, "Archive", eq, "the archive doesn't verify");
+        archived = false;
+    }
+
+    NativeCode native;
+    bool compiled = native.compile(optimized);
+    std::vector<double> spill(native.spillCount() + 1);
+
+    int slots = variables.size();
+    if (sharedVariables.size() > slots)
+        slots = sharedVariables.size();
+    if (treeVariables.size() > slots)
+        slots = treeVariables.size();
+
+    std::vector<double> values(slots + 1, 0.0);
+    for (int row = 0; row < kRows; row++)
+    {
+        for (int slot = 0; slot < bound; slot++)
+            values[slot] = kRowValues[row][slot];
+
+        double answer = evaluate(program, values.data());
+        if (solved[row].ok() && !near(answer, solved[row].value))
+            diverge(report, "evaluate", eq, "row %d: %.17g, solve() %.17g", row, answer, solved[row].value);
+
+        if (tree.ok())
+        {
+            double treeAnswer = evaluate(tree, values.data());
+            if (!near(treeAnswer, answer))
+                diverge(report, "evaluate(Ast)", eq, "row %d: %.17g, evaluate() %.17g", row, treeAnswer, answer);
+        }
+
+        double optimizedAnswer = evaluate(optimized, values.data());
+        if (!same(optimizedAnswer, answer))
+            diverge(report, "optimize", eq, "row %d: %.17g, unoptimized %.17g", row, optimizedAnswer, answer);
+
+        double relaxedAnswer = evaluate(relaxed, values.data());
+        if (continuous && std::isfinite(answer) && !near(relaxedAnswer, answer))
+            diverge(report, "optimize(relaxed)", eq, "row %d: %.17g, unoptimized %.17g", row, relaxedAnswer, answer);
+
+        if (shared.outputs[0].error == ErrorCode::None)
+        {
+            double answers[2];
+            evaluateShared(shared, values.data(), answers);
+            if (!same(answers[0], answer))
+                diverge(report, "evaluateShared", eq, "row %d: %.17g, evaluate() %.17g", row, answers[0], answer);
+        }
+        else
+        {
+            diverge(report, "compileShared", eq, "error %d, compile() succeeded", (int)shared.outputs[0].error);
+        }
+
+        if (archived)
+        {
+            double archiveAnswer = evaluate(archive.program(0), values.data());
+            if (!same(archiveAnswer, answer))
+                diverge(report, "Archive", eq, "row %d: %.17g, evaluate() %.17g", row, archiveAnswer, answer);
+        }
+
+        if (compiled)
+        {
+            double nativeAnswer = native.function()(values.data(), spill.data());
+            if (!same(nativeAnswer, optimizedAnswer))
+                diverge(report, "NativeCode", eq, "row %d: %.17g, evaluate() %.17g", row, nativeAnswer, optimizedAnswer);
+        }
+    }
+
+    checkIncremental(eq, program, slots, report);
+    checkBatchOf<double>(eq, program, slots, "double", report);
+    checkBatchOf<float>(eq, program, slots, "float", report);
+    checkGradient(eq, program, slots, report);
+    checkInterval(eq, program, slots, report);
+}
+
+//NAME: checkLiteral
+//DESCRIPTION:  Checks that a number on its own converts to exactly what strtod() and strtof() give.
+//              Anything which isn't only a literal is left alone.
+//INPUT:
+//    text - The literal.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+void checkLiteral(const char* text, DifferentialReport& report)
+{
+    if (!isDigit(*text) && *text != '.')
+        return;
+
+    for (const char* at = text; *at != '\0'; at++)
+    {
+        if (!isDigit(*at) && *at != '.' && *at != 'e' && *at != 'E' && *at != '+' && *at != '-')
+            return;
+    }
+
+    Result<double> solved = solve(text);
+    Result<float> solvedFloat = solve<float>(text);
+    if (!solved.ok() || !solvedFloat.ok())
+        return;
+
+    char* end = NULL;
+    double expected = strtod(text, &end);
+    if (*end != '\0')
+        return;
+
+    float expectedFloat = strtof(text, &end);
+    if (memcmp(&solved.value, &expected, sizeof(double)) != 0)
+        diverge(report, "double literal", text, "%.17g, strtod() %.17g", solved.value, expected);
+    if (memcmp(&solvedFloat.value, &expectedFloat, sizeof(float)) != 0)
+        diverge(report, "float literal", text, "%.9g, strtof() %.9g", solvedFloat.value, expectedFloat);
+}
+
+//NAME: checkCraftedArchive
+//DESCRIPTION:  Checks that Archive::verify() turns down a formula which reads a register evaluate() never
+//              writes, which packArchive() never makes but a file from somewhere else could have.
+//INPUT:
+//    eq     - A conditional.
+//    inside - Which of its instructions is read after it: 0 for its Jump, 1 for the one before the Jump.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkCraftedArchive(const char* eq, int inside, DifferentialReport& report)
+{
+    VariableTable variables;
+    variables.define("x", 1);
+    variables.define("y", 2);
+
+    Program program = compile(eq, variables);
+    int read = -1;
+    for (size_t i = 0; i < program.code.size(); i++)
+    {
+        if (program.code[i].op == OpCode::Jump)
+            read = (int)i - inside;
+    }
+
+    if (!program.ok() || read < 0)
+    {
+        diverge(report, "Archive::verify", eq, "doesn't compile to a conditional");
+        return;
+    }
+
+    program.code.push_back(Instruction{ OpCode::Add, read, (int)program.code.size() - 1 });
+
+    std::vector<char> packed = packArchive(std::span<const Program>(&program, 1), &variables);
+    std::vector<double> archiveMemory(packed.size() / sizeof(double) + 1);
+    memcpy(archiveMemory.data(), packed.data(), packed.size());
+    Archive archive;
+    if (!archive.attach(archiveMemory.data(), packed.size()) || archive.verify())
+        diverge(report, "Archive::verify", eq, "accepts a formula reading register %d after the conditional", read);
+}
+
+//Expressions which have gone wrong before, each solved through a cache after the one next to it.
+static const char* const kCachedPairs[][2] = {
+    { "-1", "- 1" },
+    { "2*-3", "2*- 3" },
+    { "1---1", "1 - - - 1" },
+    { "-(1)", "- (1)" },
+    { "1 <= 2", "1 < = 2" },
+    { "2 >= 1", "2 > = 1" },
+    { "1 == 1", "1 = = 1" },
+    { "1 != 2", "1 ! = 2" },
+    { "1 && 2", "1 & & 2" },
+    { "1 || 0", "1 | | 0" },
+};
+
+//Decimal literals with exponents of 7 and 10 digits, far beyond double but not all beyond Decimal128.
+static const char* const kDecimalLiterals[] = {
+    "1e1234567", "1e5000000", "1e-1234567", "2.5e999999999", "0.001e1234567",
+    "1e1234567890", "1e-1234567890", "7e-1000000040",
+};
+
+//NAME: checkDecimalLiteral
+//DESCRIPTION:  Checks that solve<Decimal128>() reads a literal exactly as Decimal128::fromText() does,
+//              which reads every digit of the text instead of the mantissa the parser scanned.
+//INPUT:
+//    text - The literal.
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+static void checkDecimalLiteral(const char* text, DifferentialReport& report)
+{
+    Result<Decimal128> solved = solve<Decimal128>(text);
+    Decimal128 expected = Decimal128::fromText(text, text + strlen(text));
+
+    char got[kLongestDecimal];
+    char wanted[kLongestDecimal];
+    size_t gotLength = formatDecimal(solved.value, got, sizeof(got));
+    size_t wantedLength = formatDecimal(expected, wanted, sizeof(wanted));
+    if (!solved.ok() || gotLength != wantedLength || memcmp(got, wanted, gotLength) != 0)
+    {
+        diverge(report, "Decimal128 literal", text, "%.*s error %d, fromText() %.*s", (int)gotLength, got,
+                (int)solved.error, (int)wantedLength, wanted);
+    }
+}
+
+//NAME: nest
+//DESCRIPTION:  Nests an expression in as many levels of the same operators as it takes.
+//INPUT:
+//    open      - What each level starts with.
+//    innermost - The expression in the middle.
+//    close     - What each level ends with.
+//    levels    - How many levels there are.
+//OUTPUT:
+//    none
+//RETURNS:
+//    open levels times, then innermost, then close levels times.
+static std::string nest(const char* open, const char* innermost, const char* close, int levels)
+{
+    std::string nested;
+    for (int level = 0; level < levels; level++)
+        nested += open;
+    nested += innermost;
+    for (int level = 0; level < levels; level++)
+        nested += close;
+    return nested;
+}
+
+//NAME: checkRegressions
+//DESCRIPTION:  Checks the inputs of bugs which have been fixed, which generated expressions only find
+//              now and then.
+//INPUT:
+//    none
+//INPUT/OUTPUT:
+//    report - Where a divergence is recorded.
+//RETURNS:
+//    none
+void checkRegressions(DifferentialReport& report)
+{
+    struct Regression
+    {
+        std::string eq;
+        int bound;          //How many of kFuzzVariableNames are bound.
+    };
+
+    const Regression regressions[] = {
+        //Sums, powers and conditionals nested deeply enough that the iterative parser moves its frames to
+        //the heap.
+        { nest("x+(y^(x<y?(", "qty", "):rate))", 20), kFuzzVariableCount },
+        //A tree whose stack is deeper than the one evaluate() keeps on the thread's stack.
+        { nest("x-(", "y", ")", 100), kFuzzVariableCount },
+        //The sweep of a whole block passed (adjoint / y) * value on to y, infinity times 0 where y is 0 and
+        //the value too, while the tape passes adjoint * (value / y).
+        { "((-x)^2.5/y?y:y+1) * exp(-x-2||0)/-(0.1)^(0.1^x)", kFuzzVariableCount },
+        //Names in an answer which isn't taken are neither looked up by solve() nor by compile().
+        { "0 ? y : 1", 0 },
+        { "1 ? 2 : (0 ? 3 : y)", 0 },
+        { "x < 0 ? y : 1", 1 },
+    };
+
+    for (const auto& pair : kCachedPairs)
+        checkCached(pair[0], pair[1], report);
+
+    for (const char* text : kDecimalLiterals)
+        checkDecimalLiteral(text, report);
+
+    for (const Regression& regression : regressions)
+        checkExpression(regression.eq.c_str(), report, regression.bound);
+
+    checkCraftedArchive("x > y ? x * y : y", 0, report);
+    checkCraftedArchive("x > y ? x * y : y", 1, report);
+
+    //A sum nested too deeply for the iterative parser at all.
+    std::string tooDeep = nest("1+(", "1", ")", 300);
+    Result<double> deepest = solveIterative(tooDeep.c_str());
+    if (deepest.error != ErrorCode::TooDeep)
+        diverge(report, "solveIterative", "1+(1+(...300 levels...)))", "error %d, not TooDeep", (int)deepest.error);
+}
+
+//NAME: nextRandom
+//DESCRIPTION:  splitmix64, as the generator uses.
+static uint64_t nextRandom(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//NAME: ulps
+//DESCRIPTION:  How many representable numbers apart two values are, 0 for two NaNs.
+template <typename T>
+static uint64_t ulps(T a, T b)
+{
+    if (std::isnan(a) || std::isnan(b))
+        return std::isnan(a) && std::isnan(b) ? 0 : UINT64_MAX;
+
+    //The bits of a float or double, ordered the way the numbers are.
+    auto ordered = [](T value) -> int64_t
+    {
+        typedef typename std::conditional<sizeof(T) == 8, int64_t, int32_t>::type Bits;
+        Bits bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits < 0 ? -(int64_t)(bits & std::numeric_limits<Bits>::max()) : (int64_t)bits;
+    };
+
+    int64_t distance = ordered(a) - ordered(b);
+    return distance < 0 ? (uint64_t)-distance : (uint64_t)distance;
+}
+
+//NAME: checkKernelsOf
+//DESCRIPTION:  Checks one set of batch kernels of one lane type against the plain C++ ones.
+//INPUT:
+//    fast - The kernels.
+//    seed - Which arguments to use.
+//    type - What T is called, for the report.
+//INPUT/OUTPUT:
+//    report - Where divergences are recorded.
+//RETURNS:
+//    none
+template <typename T>
+static void checkKernelsOf(const BatchKernels<T>& fast, uint64_t seed, const char* type, DifferentialReport& report)
+{
+    const BatchKernels<T>& plain = scalarKernels<T>();
+
+    static const double kSpecial[] = {
+        0.0, -0.0, 1.0, -1.0, 0.5, 2.0, 3.0, -2.0, 1e-5, 88.0, -100.0, 700.0, -745.0, 710.0,
+        std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN(),
+        DBL_MIN, -DBL_MIN, DBL_TRUE_MIN, 1e-310, DBL_MAX, FLT_MIN, FLT_TRUE_MIN, FLT_MAX,
+    };
+    static const int kSpecialCount = sizeof(kSpecial) / sizeof(kSpecial[0]);
+
+    //Long enough for every instruction set to go through whole vectors and a tail of every length.
+    static const size_t kLanes = 67;
+    uint64_t state = seed;
+    T a[kLanes], b[kLanes], condition[kLanes];
+    for (size_t i = 0; i < kLanes; i++)
+    {
+        T* targets[3] = { a, b, condition };
+        for (T* target : targets)
+        {
+            uint64_t bits = nextRandom(state);
+            double value;
+            if (bits % 4 == 0)
+                value = kSpecial[(bits >> 8) % kSpecialCount];
+            else if (bits % 4 == 1)
+                value = std::ldexp((double)(bits >> 11) / 9007199254740992.0, (int)((bits >> 2) % 2100) - 1075);
+            else
+                value = std::ldexp((double)(bits >> 11) / 9007199254740992.0, (int)((bits >> 2) % 40) - 20);
+
+            if (bits & 2)
+                value = -value;
+            target[i] = (T)value;
+        }
+        if (i % 3 == 0)
+            condition[i] = 0;
+    }
+
+    typedef void (*Unary)(const T*, T*, size_t);
+    typedef void (*Binary)(const T*, const T*, T*, size_t);
+    struct Operation
+    {
+        const char* name;
+        Unary fastUnary, plainUnary;
+        Binary fastBinary, plainBinary;
+        uint64_t tolerance;
+    };
+
+    //exp() and log() are polynomials in the batch kernels, and float powers go through them.
+    const uint64_t powerTolerance = sizeof(T) == 4 ? 2 : 0;
+    const Operation operations[] = {
+        { "negate", fast.negate, plain.negate, NULL, NULL, 0 },
+        { "sqrt", fast.squareRoot, plain.squareRoot, NULL, NULL, 0 },
+        { "exp", fast.exponential, plain.exponential, NULL, NULL, 2 },
+        { "log", fast.logarithm, plain.logarithm, NULL, NULL, 2 },
+        { "abs", fast.absolute, plain.absolute, NULL, NULL, 0 },
+        { "add", NULL, NULL, fast.add, plain.add, 0 },
+        { "subtract", NULL, NULL, fast.subtract, plain.subtract, 0 },
+        { "multiply", NULL, NULL, fast.multiply, plain.multiply, 0 },
+        { "divide", NULL, NULL, fast.divide, plain.divide, 0 },
+        { "power", NULL, NULL, fast.power, plain.power, powerTolerance },
+        { "min", NULL, NULL, fast.minimum, plain.minimum, 0 },
+        { "max", NULL, NULL, fast.maximum, plain.maximum, 0 },
+        { "<", NULL, NULL, fast.less, plain.less, 0 },
+        { "<=", NULL, NULL, fast.lessEqual, plain.lessEqual, 0 },
+        { ">", NULL, NULL, fast.greater, plain.greater, 0 },
+        { ">=", NULL, NULL, fast.greaterEqual, plain.greaterEqual, 0 },
+        { "==", NULL, NULL, fast.equal, plain.equal, 0 },
+        { "!=", NULL, NULL, fast.notEqual, plain.notEqual, 0 },
+    };
+
+    static const size_t kCounts[] = { 1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 33, 47, 63, kLanes };
+    for (size_t count : kCounts)
+    {
+        T got[kLanes], expected[kLanes];
+        for (const Operation& operation : operations)
+        {
+            if (operation.fastUnary != NULL)
+            {
+                operation.fastUnary(a, got, count);
+                operation.plainUnary(a, expected, count);
+            }
+            else
+            {
+                operation.fastBinary(a, b, got, count);
+                operation.plainBinary(a, b, expected, count);
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                bool matches = ulps(got[i], expected[i]) <= operation.tolerance && (std::isnan(got[i]) || std::signbit(got[i]) == std::signbit(expected[i]));
+                if (!matches)
+                {
+                    char name[64];
+                    snprintf(name, sizeof(name), "%s %s kernel", fast.name, type);
+                    diverge(report, name, operation.name, "lane %zu of %zu: %.17g and %.17g give %.17g, the plain kernel %.17g",
+                            i, count, (double)a[i], (double)b[i], (double)got[i], (double)expected[i]);
+                    break;
+                }
+            }
+        }
+
+        fast.select(condition, a, b, got, count);
+        plain.select(condition, a, b, expected, count);
+        for (size_t i = 0; i < count; i++)
+        {
+            if (ulps(got[i], expected[i]) != 0)
+            {
+                char name[64];
+                snprintf(name, sizeof(name), "%s %s kernel", fast.name, type);
+                diverge(report, name, "select", "lane %zu of %zu: %.17g, the plain kernel %.17g", i, count, (double)got[i], (double)expected[i]);
+                break;
+            }
+        }
+    }
+
+    //A lane has to come out the same wherever it is in a block and however long the block is, which is
+    //what lets checkBatchOf() evaluate a row on its own.
+    for (const Operation& operation : operations)
+    {
+        T whole[kLanes];
+        if (operation.fastUnary != NULL)
+            operation.fastUnary(a, whole, kLanes);
+        else
+            operation.fastBinary(a, b, whole, kLanes);
+
+        for (size_t i = 0; i < kLanes; i++)
+        {
+            T single;
+            if (operation.fastUnary != NULL)
+                operation.fastUnary(a + i, &single, 1);
+            else
+                operation.fastBinary(a + i, b + i, &single, 1);
+
+            if (ulps(single, whole[i]) != 0 || (!std::isnan(single) && std::signbit(single) != std::signbit(whole[i])))
+            {
+                char name[64];
+                snprintf(name, sizeof(name), "%s %s kernel", fast.name, type);
+                diverge(report, name, operation.name, "lane %zu: %.17g on its own, %.17g in a block", i, (double)single, (double)whole[i]);
+                break;
+            }
+        }
+    }
+}
+
+//NAME: checkKernels
+//DESCRIPTION:  Checks the batch kernels of every instruction set the processor runs against the plain C++
+//              ones, for doubles and floats.
+//INPUT:
+//    seed - Which arguments to use.
+//INPUT/OUTPUT:
+//    report - Where divergences are recorded.
+//RETURNS:
+//    none
+void checkKernels(uint64_t seed, DifferentialReport& report)
+{
+    for (int index = 0; supportedKernels<double>(index) != NULL; index++)
+        checkKernelsOf(*supportedKernels<double>(index), seed, "double", report);
+    for (int index = 0; supportedKernels<float>(index) != NULL; index++)
+        checkKernelsOf(*supportedKernels<float>(index), seed, "float", report);
+}
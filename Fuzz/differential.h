@@ -0,0 +1,86 @@
+#ifndef CALCULATOR_FUZZ_DIFFERENTIAL_H
+#define CALCULATOR_FUZZ_DIFFERENTIAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "generator.h"
+
+//Every engine which calculates an expression is checked against the recursive descent parser, which is
+//the definition of what an expression means, and the parser in turn against a reference calculated
+//with 34 digits:
+//     iterative parser     has to make exactly the same calls on its actions, and fail the same way
+//     solveIterative()     bit for bit solve()
+//     compile()            fails where solve() does, without variables too; its answer within 1e-9 of
+//                          solve()'s (constants are folded in the order the compiler sees them, not always
+//                          the order solve() uses)
+//     parseTree()          accepts whatever compile() does, and evaluates within 1e-9 of it
+//     optimize()           bit for bit the program it started from; relaxed, within 1e-9 unless that is
+//                          infinite or NaN, or the program has a comparison its rounding could flip
+//     compileShared()      bit for bit, and so must the same program packed into an archive
+//     NativeCode           bit for bit the optimized program
+//     IncrementalProgram   bit for bit as its variables change, row after row
+//     evaluateBatch()      bit for bit the program evaluated one row at a time with the batch kernels,
+//                          over rows which change from one to the next
+//     evaluateGradient()   bit for bit evaluate(), and every derivative within 1e-9 of the same one
+//                          calculated forwards with dual numbers, relative to the size of its terms,
+//                          where no partial on the tape is infinite or NaN and no term has underflowed
+//     evaluateGradientBatch() bit for bit evaluateBatch(), and every derivative bit for bit (NaN or not)
+//                          evaluateGradient() run one lane at a time with the batch kernels
+//     evaluate<Interval>() holds what evaluate() gives for each row on its own and for all of them at
+//                          once, and what evaluateBatch() gives for the batch rows
+//     solve<float>()       fails where solve() does, unless either of them finds an answer out of its
+//     solve<Fixed64>()     type's domain, and bit for bit the iterative parser in the same type
+//     SolveCache           bit for bit solve() after the same expression without spaces, and with a space
+//                          after every operator
+//     solveLine()          bit for bit solve(), stopping at the end of the line; evaluateLines() writes
+//                          what solve() gives for every kind of line
+//The batch kernels of every instruction set the processor supports are checked against the plain C++
+//ones on their own too, with NaNs, infinities and denormals, and over counts which end in every position
+//of a vector.
+//
+//The reference runs the same parser with Decimal128, keeping next to each value a bound on how far the
+//double which solve() calculates can be from it: the error of every rounding so far, carried through the
+//operators the way it grows.  The answer of solve() has to be within twice that bound.  Where the bound
+//doesn't say which way a comparison, a condition or a check for zero goes in double, or a value is too
+//large or small for a double, the reference can't tell what solve() should do and the expression is only
+//checked engine against engine.  A literal on its own is compared bit for bit with strtod() and strtof().
+//checkRegressions() runs the inputs of bugs which have been fixed through the checks which would have
+//caught them, such as an expression solved through a SolveCache which has seen it spaced differently.
+
+//NAME: Divergence
+//DESCRIPTION:  An engine which doesn't agree with the one it is checked against.
+struct Divergence
+{
+    std::string engine;
+    std::string expression;
+    std::string detail;
+};
+
+//NAME: DifferentialReport
+//DESCRIPTION:  What the checks so far have found.
+struct DifferentialReport
+{
+    DifferentialReport() : checked(0), referenced(0), malformed(0), undefined(0) {}
+
+    bool ok() const { return divergences.empty(); }
+
+    size_t checked;       //Expressions checked.
+    size_t referenced;    //Of those, the ones the reference could decide.
+    size_t malformed;     //Of those, the ones solve() found a mistake in.
+    size_t undefined;     //Of the others, the ones without an answer in some row, such as log(-1).
+    std::vector<Divergence> divergences;
+};
+
+//Function declarations
+void checkExpression(const char* eq, DifferentialReport& report, int bound = kFuzzVariableCount);
+
+void checkLiteral(const char* text, DifferentialReport& report);
+
+void checkKernels(uint64_t seed, DifferentialReport& report);
+
+void checkRegressions(DifferentialReport& report);
+
+#endif
@@ -0,0 +1,180 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "generator.h"
+#include "differential.h"
+#include "perf.h"
+
+//     Fuzz [--seed N] [--count N] [--depth N] [--length N]
+//          Checks N generated expressions (and literals) with every engine, the batch kernels, and the
+//          inputs of bugs which have been fixed.
+//     Fuzz --replay file...
+//          Runs files through the libFuzzer entry point, such as the crashes a fuzzing run saved.
+//     Fuzz --perf baseline.txt [--record] [--tolerance 0.25]
+//          Times every engine and compares the times with the baseline, or records it.
+//The exit status is 1 if an engine diverged or got slower than the tolerance allows.
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+//How many divergences are printed; the rest are only counted.
+static const size_t kPrinted = 20;
+
+//NAME: runGenerated
+//DESCRIPTION:  Checks generated expressions and prints what was found.
+//INPUT:
+//    seed    - Which expressions.
+//    count   - How many.
+//    options - Their shape.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The exit status.
+static int runGenerated(uint64_t seed, uint64_t count, const GeneratorOptions& options)
+{
+    DifferentialReport report;
+    checkRegressions(report);
+    checkKernels(seed, report);
+
+    ExpressionGenerator generator(seed, options);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        std::string eq = generator.next();
+        checkExpression(eq.c_str(), report);
+
+        if (i % 8 == 0)
+        {
+            std::string literal = generator.literal();
+            checkLiteral(literal.c_str(), report);
+        }
+    }
+
+    for (size_t i = 0; i < report.divergences.size() && i < kPrinted; i++)
+    {
+        const Divergence& divergence = report.divergences[i];
+        printf("%s: \"%s\": %s\n", divergence.engine.c_str(), divergence.expression.c_str(), divergence.detail.c_str());
+    }
+
+    printf("%zu expressions, %zu checked against the reference, %zu malformed, %zu undefined: %zu divergences\n",
+           report.checked, report.referenced, report.malformed, report.undefined, report.divergences.size());
+    return report.ok() ? 0 : 1;
+}
+
+//NAME: runReplay
+//DESCRIPTION:  Runs files through the libFuzzer entry point, which aborts at a divergence.
+//INPUT:
+//    paths - The files.
+//    count - How many.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The exit status.
+static int runReplay(char* paths[], int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        FILE* file = fopen(paths[i], "rb");
+        if (file == NULL)
+        {
+            fprintf(stderr, "Fuzz: can't open %s\n", paths[i]);
+            return 1;
+        }
+
+        std::vector<uint8_t> data;
+        uint8_t buffer[4096];
+        size_t read;
+        while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+            data.insert(data.end(), buffer, buffer + read);
+        fclose(file);
+
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+
+    printf("%d inputs replayed\n", count);
+    return 0;
+}
+
+//NAME: runPerf
+//DESCRIPTION:  Times every engine and compares with, or records, a baseline.
+//INPUT:
+//    path      - The baseline file.
+//    record    - True to write the times as the new baseline.
+//    tolerance - How much slower a sample may be.
+//OUTPUT:
+//    none
+//RETURNS:
+//    The exit status.
+static int runPerf(const char* path, bool record, double tolerance)
+{
+    std::vector<PerfSample> measured = measurePerformance();
+    if (record)
+    {
+        if (!writeBaseline(path, measured))
+        {
+            fprintf(stderr, "Fuzz: can't write %s\n", path);
+            return 1;
+        }
+
+        compareBaseline(measured, measured, tolerance, stdout);
+        return 0;
+    }
+
+    std::vector<PerfSample> baseline;
+    if (!readBaseline(path, baseline))
+    {
+        fprintf(stderr, "Fuzz: can't read %s\n", path);
+        return 1;
+    }
+
+    int regressions = compareBaseline(baseline, measured, tolerance, stdout);
+    printf("%d of %zu samples slower than the baseline by more than %.0f%%\n", regressions, measured.size(), tolerance * 100);
+    return regressions == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1 && strcmp(argv[1], "--replay") == 0)
+        return runReplay(argv + 2, argc - 2);
+
+    uint64_t seed = 1;
+    uint64_t count = 100000;
+    GeneratorOptions options;
+    const char* baseline = NULL;
+    bool record = false;
+    double tolerance = 0.25;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        bool hasValue = arg + 1 < argc;
+        if (strcmp(argv[arg], "--record") == 0)
+            record = true;
+        else if (hasValue && strcmp(argv[arg], "--seed") == 0)
+            seed = strtoull(argv[++arg], NULL, 10);
+        else if (hasValue && strcmp(argv[arg], "--count") == 0)
+            count = strtoull(argv[++arg], NULL, 10);
+        else if (hasValue && strcmp(argv[arg], "--depth") == 0)
+            options.maxDepth = atoi(argv[++arg]);
+        else if (hasValue && strcmp(argv[arg], "--length") == 0)
+            options.maxLength = (size_t)strtoull(argv[++arg], NULL, 10);
+        else if (hasValue && strcmp(argv[arg], "--variables") == 0)
+            options.variables = atoi(argv[++arg]);
+        else if (hasValue && strcmp(argv[arg], "--malformed") == 0)
+            options.malformed = atoi(argv[++arg]);
+        else if (hasValue && strcmp(argv[arg], "--perf") == 0)
+            baseline = argv[++arg];
+        else if (hasValue && strcmp(argv[arg], "--tolerance") == 0)
+            tolerance = atof(argv[++arg]);
+        else
+        {
+            fprintf(stderr, "Fuzz: don't know what %s is\n", argv[arg]);
+            return 2;
+        }
+    }
+
+    if (baseline != NULL)
+        return runPerf(baseline, record, tolerance);
+
+    return runGenerated(seed, count, options);
+}
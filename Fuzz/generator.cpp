@@ -0,0 +1,336 @@
+#include "generator.h"
+
+//The characters damage() puts into an expression, everything the scanner treats specially.
+static const char kJunk[] = "()+-*/^, x1.e<>=!&|?:0";
+
+//The literals the scanner could most easily get wrong: the largest and smallest doubles, the halfway
+//cases, numbers which overflow or underflow and numbers with more digits than a double needs.
+static const char* const kAwkwardLiterals[] = {
+    "1.7976931348623157e308",
+    "1e308",
+    "1e309",
+    "1e400",
+    "4.9e-324",
+    "2.4703282292062327e-324",
+    "2.2250738585072014e-308",
+    "1e-400",
+    "9007199254740993",
+    "0.1000000000000000055511151231257827",
+    "123456789012345678901234567890",
+    "0.30000000000000004",
+    "3.4028235e38",
+    "1.17549435e-38",
+    "0000000000000000000012.5",
+    "0.000000000000000000000000001",
+};
+
+static const int kAwkwardCount = sizeof(kAwkwardLiterals) / sizeof(kAwkwardLiterals[0]);
+
+//NAME: ExpressionGenerator::ExpressionGenerator
+//DESCRIPTION:  Starts the expressions of a seed.
+//INPUT:
+//    seed    - Which expressions to make.
+//    options - Their shape.
+//OUTPUT:
+//    none
+//RETURNS:
+//    none
+ExpressionGenerator::ExpressionGenerator(uint64_t seed, const GeneratorOptions& options)
+    : state(seed), options(options)
+{
+    if (this->options.variables > kFuzzVariableCount)
+        this->options.variables = kFuzzVariableCount;
+}
+
+//NAME: ExpressionGenerator::random
+//DESCRIPTION:  The next random number, splitmix64, so the expressions of a seed don't depend on the
+//              standard library.
+uint64_t ExpressionGenerator::random()
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//NAME: ExpressionGenerator::below
+//DESCRIPTION:  A random number from 0 up to, not including, count.
+uint32_t ExpressionGenerator::below(uint32_t count)
+{
+    return (uint32_t)(((random() >> 32) * count) >> 32);
+}
+
+//NAME: ExpressionGenerator::next
+//DESCRIPTION:  Makes the next expression.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The expression, damaged options.malformed percent of the time.
+std::string ExpressionGenerator::next()
+{
+    std::string eq;
+    expression(eq, 0);
+
+    if ((int)below(100) < options.malformed)
+        damage(eq);
+
+    return eq;
+}
+
+//NAME: ExpressionGenerator::literal
+//DESCRIPTION:  Makes a single literal, to compare its conversion with strtod().
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    The literal.
+std::string ExpressionGenerator::literal()
+{
+    std::string text;
+    switch (below(6))
+    {
+    case 0:
+        return kAwkwardLiterals[below(kAwkwardCount)];
+
+    case 1:
+        //Long mantissas, where rounding the digits which don't fit matters.
+        digits(text, 1 + below(40));
+        break;
+
+    case 2:
+        digits(text, 1 + below(20));
+        text += '.';
+        digits(text, 1 + below(20));
+        break;
+
+    case 3:
+        text += '.';
+        digits(text, 1 + below(25));
+        break;
+
+    default:
+        digits(text, 1 + below(20));
+        if (below(2))
+        {
+            text += '.';
+            digits(text, below(20));
+        }
+        break;
+    }
+
+    if (below(2))
+    {
+        text += below(2) ? 'e' : 'E';
+        if (below(2))
+            text += below(2) ? '-' : '+';
+        digits(text, 1 + below(3));
+    }
+
+    return text;
+}
+
+//NAME: ExpressionGenerator::expression
+//DESCRIPTION:  Appends a random expression.
+//INPUT:
+//    depth   - How deeply the expression is nested already.
+//    negated - It follows a unary minus, which has to touch its operand: the expression may not start
+//              with a space, or with a minus of its own, which the parser doesn't take.
+//INPUT/OUTPUT:
+//    out - Where the expression is appended.
+//RETURNS:
+//    none
+void ExpressionGenerator::expression(std::string& out, int depth, bool negated)
+{
+    if (depth >= options.maxDepth || out.size() >= options.maxLength || below(5) == 0)
+    {
+        leaf(out);
+        return;
+    }
+
+    static const char* const kBinary[] = { "+", "-", "*", "/", "^", "*-", "^-", "/-" };
+    static const char* const kComparisons[] = { "<", "<=", ">", ">=", "==", "!=" };
+    static const char* const kUnaryFunctions[] = { "sqrt", "exp", "log", "abs" };
+
+    if (!negated)
+        space(out);
+
+    uint32_t kind = below(12);
+    if (negated && kind == 0)
+        kind = 1;
+
+    switch (kind)
+    {
+    case 0:
+        out += '-';
+        expression(out, depth + 1, true);
+        break;
+
+    case 1:
+        out += '(';
+        expression(out, depth + 1);
+        out += ')';
+        break;
+
+    case 2:
+        if (below(2) && !negated)
+        {
+            out += "-(";
+            expression(out, depth + 1);
+        }
+        else
+        {
+            out += "(-";
+            expression(out, depth + 1, true);
+        }
+        out += ')';
+        break;
+
+    case 3:
+        out += kUnaryFunctions[below(4)];
+        space(out);
+        out += '(';
+        expression(out, depth + 1);
+        out += ')';
+        break;
+
+    case 4:
+        out += below(2) ? "min(" : "max(";
+        expression(out, depth + 1);
+        out += ',';
+        expression(out, depth + 1);
+        out += ')';
+        break;
+
+    case 5:
+        expression(out, depth + 1, negated);
+        space(out);
+        out += kComparisons[below(6)];
+        expression(out, depth + 1);
+        break;
+
+    case 6:
+        expression(out, depth + 1, negated);
+        out += below(2) ? "&&" : "||";
+        expression(out, depth + 1);
+        break;
+
+    case 7:
+        {
+            bool parenthesised = below(2) != 0;
+            if (parenthesised)
+                out += '(';
+            expression(out, depth + 1, negated && !parenthesised);
+            out += '?';
+            expression(out, depth + 1);
+            out += ':';
+            expression(out, depth + 1);
+            if (parenthesised)
+                out += ')';
+        }
+        break;
+
+    default:
+        {
+            const char* op = kBinary[below(8)];
+            bool unary = op[1] == '-';
+            expression(out, depth + 1, negated);
+            space(out);
+            out += op;
+            if (!unary)
+                space(out);
+            expression(out, depth + 1, unary);
+        }
+        break;
+    }
+    space(out);
+}
+
+//NAME: ExpressionGenerator::leaf
+//DESCRIPTION:  Appends a variable or a literal.  Mostly short literals, which are the common case.
+//INPUT/OUTPUT:
+//    out - Where the operand is appended.
+//RETURNS:
+//    none
+void ExpressionGenerator::leaf(std::string& out)
+{
+    uint32_t kind = below(10);
+    if (kind < 3 && options.variables > 0)
+    {
+        out += kFuzzVariableNames[below(options.variables)];
+        return;
+    }
+
+    if (kind == 3)
+    {
+        out += literal();
+        return;
+    }
+
+    static const char* const kSmall[] = { "0", "1", "2", "3", "0.5", "2.5", "10", "0.1", "1.5", "100", "0.25", "7" };
+    out += kSmall[below(sizeof(kSmall) / sizeof(kSmall[0]))];
+}
+
+//NAME: ExpressionGenerator::digits
+//DESCRIPTION:  Appends random digits.
+//INPUT:
+//    count - How many.
+//INPUT/OUTPUT:
+//    out - Where the digits are appended.
+//RETURNS:
+//    none
+void ExpressionGenerator::digits(std::string& out, int count)
+{
+    for (int i = 0; i < count; i++)
+        out += (char)('0' + below(10));
+}
+
+//NAME: ExpressionGenerator::space
+//DESCRIPTION:  Appends a space a third of the time, and now and then a tab or several spaces.
+//INPUT/OUTPUT:
+//    out - Where the space is appended.
+//RETURNS:
+//    none
+void ExpressionGenerator::space(std::string& out)
+{
+    switch (below(12))
+    {
+    case 0: case 1: case 2: out += ' '; break;
+    case 3: out += below(2) ? "\t" : "   "; break;
+    default: break;
+    }
+}
+
+//NAME: ExpressionGenerator::damage
+//DESCRIPTION:  Breaks an expression on purpose: drops, adds or changes a few characters, and now and
+//              then calls a function which doesn't exist or one with the wrong number of arguments.
+//INPUT/OUTPUT:
+//    out - The expression.
+//RETURNS:
+//    none
+void ExpressionGenerator::damage(std::string& out)
+{
+    int changes = 1 + below(3);
+    for (int i = 0; i < changes && !out.empty(); i++)
+    {
+        size_t at = below((uint32_t)out.size());
+        char junk = kJunk[below(sizeof(kJunk) - 1)];
+        switch (below(3))
+        {
+        case 0: out.erase(at, 1); break;
+        case 1: out.insert(out.begin() + at, junk); break;
+        default: out[at] = junk; break;
+        }
+    }
+
+    switch (below(12))
+    {
+    case 0: out = "foo(" + out + ")"; break;
+    case 1: out = "min(" + out + ")"; break;
+    case 2: out = "abs(" + out + "," + out + ")"; break;
+    case 3: out = out + "?"; break;
+    default: break;
+    }
+}
@@ -0,0 +1,67 @@
+#ifndef CALCULATOR_FUZZ_GENERATOR_H
+#define CALCULATOR_FUZZ_GENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//Random expressions for the differential checks.  They use everything the grammar has: every operator,
+//function and comparison, conditionals, && and ||, parentheses, unary minus and whitespace, variables and
+//literals in every form the scanner handles differently, from single digits to forty digit mantissas,
+//exponents and numbers too large or too small for a double.
+//maxDepth limits how deeply operators nest and maxLength roughly how long an expression gets: once it
+//is reached only leaves are added, so the operators already started can still be finished.
+//Expressions are well formed, with every unary minus touching what it negates, though some have no answer
+//for some values of their variables, such as log(x) for a negative x.  A share of them is damaged on
+//purpose, with characters added, dropped or changed, or a call to a function which doesn't exist, so the
+//error paths are compared as well.
+//The same seed always gives the same expressions, on every platform.
+
+//The variables the generator uses, in the slots the differential checks bind them to.
+static const int kFuzzVariableCount = 4;
+
+static const char* const kFuzzVariableNames[kFuzzVariableCount] = { "x", "y", "rate", "qty" };
+
+//NAME: GeneratorOptions
+//DESCRIPTION:  The shape of the expressions ExpressionGenerator makes.
+struct GeneratorOptions
+{
+    GeneratorOptions() : maxDepth(6), maxLength(160), variables(2), malformed(10) {}
+
+    int maxDepth;       //How deeply operators may nest.
+    size_t maxLength;   //Roughly the longest expression; after this only leaves are added.
+    int variables;      //How many of kFuzzVariableNames may appear, 0 to kFuzzVariableCount.
+    int malformed;      //The percentage of expressions which are damaged on purpose.
+};
+
+//NAME: ExpressionGenerator
+//DESCRIPTION:  Makes random expressions from a seed.
+class ExpressionGenerator
+{
+public:
+    explicit ExpressionGenerator(uint64_t seed, const GeneratorOptions& options = GeneratorOptions());
+
+    std::string next();
+
+    std::string literal();
+
+private:
+    uint64_t random();
+
+    uint32_t below(uint32_t count);
+
+    void expression(std::string& out, int depth, bool negated = false);
+
+    void leaf(std::string& out);
+
+    void digits(std::string& out, int count);
+
+    void space(std::string& out);
+
+    void damage(std::string& out);
+
+    uint64_t state;
+    GeneratorOptions options;
+};
+
+#endif
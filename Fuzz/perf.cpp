@@ -0,0 +1,440 @@
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+
+#include "../Calculator/parser.h"
+#include "../Calculator/iterative.h"
+#include "../Calculator/compiler.h"
+#include "../Calculator/ast.h"
+#include "../Calculator/optimizer.h"
+#include "../Calculator/jit.h"
+#include "../Calculator/batch.h"
+#include "../Calculator/decimal.h"
+#include "../Calculator/gradient.h"
+#include "../Calculator/interval.h"
+
+#include "generator.h"
+#include "perf.h"
+
+//The expressions are always the same ones, so a baseline stays comparable.
+static const uint64_t kCorpusSeed = 27;
+
+static const int kCorpusSize = 64;
+
+//How many times each sample is measured; the best time is kept.
+static const int kRepetitions = 7;
+
+//How long one measurement should take at least, so the clock's resolution doesn't matter.
+static const double kMinimumNanoseconds = 50e6;
+
+//How many rows the batch samples evaluate at once.
+static const size_t kBatchRows = 1024;
+
+//Answers are added up here so the compiler can't drop the work as unused.
+static volatile double gSink;
+
+//NAME: Corpus
+//DESCRIPTION:  The expressions every sample works through, compiled for the samples which need it.
+struct Corpus
+{
+    std::vector<std::string> expressions;
+    VariableTable variables;
+    std::vector<Program> programs;
+    std::vector<Program> optimized;
+};
+
+//NAME: makeCorpus
+//DESCRIPTION:  Generates the expressions, keeping only those solve() has an answer for.
+static void makeCorpus(Corpus& corpus)
+{
+    GeneratorOptions options;
+    options.maxDepth = 5;
+    options.maxLength = 100;
+    options.variables = 2;
+    options.malformed = 0;
+
+    for (int slot = 0; slot < kFuzzVariableCount; slot++)
+        corpus.variables.define(kFuzzVariableNames[slot], 1.25 + slot);
+
+    ExpressionGenerator generator(kCorpusSeed, options);
+    while ((int)corpus.expressions.size() < kCorpusSize)
+    {
+        std::string eq = generator.next();
+        if (!solve(eq.c_str(), corpus.variables).ok())
+            continue;
+
+        Program program = compile(eq.c_str(), corpus.variables);
+        if (!program.ok() || corpus.variables.size() > kFuzzVariableCount)
+            continue;
+
+        corpus.expressions.push_back(eq);
+        corpus.programs.push_back(program);
+        optimize(program);
+        corpus.optimized.push_back(program);
+    }
+}
+
+//NAME: Timing
+//DESCRIPTION:  One sample being measured: the work, how many expressions or rows one run of it is, how
+//              many runs make a measurement, and the best time so far.
+struct Timing
+{
+    const char* name;
+    std::function<double()> work;
+    size_t items;
+    int runs;
+    double best;
+};
+
+//NAME: calibrate
+//DESCRIPTION:  Finds out how many runs of a sample last kMinimumNanoseconds, which also warms the caches up.
+//INPUT/OUTPUT:
+//    timing - The sample.  Its runs are set.
+//RETURNS:
+//    none
+static void calibrate(Timing& timing)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    timing.runs = 1;
+    for (;;)
+    {
+        Clock::time_point start = Clock::now();
+        for (int i = 0; i < timing.runs; i++)
+            gSink = gSink + timing.work();
+        double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        if (elapsed >= kMinimumNanoseconds || timing.runs >= (1 << 24))
+            break;
+        timing.runs *= 2;
+    }
+}
+
+//NAME: timeAll
+//DESCRIPTION:  Measures every sample kRepetitions times, taking turns, and keeps the best time of each.
+//              Taking turns means a moment when the machine is busy with something else slows down one
+//              measurement of several samples rather than every measurement of one.
+//INPUT/OUTPUT:
+//    timings - The samples.  Their best is set, in nanoseconds per expression or row.
+//RETURNS:
+//    none
+static void timeAll(std::vector<Timing>& timings)
+{
+    typedef std::chrono::steady_clock Clock;
+
+    for (Timing& timing : timings)
+        calibrate(timing);
+
+    for (int repetition = 0; repetition < kRepetitions; repetition++)
+    {
+        for (Timing& timing : timings)
+        {
+            Clock::time_point start = Clock::now();
+            for (int i = 0; i < timing.runs; i++)
+                gSink = gSink + timing.work();
+            double elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((double)timing.runs * (double)timing.items);
+            if (repetition == 0 || elapsed < timing.best)
+                timing.best = elapsed;
+        }
+    }
+}
+
+//NAME: measurePerformance
+//DESCRIPTION:  Times every engine over the same expressions.
+//INPUT:
+//    none
+//OUTPUT:
+//    none
+//RETURNS:
+//    One sample per engine.
+std::vector<PerfSample> measurePerformance()
+{
+    Corpus corpus;
+    makeCorpus(corpus);
+
+    const std::vector<std::string>& expressions = corpus.expressions;
+    const VariableTable& variables = corpus.variables;
+    const double* values = variables.values();
+    const size_t count = expressions.size();
+
+    std::vector<Timing> timings;
+    auto sample = [&timings](const char* name, std::function<double()> work, size_t items)
+    {
+        Timing timing = { name, work, items, 1, 0 };
+        timings.push_back(timing);
+    };
+
+    sample("solve", [&]() {
+        double sum = 0;
+        for (const std::string& eq : expressions)
+            sum += solve(eq.c_str(), variables).value;
+        return sum;
+    }, count);
+
+    sample("solve-iterative", [&]() {
+        double sum = 0;
+        for (const std::string& eq : expressions)
+            sum += solveIterative(eq.c_str(), &variables).value;
+        return sum;
+    }, count);
+
+    sample("solve-float", [&]() {
+        double sum = 0;
+        for (const std::string& eq : expressions)
+            sum += solve<float>(eq.c_str(), variables).value;
+        return sum;
+    }, count);
+
+    sample("solve-decimal", [&]() {
+        double sum = 0;
+        for (const std::string& eq : expressions)
+            sum += solve<Decimal128>(eq.c_str(), variables).value.toDouble();
+        return sum;
+    }, count);
+
+    sample("compile", [&]() {
+        double sum = 0;
+        VariableTable table = variables;
+        for (const std::string& eq : expressions)
+            sum += (double)compile(eq.c_str(), table).code.size();
+        return sum;
+    }, count);
+
+    sample("evaluate", [&]() {
+        double sum = 0;
+        for (const Program& program : corpus.programs)
+            sum += evaluate(program, values);
+        return sum;
+    }, count);
+
+    sample("evaluate-optimized", [&]() {
+        double sum = 0;
+        for (const Program& program : corpus.optimized)
+            sum += evaluate(program, values);
+        return sum;
+    }, count);
+
+    Arena arena;
+    std::vector<Ast> trees;
+    for (const std::string& eq : expressions)
+    {
+        VariableTable table = variables;
+        trees.push_back(parseTree(eq.c_str(), arena, table));
+    }
+
+    sample("evaluate-tree", [&]() {
+        double sum = 0;
+        for (const Ast& tree : trees)
+            sum += evaluate(tree, values);
+        return sum;
+    }, count);
+
+    //The samples are only measured once they are all set up, so what they use has to live until then.
+    std::vector<NativeCode> native(jitSupported() ? count : 0);
+    int spills = 0;
+    for (size_t i = 0; i < native.size(); i++)
+    {
+        native[i].compile(corpus.optimized[i]);
+        if (native[i].spillCount() > spills)
+            spills = native[i].spillCount();
+    }
+
+    std::vector<double> spill(spills + 1);
+    if (!native.empty())
+    {
+        sample("evaluate-native", [&]() {
+            double sum = 0;
+            for (const NativeCode& code : native)
+                sum += code.function() != NULL ? code.function()(values, spill.data()) : 0;
+            return sum;
+        }, count);
+    }
+
+    //Every variable gets a column of its own, each row a little different.
+    std::vector<double> doubles(kFuzzVariableCount * kBatchRows);
+    std::vector<float> floats(doubles.size());
+    std::vector<const double*> doubleColumns(kFuzzVariableCount);
+    std::vector<const float*> floatColumns(kFuzzVariableCount);
+    for (int slot = 0; slot < kFuzzVariableCount; slot++)
+    {
+        for (size_t row = 0; row < kBatchRows; row++)
+        {
+            doubles[slot * kBatchRows + row] = values[slot] + (double)row / kBatchRows;
+            floats[slot * kBatchRows + row] = (float)doubles[slot * kBatchRows + row];
+        }
+
+        doubleColumns[slot] = &doubles[slot * kBatchRows];
+        floatColumns[slot] = &floats[slot * kBatchRows];
+    }
+
+    std::vector<double> doubleAnswers(kBatchRows);
+    std::vector<float> floatAnswers(kBatchRows);
+    sample("batch-double", [&]() {
+        double sum = 0;
+        for (const Program& program : corpus.optimized)
+        {
+            evaluateBatch(program, doubleColumns.data(), doubleAnswers.data(), kBatchRows);
+            sum += doubleAnswers[kBatchRows - 1];
+        }
+        return sum;
+    }, count * kBatchRows);
+
+    sample("batch-float", [&]() {
+        double sum = 0;
+        for (const Program& program : corpus.optimized)
+        {
+            evaluateBatch(program, floatColumns.data(), floatAnswers.data(), kBatchRows);
+            sum += floatAnswers[kBatchRows - 1];
+        }
+        return sum;
+    }, count * kBatchRows);
+
+    Arena tapes;
+    std::vector<double> gradient(kFuzzVariableCount);
+    sample("gradient", [&]() {
+        double sum = 0;
+        for (const Program& program : corpus.optimized)
+        {
+            sum += evaluateGradient(program, values, gradient.data(), tapes);
+            tapes.reset();
+        }
+        return sum;
+    }, count);
+
+    std::vector<double> slopes(kFuzzVariableCount * kBatchRows);
+    std::vector<double*> slopeColumns(kFuzzVariableCount);
+    for (int slot = 0; slot < kFuzzVariableCount; slot++)
+        slopeColumns[slot] = &slopes[slot * kBatchRows];
+
+    sample("gradient-batch", [&]() {
+        double sum = 0;
+        for (const Program& program : corpus.optimized)
+        {
+            evaluateGradientBatch(program, doubleColumns.data(), doubleAnswers.data(), slopeColumns.data(), kBatchRows, tapes);
+            tapes.reset();
+            sum += slopes[kBatchRows - 1];
+        }
+        return sum;
+    }, count * kBatchRows);
+
+    std::vector<Interval> ranges(kFuzzVariableCount);
+    for (int slot = 0; slot < kFuzzVariableCount; slot++)
+        ranges[slot] = Interval(values[slot], values[slot] + 1);
+
+    sample("interval", [&]() {
+        double sum = 0;
+        for (const Program& program : corpus.optimized)
+            sum += evaluate(program, ranges.data()).hi;
+        return sum;
+    }, count);
+
+    timeAll(timings);
+
+    std::vector<PerfSample> samples;
+    for (const Timing& timing : timings)
+    {
+        PerfSample measured = { timing.name, timing.best };
+        samples.push_back(measured);
+    }
+
+    return samples;
+}
+
+//NAME: readBaseline
+//DESCRIPTION:  Reads the samples of a baseline file.
+//INPUT:
+//    path - The file.
+//OUTPUT:
+//    baseline - The samples.
+//RETURNS:
+//    False if the file can't be read.
+bool readBaseline(const char* path, std::vector<PerfSample>& baseline)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+        return false;
+
+    baseline.clear();
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#')
+            continue;
+
+        char name[128];
+        double nanoseconds = 0;
+        if (sscanf(line, "%127s %lf", name, &nanoseconds) == 2)
+        {
+            PerfSample sample = { name, nanoseconds };
+            baseline.push_back(sample);
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+//NAME: writeBaseline
+//DESCRIPTION:  Writes samples as a baseline file.
+//INPUT:
+//    path     - The file.
+//    measured - The samples.
+//OUTPUT:
+//    none
+//RETURNS:
+//    False if the file can't be written.
+bool writeBaseline(const char* path, const std::vector<PerfSample>& measured)
+{
+    FILE* file = fopen(path, "w");
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "# Nanoseconds per expression, or per row for the batch samples.  Only comparable on the machine\n");
+    fprintf(file, "# and build it was recorded with; record it again with: Fuzz --perf %s --record\n", path);
+    for (const PerfSample& sample : measured)
+        fprintf(file, "%s %.1f\n", sample.name.c_str(), sample.nanoseconds);
+
+    bool written = ferror(file) == 0;
+    return fclose(file) == 0 && written;
+}
+
+//NAME: compareBaseline
+//DESCRIPTION:  Compares measured samples with a baseline and prints the comparison.
+//INPUT:
+//    baseline  - The samples recorded before.
+//    measured  - The samples just measured.
+//    tolerance - How much slower a sample may be, 0.25 for 25%.
+//    out       - Where to print the comparison.
+//OUTPUT:
+//    none
+//RETURNS:
+//    How many samples are slower than the tolerance allows.  One which isn't in the baseline never is.
+int compareBaseline(const std::vector<PerfSample>& baseline, const std::vector<PerfSample>& measured, double tolerance, FILE* out)
+{
+    int regressions = 0;
+    for (const PerfSample& sample : measured)
+    {
+        const PerfSample* recorded = NULL;
+        for (const PerfSample& candidate : baseline)
+        {
+            if (candidate.name == sample.name && candidate.nanoseconds > 0)
+                recorded = &candidate;
+        }
+
+        if (recorded == NULL)
+        {
+            fprintf(out, "%-20s %10.1f ns  (not in the baseline)\n", sample.name.c_str(), sample.nanoseconds);
+            continue;
+        }
+
+        double change = sample.nanoseconds / recorded->nanoseconds - 1;
+        bool regressed = change > tolerance;
+        if (regressed)
+            regressions++;
+
+        fprintf(out, "%-20s %10.1f ns  baseline %10.1f ns  %+6.1f%%%s\n", sample.name.c_str(), sample.nanoseconds,
+                recorded->nanoseconds, change * 100, regressed ? "  SLOWER" : "");
+    }
+
+    return regressions;
+}
@@ -0,0 +1,42 @@
+#ifndef CALCULATOR_FUZZ_PERF_H
+#define CALCULATOR_FUZZ_PERF_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//A fast path which gives the right answers but has quietly become slow is caught by timing every engine
+//over the same fixed set of expressions and comparing the times with a baseline kept in the repository.
+//Each time is the best of several runs, the one least disturbed by whatever else the machine is doing,
+//in nanoseconds per expression or per row.  The Benchmark project measures far more carefully; this only
+//has to notice when something has become a good deal slower than it was.
+//
+//A baseline only means something on the machine it was recorded on, with the same compiler and settings.
+//Record it again with --record whenever either changes, or when something has been made faster on purpose.
+//On a busy or shared machine the times can drift by more than the default 25%, so the gate is only worth
+//trusting on a quiet one; --tolerance loosens it elsewhere.
+//
+//The baseline file has one sample per line, its name and its time, and # starts a comment:
+//     # Fuzz --perf baseline.txt --record
+//     solve 312.5
+//     evaluate 41.2
+
+//NAME: PerfSample
+//DESCRIPTION:  How long one engine takes.
+struct PerfSample
+{
+    std::string name;
+    double nanoseconds;
+};
+
+//Function declarations
+std::vector<PerfSample> measurePerformance();
+
+bool readBaseline(const char* path, std::vector<PerfSample>& baseline);
+
+bool writeBaseline(const char* path, const std::vector<PerfSample>& measured);
+
+int compareBaseline(const std::vector<PerfSample>& baseline, const std::vector<PerfSample>& measured, double tolerance, FILE* out);
+
+#endif
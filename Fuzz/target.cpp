@@ -0,0 +1,43 @@
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "differential.h"
+
+//The entry point libFuzzer calls with every input it comes up with.  Built together with driver.cpp it
+//is what --replay runs the files it is given through; built with -fsanitize=fuzzer instead, libFuzzer
+//supplies main() and mutates its way from the corpus towards new paths through the parser.
+
+//Longer inputs only take time; the parser's limits on nesting are reached well before this.
+static const size_t kMaxInput = 4096;
+
+//NAME: LLVMFuzzerTestOneInput
+//DESCRIPTION:  Checks one input as an expression and as a literal, and stops the fuzzer at the first
+//              engine which doesn't agree so the input is saved.
+//INPUT:
+//    data - The input, not NUL terminated.
+//    size - How many bytes it has.
+//OUTPUT:
+//    none
+//RETURNS:
+//    0, as libFuzzer expects.
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    if (size > kMaxInput)
+        return 0;
+
+    //A NUL in the middle simply ends the expression early, as it would for any caller.
+    std::string eq((const char*)data, size);
+
+    DifferentialReport report;
+    checkExpression(eq.c_str(), report);
+    checkLiteral(eq.c_str(), report);
+    if (report.ok())
+        return 0;
+
+    for (const Divergence& divergence : report.divergences)
+        fprintf(stderr, "%s: \"%s\": %s\n", divergence.engine.c_str(), divergence.expression.c_str(), divergence.detail.c_str());
+
+    abort();
+}
@@ -0,0 +1,12 @@
+#Merges the raw profiles Clang wrote while pgo-train ran into the one a CALC_PGO=USE build reads.
+#     cmake -DPROFDATA=llvm-profdata -DDIRECTORY=build/pgo -P merge_profiles.cmake
+file(GLOB profiles "${DIRECTORY}/*.profraw")
+if(NOT profiles)
+    message(FATAL_ERROR "There are no profiles in ${DIRECTORY}; run pgo-train on a CALC_PGO=GENERATE build first.")
+endif()
+
+execute_process(COMMAND "${PROFDATA}" merge -output=${DIRECTORY}/calculator.profdata ${profiles}
+                RESULT_VARIABLE merged)
+if(NOT merged EQUAL 0)
+    message(FATAL_ERROR "llvm-profdata couldn't merge the profiles in ${DIRECTORY}.")
+endif()